@@ -0,0 +1,91 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusLogMessageQueue.h"
+
+// STL includes
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+PlusLogMessageQueue::PlusLogMessageQueue(int capacity)
+  : m_Head(nullptr)
+  , m_Size(0)
+  , m_NumberOfDroppedMessages(0)
+  , m_Capacity(capacity)
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusLogMessageQueue::~PlusLogMessageQueue()
+{
+  Node* node = m_Head.fetchAndStoreAcquire(nullptr);
+  while (node != nullptr)
+  {
+    Node* next = node->Next;
+    delete node;
+    node = next;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool PlusLogMessageQueue::Push(const std::string& message)
+{
+  // Reserve a place first, so that concurrent producers cannot exceed the capacity
+  if (m_Size.fetchAndAddRelaxed(1) >= m_Capacity)
+  {
+    m_Size.fetchAndAddRelaxed(-1);
+    m_NumberOfDroppedMessages.fetchAndAddRelaxed(1);
+    return false;
+  }
+
+  Node* node = new Node;
+  node->Message = message;
+  Node* head = nullptr;
+  do
+  {
+    head = m_Head.loadAcquire();
+    node->Next = head;
+  }
+  while (!m_Head.testAndSetRelease(head, node));
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void PlusLogMessageQueue::TakeAll(std::vector<std::string>& messages)
+{
+  // The list is taken as a whole, so there is no ABA problem with the concurrent pushes
+  Node* node = m_Head.fetchAndStoreAcquire(nullptr);
+
+  // The list is in reverse order
+  std::vector<std::string>::size_type firstIndex = messages.size();
+  int numberOfMessages = 0;
+  while (node != nullptr)
+  {
+    messages.push_back(std::string());
+    messages.back().swap(node->Message);
+    Node* next = node->Next;
+    delete node;
+    node = next;
+    ++numberOfMessages;
+  }
+  std::reverse(messages.begin() + firstIndex, messages.end());
+
+  m_Size.fetchAndAddRelaxed(-numberOfMessages);
+}
+
+//-----------------------------------------------------------------------------
+int PlusLogMessageQueue::GetSize() const
+{
+  return m_Size.loadAcquire();
+}
+
+//-----------------------------------------------------------------------------
+int PlusLogMessageQueue::TakeNumberOfDroppedMessages()
+{
+  return m_NumberOfDroppedMessages.fetchAndStoreRelaxed(0);
+}
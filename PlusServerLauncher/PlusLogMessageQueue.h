@@ -0,0 +1,68 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusLogMessageQueue_h
+#define __PlusLogMessageQueue_h
+
+#include "PlusConfigure.h"
+
+// Qt includes
+#include <QAtomicInt>
+#include <QAtomicPointer>
+
+// STL includes
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+/*!
+  \class PlusLogMessageQueue
+  \brief Bounded lock-free queue of log messages with multiple producers and a single consumer
+
+  Log messages may be logged on any thread, so they are pushed without locking onto a linked list. The consumer
+  takes the whole list at once and restores the order of the messages. If the queue is full then the message is
+  dropped and counted, so a flood of log messages cannot grow the memory usage without limit.
+  \ingroup PlusAppPlusServerLauncher
+ */
+class PlusLogMessageQueue
+{
+public:
+  PlusLogMessageQueue(int capacity);
+  ~PlusLogMessageQueue();
+
+  /*! Add a message to the queue (may be called from any thread). Returns false if the queue is full and the message is dropped. */
+  bool Push(const std::string& message);
+
+  /*! Append all queued messages to the vector, in the order they were pushed (must be called from a single thread) */
+  void TakeAll(std::vector<std::string>& messages);
+
+  /*! Approximate number of queued messages */
+  int GetSize() const;
+
+  /*! Returns the number of messages dropped since the previous call */
+  int TakeNumberOfDroppedMessages();
+
+protected:
+  struct Node
+  {
+    std::string Message;
+    Node* Next;
+  };
+
+  /*! Most recently pushed message, NULL if the queue is empty */
+  QAtomicPointer<Node> m_Head;
+
+  QAtomicInt m_Size;
+  QAtomicInt m_NumberOfDroppedMessages;
+  int m_Capacity;
+
+private:
+  PlusLogMessageQueue(const PlusLogMessageQueue&);
+  void operator=(const PlusLogMessageQueue&);
+};
+
+#endif
@@ -72,12 +72,39 @@ namespace
 
 const int SYSTEM_TRAY_MESSAGE_TIMEOUT_MS = 1000;
 
+// The connector receives messages on its own thread, they are delivered as events when the connector is processed.
+// No commands can arrive while no client is connected, so the connector is processed rarely then.
+const int REMOTE_CONTROL_NO_CLIENT_PROCESS_INTERVAL_MS = 50;
+const int REMOTE_CONTROL_CONNECTED_PROCESS_INTERVAL_MS = 5;
+
+// Log messages are forwarded to the subscribed clients in batches, periodically or earlier if a full batch is waiting.
+// If messages are logged faster than they can be sent then the queue fills up and the new messages are dropped
+// (the number of dropped messages is reported).
+const int REMOTE_CONTROL_LOG_FLUSH_INTERVAL_MS = 100;
+const int REMOTE_CONTROL_LOG_MAX_MESSAGES_PER_COMMAND = 200;
+const int REMOTE_CONTROL_LOG_QUEUE_CAPACITY = 20000;
+
+namespace
+{
+  /*! Consecutive log messages with the same level and origin */
+  struct LogMessageBatch
+  {
+    std::string LogLevel;
+    std::string Origin;
+    std::vector<std::string> Messages;
+  };
+}
+
 //-----------------------------------------------------------------------------
 PlusServerLauncherMainWindow::PlusServerLauncherMainWindow(QWidget* parent /*=0*/, Qt::WindowFlags flags/*=0*/, bool autoConnect /*=false*/, int remoteControlServerPort/*=RemoteControlServerPortUseDefault*/)
   : QMainWindow(parent, flags)
   , m_DeviceSetSelectorWidget(NULL)
   , m_RemoteControlServerPort(remoteControlServerPort)
   , m_RemoteControlServerConnectorProcessTimer(new QTimer())
+  , m_RemoteControlLogMessageQueue(REMOTE_CONTROL_LOG_QUEUE_CAPACITY)
+  , m_RemoteControlLogForwardingEnabled(0)
+  , m_RemoteControlLogFlushRequested(0)
+  , m_RemoteControlLogFlushTimer(new QTimer())
 {
   m_RemoteControlServerCallbackCommand = vtkSmartPointer<vtkCallbackCommand>::New();
   m_RemoteControlServerCallbackCommand->SetCallback(PlusServerLauncherMainWindow::OnRemoteControlServerEventReceived);
@@ -230,10 +257,14 @@ PlusServerLauncherMainWindow::PlusServerLauncherMainWindow(QWidget* parent /*=0*
   connect(ui.checkBox_writePermission, &QCheckBox::clicked, this, &PlusServerLauncherMainWindow::OnWritePermissionClicked);
 
   connect(m_RemoteControlServerConnectorProcessTimer, &QTimer::timeout, this, &PlusServerLauncherMainWindow::OnTimerTimeout);
+  connect(m_RemoteControlLogFlushTimer, &QTimer::timeout, this, &PlusServerLauncherMainWindow::FlushRemoteControlLogMessages);
 
   connect(ui.pushButton_LatestLog, &QPushButton::clicked, this, &PlusServerLauncherMainWindow::LatestLogClicked);
 
-  m_RemoteControlServerConnectorProcessTimer->start(5);
+  if (m_RemoteControlServerConnector)
+  {
+    m_RemoteControlServerConnectorProcessTimer->start(REMOTE_CONTROL_NO_CLIENT_PROCESS_INTERVAL_MS);
+  }
 
   ReadConfiguration();
 }
@@ -274,6 +305,11 @@ PlusServerLauncherMainWindow::~PlusServerLauncherMainWindow()
   delete m_RemoteControlServerConnectorProcessTimer;
   m_RemoteControlServerConnectorProcessTimer = nullptr;
 
+  m_RemoteControlLogForwardingEnabled.storeRelease(0);
+  disconnect(m_RemoteControlLogFlushTimer, &QTimer::timeout, this, &PlusServerLauncherMainWindow::FlushRemoteControlLogMessages);
+  delete m_RemoteControlLogFlushTimer;
+  m_RemoteControlLogFlushTimer = nullptr;
+
   disconnect(ui.checkBox_writePermission, &QCheckBox::clicked, this, &PlusServerLauncherMainWindow::OnWritePermissionClicked);
   disconnect(m_RemoteControlServerConnectorProcessTimer, &QTimer::timeout, this, &PlusServerLauncherMainWindow::OnTimerTimeout);
   disconnect(ui.pushButton_LatestLog, &QPushButton::clicked, this, &PlusServerLauncherMainWindow::LatestLogClicked);
@@ -1100,6 +1136,7 @@ void PlusServerLauncherMainWindow::OnClientDisconnectedEvent()
     m_RemoteControlLogSubscribedClients.erase(unsubscribedClients.front());
     unsubscribedClients.pop();
   }
+  UpdateRemoteControlLogForwarding();
 }
 
 //---------------------------------------------------------------------------
@@ -1138,11 +1175,13 @@ void PlusServerLauncherMainWindow::OnCommandReceivedEvent(igtlioCommandPointer c
   else if (igsioCommon::IsEqualInsensitive(name, "LogSubscribe"))
   {
     m_RemoteControlLogSubscribedClients.insert(command->GetClientId());
+    UpdateRemoteControlLogForwarding();
     return;
   }
   else if (igsioCommon::IsEqualInsensitive(name, "LogUnsubscribe"))
   {
     m_RemoteControlLogSubscribedClients.erase(command->GetClientId());
+    UpdateRemoteControlLogForwarding();
     return;
   }
   else if (igsioCommon::IsEqualInsensitive(name, "GetRunningServers"))
@@ -1489,6 +1528,19 @@ void PlusServerLauncherMainWindow::OnTimerTimeout()
   if (m_RemoteControlServerConnector != nullptr)
   {
     m_RemoteControlServerConnector->PeriodicProcess();
+    UpdateRemoteControlServerProcessInterval();
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusServerLauncherMainWindow::UpdateRemoteControlServerProcessInterval()
+{
+  int intervalMs = (m_RemoteControlServerConnector->GetClientIds().empty() ? REMOTE_CONTROL_NO_CLIENT_PROCESS_INTERVAL_MS : REMOTE_CONTROL_CONNECTED_PROCESS_INTERVAL_MS);
+
+  // Setting the interval restarts the timer, so only change it if needed
+  if (m_RemoteControlServerConnectorProcessTimer->interval() != intervalMs)
+  {
+    m_RemoteControlServerConnectorProcessTimer->setInterval(intervalMs);
   }
 }
 
@@ -1551,90 +1603,208 @@ void PlusServerLauncherMainWindow::OnLogEvent(vtkObject* caller, unsigned long e
 {
   PlusServerLauncherMainWindow* self = reinterpret_cast<PlusServerLauncherMainWindow*>(clientData);
 
-  // Return if we are not connected. No client to send log messages to
-  if (!self->m_RemoteControlServerConnector || !self->m_RemoteControlServerConnector->IsConnected())
+  // Messages may be logged on any thread, so they are only queued here and sent by FlushRemoteControlLogMessages.
+  // Nothing is logged here, so the observer does not have to be removed to prevent an infinite loop of logging.
+  if (self->m_RemoteControlLogForwardingEnabled.loadAcquire() == 0)
+  {
+    // No client is subscribed to log messages
+    return;
+  }
+
+  std::string logMessage;
+  if (event == vtkPlusLogger::MessageLogged)
+  {
+    const char* logMessageChar = static_cast<char*>(callData);
+    logMessage = QString::fromLatin1(logMessageChar).toStdString();
+  }
+  else if (event == vtkPlusLogger::WideMessageLogged)
+  {
+    const wchar_t* logMessageWChar = static_cast<wchar_t*>(callData);
+    logMessage = QString::fromWCharArray(logMessageWChar).toStdString();
+  }
+  if (logMessage.empty())
   {
     return;
   }
 
-  // Return if the client has not subscribed to log messages
-  if (self->m_RemoteControlLogSubscribedClients.empty())
+  if (!self->m_RemoteControlLogMessageQueue.Push(logMessage))
   {
+    // Queue is full, the message is counted as dropped
     return;
   }
 
-  // We don't want to end up in an infinite loop of logging if something goes wrong, so remove the log observer
-  vtkPlusLogger::Instance()->RemoveObserver(self->m_RemoteControlLogMessageCallbackCommand);
+  // Do not wait for the flush timer if a full command is waiting
+  if (self->m_RemoteControlLogMessageQueue.GetSize() >= REMOTE_CONTROL_LOG_MAX_MESSAGES_PER_COMMAND
+      && self->m_RemoteControlLogFlushRequested.testAndSetOrdered(0, 1))
+  {
+    QMetaObject::invokeMethod(self, "FlushRemoteControlLogMessages", Qt::QueuedConnection);
+  }
+}
 
-  QString logMessage = QString();
-  if (event == vtkPlusLogger::MessageLogged)
+//---------------------------------------------------------------------------
+void PlusServerLauncherMainWindow::FlushRemoteControlLogMessages()
+{
+  m_RemoteControlLogFlushRequested.storeRelease(0);
+
+  std::vector<std::string> logMessages;
+  m_RemoteControlLogMessageQueue.TakeAll(logMessages);
+
+  int numberOfDroppedMessages = m_RemoteControlLogMessageQueue.TakeNumberOfDroppedMessages();
+  if (numberOfDroppedMessages > 0)
   {
-    const char* logMessageChar = static_cast<char*>(callData);
-    logMessage = logMessage.fromLatin1(logMessageChar);
+    // The queue has just been emptied, so this message is forwarded with the next batch
+    LOG_WARNING(numberOfDroppedMessages << " log messages were not forwarded to remote clients because messages were logged faster than they could be sent");
   }
-  else if (event == vtkPlusLogger::WideMessageLogged)
+
+  if (logMessages.empty() || m_RemoteControlLogSubscribedClients.empty()
+      || !m_RemoteControlServerConnector || !m_RemoteControlServerConnector->IsConnected())
   {
-    const wchar_t* logMessageWChar = static_cast<wchar_t*>(callData);
-    logMessage = logMessage.fromWCharArray(logMessageWChar);
+    return;
   }
 
-  if (!logMessage.isEmpty())
+  // Split the log lines into level, origin and message and group the consecutive lines with the same level and origin
+  std::vector<LogMessageBatch> batches;
+  for (std::vector<std::string>::const_iterator logMessageIt = logMessages.begin(); logMessageIt != logMessages.end(); ++logMessageIt)
   {
+    QString logMessage = QString::fromStdString(*logMessageIt);
 #if (QT_VERSION >= QT_VERSION_CHECK(5,14,0))
     QStringList tokens = logMessage.split('|', Qt::SkipEmptyParts);
 #else
     QStringList tokens = logMessage.split('|', QString::SkipEmptyParts);
 #endif
-    if (tokens.size() > 0)
+    if (tokens.size() == 0)
+    {
+      continue;
+    }
+
+    std::string logLevel = tokens[0].toStdString();
+    std::string messageOrigin;
+    if (tokens.size() > 2 && logMessageIt->find("SERVER>") != std::string::npos)
+    {
+      messageOrigin = "SERVER";
+    }
+    else
+    {
+      messageOrigin = "LAUNCHER";
+    }
+
+    std::stringstream message;
+    for (int i = 1; i < tokens.size(); ++i)
+    {
+      message << "|" << tokens[i].toStdString();
+    }
+
+    if (batches.empty() || batches.back().LogLevel != logLevel || batches.back().Origin != messageOrigin
+        || batches.back().Messages.size() >= REMOTE_CONTROL_LOG_MAX_MESSAGES_PER_COMMAND)
     {
-      std::string logLevel = tokens[0].toStdString();
-      std::string messageOrigin;
-      if (tokens.size() > 2 && logMessage.toStdString().find("SERVER>") != std::string::npos)
+      batches.push_back(LogMessageBatch());
+      batches.back().LogLevel = logLevel;
+      batches.back().Origin = messageOrigin;
+    }
+    batches.back().Messages.push_back(message.str());
+  }
+
+  for (std::set<int>::iterator subscribedClientsIt = m_RemoteControlLogSubscribedClients.begin(); subscribedClientsIt != m_RemoteControlLogSubscribedClients.end(); ++subscribedClientsIt)
+  {
+    int clientId = *subscribedClientsIt;
+    int& numberOfUnsentMessages = m_RemoteControlLogNumberOfUnsentMessages[clientId];
+
+    bool sendFailed = false;
+    if (numberOfUnsentMessages > 0)
+    {
+      // Let the client know about the gap in the log
+      std::stringstream notice;
+      notice << "|" << numberOfUnsentMessages << " log messages could not be sent to this client";
+      if (SendRemoteControlLogMessages(clientId, "WARNING", "LAUNCHER", std::vector<std::string>(1, notice.str())) == PLUS_SUCCESS)
       {
-        messageOrigin = "SERVER";
+        numberOfUnsentMessages = 0;
       }
       else
       {
-        messageOrigin = "LAUNCHER";
+        sendFailed = true;
       }
+    }
 
-      std::stringstream message;
-      for (int i = 1; i < tokens.size(); ++i)
+    for (std::vector<LogMessageBatch>::const_iterator batchIt = batches.begin(); batchIt != batches.end(); ++batchIt)
+    {
+      // If the client does not keep up then the rest of the messages are not sent now, only counted
+      if (sendFailed || SendRemoteControlLogMessages(clientId, batchIt->LogLevel, batchIt->Origin, batchIt->Messages) != PLUS_SUCCESS)
       {
-        message << "|" << tokens[i].toStdString();
+        sendFailed = true;
+        numberOfUnsentMessages += static_cast<int>(batchIt->Messages.size());
       }
-      std::string logMessageString = message.str();
+    }
+  }
+}
 
-      vtkSmartPointer<vtkXMLDataElement> commandElement = vtkSmartPointer<vtkXMLDataElement>::New();
-      commandElement->SetName("Command");
-      vtkSmartPointer<vtkXMLDataElement> messageElement = vtkSmartPointer<vtkXMLDataElement>::New();
-      messageElement->SetName("LogMessage");
-      messageElement->SetAttribute("Message", logMessageString.c_str());
-      messageElement->SetAttribute("LogLevel", logLevel.c_str());
-      messageElement->SetAttribute("Origin", messageOrigin.c_str());
-      commandElement->AddNestedElement(messageElement);
+//---------------------------------------------------------------------------
+PlusStatus PlusServerLauncherMainWindow::SendRemoteControlLogMessages(int clientId, const std::string& logLevel, const std::string& origin, const std::vector<std::string>& messages)
+{
+  vtkSmartPointer<vtkXMLDataElement> commandElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  commandElement->SetName("Command");
+  std::string joinedMessages;
+  for (std::vector<std::string>::const_iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+  {
+    vtkSmartPointer<vtkXMLDataElement> messageElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    messageElement->SetName("LogMessage");
+    messageElement->SetAttribute("Message", messageIt->c_str());
+    messageElement->SetAttribute("LogLevel", logLevel.c_str());
+    messageElement->SetAttribute("Origin", origin.c_str());
+    commandElement->AddNestedElement(messageElement);
 
-      std::stringstream messageCommand;
-      vtkXMLUtilities::FlattenElement(commandElement, messageCommand);
+    if (!joinedMessages.empty())
+    {
+      joinedMessages += "\n";
+    }
+    joinedMessages += *messageIt;
+  }
+
+  std::stringstream messageCommand;
+  vtkXMLUtilities::FlattenElement(commandElement, messageCommand);
+
+  igtlioCommandPointer logMessageCommand = igtlioCommandPointer::New();
+  logMessageCommand->SetClientId(clientId);
+  logMessageCommand->BlockingOff();
+  logMessageCommand->SetName("LogMessage");
+  logMessageCommand->SetCommandContent(messageCommand.str());
+  logMessageCommand->SetCommandMetaDataElement("Message", joinedMessages);
+  logMessageCommand->SetCommandMetaDataElement("LogLevel", logLevel);
+  logMessageCommand->SetCommandMetaDataElement("Origin", origin);
+  logMessageCommand->SetCommandMetaDataElement("MessageCount", igsioCommon::ToString<int>(static_cast<int>(messages.size())));
+  return SendCommand(logMessageCommand);
+}
 
-      for (std::set<int>::iterator subscribedClientsIt = self->m_RemoteControlLogSubscribedClients.begin(); subscribedClientsIt != self->m_RemoteControlLogSubscribedClients.end(); ++subscribedClientsIt)
-      {
-        igtlioCommandPointer logMessageCommand = igtlioCommandPointer::New();
-        logMessageCommand->SetClientId(*subscribedClientsIt);
-        logMessageCommand->BlockingOff();
-        logMessageCommand->SetName("LogMessage");
-        logMessageCommand->SetCommandContent(messageCommand.str());
-        logMessageCommand->SetCommandMetaDataElement("Message", logMessageString);
-        logMessageCommand->SetCommandMetaDataElement("LogLevel", logLevel);
-        logMessageCommand->SetCommandMetaDataElement("Origin", messageOrigin);
-        self->SendCommand(logMessageCommand);
-      }
+//---------------------------------------------------------------------------
+void PlusServerLauncherMainWindow::UpdateRemoteControlLogForwarding()
+{
+  // Forget the unsent message counts of the clients that are not subscribed anymore
+  for (std::map<int, int>::iterator unsentIt = m_RemoteControlLogNumberOfUnsentMessages.begin(); unsentIt != m_RemoteControlLogNumberOfUnsentMessages.end();)
+  {
+    if (m_RemoteControlLogSubscribedClients.find(unsentIt->first) == m_RemoteControlLogSubscribedClients.end())
+    {
+      m_RemoteControlLogNumberOfUnsentMessages.erase(unsentIt++);
+    }
+    else
+    {
+      ++unsentIt;
     }
   }
 
-  // Re-apply the log observers
-  vtkPlusLogger::Instance()->AddObserver(vtkPlusLogger::MessageLogged, self->m_RemoteControlLogMessageCallbackCommand);
-  vtkPlusLogger::Instance()->AddObserver(vtkPlusLogger::WideMessageLogged, self->m_RemoteControlLogMessageCallbackCommand);
+  bool enabled = !m_RemoteControlLogSubscribedClients.empty();
+  m_RemoteControlLogForwardingEnabled.storeRelease(enabled ? 1 : 0);
+  if (enabled && !m_RemoteControlLogFlushTimer->isActive())
+  {
+    m_RemoteControlLogFlushTimer->start(REMOTE_CONTROL_LOG_FLUSH_INTERVAL_MS);
+  }
+  else if (!enabled && m_RemoteControlLogFlushTimer->isActive())
+  {
+    m_RemoteControlLogFlushTimer->stop();
+
+    // Nobody is interested in the remaining messages
+    std::vector<std::string> discardedMessages;
+    m_RemoteControlLogMessageQueue.TakeAll(discardedMessages);
+    m_RemoteControlLogMessageQueue.TakeNumberOfDroppedMessages();
+  }
 }
 
 //---------------------------------------------------------------------------
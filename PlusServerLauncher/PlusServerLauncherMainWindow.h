@@ -8,6 +8,7 @@
 #define __PlusServerLauncherMainWindow_h
 
 #include "PlusConfigure.h"
+#include "PlusLogMessageQueue.h"
 #include "ui_PlusServerLauncherMainWindow.h"
 
 // Qt includes
@@ -93,6 +94,9 @@ protected slots:
 
   void OnTimerTimeout();
 
+  /*! Send the queued log messages to the clients subscribed to log messages */
+  void FlushRemoteControlLogMessages();
+
   void StopRemoteServerButtonClicked();
 
   void SystemTrayIconActivated(QSystemTrayIcon::ActivationReason reason);
@@ -177,6 +181,15 @@ protected:
 
   void ShowNotification(QString message, QString title="PlusServerLauncher");
 
+  /*! Start or stop forwarding log messages to remote clients, according to the subscribed clients */
+  void UpdateRemoteControlLogForwarding();
+
+  /*! Send log messages with the same level and origin to a client in one LogMessage command */
+  PlusStatus SendRemoteControlLogMessages(int clientId, const std::string& logLevel, const std::string& origin, const std::vector<std::string>& messages);
+
+  /*! Set how often the remote control connector is processed, according to the connected clients */
+  void UpdateRemoteControlServerProcessInterval();
+
 protected:
   /*! Device set selector widget */
   QPlusDeviceSetSelectorWidget*         m_DeviceSetSelectorWidget;
@@ -207,6 +220,21 @@ protected:
 
   std::set<int>                         m_RemoteControlLogSubscribedClients;
 
+  /*! Log messages waiting to be forwarded to the subscribed clients (filled from any thread) */
+  PlusLogMessageQueue                   m_RemoteControlLogMessageQueue;
+
+  /*! Nonzero if there are clients subscribed to log messages (read from any thread) */
+  QAtomicInt                            m_RemoteControlLogForwardingEnabled;
+
+  /*! Nonzero if a flush is queued because many log messages are waiting (set from any thread) */
+  QAtomicInt                            m_RemoteControlLogFlushRequested;
+
+  /*! Timer for sending the queued log messages periodically */
+  QTimer*                               m_RemoteControlLogFlushTimer;
+
+  /*! Number of log messages that could not be sent to a client, by client ID */
+  std::map<int, int>                    m_RemoteControlLogNumberOfUnsentMessages;
+
   /*! Incomplete string received from PlusServer */
   std::string                           m_LogIncompleteLine;
 
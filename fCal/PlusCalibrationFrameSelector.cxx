@@ -0,0 +1,189 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusCalibrationFrameSelector.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPoints.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//-----------------------------------------------------------------------------
+PlusCalibrationFrameSelector::PlusCalibrationFrameSelector()
+  : m_MinimumPositionDifferenceMm(2.0)
+  , m_MinimumAngleDifferenceDeg(2.0)
+  , m_MinimumNumberOfFrames(50)
+  , m_MinimumOrientationSpreadDeg(5.0)
+  , m_MinimumImageCoverage(0.5)
+{
+  Reset();
+}
+
+//-----------------------------------------------------------------------------
+PlusCalibrationFrameSelector::~PlusCalibrationFrameSelector()
+{
+}
+
+//-----------------------------------------------------------------------------
+void PlusCalibrationFrameSelector::Reset()
+{
+  m_SelectedPoses.clear();
+  for (int i = 0; i < 3; ++i)
+  {
+    m_RotationVectorSum[i] = 0.0;
+    for (int j = 0; j < 3; ++j)
+    {
+      m_FirstOrientation[i][j] = (i == j ? 1.0 : 0.0);
+      m_RotationVectorOuterProductSum[i][j] = 0.0;
+    }
+  }
+  m_WireBoundsPx[0] = m_WireBoundsPx[2] = std::numeric_limits<double>::max();
+  m_WireBoundsPx[1] = m_WireBoundsPx[3] = -std::numeric_limits<double>::max();
+  m_FrameSize[0] = 0;
+  m_FrameSize[1] = 0;
+  m_FrameSize[2] = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool PlusCalibrationFrameSelector::SelectFrame(vtkMatrix4x4* aProbeToPhantomTransform, vtkPoints* aWirePointsPx, const FrameSizeType& aFrameSize)
+{
+  if (aProbeToPhantomTransform == NULL || aWirePointsPx == NULL || aWirePointsPx->GetNumberOfPoints() == 0)
+  {
+    return false;
+  }
+
+  Pose pose;
+  double transformOrientation[3][3];
+  for (int i = 0; i < 3; ++i)
+  {
+    pose.Position[i] = aProbeToPhantomTransform->GetElement(i, 3);
+    for (int j = 0; j < 3; ++j)
+    {
+      transformOrientation[i][j] = aProbeToPhantomTransform->GetElement(i, j);
+    }
+  }
+  // Remove scaling and shearing, if any
+  double orientation[3][3];
+  vtkMath::Orthogonalize3x3(transformOrientation, orientation);
+  vtkMath::Matrix3x3ToQuaternion(orientation, pose.Orientation);
+
+  // Skip near-duplicate poses
+  for (std::vector<Pose>::iterator selectedPoseIt = m_SelectedPoses.begin(); selectedPoseIt != m_SelectedPoses.end(); ++selectedPoseIt)
+  {
+    if (sqrt(vtkMath::Distance2BetweenPoints(pose.Position, selectedPoseIt->Position)) < m_MinimumPositionDifferenceMm
+        && GetAngleDifferenceDeg(pose.Orientation, selectedPoseIt->Orientation) < m_MinimumAngleDifferenceDeg)
+    {
+      return false;
+    }
+  }
+
+  // Rotation vector relative to the first pose
+  if (m_SelectedPoses.empty())
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      for (int j = 0; j < 3; ++j)
+      {
+        m_FirstOrientation[i][j] = orientation[i][j];
+      }
+    }
+  }
+  double firstOrientationInverse[3][3];
+  vtkMath::Transpose3x3(m_FirstOrientation, firstOrientationInverse);
+  double relativeOrientation[3][3];
+  vtkMath::Multiply3x3(firstOrientationInverse, orientation, relativeOrientation);
+  double relativeQuaternion[4];
+  vtkMath::Matrix3x3ToQuaternion(relativeOrientation, relativeQuaternion);
+  double halfAngleSin = sqrt(relativeQuaternion[1] * relativeQuaternion[1] + relativeQuaternion[2] * relativeQuaternion[2] + relativeQuaternion[3] * relativeQuaternion[3]);
+  double angleDeg = vtkMath::DegreesFromRadians(2.0 * atan2(halfAngleSin, relativeQuaternion[0]));
+  for (int i = 0; i < 3; ++i)
+  {
+    pose.RotationVectorDeg[i] = (halfAngleSin > 1e-9 ? relativeQuaternion[i + 1] / halfAngleSin * angleDeg : 0.0);
+    m_RotationVectorSum[i] += pose.RotationVectorDeg[i];
+    for (int j = 0; j < 3; ++j)
+    {
+      m_RotationVectorOuterProductSum[i][j] += pose.RotationVectorDeg[i] * pose.RotationVectorDeg[j];
+    }
+  }
+
+  // Image area covered by the wires
+  for (vtkIdType pointIndex = 0; pointIndex < aWirePointsPx->GetNumberOfPoints(); ++pointIndex)
+  {
+    double* point = aWirePointsPx->GetPoint(pointIndex);
+    m_WireBoundsPx[0] = std::min(m_WireBoundsPx[0], point[0]);
+    m_WireBoundsPx[1] = std::max(m_WireBoundsPx[1], point[0]);
+    m_WireBoundsPx[2] = std::min(m_WireBoundsPx[2], point[1]);
+    m_WireBoundsPx[3] = std::max(m_WireBoundsPx[3], point[1]);
+  }
+  m_FrameSize = aFrameSize;
+
+  m_SelectedPoses.push_back(pose);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool PlusCalibrationFrameSelector::IsWellConditioned() const
+{
+  return GetNumberOfSelectedFrames() >= m_MinimumNumberOfFrames
+         && GetOrientationSpreadDeg() >= m_MinimumOrientationSpreadDeg
+         && GetImageCoverage() >= m_MinimumImageCoverage;
+}
+
+//-----------------------------------------------------------------------------
+double PlusCalibrationFrameSelector::GetOrientationSpreadDeg() const
+{
+  const int numberOfPoses = m_SelectedPoses.size();
+  if (numberOfPoses < 2)
+  {
+    return 0.0;
+  }
+
+  double covariance[3][3];
+  double* covarianceRows[3] = {covariance[0], covariance[1], covariance[2]};
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      covariance[i][j] = (m_RotationVectorOuterProductSum[i][j] - m_RotationVectorSum[i] * m_RotationVectorSum[j] / numberOfPoses) / (numberOfPoses - 1);
+    }
+  }
+
+  double eigenvalues[3] = {0.0, 0.0, 0.0};
+  double eigenvectors[3][3];
+  double* eigenvectorRows[3] = {eigenvectors[0], eigenvectors[1], eigenvectors[2]};
+  if (vtkMath::Jacobi(covarianceRows, eigenvalues, eigenvectorRows) == 0)
+  {
+    return 0.0;
+  }
+
+  // Eigenvalues are sorted in decreasing order
+  return sqrt(std::max(eigenvalues[2], 0.0));
+}
+
+//-----------------------------------------------------------------------------
+double PlusCalibrationFrameSelector::GetImageCoverage() const
+{
+  if (m_SelectedPoses.empty() || m_FrameSize[0] == 0 || m_FrameSize[1] == 0)
+  {
+    return 0.0;
+  }
+  double horizontalCoverage = (m_WireBoundsPx[1] - m_WireBoundsPx[0]) / m_FrameSize[0];
+  double verticalCoverage = (m_WireBoundsPx[3] - m_WireBoundsPx[2]) / m_FrameSize[1];
+  return std::min(horizontalCoverage, verticalCoverage);
+}
+
+//-----------------------------------------------------------------------------
+double PlusCalibrationFrameSelector::GetAngleDifferenceDeg(const double aQuaternion1[4], const double aQuaternion2[4])
+{
+  double dotProduct = fabs(aQuaternion1[0] * aQuaternion2[0] + aQuaternion1[1] * aQuaternion2[1] + aQuaternion1[2] * aQuaternion2[2] + aQuaternion1[3] * aQuaternion2[3]);
+  return vtkMath::DegreesFromRadians(2.0 * acos(std::min(dotProduct, 1.0)));
+}
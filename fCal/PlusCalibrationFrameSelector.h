@@ -0,0 +1,103 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusCalibrationFrameSelector_h
+#define __PlusCalibrationFrameSelector_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+#include <igsioCommon.h>
+
+// STL includes
+#include <vector>
+
+class vtkMatrix4x4;
+class vtkPoints;
+
+//-----------------------------------------------------------------------------
+
+/*! \class PlusCalibrationFrameSelector
+ * \brief Selects segmented frames that add new information to a spatial calibration dataset
+ *
+ * A frame is selected only if its probe pose differs from all the already selected poses by more than the minimum
+ * position or angle difference, so near-duplicate poses are skipped. The dataset is considered well-conditioned when
+ * enough frames are selected, the orientations of the selected poses are spread in all directions and the segmented
+ * wires cover a large enough part of the image.
+ * \ingroup PlusAppFCal
+ */
+class PlusCalibrationFrameSelector
+{
+public:
+  PlusCalibrationFrameSelector();
+  virtual ~PlusCalibrationFrameSelector();
+
+  /*! Forget all selected frames */
+  void Reset();
+
+  /*!
+  * Decide if a segmented frame should be added to the calibration dataset. The frame is remembered if selected.
+  * \param aProbeToPhantomTransform Pose of the probe in the phantom coordinate system
+  * \param aWirePointsPx Segmented wire intersection points in the image (pixels)
+  * \param aFrameSize Size of the image (pixels)
+  * \return True if the frame is selected
+  */
+  bool SelectFrame(vtkMatrix4x4* aProbeToPhantomTransform, vtkPoints* aWirePointsPx, const FrameSizeType& aFrameSize);
+
+  /*! Returns true if the selected frames are enough for an accurate calibration */
+  bool IsWellConditioned() const;
+
+  /*! Number of selected frames */
+  int GetNumberOfSelectedFrames() const { return m_SelectedPoses.size(); };
+
+  /*! Standard deviation of the selected orientations along the least varied rotation axis (in degrees) */
+  double GetOrientationSpreadDeg() const;
+
+  /*! Smaller of the horizontal and vertical fractions of the image that the segmented wires cover */
+  double GetImageCoverage() const;
+
+  void SetMinimumPositionDifferenceMm(double aValue) { m_MinimumPositionDifferenceMm = aValue; };
+  void SetMinimumAngleDifferenceDeg(double aValue) { m_MinimumAngleDifferenceDeg = aValue; };
+  void SetMinimumNumberOfFrames(int aValue) { m_MinimumNumberOfFrames = aValue; };
+  void SetMinimumOrientationSpreadDeg(double aValue) { m_MinimumOrientationSpreadDeg = aValue; };
+  void SetMinimumImageCoverage(double aValue) { m_MinimumImageCoverage = aValue; };
+
+protected:
+  struct Pose
+  {
+    double Position[3];
+    /*! Orientation as quaternion (w, x, y, z) */
+    double Orientation[4];
+    /*! Rotation vector relative to the first selected pose (in degrees) */
+    double RotationVectorDeg[3];
+  };
+
+  /*! Angle between two orientations in degrees */
+  static double GetAngleDifferenceDeg(const double aQuaternion1[4], const double aQuaternion2[4]);
+
+protected:
+  std::vector<Pose> m_SelectedPoses;
+
+  /*! Rotation matrix of the first selected pose, rotation vectors are computed relative to this */
+  double m_FirstOrientation[3][3];
+
+  /*! Sum of rotation vectors and their outer products, for computing the orientation covariance */
+  double m_RotationVectorSum[3];
+  double m_RotationVectorOuterProductSum[3][3];
+
+  /*! Bounding box of the segmented wire points (x min, x max, y min, y max) */
+  double m_WireBoundsPx[4];
+
+  /*! Size of the last image */
+  FrameSizeType m_FrameSize;
+
+  double m_MinimumPositionDifferenceMm;
+  double m_MinimumAngleDifferenceDeg;
+  int m_MinimumNumberOfFrames;
+  double m_MinimumOrientationSpreadDeg;
+  double m_MinimumImageCoverage;
+};
+
+#endif
@@ -0,0 +1,237 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusIncrementalPivotCalibration.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // Smallest eigenvalue of the normalized normal matrix, equals 1 - (largest singular value of the mean rotation).
+  // It is 0 if the stylus is not rotated at all or only around a single axis.
+  const double MINIMUM_NORMALIZED_EIGENVALUE = 0.01;
+}
+
+//-----------------------------------------------------------------------------
+PlusIncrementalPivotCalibration::PlusIncrementalPivotCalibration()
+  : m_ConvergenceThresholdMm(0.1)
+  , m_ConvergenceWindowSize(20)
+  , m_MinimumNumberOfPoses(50)
+{
+  Reset();
+}
+
+//-----------------------------------------------------------------------------
+PlusIncrementalPivotCalibration::~PlusIncrementalPivotCalibration()
+{
+}
+
+//-----------------------------------------------------------------------------
+void PlusIncrementalPivotCalibration::Reset()
+{
+  m_NumberOfPoses = 0;
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 3; ++column)
+    {
+      m_SumRotation[row][column] = 0.0;
+    }
+    m_SumRotationTransposeTimesTranslation[row] = 0.0;
+    m_SumTranslation[row] = 0.0;
+  }
+  m_SumTranslationSquaredNorm = 0.0;
+
+  for (int i = 0; i < 6; ++i)
+  {
+    m_Solution[i] = 0.0;
+  }
+  m_SolutionValid = false;
+  m_RmsErrorMm = 0.0;
+  m_RecentPivotPoints.clear();
+}
+
+//-----------------------------------------------------------------------------
+void PlusIncrementalPivotCalibration::AddPose(vtkMatrix4x4* aMarkerToReferenceTransformMatrix)
+{
+  if (aMarkerToReferenceTransformMatrix == NULL)
+  {
+    return;
+  }
+
+  double translation[3] = { aMarkerToReferenceTransformMatrix->GetElement(0, 3), aMarkerToReferenceTransformMatrix->GetElement(1, 3), aMarkerToReferenceTransformMatrix->GetElement(2, 3) };
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 3; ++column)
+    {
+      m_SumRotation[row][column] += aMarkerToReferenceTransformMatrix->GetElement(row, column);
+      // (R^T * p)[column] += R[row][column] * p[row]
+      m_SumRotationTransposeTimesTranslation[column] += aMarkerToReferenceTransformMatrix->GetElement(row, column) * translation[row];
+    }
+    m_SumTranslation[row] += translation[row];
+  }
+  m_SumTranslationSquaredNorm += vtkMath::Dot(translation, translation);
+  ++m_NumberOfPoses;
+
+  UpdateSolution();
+
+  if (m_SolutionValid)
+  {
+    std::array<double, 3> pivotPoint = {{ m_Solution[0], m_Solution[1], m_Solution[2] }};
+    m_RecentPivotPoints.push_back(pivotPoint);
+  }
+  else
+  {
+    m_RecentPivotPoints.clear();
+  }
+  while (m_RecentPivotPoints.size() > static_cast<unsigned int>(std::max(m_ConvergenceWindowSize, 1)))
+  {
+    m_RecentPivotPoints.pop_front();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PlusIncrementalPivotCalibration::UpdateSolution()
+{
+  m_SolutionValid = false;
+  if (m_NumberOfPoses < 2)
+  {
+    return;
+  }
+
+  // Normal equations of [R -I] * [t_Marker; t_Reference] = -p:
+  //   [ n*I   -S^T ] * [t_Marker   ] = [ -sum(R^T * p) ]
+  //   [ -S    n*I  ]   [t_Reference]   [  sum(p)       ]
+  // where S is the sum of the rotation matrices
+  double normalMatrix[6][6];
+  double n = static_cast<double>(m_NumberOfPoses);
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 3; ++column)
+    {
+      double identity = (row == column ? n : 0.0);
+      normalMatrix[row][column] = identity;
+      normalMatrix[row + 3][column + 3] = identity;
+      normalMatrix[row][column + 3] = -m_SumRotation[column][row];
+      normalMatrix[row + 3][column] = -m_SumRotation[row][column];
+    }
+  }
+  double rightHandSide[6] = { -m_SumRotationTransposeTimesTranslation[0], -m_SumRotationTransposeTimesTranslation[1], -m_SumRotationTransposeTimesTranslation[2],
+                              m_SumTranslation[0], m_SumTranslation[1], m_SumTranslation[2]
+                            };
+
+  // Check the conditioning of the system on the normalized matrix (JacobiN and SolveLinearSystem overwrite their input matrices)
+  double normalizedMatrixElements[6][6];
+  double solverMatrixElements[6][6];
+  double eigenvectorElements[6][6];
+  double* normalizedMatrix[6];
+  double* solverMatrix[6];
+  double* eigenvectors[6];
+  for (int row = 0; row < 6; ++row)
+  {
+    for (int column = 0; column < 6; ++column)
+    {
+      normalizedMatrixElements[row][column] = normalMatrix[row][column] / n;
+      solverMatrixElements[row][column] = normalMatrix[row][column];
+    }
+    normalizedMatrix[row] = normalizedMatrixElements[row];
+    solverMatrix[row] = solverMatrixElements[row];
+    eigenvectors[row] = eigenvectorElements[row];
+  }
+  double eigenvalues[6];
+  if (vtkMath::JacobiN(normalizedMatrix, 6, eigenvalues, eigenvectors) == 0)
+  {
+    LOG_DEBUG("Unable to compute eigenvalues of the pivot calibration normal matrix");
+    return;
+  }
+  // Eigenvalues are sorted in decreasing order
+  if (eigenvalues[5] < MINIMUM_NORMALIZED_EIGENVALUE)
+  {
+    // Not enough orientation spread yet
+    return;
+  }
+
+  double solution[6];
+  for (int i = 0; i < 6; ++i)
+  {
+    solution[i] = rightHandSide[i];
+  }
+  if (vtkMath::SolveLinearSystem(solverMatrix, solution, 6) == 0)
+  {
+    LOG_DEBUG("Unable to solve pivot calibration normal equations");
+    return;
+  }
+
+  // Sum of squared residuals: x^T * N * x - 2 * x^T * b + sum(p * p)
+  double quadraticTerm = 0.0;
+  double linearTerm = 0.0;
+  for (int row = 0; row < 6; ++row)
+  {
+    double normalMatrixTimesSolution = 0.0;
+    for (int column = 0; column < 6; ++column)
+    {
+      normalMatrixTimesSolution += normalMatrix[row][column] * solution[column];
+    }
+    quadraticTerm += solution[row] * normalMatrixTimesSolution;
+    linearTerm += solution[row] * rightHandSide[row];
+  }
+  double sumOfSquaredResiduals = quadraticTerm - 2.0 * linearTerm + m_SumTranslationSquaredNorm;
+  if (sumOfSquaredResiduals < 0.0)
+  {
+    // Numerical error
+    sumOfSquaredResiduals = 0.0;
+  }
+
+  for (int i = 0; i < 6; ++i)
+  {
+    m_Solution[i] = solution[i];
+  }
+  m_RmsErrorMm = std::sqrt(sumOfSquaredResiduals / n);
+  m_SolutionValid = true;
+}
+
+//-----------------------------------------------------------------------------
+void PlusIncrementalPivotCalibration::GetPivotPointToMarkerTranslation(double aTranslation[3]) const
+{
+  aTranslation[0] = m_Solution[0];
+  aTranslation[1] = m_Solution[1];
+  aTranslation[2] = m_Solution[2];
+}
+
+//-----------------------------------------------------------------------------
+void PlusIncrementalPivotCalibration::GetPivotPointPosition_Reference(double aPosition[3]) const
+{
+  aPosition[0] = m_Solution[3];
+  aPosition[1] = m_Solution[4];
+  aPosition[2] = m_Solution[5];
+}
+
+//-----------------------------------------------------------------------------
+bool PlusIncrementalPivotCalibration::IsConverged() const
+{
+  if (!m_SolutionValid || m_NumberOfPoses < m_MinimumNumberOfPoses
+      || m_RecentPivotPoints.size() < static_cast<unsigned int>(std::max(m_ConvergenceWindowSize, 1)))
+  {
+    return false;
+  }
+
+  const std::array<double, 3>& latestPivotPoint = m_RecentPivotPoints.back();
+  for (std::deque<std::array<double, 3> >::const_iterator pivotPointIt = m_RecentPivotPoints.begin(); pivotPointIt != m_RecentPivotPoints.end(); ++pivotPointIt)
+  {
+    double distanceMm = std::sqrt(vtkMath::Distance2BetweenPoints(pivotPointIt->data(), latestPivotPoint.data()));
+    if (distanceMm > m_ConvergenceThresholdMm)
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,103 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIncrementalPivotCalibration_h
+#define __PlusIncrementalPivotCalibration_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+
+// STL includes
+#include <array>
+#include <deque>
+
+class vtkMatrix4x4;
+
+//-----------------------------------------------------------------------------
+
+/*! \class PlusIncrementalPivotCalibration
+ * \brief Pivot calibration solver that updates the estimate after each added pose
+ *
+ * Each marker to reference pose (R, p) gives the equation R * t_Marker + p = t_Reference, where t_Marker is the
+ * pivot point in the marker coordinate frame and t_Reference is the pivot point in the reference coordinate frame.
+ * Only the sums that make up the normal equations of the least squares problem are stored, so adding a pose and
+ * solving the 6x6 system takes constant time, independently of the number of poses. The RMS residual is computed
+ * from the same sums.
+ *
+ * The estimate is considered converged when the system is well conditioned (the poses have enough orientation
+ * spread), there are enough poses and the pivot point estimate has not moved more than a threshold while the
+ * last few poses were added.
+ * \ingroup PlusAppFCal
+ */
+class PlusIncrementalPivotCalibration
+{
+public:
+  PlusIncrementalPivotCalibration();
+  virtual ~PlusIncrementalPivotCalibration();
+
+  /*! Remove all poses */
+  void Reset();
+
+  /*! Add a marker to reference pose and update the estimate */
+  void AddPose(vtkMatrix4x4* aMarkerToReferenceTransformMatrix);
+
+  /*! Number of added poses */
+  int GetNumberOfPoses() const { return m_NumberOfPoses; };
+
+  /*! True if the poses determine the pivot point (the solution is not valid until the stylus is pivoted) */
+  bool IsSolutionValid() const { return m_SolutionValid; };
+
+  /*! Pivot point in the marker coordinate frame (valid if IsSolutionValid() returns true) */
+  void GetPivotPointToMarkerTranslation(double aTranslation[3]) const;
+
+  /*! Pivot point in the reference coordinate frame (valid if IsSolutionValid() returns true) */
+  void GetPivotPointPosition_Reference(double aPosition[3]) const;
+
+  /*! Root mean square distance of the pivot points computed from the individual poses from the estimated pivot point */
+  double GetRmsErrorMm() const { return m_RmsErrorMm; };
+
+  /*! True if the estimate has converged (see class description) */
+  bool IsConverged() const;
+
+  /*! Maximum movement of the pivot point estimate (in the marker coordinate frame) while the last ConvergenceWindowSize poses were added */
+  void SetConvergenceThresholdMm(double aThresholdMm) { m_ConvergenceThresholdMm = aThresholdMm; };
+  double GetConvergenceThresholdMm() const { return m_ConvergenceThresholdMm; };
+
+  void SetConvergenceWindowSize(int aNumberOfPoses) { m_ConvergenceWindowSize = aNumberOfPoses; };
+
+  /*! The estimate is not considered converged before this many poses are added */
+  void SetMinimumNumberOfPoses(int aNumberOfPoses) { m_MinimumNumberOfPoses = aNumberOfPoses; };
+
+protected:
+  /*! Solve the normal equations and update the residual */
+  void UpdateSolution();
+
+protected:
+  int m_NumberOfPoses;
+
+  /*! Sum of the rotation matrices */
+  double m_SumRotation[3][3];
+  /*! Sum of transpose(R) * p */
+  double m_SumRotationTransposeTimesTranslation[3];
+  /*! Sum of p */
+  double m_SumTranslation[3];
+  /*! Sum of p * p */
+  double m_SumTranslationSquaredNorm;
+
+  /*! Pivot point in the marker (0..2) and in the reference (3..5) coordinate frame */
+  double m_Solution[6];
+  bool m_SolutionValid;
+  double m_RmsErrorMm;
+
+  /*! Pivot point estimates (in the marker coordinate frame) after the most recent poses */
+  std::deque<std::array<double, 3> > m_RecentPivotPoints;
+
+  double m_ConvergenceThresholdMm;
+  int m_ConvergenceWindowSize;
+  int m_MinimumNumberOfPoses;
+};
+
+#endif
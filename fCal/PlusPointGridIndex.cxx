@@ -0,0 +1,153 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusPointGridIndex.h"
+
+// STL includes
+#include <cmath>
+
+//-----------------------------------------------------------------------------
+bool PlusPointGridIndex::CellKey::operator<(const CellKey& other) const
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    if (Index[i] != other.Index[i])
+    {
+      return Index[i] < other.Index[i];
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+PlusPointGridIndex::PlusPointGridIndex()
+  : m_CellSizeMm(10.0)
+  , m_NumberOfPoints(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusPointGridIndex::~PlusPointGridIndex()
+{
+}
+
+//-----------------------------------------------------------------------------
+void PlusPointGridIndex::SetCellSizeMm(double aCellSizeMm)
+{
+  if (aCellSizeMm <= 0.0)
+  {
+    LOG_ERROR("Invalid grid cell size: " << aCellSizeMm << "mm");
+    return;
+  }
+  m_CellSizeMm = aCellSizeMm;
+  Clear();
+}
+
+//-----------------------------------------------------------------------------
+void PlusPointGridIndex::Clear()
+{
+  m_Cells.clear();
+  m_NumberOfPoints = 0;
+}
+
+//-----------------------------------------------------------------------------
+PlusPointGridIndex::CellKey PlusPointGridIndex::GetCellKey(const double aPosition[3]) const
+{
+  CellKey key;
+  for (int i = 0; i < 3; ++i)
+  {
+    key.Index[i] = static_cast<int>(std::floor(aPosition[i] / m_CellSizeMm));
+  }
+  return key;
+}
+
+//-----------------------------------------------------------------------------
+void PlusPointGridIndex::InsertPoint(int aId, const double aPosition[3])
+{
+  Entry entry;
+  entry.Id = aId;
+  entry.Position[0] = aPosition[0];
+  entry.Position[1] = aPosition[1];
+  entry.Position[2] = aPosition[2];
+  m_Cells[GetCellKey(aPosition)].push_back(entry);
+  ++m_NumberOfPoints;
+}
+
+//-----------------------------------------------------------------------------
+void PlusPointGridIndex::RemovePoint(int aId)
+{
+  for (std::map<CellKey, std::vector<Entry> >::iterator cellIt = m_Cells.begin(); cellIt != m_Cells.end();)
+  {
+    std::vector<Entry>& entries = cellIt->second;
+    for (std::vector<Entry>::iterator entryIt = entries.begin(); entryIt != entries.end();)
+    {
+      if (entryIt->Id == aId)
+      {
+        entryIt = entries.erase(entryIt);
+        --m_NumberOfPoints;
+      }
+      else
+      {
+        ++entryIt;
+      }
+    }
+    if (entries.empty())
+    {
+      m_Cells.erase(cellIt++);
+    }
+    else
+    {
+      ++cellIt;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+int PlusPointGridIndex::FindClosestPointWithinRadius(const double aPosition[3], double aRadiusMm) const
+{
+  if (aRadiusMm <= 0.0)
+  {
+    return -1;
+  }
+
+  // Number of neighbor cells to check in each direction (1 if the radius is not larger than the cell size)
+  int cellRange = static_cast<int>(std::ceil(aRadiusMm / m_CellSizeMm));
+  CellKey centerKey = GetCellKey(aPosition);
+
+  int closestId = -1;
+  double closestDistance2 = aRadiusMm * aRadiusMm;
+  CellKey key;
+  for (key.Index[0] = centerKey.Index[0] - cellRange; key.Index[0] <= centerKey.Index[0] + cellRange; ++key.Index[0])
+  {
+    for (key.Index[1] = centerKey.Index[1] - cellRange; key.Index[1] <= centerKey.Index[1] + cellRange; ++key.Index[1])
+    {
+      for (key.Index[2] = centerKey.Index[2] - cellRange; key.Index[2] <= centerKey.Index[2] + cellRange; ++key.Index[2])
+      {
+        std::map<CellKey, std::vector<Entry> >::const_iterator cellIt = m_Cells.find(key);
+        if (cellIt == m_Cells.end())
+        {
+          continue;
+        }
+        for (std::vector<Entry>::const_iterator entryIt = cellIt->second.begin(); entryIt != cellIt->second.end(); ++entryIt)
+        {
+          double distance2 = 0.0;
+          for (int i = 0; i < 3; ++i)
+          {
+            double difference = entryIt->Position[i] - aPosition[i];
+            distance2 += difference * difference;
+          }
+          if (distance2 < closestDistance2)
+          {
+            closestDistance2 = distance2;
+            closestId = entryIt->Id;
+          }
+        }
+      }
+    }
+  }
+  return closestId;
+}
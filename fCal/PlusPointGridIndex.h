@@ -0,0 +1,75 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusPointGridIndex_h
+#define __PlusPointGridIndex_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+
+// STL includes
+#include <map>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+/*! \class PlusPointGridIndex
+ * \brief Uniform grid spatial index of 3D points for fixed radius neighbor queries
+ *
+ * Points are stored in the cubic cells of a sparse uniform grid. If the cell size is not smaller than the query
+ * radius then a query only has to check the points in the 27 cells around the query position, so the cost of
+ * a query does not grow with the total number of points.
+ * \ingroup PlusAppFCal
+ */
+class PlusPointGridIndex
+{
+public:
+  PlusPointGridIndex();
+  virtual ~PlusPointGridIndex();
+
+  /*! Set the size of the grid cells. Removes all points. Should not be smaller than the radius of the queries. */
+  void SetCellSizeMm(double aCellSizeMm);
+  double GetCellSizeMm() const { return m_CellSizeMm; };
+
+  /*! Remove all points */
+  void Clear();
+
+  /*! Add a point with a user defined identifier */
+  void InsertPoint(int aId, const double aPosition[3]);
+
+  /*! Remove all points with the given identifier */
+  void RemovePoint(int aId);
+
+  /*!
+  * Find the closest point within the given radius
+  * \return Identifier of the point, -1 if there is no point within the radius (or the radius is not positive)
+  */
+  int FindClosestPointWithinRadius(const double aPosition[3], double aRadiusMm) const;
+
+  int GetNumberOfPoints() const { return m_NumberOfPoints; };
+
+protected:
+  struct CellKey
+  {
+    int Index[3];
+    bool operator<(const CellKey& other) const;
+  };
+
+  struct Entry
+  {
+    int Id;
+    double Position[3];
+  };
+
+  CellKey GetCellKey(const double aPosition[3]) const;
+
+protected:
+  double m_CellSizeMm;
+  int m_NumberOfPoints;
+  std::map<CellKey, std::vector<Entry> > m_Cells;
+};
+
+#endif
@@ -0,0 +1,345 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusSequenceFileStreamReader.h"
+
+// PlusLib includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <cstdlib>
+#include <sstream>
+
+namespace
+{
+  const std::string SEQUENCE_FIELD_NAME_PREFIX = "Seq_Frame";
+}
+
+//-----------------------------------------------------------------------------
+PlusSequenceFileStreamReader::PlusSequenceFileStreamReader()
+  : m_PixelType(VTK_VOID)
+  , m_NumberOfScalarComponents(1)
+  , m_ImageType(US_IMG_BRIGHTNESS)
+  , m_FrameSizeInBytes(0)
+  , m_PixelDataOffset(0)
+{
+  m_FrameSize[0] = 0;
+  m_FrameSize[1] = 0;
+  m_FrameSize[2] = 1;
+}
+
+//-----------------------------------------------------------------------------
+PlusSequenceFileStreamReader::~PlusSequenceFileStreamReader()
+{
+  Close();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusSequenceFileStreamReader::Open(const std::string& aFileName)
+{
+  LOG_TRACE("PlusSequenceFileStreamReader::Open(" << aFileName << ")");
+
+  Close();
+
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(aFileName));
+  if (extension != ".mha" && extension != ".mhd")
+  {
+    LOG_DEBUG("Only MetaImage sequences can be streamed: " << aFileName);
+    return PLUS_FAIL;
+  }
+
+  std::ifstream headerStream(aFileName.c_str(), std::ios::in | std::ios::binary);
+  if (!headerStream.is_open())
+  {
+    LOG_ERROR("Unable to open sequence file: " << aFileName);
+    return PLUS_FAIL;
+  }
+
+  int numberOfDimensions = 0;
+  unsigned int dimensions[3] = {0, 0, 0};
+  std::string elementType;
+  std::string elementDataFile;
+  bool compressed = false;
+  bool msbByteOrder = false;
+  std::string imageOrientation = "MF";
+  std::string imageType;
+
+  std::string line;
+  while (std::getline(headerStream, line))
+  {
+    size_t separatorPos = line.find('=');
+    if (separatorPos == std::string::npos)
+    {
+      continue;
+    }
+    std::string name = line.substr(0, separatorPos);
+    std::string value = line.substr(separatorPos + 1);
+    vtksys::SystemTools::ReplaceString(value, "\r", "");
+    name = igsioCommon::Trim(name);
+    value = igsioCommon::Trim(value);
+
+    if (name.compare(0, SEQUENCE_FIELD_NAME_PREFIX.size(), SEQUENCE_FIELD_NAME_PREFIX) == 0)
+    {
+      // Per-frame field, e.g., Seq_Frame0012_ProbeToTrackerTransform
+      size_t frameNumberEndPos = name.find('_', SEQUENCE_FIELD_NAME_PREFIX.size());
+      if (frameNumberEndPos == std::string::npos)
+      {
+        continue;
+      }
+      unsigned int frameIndex = atoi(name.substr(SEQUENCE_FIELD_NAME_PREFIX.size(), frameNumberEndPos - SEQUENCE_FIELD_NAME_PREFIX.size()).c_str());
+      if (frameIndex >= m_FrameFields.size())
+      {
+        m_FrameFields.resize(frameIndex + 1);
+      }
+      m_FrameFields[frameIndex].push_back(std::make_pair(name.substr(frameNumberEndPos + 1), value));
+    }
+    else if (name == "NDims")
+    {
+      numberOfDimensions = atoi(value.c_str());
+    }
+    else if (name == "DimSize")
+    {
+      std::istringstream dimSizeStream(value);
+      dimSizeStream >> dimensions[0] >> dimensions[1] >> dimensions[2];
+    }
+    else if (name == "ElementType")
+    {
+      elementType = value;
+    }
+    else if (name == "ElementNumberOfChannels")
+    {
+      m_NumberOfScalarComponents = atoi(value.c_str());
+    }
+    else if (name == "CompressedData")
+    {
+      compressed = (STRCASECMP(value.c_str(), "TRUE") == 0);
+    }
+    else if (name == "BinaryDataByteOrderMSB" || name == "ElementByteOrderMSB")
+    {
+      msbByteOrder = (STRCASECMP(value.c_str(), "TRUE") == 0);
+    }
+    else if (name == "UltrasoundImageOrientation")
+    {
+      imageOrientation = value;
+    }
+    else if (name == "UltrasoundImageType")
+    {
+      imageType = value;
+    }
+    else if (name == "ElementDataFile")
+    {
+      // This is always the last field of the header
+      elementDataFile = value;
+      break;
+    }
+  }
+
+  if (elementDataFile.empty())
+  {
+    LOG_ERROR("Invalid sequence file, ElementDataFile field is missing: " << aFileName);
+    return PLUS_FAIL;
+  }
+
+  // Reorienting, decompressing, byte swapping of images are done by vtkPlusSequenceIO
+  if (numberOfDimensions != 3 || compressed || msbByteOrder || STRCASECMP(imageOrientation.c_str(), "MF") != 0)
+  {
+    LOG_DEBUG("Sequence file cannot be streamed (only uncompressed 2D+t sequences with MF orientation are supported): " << aFileName);
+    return PLUS_FAIL;
+  }
+
+  // Pixel data of a single file only, not a LIST of files or a file name pattern (e.g., "slice%03d.raw 1 10 1")
+  if (STRCASECMP(elementDataFile.substr(0, 4).c_str(), "LIST") == 0 || elementDataFile.find('%') != std::string::npos)
+  {
+    LOG_DEBUG("Sequence file cannot be streamed, pixel data is stored in multiple files: " << aFileName);
+    return PLUS_FAIL;
+  }
+
+  m_PixelType = GetScalarTypeFromElementType(elementType);
+  if (m_PixelType == VTK_VOID)
+  {
+    LOG_DEBUG("Sequence file cannot be streamed, unsupported element type " << elementType << ": " << aFileName);
+    return PLUS_FAIL;
+  }
+
+  if (!imageType.empty())
+  {
+    m_ImageType = igsioVideoFrame::GetUsImageTypeFromString(imageType);
+  }
+
+  m_FrameSize[0] = dimensions[0];
+  m_FrameSize[1] = dimensions[1];
+  m_FrameSize[2] = 1;
+  m_FrameSizeInBytes = static_cast<unsigned long long>(dimensions[0]) * dimensions[1] * m_NumberOfScalarComponents * vtkDataArray::GetDataTypeSize(m_PixelType);
+  m_FrameFields.resize(dimensions[2]);
+
+  // Pixel data is either right after the header or in a separate file next to the header
+  std::string pixelDataFileName = aFileName;
+  m_PixelDataOffset = 0;
+  if (STRCASECMP(elementDataFile.c_str(), "LOCAL") == 0)
+  {
+    m_PixelDataOffset = headerStream.tellg();
+  }
+  else
+  {
+    pixelDataFileName = vtksys::SystemTools::GetFilenamePath(aFileName) + "/" + elementDataFile;
+  }
+  headerStream.close();
+
+  m_PixelDataStream.open(pixelDataFileName.c_str(), std::ios::in | std::ios::binary);
+  if (!m_PixelDataStream.is_open())
+  {
+    LOG_ERROR("Unable to open pixel data file: " << pixelDataFileName);
+    Close();
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void PlusSequenceFileStreamReader::Close()
+{
+  if (m_PixelDataStream.is_open())
+  {
+    m_PixelDataStream.close();
+  }
+  m_FrameFields.clear();
+  m_FrameSizeInBytes = 0;
+}
+
+//-----------------------------------------------------------------------------
+unsigned int PlusSequenceFileStreamReader::GetNumberOfFrames() const
+{
+  return m_FrameFields.size();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusSequenceFileStreamReader::ReadFrameHeaders(vtkIGSIOTrackedFrameList* aTrackedFrameList)
+{
+  if (aTrackedFrameList == NULL)
+  {
+    LOG_ERROR("Invalid tracked frame list!");
+    return PLUS_FAIL;
+  }
+
+  // Only the extent of the image is used for computing the volume extent, so the frames get an image
+  // that has the extent of the frames but no scalars
+  vtkSmartPointer<vtkImageData> frameGeometry = vtkSmartPointer<vtkImageData>::New();
+  frameGeometry->SetExtent(0, m_FrameSize[0] - 1, 0, m_FrameSize[1] - 1, 0, 0);
+
+  for (unsigned int frameIndex = 0; frameIndex < m_FrameFields.size(); ++frameIndex)
+  {
+    igsioTrackedFrame trackedFrame;
+    SetFrameFields(frameIndex, trackedFrame);
+
+    if (trackedFrame.GetImageData()->DeepCopyFrom(frameGeometry) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to set image extent of frame #" << frameIndex);
+      return PLUS_FAIL;
+    }
+
+    if (aTrackedFrameList->AddTrackedFrame(&trackedFrame, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add frame #" << frameIndex << " to the list");
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusSequenceFileStreamReader::ReadFrame(unsigned int aFrameIndex, igsioTrackedFrame& aTrackedFrame)
+{
+  if (aFrameIndex >= m_FrameFields.size() || !m_PixelDataStream.is_open())
+  {
+    LOG_ERROR("Unable to read frame #" << aFrameIndex << ", the file is not open or the frame index is out of range");
+    return PLUS_FAIL;
+  }
+
+  SetFrameFields(aFrameIndex, aTrackedFrame);
+
+  if (aTrackedFrame.GetImageData()->AllocateFrame(m_FrameSize, m_PixelType, m_NumberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to allocate image of frame #" << aFrameIndex);
+    return PLUS_FAIL;
+  }
+
+  m_PixelDataStream.clear();
+  m_PixelDataStream.seekg(m_PixelDataOffset + static_cast<std::streamoff>(m_FrameSizeInBytes * aFrameIndex), std::ios::beg);
+  m_PixelDataStream.read(static_cast<char*>(aTrackedFrame.GetImageData()->GetScalarPointer()), m_FrameSizeInBytes);
+  if (static_cast<unsigned long long>(m_PixelDataStream.gcount()) != m_FrameSizeInBytes)
+  {
+    LOG_ERROR("Failed to read pixel data of frame #" << aFrameIndex);
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void PlusSequenceFileStreamReader::SetFrameFields(unsigned int aFrameIndex, igsioTrackedFrame& aTrackedFrame)
+{
+  aTrackedFrame.GetImageData()->SetImageOrientation(US_IMG_ORIENT_MF);
+  aTrackedFrame.GetImageData()->SetImageType(m_ImageType);
+
+  const FieldListType& fields = m_FrameFields[aFrameIndex];
+  for (FieldListType::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+  {
+    aTrackedFrame.SetFrameField(fieldIt->first, fieldIt->second);
+    if (fieldIt->first == "Timestamp")
+    {
+      aTrackedFrame.SetTimestamp(atof(fieldIt->second.c_str()));
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+IGSIOCommon::VTKScalarPixelType PlusSequenceFileStreamReader::GetScalarTypeFromElementType(const std::string& aElementType)
+{
+  if (aElementType == "MET_UCHAR")
+  {
+    return VTK_UNSIGNED_CHAR;
+  }
+  else if (aElementType == "MET_CHAR")
+  {
+    return VTK_CHAR;
+  }
+  else if (aElementType == "MET_USHORT")
+  {
+    return VTK_UNSIGNED_SHORT;
+  }
+  else if (aElementType == "MET_SHORT")
+  {
+    return VTK_SHORT;
+  }
+  else if (aElementType == "MET_UINT")
+  {
+    return VTK_UNSIGNED_INT;
+  }
+  else if (aElementType == "MET_INT")
+  {
+    return VTK_INT;
+  }
+  else if (aElementType == "MET_FLOAT")
+  {
+    return VTK_FLOAT;
+  }
+  else if (aElementType == "MET_DOUBLE")
+  {
+    return VTK_DOUBLE;
+  }
+  return VTK_VOID;
+}
@@ -0,0 +1,100 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusSequenceFileStreamReader_h
+#define __PlusSequenceFileStreamReader_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+#include <igsioCommon.h>
+
+// STL includes
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+
+//-----------------------------------------------------------------------------
+
+/*! \class PlusSequenceFileStreamReader
+ * \brief Reads frames of a sequence metafile one by one, without loading all the images into memory
+ *
+ * Open() parses only the header. ReadFrameHeaders() returns all the frames with their fields (transforms, timestamps)
+ * but without pixel data, which is enough to compute the extent of a reconstructed volume. ReadFrame() then reads
+ * a single frame including its pixel data.
+ *
+ * Only uncompressed 2D+t MetaImage sequences (.mha or .mhd) with MF image orientation and pixel data in a single file can be streamed, Open() fails
+ * for all other files. Those have to be read completely by vtkPlusSequenceIO.
+ * \ingroup PlusAppFCal
+ */
+class PlusSequenceFileStreamReader
+{
+public:
+  PlusSequenceFileStreamReader();
+  virtual ~PlusSequenceFileStreamReader();
+
+  /*! Parse the header of the file and prepare for reading frames. Fails if the file cannot be streamed. */
+  PlusStatus Open(const std::string& aFileName);
+
+  /*! Close the file */
+  void Close();
+
+  /*! Get number of frames in the file */
+  unsigned int GetNumberOfFrames() const;
+
+  /*!
+  * Add all frames to a list with their fields but without pixel data. The image of each frame has the correct
+  * extent but no scalars are allocated, so the list takes very little memory. Only the extent of these images may be used.
+  * \param aTrackedFrameList List to add the frames to
+  */
+  PlusStatus ReadFrameHeaders(vtkIGSIOTrackedFrameList* aTrackedFrameList);
+
+  /*!
+  * Read a single frame with its fields and pixel data
+  * \param aFrameIndex Index of the frame in the file
+  * \param aTrackedFrame Output frame
+  */
+  PlusStatus ReadFrame(unsigned int aFrameIndex, igsioTrackedFrame& aTrackedFrame);
+
+protected:
+  /*! Set the fields of the frame from the header */
+  void SetFrameFields(unsigned int aFrameIndex, igsioTrackedFrame& aTrackedFrame);
+
+  /*! Convert MetaImage element type to VTK scalar type. Returns VTK_VOID if the type is unknown. */
+  static IGSIOCommon::VTKScalarPixelType GetScalarTypeFromElementType(const std::string& aElementType);
+
+protected:
+  typedef std::vector< std::pair<std::string, std::string> > FieldListType;
+
+  /*! Fields of each frame, in the order of the file */
+  std::vector<FieldListType> m_FrameFields;
+
+  /*! Size of one frame in pixels */
+  FrameSizeType m_FrameSize;
+
+  /*! Pixel type */
+  IGSIOCommon::VTKScalarPixelType m_PixelType;
+
+  /*! Number of scalar components per pixel */
+  unsigned int m_NumberOfScalarComponents;
+
+  /*! Image type of the frames */
+  US_IMAGE_TYPE m_ImageType;
+
+  /*! Size of one frame in bytes */
+  unsigned long long m_FrameSizeInBytes;
+
+  /*! Position of the first pixel of the first frame in the pixel data file */
+  std::streamoff m_PixelDataOffset;
+
+  /*! Pixel data file */
+  std::ifstream m_PixelDataStream;
+};
+
+#endif
@@ -0,0 +1,236 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusTemporalCalibrationSignal.h"
+
+// PlusLib includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+#include <vtkIGSIOTransformRepository.h>
+#include <vtkPlusLineSegmentationAlgo.h>
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+//-----------------------------------------------------------------------------
+PlusTemporalCalibrationSignal::PlusTemporalCalibrationSignal()
+  : m_FrameType(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE)
+  , m_LineSegmenter(vtkSmartPointer<vtkPlusLineSegmentationAlgo>::New())
+  , m_TransformRepository(vtkSmartPointer<vtkIGSIOTransformRepository>::New())
+{
+  m_LineSegmenter->SetSaveIntermediateImages(false);
+}
+
+//-----------------------------------------------------------------------------
+PlusTemporalCalibrationSignal::~PlusTemporalCalibrationSignal()
+{
+}
+
+//-----------------------------------------------------------------------------
+void PlusTemporalCalibrationSignal::Reset(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aFrameType, const igsioTransformName& aProbeToReferenceTransformName)
+{
+  m_FrameType = aFrameType;
+  m_ProbeToReferenceTransformName = aProbeToReferenceTransformName;
+  m_Timestamps.clear();
+  m_LinePositions.clear();
+  m_ProbePositions.clear();
+}
+
+//-----------------------------------------------------------------------------
+void PlusTemporalCalibrationSignal::SetClipRectangle(const std::vector<int>& aClipRectangle)
+{
+  if (aClipRectangle.size() < 4)
+  {
+    return;
+  }
+  std::vector<int> clipRectangle(aClipRectangle);
+  m_LineSegmenter->SetClipRectangle(clipRectangle.data(), &(clipRectangle.data()[2]));
+}
+
+//-----------------------------------------------------------------------------
+int PlusTemporalCalibrationSignal::AddFrames(vtkIGSIOTrackedFrameList* aTrackedFrameList)
+{
+  if (aTrackedFrameList == NULL)
+  {
+    return 0;
+  }
+
+  int numberOfAddedSamples = 0;
+  for (unsigned int frameIndex = 0; frameIndex < aTrackedFrameList->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    if (AddFrame(*aTrackedFrameList->GetTrackedFrame(frameIndex)) == PLUS_SUCCESS)
+    {
+      ++numberOfAddedSamples;
+    }
+  }
+  return numberOfAddedSamples;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTemporalCalibrationSignal::AddFrame(igsioTrackedFrame& aTrackedFrame)
+{
+  double timestamp = aTrackedFrame.GetTimestamp();
+  if (!m_Timestamps.empty() && timestamp <= m_Timestamps.back())
+  {
+    // Duplicate or out of order frame
+    return PLUS_FAIL;
+  }
+
+  if (m_FrameType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO)
+  {
+    double linePosition = 0.0;
+    if (ComputeVideoPosition(aTrackedFrame, linePosition) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    m_LinePositions.push_back(linePosition);
+  }
+  else if (m_FrameType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER)
+  {
+    vtkSmartPointer<vtkMatrix4x4> probeToReferenceTransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    ToolStatus status(TOOL_INVALID);
+    if (m_TransformRepository->SetTransforms(aTrackedFrame) != PLUS_SUCCESS
+        || m_TransformRepository->GetTransform(m_ProbeToReferenceTransformName, probeToReferenceTransformMatrix, &status) != PLUS_SUCCESS
+        || status != TOOL_OK)
+    {
+      return PLUS_FAIL;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      m_ProbePositions.push_back(probeToReferenceTransformMatrix->GetElement(i, 3));
+    }
+  }
+  else
+  {
+    LOG_ERROR("Temporal calibration signal type is not set");
+    return PLUS_FAIL;
+  }
+
+  m_Timestamps.push_back(timestamp);
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void PlusTemporalCalibrationSignal::RemoveSamplesBefore(double aTimestamp)
+{
+  const int numberOfRemovedSamples = std::lower_bound(m_Timestamps.begin(), m_Timestamps.end(), aTimestamp) - m_Timestamps.begin();
+  if (numberOfRemovedSamples == 0)
+  {
+    return;
+  }
+
+  m_Timestamps.erase(m_Timestamps.begin(), m_Timestamps.begin() + numberOfRemovedSamples);
+  if (m_FrameType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO)
+  {
+    m_LinePositions.erase(m_LinePositions.begin(), m_LinePositions.begin() + numberOfRemovedSamples);
+  }
+  else if (m_FrameType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER)
+  {
+    m_ProbePositions.erase(m_ProbePositions.begin(), m_ProbePositions.begin() + 3 * numberOfRemovedSamples);
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTemporalCalibrationSignal::GetSignal(std::vector<double>& aTimestamps, std::vector<double>& aPositions) const
+{
+  aTimestamps = m_Timestamps;
+  aPositions.clear();
+
+  if (m_FrameType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO)
+  {
+    aPositions = m_LinePositions;
+    return PLUS_SUCCESS;
+  }
+
+  if (m_FrameType != vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER)
+  {
+    return PLUS_FAIL;
+  }
+
+  const int numberOfSamples = m_Timestamps.size();
+  if (numberOfSamples < 2)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Principal axis of motion
+  double mean[3] = {0.0, 0.0, 0.0};
+  for (int sampleIndex = 0; sampleIndex < numberOfSamples; ++sampleIndex)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      mean[i] += m_ProbePositions[3 * sampleIndex + i] / numberOfSamples;
+    }
+  }
+  double covariance[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+  double* covarianceRows[3] = {covariance[0], covariance[1], covariance[2]};
+  for (int sampleIndex = 0; sampleIndex < numberOfSamples; ++sampleIndex)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      for (int j = 0; j < 3; ++j)
+      {
+        covariance[i][j] += (m_ProbePositions[3 * sampleIndex + i] - mean[i]) * (m_ProbePositions[3 * sampleIndex + j] - mean[j]);
+      }
+    }
+  }
+  double eigenvalues[3] = {0.0, 0.0, 0.0};
+  double eigenvectors[3][3];
+  double* eigenvectorRows[3] = {eigenvectors[0], eigenvectors[1], eigenvectors[2]};
+  if (vtkMath::Jacobi(covarianceRows, eigenvalues, eigenvectorRows) == 0)
+  {
+    LOG_ERROR("Unable to determine the principal axis of motion of the tracker signal");
+    return PLUS_FAIL;
+  }
+
+  // Eigenvalues are sorted in decreasing order, eigenvectors are the columns
+  aPositions.reserve(numberOfSamples);
+  for (int sampleIndex = 0; sampleIndex < numberOfSamples; ++sampleIndex)
+  {
+    double position = 0.0;
+    for (int i = 0; i < 3; ++i)
+    {
+      position += (m_ProbePositions[3 * sampleIndex + i] - mean[i]) * eigenvectors[i][0];
+    }
+    aPositions.push_back(position);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTemporalCalibrationSignal::ComputeVideoPosition(igsioTrackedFrame& aTrackedFrame, double& aPosition)
+{
+  m_LineSegmenter->SetTrackedFrame(aTrackedFrame);
+  if (m_LineSegmenter->Update() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  std::vector<vtkPlusLineSegmentationAlgo::LineParameters> parameters;
+  m_LineSegmenter->GetDetectedLineParameters(parameters);
+  if (parameters.empty() || !parameters[0].lineDetected)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Distance of the line from the image origin
+  double origin[2] = { parameters[0].lineOriginPoint_Image[0], parameters[0].lineOriginPoint_Image[1] };
+  double direction[2] = { parameters[0].lineDirectionVector_Image[0], parameters[0].lineDirectionVector_Image[1] };
+  double directionLength = sqrt(direction[0] * direction[0] + direction[1] * direction[1]);
+  if (directionLength < 1e-9)
+  {
+    return PLUS_FAIL;
+  }
+  aPosition = fabs(origin[0] * direction[1] - origin[1] * direction[0]) / directionLength;
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,97 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusTemporalCalibrationSignal_h
+#define __PlusTemporalCalibrationSignal_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+#include <vtkPlusTemporalCalibrationAlgo.h>
+
+// IGSIO includes
+#include <igsioTransformName.h>
+
+// STL includes
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+class vtkIGSIOTransformRepository;
+class vtkPlusLineSegmentationAlgo;
+
+//-----------------------------------------------------------------------------
+
+/*! \class PlusTemporalCalibrationSignal
+ * \brief Position signal of a video or tracker stream for temporal calibration
+ *
+ * Frames are reduced to a single position value as soon as they are added, so only the timestamps and the position
+ * values are kept in memory, not the images. For video frames the position is the distance of the segmented line
+ * (e.g., water tank bottom) from the image origin. For tracker frames the probe position is stored and projected to
+ * the principal axis of motion when the signal is requested.
+ * \ingroup PlusAppFCal
+ */
+class PlusTemporalCalibrationSignal
+{
+public:
+  PlusTemporalCalibrationSignal();
+  virtual ~PlusTemporalCalibrationSignal();
+
+  /*!
+  * Discard the collected samples and set the signal source
+  * \param aFrameType Type of the signal (video or tracker)
+  * \param aProbeToReferenceTransformName Transform that provides the tracker position (ignored for video signals)
+  */
+  void Reset(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aFrameType, const igsioTransformName& aProbeToReferenceTransformName);
+
+  /*! Set the image region where the line is searched (origin x, origin y, size x, size y), empty vector means the whole image */
+  void SetClipRectangle(const std::vector<int>& aClipRectangle);
+
+  /*! Compute the positions of the frames and add them to the signal. Returns the number of added samples. */
+  int AddFrames(vtkIGSIOTrackedFrameList* aTrackedFrameList);
+
+  /*! Compute the position of a frame and add it to the signal. Fails if the position cannot be determined. */
+  PlusStatus AddFrame(igsioTrackedFrame& aTrackedFrame);
+
+  /*! Discard the samples that are older than the given timestamp (for keeping a sliding window of the signal) */
+  void RemoveSamplesBefore(double aTimestamp);
+
+  /*! Timestamp of the latest sample, UNDEFINED_TIMESTAMP if there are no samples */
+  double GetLatestTimestamp() const { return m_Timestamps.empty() ? UNDEFINED_TIMESTAMP : m_Timestamps.back(); };
+
+  /*! Number of collected samples */
+  int GetNumberOfSamples() const { return m_Timestamps.size(); };
+
+  /*!
+  * Get the position signal
+  * \param aTimestamps Timestamps of the samples, in increasing order
+  * \param aPositions Position values (in pixels for video and in mm for tracker signals)
+  */
+  PlusStatus GetSignal(std::vector<double>& aTimestamps, std::vector<double>& aPositions) const;
+
+  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE GetFrameType() const { return m_FrameType; };
+
+protected:
+  /*! Distance of the segmented line from the image origin (in pixels) */
+  PlusStatus ComputeVideoPosition(igsioTrackedFrame& aTrackedFrame, double& aPosition);
+
+protected:
+  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE m_FrameType;
+  igsioTransformName m_ProbeToReferenceTransformName;
+
+  vtkSmartPointer<vtkPlusLineSegmentationAlgo> m_LineSegmenter;
+  vtkSmartPointer<vtkIGSIOTransformRepository> m_TransformRepository;
+
+  /*! Timestamps of the samples */
+  std::vector<double> m_Timestamps;
+
+  /*! Line positions of video signals */
+  std::vector<double> m_LinePositions;
+
+  /*! Probe positions (x, y, z for each sample) of tracker signals */
+  std::vector<double> m_ProbePositions;
+};
+
+#endif
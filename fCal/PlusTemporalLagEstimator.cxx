@@ -0,0 +1,333 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusTemporalLagEstimator.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkTable.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+  /*! Minimum number of samples in a signal and in the overlapping part of the signals */
+  const int MINIMUM_NUMBER_OF_SAMPLES = 10;
+}
+
+//-----------------------------------------------------------------------------
+PlusTemporalLagEstimator::PlusTemporalLagEstimator()
+  : m_MaximumLagSec(0.5)
+  , m_SamplingResolutionSec(0.001)
+  , m_MinimumCorrelation(0.5)
+  , m_CoarseSamplingResolutionSec(0.01)
+  , m_MovingLagSec(0.0)
+  , m_BestCorrelation(0.0)
+  , m_CorrelationSign(1.0)
+  , m_MovingSignalTooShort(false)
+  , m_GridStartTime(0.0)
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusTemporalLagEstimator::~PlusTemporalLagEstimator()
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTemporalLagEstimator::Update(const std::vector<double>& aFixedTimestamps, const std::vector<double>& aFixedPositions,
+    const std::vector<double>& aMovingTimestamps, const std::vector<double>& aMovingPositions,
+    vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR& aError)
+{
+  aError = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NONE;
+  m_MovingLagSec = 0.0;
+  m_BestCorrelation = 0.0;
+  m_CorrelationSign = 1.0;
+  m_MovingSignalTooShort = false;
+
+  m_FixedTimestamps = aFixedTimestamps;
+  m_FixedPositions = aFixedPositions;
+  m_MovingTimestamps = aMovingTimestamps;
+  m_MovingPositions = aMovingPositions;
+
+  if (m_SamplingResolutionSec <= 0.0)
+  {
+    aError = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_SAMPLING_RESOLUTION_TOO_SMALL;
+    return PLUS_FAIL;
+  }
+  if (static_cast<int>(m_FixedTimestamps.size()) < MINIMUM_NUMBER_OF_SAMPLES || m_FixedPositions.size() != m_FixedTimestamps.size())
+  {
+    LOG_DEBUG("Not enough samples in the fixed signal: " << m_FixedTimestamps.size());
+    aError = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NOT_ENOUGH_FIXED_FRAMES;
+    return PLUS_FAIL;
+  }
+  if (static_cast<int>(m_MovingTimestamps.size()) < MINIMUM_NUMBER_OF_SAMPLES || m_MovingPositions.size() != m_MovingTimestamps.size())
+  {
+    LOG_DEBUG("Not enough samples in the moving signal: " << m_MovingTimestamps.size());
+    // There is no separate error code for the moving signal
+    aError = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NOT_ENOUGH_FIXED_FRAMES;
+    m_MovingSignalTooShort = true;
+    return PLUS_FAIL;
+  }
+
+  // Uniform time grids that cover both signals
+  m_GridStartTime = std::min(m_FixedTimestamps.front(), m_MovingTimestamps.front());
+  const int maximumShift = static_cast<int>(m_MaximumLagSec / m_SamplingResolutionSec + 0.5);
+  int firstShift = -maximumShift;
+  int lastShift = maximumShift;
+  double fineSearchProgressStart = 0.0;
+
+  const int coarseStep = static_cast<int>(m_CoarseSamplingResolutionSec / m_SamplingResolutionSec + 0.5);
+  if (coarseStep > 2)
+  {
+    std::vector<double> fixedCoarse;
+    std::vector<bool> fixedCoarseValid;
+    ResampleSignal(m_FixedTimestamps, m_FixedPositions, coarseStep * m_SamplingResolutionSec, fixedCoarse, fixedCoarseValid);
+    std::vector<double> movingCoarse;
+    std::vector<bool> movingCoarseValid;
+    ResampleSignal(m_MovingTimestamps, m_MovingPositions, coarseStep * m_SamplingResolutionSec, movingCoarse, movingCoarseValid);
+
+    const int maximumCoarseShift = maximumShift / coarseStep;
+    bool coarseCorrelationComputed = false;
+    int bestCoarseShift = 0;
+    double bestCoarseCorrelation = 0.0;
+    if (FindBestShift(fixedCoarse, fixedCoarseValid, movingCoarse, movingCoarseValid, -maximumCoarseShift, maximumCoarseShift,
+                      0.0, 0.5, coarseCorrelationComputed, bestCoarseShift, bestCoarseCorrelation) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // If the coarse grid is too sparse for correlation then the whole range is searched at full resolution
+    if (coarseCorrelationComputed)
+    {
+      firstShift = std::max(-maximumShift, (bestCoarseShift - 1) * coarseStep);
+      lastShift = std::min(maximumShift, (bestCoarseShift + 1) * coarseStep);
+    }
+    fineSearchProgressStart = 0.5;
+  }
+
+  std::vector<double> fixedResampled;
+  std::vector<bool> fixedValid;
+  ResampleSignal(m_FixedTimestamps, m_FixedPositions, m_SamplingResolutionSec, fixedResampled, fixedValid);
+  std::vector<double> movingResampled;
+  std::vector<bool> movingValid;
+  ResampleSignal(m_MovingTimestamps, m_MovingPositions, m_SamplingResolutionSec, movingResampled, movingValid);
+
+  bool correlationComputed = false;
+  double bestSignedCorrelation = 0.0;
+  int bestShift = 0;
+  if (FindBestShift(fixedResampled, fixedValid, movingResampled, movingValid, firstShift, lastShift,
+                    fineSearchProgressStart, 1.0, correlationComputed, bestShift, bestSignedCorrelation) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (!correlationComputed)
+  {
+    LOG_DEBUG("Unable to correlate the fixed and moving signals. Check if the signals overlap in time and the position changes in both.");
+    aError = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_UNABLE_NORMALIZE_METRIC;
+    return PLUS_FAIL;
+  }
+
+  m_MovingLagSec = bestShift * m_SamplingResolutionSec;
+  m_BestCorrelation = fabs(bestSignedCorrelation);
+  m_CorrelationSign = (bestSignedCorrelation < 0 ? -1.0 : 1.0);
+
+  if (m_BestCorrelation < m_MinimumCorrelation)
+  {
+    aError = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_RESULT_ABOVE_THRESHOLD;
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTemporalLagEstimator::FindBestShift(const std::vector<double>& aFixed, const std::vector<bool>& aFixedValid,
+    const std::vector<double>& aMoving, const std::vector<bool>& aMovingValid,
+    int aFirstShift, int aLastShift, double aProgressStart, double aProgressEnd,
+    bool& aFound, int& aBestShift, double& aBestSignedCorrelation)
+{
+  aFound = false;
+  aBestShift = 0;
+  aBestSignedCorrelation = 0.0;
+
+  const int numberOfShifts = aLastShift - aFirstShift + 1;
+  for (int shift = aFirstShift; shift <= aLastShift; ++shift)
+  {
+    if (m_ProgressCallback && !m_ProgressCallback(aProgressStart + (aProgressEnd - aProgressStart) * (shift - aFirstShift) / numberOfShifts))
+    {
+      return PLUS_FAIL;
+    }
+
+    double correlation = ComputeCorrelation(aFixed, aFixedValid, aMoving, aMovingValid, shift);
+    if (correlation != correlation)
+    {
+      // NaN: not enough overlap or constant signal
+      continue;
+    }
+    if (!aFound || fabs(correlation) > fabs(aBestSignedCorrelation))
+    {
+      aFound = true;
+      aBestSignedCorrelation = correlation;
+      aBestShift = shift;
+    }
+  }
+
+  if (m_ProgressCallback && !m_ProgressCallback(aProgressEnd))
+  {
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void PlusTemporalLagEstimator::ResampleSignal(const std::vector<double>& aTimestamps, const std::vector<double>& aPositions, double aResolutionSec, std::vector<double>& aResampled, std::vector<bool>& aValid)
+{
+  aResampled.clear();
+  aValid.clear();
+
+  const double endTime = std::max(m_FixedTimestamps.back(), m_MovingTimestamps.back());
+  const int numberOfGridPoints = static_cast<int>((endTime - m_GridStartTime) / aResolutionSec) + 1;
+  aResampled.resize(numberOfGridPoints, 0.0);
+  aValid.resize(numberOfGridPoints, false);
+
+  unsigned int sampleIndex = 0;
+  for (int gridIndex = 0; gridIndex < numberOfGridPoints; ++gridIndex)
+  {
+    double time = m_GridStartTime + gridIndex * aResolutionSec;
+    if (time < aTimestamps.front() || time > aTimestamps.back())
+    {
+      continue;
+    }
+    while (sampleIndex + 1 < aTimestamps.size() && aTimestamps[sampleIndex + 1] < time)
+    {
+      ++sampleIndex;
+    }
+    if (sampleIndex + 1 >= aTimestamps.size())
+    {
+      aResampled[gridIndex] = aPositions.back();
+    }
+    else
+    {
+      double weight = (time - aTimestamps[sampleIndex]) / (aTimestamps[sampleIndex + 1] - aTimestamps[sampleIndex]);
+      aResampled[gridIndex] = (1.0 - weight) * aPositions[sampleIndex] + weight * aPositions[sampleIndex + 1];
+    }
+    aValid[gridIndex] = true;
+  }
+}
+
+//-----------------------------------------------------------------------------
+double PlusTemporalLagEstimator::ComputeCorrelation(const std::vector<double>& aFixed, const std::vector<bool>& aFixedValid,
+    const std::vector<double>& aMoving, const std::vector<bool>& aMovingValid, int aShift)
+{
+  double sumFixed = 0.0;
+  double sumMoving = 0.0;
+  double sumFixedSquared = 0.0;
+  double sumMovingSquared = 0.0;
+  double sumProduct = 0.0;
+  int numberOfPairs = 0;
+
+  const int numberOfGridPoints = aFixed.size();
+  const int firstIndex = std::max(0, -aShift);
+  const int lastIndex = std::min(numberOfGridPoints, numberOfGridPoints - aShift);
+  for (int fixedIndex = firstIndex; fixedIndex < lastIndex; ++fixedIndex)
+  {
+    const int movingIndex = fixedIndex + aShift;
+    if (!aFixedValid[fixedIndex] || !aMovingValid[movingIndex])
+    {
+      continue;
+    }
+    const double fixedValue = aFixed[fixedIndex];
+    const double movingValue = aMoving[movingIndex];
+    sumFixed += fixedValue;
+    sumMoving += movingValue;
+    sumFixedSquared += fixedValue * fixedValue;
+    sumMovingSquared += movingValue * movingValue;
+    sumProduct += fixedValue * movingValue;
+    ++numberOfPairs;
+  }
+
+  if (numberOfPairs < MINIMUM_NUMBER_OF_SAMPLES)
+  {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  const double covariance = sumProduct - sumFixed * sumMoving / numberOfPairs;
+  const double fixedVariance = sumFixedSquared - sumFixed * sumFixed / numberOfPairs;
+  const double movingVariance = sumMovingSquared - sumMoving * sumMoving / numberOfPairs;
+  if (fixedVariance <= 0.0 || movingVariance <= 0.0)
+  {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  return covariance / sqrt(fixedVariance * movingVariance);
+}
+
+//-----------------------------------------------------------------------------
+void PlusTemporalLagEstimator::GetFixedPositionSignal(vtkTable* aTable)
+{
+  ConstructTable(m_FixedTimestamps, m_FixedPositions, m_GridStartTime, 1.0, aTable);
+}
+
+//-----------------------------------------------------------------------------
+void PlusTemporalLagEstimator::GetUncalibratedMovingPositionSignal(vtkTable* aTable)
+{
+  ConstructTable(m_MovingTimestamps, m_MovingPositions, m_GridStartTime, m_CorrelationSign, aTable);
+}
+
+//-----------------------------------------------------------------------------
+void PlusTemporalLagEstimator::GetCalibratedMovingPositionSignal(vtkTable* aTable)
+{
+  ConstructTable(m_MovingTimestamps, m_MovingPositions, m_GridStartTime + m_MovingLagSec, m_CorrelationSign, aTable);
+}
+
+//-----------------------------------------------------------------------------
+void PlusTemporalLagEstimator::ConstructTable(const std::vector<double>& aTimestamps, const std::vector<double>& aPositions, double aTimeOffset, double aSign, vtkTable* aTable)
+{
+  if (aTable == NULL)
+  {
+    return;
+  }
+
+  // Normalize to zero mean and unit standard deviation, so that the signals can be shown in the same plot
+  double mean = 0.0;
+  double standardDeviation = 0.0;
+  if (!aPositions.empty())
+  {
+    for (std::vector<double>::const_iterator positionIt = aPositions.begin(); positionIt != aPositions.end(); ++positionIt)
+    {
+      mean += *positionIt / aPositions.size();
+    }
+    for (std::vector<double>::const_iterator positionIt = aPositions.begin(); positionIt != aPositions.end(); ++positionIt)
+    {
+      standardDeviation += (*positionIt - mean) * (*positionIt - mean) / aPositions.size();
+    }
+    standardDeviation = sqrt(standardDeviation);
+  }
+  if (standardDeviation <= 0.0)
+  {
+    standardDeviation = 1.0;
+  }
+
+  vtkSmartPointer<vtkDoubleArray> timeArray = vtkSmartPointer<vtkDoubleArray>::New();
+  timeArray->SetName("Time [s]");
+  vtkSmartPointer<vtkDoubleArray> positionArray = vtkSmartPointer<vtkDoubleArray>::New();
+  positionArray->SetName("Position");
+
+  aTable->Initialize();
+  aTable->AddColumn(timeArray);
+  aTable->AddColumn(positionArray);
+  aTable->SetNumberOfRows(aPositions.size());
+  for (unsigned int sampleIndex = 0; sampleIndex < aPositions.size() && sampleIndex < aTimestamps.size(); ++sampleIndex)
+  {
+    aTable->SetValue(sampleIndex, 0, aTimestamps[sampleIndex] - aTimeOffset);
+    aTable->SetValue(sampleIndex, 1, aSign * (aPositions[sampleIndex] - mean) / standardDeviation);
+  }
+}
@@ -0,0 +1,129 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusTemporalLagEstimator_h
+#define __PlusTemporalLagEstimator_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+#include <vtkPlusTemporalCalibrationAlgo.h>
+
+// STL includes
+#include <functional>
+#include <vector>
+
+class vtkTable;
+
+//-----------------------------------------------------------------------------
+
+/*! \class PlusTemporalLagEstimator
+ * \brief Estimates the time lag between two position signals by normalized cross-correlation
+ *
+ * Both signals are resampled to a uniform time grid and the moving signal is shifted by whole sampling steps within
+ * the maximum lag. The lag with the highest absolute correlation is the result, so the signals may move in opposite
+ * directions (e.g., line distance decreases while the probe moves up).
+ *
+ * The search is coarse-to-fine: the whole lag range is swept on a coarse grid first, then only the neighborhood of
+ * the coarse optimum is searched at the sampling resolution.
+ * \ingroup PlusAppFCal
+ */
+class PlusTemporalLagEstimator
+{
+public:
+  /*! Called with the progress of the computation (0.0 to 1.0). The computation is aborted if it returns false. */
+  typedef std::function<bool(double)> ProgressCallbackType;
+
+  PlusTemporalLagEstimator();
+  virtual ~PlusTemporalLagEstimator();
+
+  /*!
+  * Compute the lag of the moving signal
+  * \param aFixedTimestamps Timestamps of the fixed signal, in increasing order
+  * \param aFixedPositions Positions of the fixed signal
+  * \param aMovingTimestamps Timestamps of the moving signal, in increasing order
+  * \param aMovingPositions Positions of the moving signal
+  * \param aError Reason of the failure (TEMPORAL_CALIBRATION_ERROR_NONE if aborted by the progress callback).
+  *   TEMPORAL_CALIBRATION_ERROR_NOT_ENOUGH_FIXED_FRAMES is reported for too short fixed or moving signal, see IsMovingSignalTooShort.
+  */
+  PlusStatus Update(const std::vector<double>& aFixedTimestamps, const std::vector<double>& aFixedPositions,
+                    const std::vector<double>& aMovingTimestamps, const std::vector<double>& aMovingPositions,
+                    vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR& aError);
+
+  /*! Lag of the moving signal compared to the fixed signal (positive if the moving signal is delayed) */
+  double GetMovingLagSec() const { return m_MovingLagSec; };
+
+  /*! Absolute value of the normalized correlation at the computed lag (1.0 is perfect match) */
+  double GetBestCorrelation() const { return m_BestCorrelation; };
+
+  /*! Returns true if the last update failed because the moving signal did not have enough samples */
+  bool IsMovingSignalTooShort() const { return m_MovingSignalTooShort; };
+
+  /*! Normalized fixed signal (time, position) */
+  void GetFixedPositionSignal(vtkTable* aTable);
+
+  /*! Normalized moving signal before lag correction (time, position) */
+  void GetUncalibratedMovingPositionSignal(vtkTable* aTable);
+
+  /*! Normalized moving signal after lag correction (time, position) */
+  void GetCalibratedMovingPositionSignal(vtkTable* aTable);
+
+  void SetMaximumLagSec(double aValue) { m_MaximumLagSec = aValue; };
+  void SetSamplingResolutionSec(double aValue) { m_SamplingResolutionSec = aValue; };
+  void SetMinimumCorrelation(double aValue) { m_MinimumCorrelation = aValue; };
+
+  /*! Resolution of the coarse lag sweep. If it is not larger than twice the sampling resolution then the whole range is searched at the sampling resolution. */
+  void SetCoarseSamplingResolutionSec(double aValue) { m_CoarseSamplingResolutionSec = aValue; };
+
+  void SetProgressCallback(const ProgressCallbackType& aCallback) { m_ProgressCallback = aCallback; };
+
+protected:
+  /*! Resample a signal to the uniform grid with the given resolution. Samples outside of the signal time range are marked invalid. */
+  void ResampleSignal(const std::vector<double>& aTimestamps, const std::vector<double>& aPositions, double aResolutionSec, std::vector<double>& aResampled, std::vector<bool>& aValid);
+
+  /*!
+  * Find the shift with the highest absolute correlation in a shift range of signals resampled to the same grid
+  * \param aFound Set to false if the correlation could not be computed for any of the shifts
+  * \return PLUS_FAIL if the computation was aborted by the progress callback
+  */
+  PlusStatus FindBestShift(const std::vector<double>& aFixed, const std::vector<bool>& aFixedValid,
+                           const std::vector<double>& aMoving, const std::vector<bool>& aMovingValid,
+                           int aFirstShift, int aLastShift, double aProgressStart, double aProgressEnd,
+                           bool& aFound, int& aBestShift, double& aBestSignedCorrelation);
+
+  /*! Normalized correlation of the resampled signals when the moving signal is shifted by the given number of samples */
+  static double ComputeCorrelation(const std::vector<double>& aFixed, const std::vector<bool>& aFixedValid,
+                                   const std::vector<double>& aMoving, const std::vector<bool>& aMovingValid, int aShift);
+
+  /*! Fill a table with a normalized signal */
+  static void ConstructTable(const std::vector<double>& aTimestamps, const std::vector<double>& aPositions, double aTimeOffset, double aSign, vtkTable* aTable);
+
+protected:
+  double m_MaximumLagSec;
+  double m_SamplingResolutionSec;
+  double m_MinimumCorrelation;
+  double m_CoarseSamplingResolutionSec;
+
+  ProgressCallbackType m_ProgressCallback;
+
+  double m_MovingLagSec;
+  double m_BestCorrelation;
+  /*! -1 if the signals move in opposite directions, +1 otherwise */
+  double m_CorrelationSign;
+
+  /*! Set if the last update failed because the moving signal did not have enough samples */
+  bool m_MovingSignalTooShort;
+
+  /*! Start of the uniform time grid */
+  double m_GridStartTime;
+
+  /*! Input signals, kept for constructing the tables */
+  std::vector<double> m_FixedTimestamps;
+  std::vector<double> m_FixedPositions;
+  std::vector<double> m_MovingTimestamps;
+  std::vector<double> m_MovingPositions;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusTrackerPoseSampler.h"
+
+// PlusLib includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTransformRepository.h>
+#include <vtkPlusChannel.h>
+#include <vtkPlusDataSource.h>
+
+// STL includes
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+PlusTrackerPoseSampler::PlusTrackerPoseSampler()
+  : m_Channel(NULL)
+  , m_TrackerSource(NULL)
+  , m_TransformRepository(vtkSmartPointer<vtkIGSIOTransformRepository>::New())
+  , m_MaxNumberOfItemsPerCall(1000)
+  , m_LastSampledItemUid(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusTrackerPoseSampler::~PlusTrackerPoseSampler()
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTrackerPoseSampler::Reset(vtkPlusChannel* aChannel, vtkIGSIOTransformRepository* aTransformRepository, const igsioTransformName& aToolToReferenceTransformName)
+{
+  m_Channel = NULL;
+  m_TrackerSource = NULL;
+  m_ToolToReferenceTransformName = aToolToReferenceTransformName;
+
+  if (aChannel == NULL || aTransformRepository == NULL)
+  {
+    LOG_ERROR("Unable to reset tracker pose sampler: invalid channel or transform repository");
+    return PLUS_FAIL;
+  }
+
+  // Use the persistent transforms only, the tool transforms are set from the sampled frames
+  m_TransformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (m_TransformRepository->DeepCopy(aTransformRepository, true) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to copy transform repository for tracker pose sampling");
+    return PLUS_FAIL;
+  }
+
+  // Sample at the times of the items of the sampled tool. If it is not a tool of the channel
+  // (e.g., its pose is computed from other transforms) then any tool buffer will do.
+  for (DataSourceContainerConstIterator toolIt = aChannel->GetToolsStartIterator(); toolIt != aChannel->GetToolsEndIterator(); ++toolIt)
+  {
+    vtkPlusDataSource* tool = toolIt->second;
+    if (m_TrackerSource == NULL)
+    {
+      m_TrackerSource = tool;
+    }
+    igsioTransformName toolTransformName(tool->GetId());
+    if (toolTransformName.From() == aToolToReferenceTransformName.From())
+    {
+      m_TrackerSource = tool;
+      break;
+    }
+  }
+  if (m_TrackerSource == NULL)
+  {
+    LOG_ERROR("Unable to reset tracker pose sampler: channel " << (aChannel->GetChannelId() ? aChannel->GetChannelId() : "(undefined)") << " has no tracker tools");
+    return PLUS_FAIL;
+  }
+
+  m_Channel = aChannel;
+
+  // Items that were acquired before the start are not sampled
+  m_LastSampledItemUid = m_TrackerSource->GetLatestItemUidInBuffer();
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+int PlusTrackerPoseSampler::GetNewSamples(std::vector<vtkSmartPointer<vtkMatrix4x4> >& aToolToReferenceMatrices)
+{
+  if (m_Channel == NULL || m_TrackerSource == NULL)
+  {
+    return 0;
+  }
+
+  BufferItemUidType latestItemUid = m_TrackerSource->GetLatestItemUidInBuffer();
+  if (latestItemUid <= m_LastSampledItemUid)
+  {
+    // No new items
+    return 0;
+  }
+
+  // Items that have been overwritten in the circular buffer since the previous call are lost
+  BufferItemUidType firstItemUid = std::max(m_LastSampledItemUid + 1, m_TrackerSource->GetOldestItemUidInBuffer());
+  if (firstItemUid > m_LastSampledItemUid + 1)
+  {
+    LOG_WARNING("Tracker pose sampling could not keep up with the tracker, " << firstItemUid - m_LastSampledItemUid - 1 << " items were skipped");
+  }
+
+  int numberOfSamples = 0;
+  igsioTrackedFrame trackedFrame;
+  for (BufferItemUidType itemUid = firstItemUid; itemUid <= latestItemUid && itemUid < firstItemUid + m_MaxNumberOfItemsPerCall; ++itemUid)
+  {
+    m_LastSampledItemUid = itemUid;
+
+    double timestamp = 0.0;
+    if (m_TrackerSource->GetTimeStamp(itemUid, timestamp) != ITEM_OK)
+    {
+      LOG_DEBUG("Unable to get timestamp of tracker item " << itemUid);
+      continue;
+    }
+
+    // Transforms only, the image is not needed
+    if (m_Channel->GetTrackedFrame(timestamp, trackedFrame, false) != PLUS_SUCCESS)
+    {
+      LOG_DEBUG("Unable to get tracked frame at " << std::fixed << timestamp);
+      continue;
+    }
+
+    vtkSmartPointer<vtkMatrix4x4> toolToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    ToolStatus status(TOOL_INVALID);
+    if (m_TransformRepository->SetTransforms(trackedFrame) != PLUS_SUCCESS
+        || m_TransformRepository->GetTransform(m_ToolToReferenceTransformName, toolToReferenceMatrix, &status) != PLUS_SUCCESS
+        || status != TOOL_OK)
+    {
+      // Tool or reference is out of view
+      continue;
+    }
+
+    aToolToReferenceMatrices.push_back(toolToReferenceMatrix);
+    ++numberOfSamples;
+  }
+
+  return numberOfSamples;
+}
@@ -0,0 +1,81 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusTrackerPoseSampler_h
+#define __PlusTrackerPoseSampler_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+
+// IGSIO includes
+#include <igsioCommon.h>
+#include <igsioTransformName.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <vector>
+
+class vtkIGSIOTransformRepository;
+class vtkPlusChannel;
+class vtkPlusDataSource;
+
+//-----------------------------------------------------------------------------
+
+/*! \class PlusTrackerPoseSampler
+ * \brief Collects every pose of a tracked tool that the tracker recorded since the previous call
+ *
+ * Instead of sampling the current tool pose at the rate of the display refresh, the sampler iterates through the
+ * items of the tool buffer by their unique identifiers. For each new item the tool transforms of the channel
+ * are queried at the item timestamp without image data, and the sampled transform is computed from them.
+ * This way no tracker samples are lost between two calls and the sampling rate is the tracker rate.
+ * Used for stylus pivot calibration and for recording stylus tip paths in phantom registration.
+ * \ingroup PlusAppFCal
+ */
+class PlusTrackerPoseSampler
+{
+public:
+  PlusTrackerPoseSampler();
+  virtual ~PlusTrackerPoseSampler();
+
+  /*!
+  * Set the data source and start sampling from the latest tracker item
+  * \param aChannel Channel that provides the tool transforms
+  * \param aTransformRepository Repository that contains the persistent transforms (copied)
+  * \param aToolToReferenceTransformName Transform to be sampled (e.g., stylus to reference)
+  */
+  PlusStatus Reset(vtkPlusChannel* aChannel, vtkIGSIOTransformRepository* aTransformRepository, const igsioTransformName& aToolToReferenceTransformName);
+
+  /*!
+  * Get the valid poses of the tracker items recorded since the previous call. At most MaxNumberOfItemsPerCall items are
+  * processed in one call, the rest is processed in the next call.
+  * \param aToolToReferenceMatrices New tool to reference matrices are appended to this list, in the order of acquisition
+  * \return Number of appended matrices
+  */
+  int GetNewSamples(std::vector<vtkSmartPointer<vtkMatrix4x4> >& aToolToReferenceMatrices);
+
+  /*! Set maximum number of tracker items to process in one call. Limits the time spent in a call if the caller is in the GUI thread. */
+  void SetMaxNumberOfItemsPerCall(int aValue) { m_MaxNumberOfItemsPerCall = aValue; };
+
+protected:
+  vtkPlusChannel* m_Channel;
+
+  /*! Tool buffer that determines the sampling times (the sampled tool, if found) */
+  vtkPlusDataSource* m_TrackerSource;
+
+  vtkSmartPointer<vtkIGSIOTransformRepository> m_TransformRepository;
+  igsioTransformName m_ToolToReferenceTransformName;
+
+  /*! Maximum number of tracker items to process in one call */
+  int m_MaxNumberOfItemsPerCall;
+
+  /*! Unique identifier of the last processed item of the tracker buffer */
+  BufferItemUidType m_LastSampledItemUid;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusTransformStatusFilter.h"
+
+// PlusLib includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+#include <vtkIGSIOTransformRepository.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+
+//-----------------------------------------------------------------------------
+PlusTransformStatusFilter::PlusTransformStatusFilter()
+  : m_TransformRepository(vtkSmartPointer<vtkIGSIOTransformRepository>::New())
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusTransformStatusFilter::~PlusTransformStatusFilter()
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTransformStatusFilter::Initialize(vtkIGSIOTransformRepository* aTransformRepository, const igsioTransformName& aTransformName)
+{
+  m_TransformName = aTransformName;
+  m_TransformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (aTransformRepository == NULL || m_TransformRepository->DeepCopy(aTransformRepository, true) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to copy transform repository");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTransformStatusFilter::GetDependencies(igsioTrackedFrame* aTrackedFrame, std::vector<igsioTransformName>& aDependencies)
+{
+  aDependencies.clear();
+
+  std::vector<igsioTransformName> frameTransformNames;
+  aTrackedFrame->GetFrameTransformNameList(frameTransformNames);
+
+  // Only the statuses matter, so identity matrices are used. A frame transform is a dependency
+  // if the transform becomes invalid when only that one is invalid.
+  vtkSmartPointer<vtkMatrix4x4> identityMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (std::vector<igsioTransformName>::iterator nameIt = frameTransformNames.begin(); nameIt != frameTransformNames.end(); ++nameIt)
+  {
+    m_TransformRepository->SetTransform(*nameIt, identityMatrix, TOOL_OK);
+  }
+
+  bool transformValid = false;
+  if (m_TransformRepository->GetTransformValid(m_TransformName, transformValid) != PLUS_SUCCESS || !transformValid)
+  {
+    LOG_DEBUG(m_TransformName.GetTransformName() << " transform cannot be computed from the transforms of the frame");
+    return PLUS_FAIL;
+  }
+
+  for (std::vector<igsioTransformName>::iterator nameIt = frameTransformNames.begin(); nameIt != frameTransformNames.end(); ++nameIt)
+  {
+    m_TransformRepository->SetTransform(*nameIt, identityMatrix, TOOL_INVALID);
+    m_TransformRepository->GetTransformValid(m_TransformName, transformValid);
+    if (!transformValid)
+    {
+      aDependencies.push_back(*nameIt);
+    }
+    m_TransformRepository->SetTransform(*nameIt, identityMatrix, TOOL_OK);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void PlusTransformStatusFilter::GetValidFrames(vtkIGSIOTrackedFrameList* aTrackedFrameList, std::vector<unsigned int>& aValidFrameIndices)
+{
+  aValidFrameIndices.clear();
+  if (aTrackedFrameList->GetNumberOfTrackedFrames() == 0)
+  {
+    return;
+  }
+
+  std::vector<igsioTransformName> dependencies;
+  if (GetDependencies(aTrackedFrameList->GetTrackedFrame(0), dependencies) != PLUS_SUCCESS)
+  {
+    return;
+  }
+
+  aValidFrameIndices.reserve(aTrackedFrameList->GetNumberOfTrackedFrames());
+  for (unsigned int frameIndex = 0; frameIndex < aTrackedFrameList->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame* trackedFrame = aTrackedFrameList->GetTrackedFrame(frameIndex);
+    bool valid = true;
+    for (std::vector<igsioTransformName>::iterator nameIt = dependencies.begin(); valid && nameIt != dependencies.end(); ++nameIt)
+    {
+      ToolStatus status = TOOL_INVALID;
+      valid = (trackedFrame->GetFrameTransformStatus(*nameIt, status) == PLUS_SUCCESS && status == TOOL_OK);
+    }
+    if (valid)
+    {
+      aValidFrameIndices.push_back(frameIndex);
+    }
+  }
+}
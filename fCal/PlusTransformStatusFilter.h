@@ -0,0 +1,72 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusTransformStatusFilter_h
+#define __PlusTransformStatusFilter_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+#include <igsioTransformName.h>
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+class vtkIGSIOTransformRepository;
+
+//-----------------------------------------------------------------------------
+
+/*! \class PlusTransformStatusFilter
+ * \brief Selects the tracked frames in which a computed transform is valid, based on the transform statuses stored in the frames
+ *
+ * The frame transforms that the computed transform depends on are determined once per list, on a private copy of
+ * the transform repository, by invalidating each frame transform in turn. After that a frame is valid if the stored
+ * statuses of all these frame transforms are OK, so the repository does not have to be updated for every frame.
+ * \ingroup PlusAppFCal
+ */
+class PlusTransformStatusFilter
+{
+public:
+  PlusTransformStatusFilter();
+  virtual ~PlusTransformStatusFilter();
+
+  /*!
+  * Set the transform that has to be valid and copy the persistent transforms of the repository that it is computed with
+  * \param aTransformRepository Transform repository that contains the persistent transforms (e.g., the phantom registration)
+  * \param aTransformName Transform that has to be valid in the selected frames
+  */
+  PlusStatus Initialize(vtkIGSIOTransformRepository* aTransformRepository, const igsioTransformName& aTransformName);
+
+  /*!
+  * Determine which frame transforms the transform depends on
+  * \param aTrackedFrame Frame that contains the transforms that are provided by the tracker
+  * \param aDependencies Frame transforms that have to be valid for a valid transform
+  */
+  PlusStatus GetDependencies(igsioTrackedFrame* aTrackedFrame, std::vector<igsioTransformName>& aDependencies);
+
+  /*!
+  * Select the frames in which the transform is valid. All frames of the list have to contain the same transforms.
+  * \param aTrackedFrameList Frames to check
+  * \param aValidFrameIndices Indices of the valid frames, in increasing order
+  */
+  void GetValidFrames(vtkIGSIOTrackedFrameList* aTrackedFrameList, std::vector<unsigned int>& aValidFrameIndices);
+
+  /*! Private copy of the transform repository. Can be used for computing transforms of the selected frames. */
+  vtkIGSIOTransformRepository* GetTransformRepository() { return m_TransformRepository; };
+
+protected:
+  /*! Copy of the transform repository, its frame transforms are overwritten when determining the dependencies */
+  vtkSmartPointer<vtkIGSIOTransformRepository> m_TransformRepository;
+
+  /*! Transform that has to be valid */
+  igsioTransformName m_TransformName;
+};
+
+#endif
@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Local includes
 #include "QPlusSegmentationParameterDialog.h"
+#include "QPlusSegmentationParameterOptimizer.h"
 #include "vtkPlusImageVisualizer.h"
 
 // PlusLib includes
@@ -30,6 +31,7 @@ See License.txt for details.
 #include <vtkImageData.h>
 #include <vtkLineSource.h>
 #include <vtkMath.h>
+#include <vtkPoints.h>
 #include <vtkPolyData.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkPropPicker.h>
@@ -44,8 +46,10 @@ See License.txt for details.
 #include <vtksys/SystemTools.hxx>
 
 // Qt includes
+#include <QFileDialog>
 #include <QMessageBox>
 #include <QResource>
+#include <QThread>
 #include <QTimer>
 
 // STL includes
@@ -65,6 +69,18 @@ void SetupHandleActor(vtkActor* actor, vtkSphereSource* source, double r, double
   actor->GetProperty()->SetColor(r, g, b);
 }
 
+//-----------------------------------------------------------------------------
+void SetPointPositions(vtkPoints* points, const std::vector<std::array<double, 2> >& positions, double z)
+{
+  // Update the points in place: Reset keeps the allocated memory, which is only extended if there are more points than before
+  points->Reset();
+  for (unsigned int i = 0; i < positions.size(); ++i)
+  {
+    points->InsertNextPoint(positions[i][0], positions[i][1], z);
+  }
+  points->Modified();
+}
+
 /*! \class vtkSegmentationParameterDialogModeHandlerBase
 *
 * \brief Base class for the segmentation parameter dialog mode handlers
@@ -755,6 +771,11 @@ QPlusSegmentationParameterDialog::QPlusSegmentationParameterDialog(QWidget* aPar
   , m_SpacingModeHandler(NULL)
   , m_ApproximateSpacingMmPerPixel(0.0)
   , m_ImageFrozen(false)
+  , m_SegmentationPreviewThread(NULL)
+  , m_SegmentationPreviewWorker(NULL)
+  , m_SegmentationParametersModified(true)
+  , m_SegmentedFrameTimestamp(UNDEFINED_TIMESTAMP)
+  , m_ParameterOptimizer(NULL)
 {
   ui.setupUi(this);
 
@@ -782,11 +803,27 @@ QPlusSegmentationParameterDialog::QPlusSegmentationParameterDialog(QWidget* aPar
   connect(ui.doubleSpinBox_MaxLineShiftMm, SIGNAL(valueChanged(double)), this, SLOT(MaxLineShiftMmChanged(double)));
   connect(ui.checkBox_OriginalIntensityForDots, SIGNAL(toggled(bool)), this, SLOT(OriginalIntensityForDotsToggled(bool)));
   connect(ui.doubleSpinBox_MaxCandidates, SIGNAL(valueChanged(double)), this, SLOT(MaxCandidatesChanged(double)));
+  connect(ui.pushButton_AddOptimizationFrame, SIGNAL(clicked()), this, SLOT(AddOptimizationFrame()));
+  connect(ui.pushButton_LoadOptimizationFrames, SIGNAL(clicked()), this, SLOT(LoadOptimizationFrames()));
+  connect(ui.pushButton_ClearOptimizationFrames, SIGNAL(clicked()), this, SLOT(ClearOptimizationFrames()));
+  connect(ui.pushButton_Optimize, SIGNAL(clicked()), this, SLOT(OptimizeParameters()));
 
   // Set up timer for refreshing UI
   m_CanvasRefreshTimer = new QTimer(this);
   connect(m_CanvasRefreshTimer, SIGNAL(timeout()), this, SLOT(UpdateCanvas()));
 
+  // Segmentation runs in the background so that the parameter fields stay responsive
+  m_SegmentationPreviewThread = new QThread(this);
+  m_SegmentationPreviewWorker = new QPlusSegmentationPreviewWorker();
+  m_SegmentationPreviewWorker->moveToThread(m_SegmentationPreviewThread);
+  connect(m_SegmentationPreviewWorker, SIGNAL(ResultAvailable()), this, SLOT(SegmentationResultAvailable()));
+  m_SegmentationPreviewThread->start(QThread::LowPriority);
+
+  // Parameter optimization evaluates the candidates on a thread pool and reports back through queued signals
+  m_ParameterOptimizer = new QPlusSegmentationParameterOptimizer(this);
+  connect(m_ParameterOptimizer, SIGNAL(ProgressChanged(int)), this, SLOT(OptimizationProgressChanged(int)));
+  connect(m_ParameterOptimizer, SIGNAL(Finished()), this, SLOT(OptimizationFinished()));
+
   // Initialize calibration controller (does the segmentation)
   m_PatternRecognition = new PlusFidPatternRecognition();
   m_PatternRecognition->ReadConfiguration(vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData());
@@ -817,6 +854,23 @@ QPlusSegmentationParameterDialog::QPlusSegmentationParameterDialog(QWidget* aPar
 //-----------------------------------------------------------------------------
 QPlusSegmentationParameterDialog::~QPlusSegmentationParameterDialog()
 {
+  if (m_ParameterOptimizer != NULL)
+  {
+    disconnect(m_ParameterOptimizer, SIGNAL(ProgressChanged(int)), this, SLOT(OptimizationProgressChanged(int)));
+    disconnect(m_ParameterOptimizer, SIGNAL(Finished()), this, SLOT(OptimizationFinished()));
+    m_ParameterOptimizer->Cancel();
+    delete m_ParameterOptimizer;
+    m_ParameterOptimizer = NULL;
+  }
+
+  if (m_SegmentationPreviewThread != NULL)
+  {
+    m_SegmentationPreviewThread->quit();
+    m_SegmentationPreviewThread->wait();
+    delete m_SegmentationPreviewWorker;
+    m_SegmentationPreviewWorker = NULL;
+  }
+
   if (m_PatternRecognition != NULL)
   {
     delete m_PatternRecognition;
@@ -890,6 +944,10 @@ QPlusSegmentationParameterDialog::~QPlusSegmentationParameterDialog()
   disconnect(ui.doubleSpinBox_MaxLineShiftMm, SIGNAL(valueChanged(double)), this, SLOT(MaxLineShiftMmChanged(double)));
   disconnect(ui.checkBox_OriginalIntensityForDots, SIGNAL(toggled(bool)), this, SLOT(OriginalIntensityForDotsToggled(bool)));
   disconnect(ui.doubleSpinBox_MaxCandidates, SIGNAL(valueChanged(double)), this, SLOT(MaxCandidatesChanged(double)));
+  disconnect(ui.pushButton_AddOptimizationFrame, SIGNAL(clicked()), this, SLOT(AddOptimizationFrame()));
+  disconnect(ui.pushButton_LoadOptimizationFrames, SIGNAL(clicked()), this, SLOT(LoadOptimizationFrames()));
+  disconnect(ui.pushButton_ClearOptimizationFrames, SIGNAL(clicked()), this, SLOT(ClearOptimizationFrames()));
+  disconnect(ui.pushButton_Optimize, SIGNAL(clicked()), this, SLOT(OptimizeParameters()));
   disconnect(m_CanvasRefreshTimer, SIGNAL(timeout()), this, SLOT(UpdateCanvas()));
 }
 
@@ -920,6 +978,8 @@ PlusStatus QPlusSegmentationParameterDialog::InitializeVisualization()
 
   m_SegmentedPointsPolyData = vtkPolyData::New();
   m_SegmentedPointsPolyData->Initialize();
+  m_SegmentedPoints = vtkSmartPointer<vtkPoints>::New();
+  m_SegmentedPointsPolyData->SetPoints(m_SegmentedPoints);
 
   vtkSmartPointer<vtkPolyDataMapper> segmentedPointMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
   vtkSmartPointer<vtkGlyph3D> segmentedPointGlyph = vtkSmartPointer<vtkGlyph3D>::New();
@@ -937,6 +997,8 @@ PlusStatus QPlusSegmentationParameterDialog::InitializeVisualization()
   // Re-use the results actor in ImageVisualizer, no need to duplicate!
   m_CandidatesPolyData = vtkPolyData::New();
   m_CandidatesPolyData->Initialize();
+  m_CandidatePoints = vtkSmartPointer<vtkPoints>::New();
+  m_CandidatesPolyData->SetPoints(m_CandidatePoints);
 
   // Setup canvas
   m_ImageVisualizer = vtkPlusImageVisualizer::New();
@@ -1221,10 +1283,38 @@ PlusStatus QPlusSegmentationParameterDialog::WriteConfiguration()
   }
 
   // Save parameters
+  if (WriteSegmentationParameters(segmentationParameters) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  std::stringstream originSs;
+  std::stringstream sizeSs;
+  originSs << ui.spinBox_XMin->value() << " " << ui.spinBox_YMin->value();
+  sizeSs << ui.spinBox_XMax->value() - ui.spinBox_XMin->value() << " " << ui.spinBox_YMax->value() - ui.spinBox_YMin->value();
+
+  vtkXMLDataElement* temporalCalibration = vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData()->FindNestedElementWithName("vtkPlusTemporalCalibrationAlgo");
+  if (temporalCalibration == nullptr)
+  {
+    temporalCalibration = vtkXMLDataElement::New();
+    temporalCalibration->SetName("vtkPlusTemporalCalibrationAlgo");
+    vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData()->AddNestedElement(temporalCalibration);
+  }
+  temporalCalibration->SetAttribute("ClipRectangleOrigin", originSs.str().c_str());
+  temporalCalibration->SetAttribute("ClipRectangleSize", sizeSs.str().c_str());
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPlusSegmentationParameterDialog::WriteSegmentationParameters(vtkXMLDataElement* aSegmentationParameters)
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::WriteSegmentationParameters");
+
   bool ok = true;
   if (ui.label_SpacingResult->text().indexOf("original") == -1)     // If has been changed
   {
-    segmentationParameters->SetDoubleAttribute("ApproximateSpacingMmPerPixel", ui.label_SpacingResult->text().toDouble(&ok));
+    aSegmentationParameters->SetDoubleAttribute("ApproximateSpacingMmPerPixel", ui.label_SpacingResult->text().toDouble(&ok));
     if (!ok)
     {
       LOG_ERROR("ApproximateSpacingMmPerPixel parameter cannot be saved!");
@@ -1232,44 +1322,34 @@ PlusStatus QPlusSegmentationParameterDialog::WriteConfiguration()
     }
   }
 
-  segmentationParameters->SetDoubleAttribute("MorphologicalOpeningCircleRadiusMm", ui.doubleSpinBox_OpeningCircleRadius->value());
-  segmentationParameters->SetDoubleAttribute("MorphologicalOpeningBarSizeMm", ui.doubleSpinBox_OpeningBarSize->value());
-  segmentationParameters->SetDoubleAttribute("MorphologicalOpeningBarSizeMm", ui.doubleSpinBox_OpeningBarSize->value());
+  aSegmentationParameters->SetDoubleAttribute("MorphologicalOpeningCircleRadiusMm", ui.doubleSpinBox_OpeningCircleRadius->value());
+  aSegmentationParameters->SetDoubleAttribute("MorphologicalOpeningBarSizeMm", ui.doubleSpinBox_OpeningBarSize->value());
+  aSegmentationParameters->SetDoubleAttribute("MorphologicalOpeningBarSizeMm", ui.doubleSpinBox_OpeningBarSize->value());
 
   std::stringstream originSs;
   std::stringstream sizeSs;
   originSs << ui.spinBox_XMin->value() << " " << ui.spinBox_YMin->value();
   sizeSs << ui.spinBox_XMax->value() - ui.spinBox_XMin->value() << " " << ui.spinBox_YMax->value() - ui.spinBox_YMin->value();
-  segmentationParameters->SetAttribute("ClipRectangleOrigin", originSs.str().c_str());
-  segmentationParameters->SetAttribute("ClipRectangleSize", sizeSs.str().c_str());
-  segmentationParameters->SetDoubleAttribute("MaxLinePairDistanceErrorPercent", ui.doubleSpinBox_LinePairDistanceError->value());
-  segmentationParameters->SetDoubleAttribute("MaxAngleDifferenceDegrees", ui.doubleSpinBox_AngleDifference->value());
-  segmentationParameters->SetDoubleAttribute("MinThetaDegrees", ui.doubleSpinBox_MinTheta->value());
-  segmentationParameters->SetDoubleAttribute("MaxThetaDegrees", ui.doubleSpinBox_MaxTheta->value());
-  segmentationParameters->SetDoubleAttribute("MaxLineShiftMm", ui.doubleSpinBox_MaxLineShiftMm->value());
-  segmentationParameters->SetDoubleAttribute("AngleToleranceDegrees", ui.doubleSpinBox_AngleTolerance->value());
-  segmentationParameters->SetDoubleAttribute("ThresholdImagePercent", ui.doubleSpinBox_ImageThreshold->value());
-  segmentationParameters->SetDoubleAttribute("CollinearPointsMaxDistanceFromLineMm", ui.doubleSpinBox_CollinearPointsMaxDistanceFromLine->value());
-  segmentationParameters->SetIntAttribute("UseOriginalImageIntensityForDotIntensityScore", (ui.checkBox_OriginalIntensityForDots->isChecked() ? 1 : 0));
+  aSegmentationParameters->SetAttribute("ClipRectangleOrigin", originSs.str().c_str());
+  aSegmentationParameters->SetAttribute("ClipRectangleSize", sizeSs.str().c_str());
+  aSegmentationParameters->SetDoubleAttribute("MaxLinePairDistanceErrorPercent", ui.doubleSpinBox_LinePairDistanceError->value());
+  aSegmentationParameters->SetDoubleAttribute("MaxAngleDifferenceDegrees", ui.doubleSpinBox_AngleDifference->value());
+  aSegmentationParameters->SetDoubleAttribute("MinThetaDegrees", ui.doubleSpinBox_MinTheta->value());
+  aSegmentationParameters->SetDoubleAttribute("MaxThetaDegrees", ui.doubleSpinBox_MaxTheta->value());
+  aSegmentationParameters->SetDoubleAttribute("MaxLineShiftMm", ui.doubleSpinBox_MaxLineShiftMm->value());
+  aSegmentationParameters->SetDoubleAttribute("AngleToleranceDegrees", ui.doubleSpinBox_AngleTolerance->value());
+  aSegmentationParameters->SetDoubleAttribute("ThresholdImagePercent", ui.doubleSpinBox_ImageThreshold->value());
+  aSegmentationParameters->SetDoubleAttribute("CollinearPointsMaxDistanceFromLineMm", ui.doubleSpinBox_CollinearPointsMaxDistanceFromLine->value());
+  aSegmentationParameters->SetIntAttribute("UseOriginalImageIntensityForDotIntensityScore", (ui.checkBox_OriginalIntensityForDots->isChecked() ? 1 : 0));
 
-  if (segmentationParameters->GetAttribute("NumberOfMaximumFiducialPointCandidates") != NULL && ui.doubleSpinBox_MaxCandidates->value() == PlusFidSegmentation::DEFAULT_NUMBER_OF_MAXIMUM_FIDUCIAL_POINT_CANDIDATES)
+  if (aSegmentationParameters->GetAttribute("NumberOfMaximumFiducialPointCandidates") != NULL && ui.doubleSpinBox_MaxCandidates->value() == PlusFidSegmentation::DEFAULT_NUMBER_OF_MAXIMUM_FIDUCIAL_POINT_CANDIDATES)
   {
-    segmentationParameters->RemoveAttribute("NumberOfMaximumFiducialPointCandidates");
+    aSegmentationParameters->RemoveAttribute("NumberOfMaximumFiducialPointCandidates");
   }
-  else if (segmentationParameters->GetAttribute("NumberOfMaximumFiducialPointCandidates") != NULL)
-  {
-    segmentationParameters->SetIntAttribute("NumberOfMaximumFiducialPointCandidates", ui.doubleSpinBox_MaxCandidates->value());
-  }
-
-  vtkXMLDataElement* temporalCalibration = vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData()->FindNestedElementWithName("vtkPlusTemporalCalibrationAlgo");
-  if (temporalCalibration == nullptr)
+  else if (aSegmentationParameters->GetAttribute("NumberOfMaximumFiducialPointCandidates") != NULL)
   {
-    temporalCalibration = vtkXMLDataElement::New();
-    temporalCalibration->SetName("vtkPlusTemporalCalibrationAlgo");
-    vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData()->AddNestedElement(temporalCalibration);
+    aSegmentationParameters->SetIntAttribute("NumberOfMaximumFiducialPointCandidates", ui.doubleSpinBox_MaxCandidates->value());
   }
-  temporalCalibration->SetAttribute("ClipRectangleOrigin", originSs.str().c_str());
-  temporalCalibration->SetAttribute("ClipRectangleSize", sizeSs.str().c_str());
 
   return PLUS_SUCCESS;
 }
@@ -1398,61 +1478,107 @@ PlusStatus QPlusSegmentationParameterDialog::SegmentCurrentImage()
   ui.spinBox_XMax->setMaximum(m_Frame.GetFrameSize()[0]);
   ui.spinBox_YMax->setMaximum(m_Frame.GetFrameSize()[1]);
 
-  // Segment image
-  PlusPatternRecognitionResult segResults;
-  PlusFidPatternRecognition::PatternRecognitionError error = PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_NO_ERROR;
-  m_PatternRecognition->RecognizePattern(&m_Frame, segResults, error, 0);   // 0: the frame is not saved into a buffer, so there is no specific frame index
-  if (error == PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_TOO_MANY_CANDIDATES)
+  // The worker segments the preview, but SetROI validates the region of interest against the frame size of the
+  // dialog's own segmentation, which is not set by RecognizePattern anymore
+  m_PatternRecognition->GetFidSegmentation()->SetFrameSize(m_Frame.GetFrameSize());
+
+  // Segment only if the frame or a segmentation parameter has changed (e.g., a frozen frame is not segmented again on every refresh)
+  if (m_Frame.GetTimestamp() == m_SegmentedFrameTimestamp && !m_SegmentationParametersModified)
   {
-    ui.label_Feedback->setText("Too many candidates. Reduce ROI region.");
-    ui.label_Feedback->setStyleSheet("QLabel { color : orange; }");
+    return PLUS_SUCCESS;
   }
-  else
+
+  // Segment image in the background, the result is displayed when it is available
+  if (m_SegmentationParametersModified)
   {
-    ui.label_Feedback->setText("");
+    if (UpdateSegmentationPreviewParameters() != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
   }
+  m_SegmentationPreviewWorker->RequestSegmentation(m_Frame);
+  m_SegmentedFrameTimestamp = m_Frame.GetTimestamp();
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkXMLDataElement> QPlusSegmentationParameterDialog::CreateSegmentationConfiguration()
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::CreateSegmentationConfiguration");
 
-  LOG_DEBUG("Candidate count: " << segResults.GetCandidateFidValues().size());
-  if (segResults.GetFoundDotsCoordinateValue().size() > 0)
+  // Copy of the configuration with the current parameters, the device set configuration is only modified on apply
+  vtkSmartPointer<vtkXMLDataElement> configuration = vtkSmartPointer<vtkXMLDataElement>::New();
+  configuration->DeepCopy(vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData());
+  vtkXMLDataElement* segmentationParameters = configuration->FindNestedElementWithName("Segmentation");
+  if (segmentationParameters == NULL)
   {
-    LOG_DEBUG("Segmented point count: " << segResults.GetFoundDotsCoordinateValue().size());
+    LOG_ERROR("No Segmentation element is found in the XML tree!");
+    return NULL;
   }
-  else
+  if (WriteSegmentationParameters(segmentationParameters) != PLUS_SUCCESS)
   {
-    LOG_DEBUG("Segmentation failed");
+    return NULL;
   }
+  segmentationParameters->SetIntAttribute("NumberOfMaximumFiducialPointCandidates", ui.doubleSpinBox_MaxCandidates->value());
 
-  // Display candidate points
-  vtkSmartPointer<vtkPoints> candidatePoints = vtkSmartPointer<vtkPoints>::New();
-  candidatePoints->SetNumberOfPoints(segResults.GetCandidateFidValues().size());
+  return configuration;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPlusSegmentationParameterDialog::UpdateSegmentationPreviewParameters()
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::UpdateSegmentationPreviewParameters");
 
-  std::vector<PlusFidDot> candidateDots = segResults.GetCandidateFidValues();
-  for (unsigned int i = 0; i < candidateDots.size(); ++i)
+  vtkSmartPointer<vtkXMLDataElement> configuration = CreateSegmentationConfiguration();
+  if (configuration == NULL)
   {
-    candidatePoints->InsertPoint(i, candidateDots[i].GetX(), candidateDots[i].GetY(), -0.3);
+    return PLUS_FAIL;
   }
-  candidatePoints->Modified();
 
-  m_CandidatesPolyData->Initialize();
-  m_CandidatesPolyData->SetPoints(candidatePoints);
+  m_SegmentationPreviewWorker->SetParameters(configuration);
+  m_SegmentationParametersModified = false;
 
-  // Display segmented points (result in tracked frame is not usable in themselves because we need to transform the points)
-  vtkSmartPointer<vtkPoints> segmentedPoints = vtkSmartPointer<vtkPoints>::New();
-  segmentedPoints->SetNumberOfPoints(segResults.GetFoundDotsCoordinateValue().size());
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterDialog::SegmentationResultAvailable()
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::SegmentationResultAvailable");
 
-  std::vector<std::vector<double> > segmentedDots = segResults.GetFoundDotsCoordinateValue();
-  for (unsigned int i = 0; i < segmentedDots.size(); ++i)
+  if (!m_SegmentationPreviewWorker->TakeLatestResult(m_SegmentationResult))
   {
-    segmentedPoints->InsertPoint(i, segmentedDots[i][0], segmentedDots[i][1], -0.3);
+    return;
   }
-  segmentedPoints->Modified();
 
-  m_ImageVisualizer->SetWireLabelPositions(segmentedPoints);
+  if (m_SegmentationResult.Error == PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_TOO_MANY_CANDIDATES)
+  {
+    ui.label_Feedback->setText("Too many candidates. Reduce ROI region.");
+    ui.label_Feedback->setStyleSheet("QLabel { color : orange; }");
+  }
+  else
+  {
+    ui.label_Feedback->setText("");
+  }
 
-  m_SegmentedPointsPolyData->Initialize();
-  m_SegmentedPointsPolyData->SetPoints(segmentedPoints);
+  LOG_DEBUG("Candidate count: " << m_SegmentationResult.CandidatePoints.size());
+  if (m_SegmentationResult.SegmentedPoints.size() > 0)
+  {
+    LOG_DEBUG("Segmented point count: " << m_SegmentationResult.SegmentedPoints.size());
+  }
+  else
+  {
+    LOG_DEBUG("Segmentation failed");
+  }
 
-  return PLUS_SUCCESS;
+  // Display candidate points
+  SetPointPositions(m_CandidatePoints, m_SegmentationResult.CandidatePoints, -0.3);
+
+  // Display segmented points (result in tracked frame is not usable in themselves because we need to transform the points)
+  SetPointPositions(m_SegmentedPoints, m_SegmentationResult.SegmentedPoints, -0.3);
+
+  m_ImageVisualizer->SetWireLabelPositions(m_SegmentedPoints);
 }
 
 //-----------------------------------------------------------------------------
@@ -1504,6 +1630,174 @@ void QPlusSegmentationParameterDialog::ExportImage()
   }
 }
 
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterDialog::AddOptimizationFrame()
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::AddOptimizationFrame");
+
+  if (m_Frame.GetFrameSize()[0] == 0 || m_Frame.GetFrameSize()[1] == 0)
+  {
+    LOG_ERROR("There is no image to add to the segmentation parameter optimization frames");
+    return;
+  }
+  if (m_ParameterOptimizer->AddFrame(m_Frame) != PLUS_SUCCESS)
+  {
+    return;
+  }
+
+  UpdateOptimizationControls();
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterDialog::LoadOptimizationFrames()
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::LoadOptimizationFrames");
+
+  QString filter = QString(tr("SequenceMetaFiles (*.mha *.mhd *.nrrd *.nhdr);;"));
+  QString fileName = QFileDialog::getOpenFileName(this, QString(tr("Open recorded frames")),
+                     vtkPlusConfig::GetInstance()->GetImageDirectory().c_str(), filter);
+  if (fileName.isNull())
+  {
+    return;
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(fileName.toStdString(), trackedFrameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read recorded frames from " << fileName.toStdString());
+    return;
+  }
+
+  // Every candidate segments every frame, so only a small set of frames is used, evenly subsampled from the whole sequence
+  int numberOfSequenceFrames = trackedFrameList->GetNumberOfTrackedFrames();
+  int numberOfFramesToAdd = std::min(numberOfSequenceFrames, m_ParameterOptimizer->GetMaximumNumberOfFrames() - m_ParameterOptimizer->GetNumberOfFrames());
+  if (numberOfFramesToAdd <= 0)
+  {
+    LOG_WARNING("No more frames can be added to the segmentation parameter optimization, the maximum is " << m_ParameterOptimizer->GetMaximumNumberOfFrames());
+    return;
+  }
+  if (numberOfFramesToAdd < numberOfSequenceFrames)
+  {
+    LOG_INFO("Using " << numberOfFramesToAdd << " of the " << numberOfSequenceFrames << " frames of " << fileName.toStdString() << " for segmentation parameter optimization");
+  }
+
+  for (int i = 0; i < numberOfFramesToAdd; ++i)
+  {
+    unsigned int frameIndex = static_cast<unsigned int>(static_cast<long long>(i) * numberOfSequenceFrames / numberOfFramesToAdd);
+    if (m_ParameterOptimizer->AddFrame(*trackedFrameList->GetTrackedFrame(frameIndex)) != PLUS_SUCCESS)
+    {
+      break;
+    }
+  }
+
+  UpdateOptimizationControls();
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterDialog::ClearOptimizationFrames()
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::ClearOptimizationFrames");
+
+  m_ParameterOptimizer->ClearFrames();
+
+  UpdateOptimizationControls();
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterDialog::OptimizeParameters()
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::OptimizeParameters");
+
+  // The same button cancels a running optimization
+  if (m_ParameterOptimizer->IsRunning())
+  {
+    m_ParameterOptimizer->Cancel();
+    UpdateOptimizationControls();
+    return;
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> configuration = CreateSegmentationConfiguration();
+  if (configuration == NULL)
+  {
+    return;
+  }
+  if (m_ParameterOptimizer->Start(configuration) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start segmentation parameter optimization");
+    return;
+  }
+
+  UpdateOptimizationControls();
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterDialog::OptimizationProgressChanged(int aPercent)
+{
+  if (m_ParameterOptimizer->IsRunning())
+  {
+    ui.pushButton_Optimize->setText(QString("Cancel (%1%)").arg(aPercent));
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterDialog::OptimizationFinished()
+{
+  LOG_TRACE("QPlusSegmentationParameterDialog::OptimizationFinished");
+
+  UpdateOptimizationControls();
+
+  QPlusSegmentationParameterOptimizer::Evaluation initialEvaluation = m_ParameterOptimizer->GetInitialEvaluation();
+  QPlusSegmentationParameterOptimizer::Evaluation bestEvaluation = m_ParameterOptimizer->GetBestEvaluation();
+  int numberOfFrames = m_ParameterOptimizer->GetNumberOfFrames();
+
+  if (bestEvaluation.NumberOfReliablySegmentedFrames == 0)
+  {
+    QMessageBox::information(this, tr("Segmentation parameter optimization"),
+                             tr("No parameters were found that segment any of the frames. Adjust the region of interest and the spacing and try again."));
+    return;
+  }
+  if (bestEvaluation.NumberOfReliablySegmentedFrames == initialEvaluation.NumberOfReliablySegmentedFrames
+      && bestEvaluation.MeanSegmentationTimeSec >= initialEvaluation.MeanSegmentationTimeSec)
+  {
+    QMessageBox::information(this, tr("Segmentation parameter optimization"),
+                             QString("The current parameters are already the fastest that segment %1 of %2 frames.").arg(initialEvaluation.NumberOfReliablySegmentedFrames).arg(numberOfFrames));
+    return;
+  }
+
+  QString message = QString("Current parameters: %1 of %2 frames segmented, %3 ms per frame.\nProposed parameters: %4 of %2 frames segmented, %5 ms per frame.\n\nApply the proposed parameters?")
+                    .arg(initialEvaluation.NumberOfReliablySegmentedFrames).arg(numberOfFrames).arg(initialEvaluation.MeanSegmentationTimeSec * 1000.0, 0, 'f', 1)
+                    .arg(bestEvaluation.NumberOfReliablySegmentedFrames).arg(bestEvaluation.MeanSegmentationTimeSec * 1000.0, 0, 'f', 1);
+  if (QMessageBox::question(this, tr("Segmentation parameter optimization"), message, QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) != QMessageBox::Yes)
+  {
+    return;
+  }
+
+  const QPlusSegmentationParameterOptimizer::Parameters& parameters = bestEvaluation.SegmentationParameters;
+  ui.doubleSpinBox_ImageThreshold->setValue(parameters.ThresholdImagePercent);
+  ui.doubleSpinBox_OpeningCircleRadius->setValue(parameters.MorphologicalOpeningCircleRadiusMm);
+  ui.doubleSpinBox_MaxCandidates->setValue(parameters.NumberOfMaximumFiducialPointCandidates);
+  ui.doubleSpinBox_CollinearPointsMaxDistanceFromLine->setValue(parameters.CollinearPointsMaxDistanceFromLineMm);
+  ui.doubleSpinBox_AngleTolerance->setValue(parameters.AngleToleranceDegrees);
+  ui.doubleSpinBox_LinePairDistanceError->setValue(parameters.MaxLinePairDistanceErrorPercent);
+  ui.doubleSpinBox_AngleDifference->setValue(parameters.MaxAngleDifferenceDegrees);
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterDialog::UpdateOptimizationControls()
+{
+  bool running = m_ParameterOptimizer->IsRunning();
+  int numberOfFrames = m_ParameterOptimizer->GetNumberOfFrames();
+
+  bool full = (numberOfFrames >= m_ParameterOptimizer->GetMaximumNumberOfFrames());
+
+  ui.label_OptimizationFrames->setText(QString("Frames: %1/%2").arg(numberOfFrames).arg(m_ParameterOptimizer->GetMaximumNumberOfFrames()));
+  ui.pushButton_AddOptimizationFrame->setEnabled(!running && !full);
+  ui.pushButton_LoadOptimizationFrames->setEnabled(!running && !full);
+  ui.pushButton_ClearOptimizationFrames->setEnabled(!running && numberOfFrames > 0);
+  ui.pushButton_Optimize->setEnabled(running || numberOfFrames > 0);
+  ui.pushButton_Optimize->setText(running ? tr("Cancel") : tr("Optimize"));
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus QPlusSegmentationParameterDialog::SwitchToROIMode()
 {
@@ -1583,6 +1877,7 @@ PlusStatus QPlusSegmentationParameterDialog::ComputeSpacingFromMeasuredLengthSum
   m_PatternRecognition->GetFidSegmentation()->SetApproximateSpacingMmPerPixel(spacing);
   m_PatternRecognition->GetFidLineFinder()->SetApproximateSpacingMmPerPixel(spacing);
   m_PatternRecognition->GetFidLabeling()->SetApproximateSpacingMmPerPixel(spacing);
+  m_SegmentationParametersModified = true;
 
   return PLUS_SUCCESS;
 }
@@ -1626,6 +1921,7 @@ PlusStatus QPlusSegmentationParameterDialog::SetROI(unsigned int roi[4])
   LOG_TRACE("QPlusSegmentationParameterDialog::SetROI(" << roi[0] << ", " << roi[1] << ", " << roi[2] << ", " << roi[3] << ")");
 
   m_PatternRecognition->GetFidSegmentation()->SetRegionOfInterest(roi[0], roi[1], roi[2], roi[3]);
+  m_SegmentationParametersModified = true;
 
   // Validate the set region of interest (e.g., the image is padded with the opening bar size)
   // but only if a valid frame size is already set (otherwise we could overwrite the region of interest
@@ -1746,6 +2042,7 @@ void QPlusSegmentationParameterDialog::OpeningCircleRadiusChanged(double aValue)
   LOG_TRACE("QPlusSegmentationParameterDialog::OpeningCircleRadiusChanged(" << aValue << ")");
   m_PatternRecognition->GetFidSegmentation()->SetMorphologicalOpeningCircleRadiusMm(aValue);
   m_PatternRecognition->GetFidSegmentation()->UpdateParameters();
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1766,6 +2063,7 @@ void QPlusSegmentationParameterDialog::LinePairDistanceErrorChanged(double aValu
 {
   LOG_TRACE("QPlusSegmentationParameterDialog::LinePairDistanceErrorChanged(" << aValue << ")");
   m_PatternRecognition->GetFidLabeling()->SetMaxLinePairDistanceErrorPercent(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1773,6 +2071,7 @@ void QPlusSegmentationParameterDialog::AngleDifferenceChanged(double aValue)
 {
   LOG_TRACE("QPlusSegmentationParameterDialog::AngleDifferenceChanged(" << aValue << ")");
   m_PatternRecognition->GetFidLabeling()->SetMaxAngleDifferenceDegrees(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1781,6 +2080,7 @@ void QPlusSegmentationParameterDialog::MinThetaChanged(double aValue)
   LOG_TRACE("QPlusSegmentationParameterDialog::MinThetaChanged(" << aValue << ")");
   m_PatternRecognition->GetFidLineFinder()->SetMinThetaDegrees(aValue);
   m_PatternRecognition->GetFidLabeling()->SetMinThetaDeg(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1789,6 +2089,7 @@ void QPlusSegmentationParameterDialog::MaxThetaChanged(double aValue)
   LOG_TRACE("QPlusSegmentationParameterDialog::MaxThetaChanged(" << aValue << ")");
   m_PatternRecognition->GetFidLineFinder()->SetMaxThetaDegrees(aValue);
   m_PatternRecognition->GetFidLabeling()->SetMaxThetaDeg(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1796,6 +2097,7 @@ void QPlusSegmentationParameterDialog::AngleToleranceChanged(double aValue)
 {
   LOG_TRACE("QPlusSegmentationParameterDialog::AngleToleranceChanged(" << aValue << ")");
   m_PatternRecognition->GetFidLabeling()->SetAngleToleranceDeg(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1803,6 +2105,7 @@ void QPlusSegmentationParameterDialog::CollinearPointsMaxDistanceFromLineChanged
 {
   LOG_TRACE("QPlusSegmentationParameterDialog::CollinearPointsMaxDistanceFromLineChanged(" << aValue << ")");
   m_PatternRecognition->GetFidLineFinder()->SetCollinearPointsMaxDistanceFromLineMm(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1810,6 +2113,7 @@ void QPlusSegmentationParameterDialog::ImageThresholdChanged(double aValue)
 {
   LOG_TRACE("QPlusSegmentationParameterDialog::ImageThresholdChanged(" << aValue << ")");
   m_PatternRecognition->GetFidSegmentation()->SetThresholdImagePercent(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1817,6 +2121,7 @@ void QPlusSegmentationParameterDialog::MaxLineShiftMmChanged(double aValue)
 {
   LOG_TRACE("QPlusSegmentationParameterDialog::MaxLineShiftMmChanged(" << aValue << ")");
   m_PatternRecognition->GetFidLabeling()->SetMaxLineShiftMm(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1824,6 +2129,7 @@ void QPlusSegmentationParameterDialog::MaxCandidatesChanged(double aValue)
 {
   LOG_TRACE("QPlusSegmentationParameterDialog::MaxCandidatesChanged(" << aValue << ")");
   m_PatternRecognition->SetNumberOfMaximumFiducialPointCandidates(aValue);
+  m_SegmentationParametersModified = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1831,4 +2137,5 @@ void QPlusSegmentationParameterDialog::OriginalIntensityForDotsToggled(bool aOn)
 {
   LOG_TRACE("QPlusSegmentationParameterDialog::OriginalIntensityForDotsToggled(" << (aOn ? "true" : "false") << ")");
   m_PatternRecognition->GetFidSegmentation()->SetUseOriginalImageIntensityForDotIntensityScore(aOn);
+  m_SegmentationParametersModified = true;
 }
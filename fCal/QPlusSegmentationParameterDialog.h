@@ -8,6 +8,7 @@
 #define SEGMENTATIONPARAMETERDIALOG_H
 
 // Local includes
+#include "QPlusSegmentationPreviewWorker.h"
 #include "ui_QPlusSegmentationParameterDialog.h"
 
 // PlusLib includes
@@ -18,12 +19,15 @@
 #include <QDialog>
 
 class PlusFidPatternRecognition;
+class QPlusSegmentationParameterOptimizer;
+class QThread;
 class QTimer;
 class vtkActor;
 class vtkPlusDataCollector;
 class vtkImageActor;
 class vtkPlusImageVisualizer;
 class vtkPlusChannel;
+class vtkPoints;
 class vtkPolyData;
 class vtkROIModeHandler;
 class vtkSpacingModeHandler;
@@ -141,11 +145,35 @@ protected:
   PlusStatus SwitchToSpacingMode();
 
   /*!
-  * Segments the currently displayed image and draws the result on the canvas
+  * Write the segmentation parameters from the input fields on the GUI to a segmentation element
+  * \param aSegmentationParameters Segmentation element of the device set configuration
+  * \return Success flag
+  */
+  PlusStatus WriteSegmentationParameters(vtkXMLDataElement* aSegmentationParameters);
+
+  /*!
+  * Submits the currently displayed image for segmentation (the result is drawn on the canvas when it is available)
   * \return Success flag
   */
   PlusStatus SegmentCurrentImage();
 
+  /*!
+  * Create a copy of the device set configuration with the segmentation parameters from the input fields on the GUI
+  * \return Configuration (NULL if it cannot be created)
+  */
+  vtkSmartPointer<vtkXMLDataElement> CreateSegmentationConfiguration();
+
+  /*!
+  * Send the current segmentation parameters to the segmentation preview worker
+  * \return Success flag
+  */
+  PlusStatus UpdateSegmentationPreviewParameters();
+
+  /*!
+  * Enable or disable the parameter optimization controls according to the number of frames and the optimization state
+  */
+  void UpdateOptimizationControls();
+
 protected slots:
   /*!
   * Applies the configuration to the data element and closes window
@@ -185,6 +213,11 @@ protected slots:
   */
   void UpdateCanvas();
 
+  /*!
+  * Slot drawing the latest segmentation result of the segmentation preview worker on the canvas
+  */
+  void SegmentationResultAvailable();
+
   /*!
   * Freeze / Unfreeze image
   * \param aOn True if checked (freeze), false if unchecked (unfreeze)
@@ -196,6 +229,38 @@ protected slots:
   */
   void ExportImage();
 
+  /*!
+  * Add the displayed image to the frames that the segmentation parameters are optimized for
+  */
+  void AddOptimizationFrame();
+
+  /*!
+  * Add the frames of a sequence file to the frames that the segmentation parameters are optimized for.
+  * The sequence is evenly subsampled if it has more frames than the optimizer accepts.
+  */
+  void LoadOptimizationFrames();
+
+  /*!
+  * Remove all frames that the segmentation parameters are optimized for
+  */
+  void ClearOptimizationFrames();
+
+  /*!
+  * Start the segmentation parameter optimization
+  */
+  void OptimizeParameters();
+
+  /*!
+  * Slot showing the progress of the segmentation parameter optimization
+  * \param aPercent Percentage of evaluated candidates
+  */
+  void OptimizationProgressChanged(int aPercent);
+
+  /*!
+  * Slot proposing the result of the segmentation parameter optimization
+  */
+  void OptimizationFinished();
+
   /*!
   * Slot handling ROI XMin value change
   * \param aValue New value
@@ -323,6 +388,12 @@ protected:
   /*! Poly data for holding the fiducial candidates */
   vtkSmartPointer<vtkPolyData>            m_CandidatesPolyData;
 
+  /*! Points of m_SegmentedPointsPolyData and the wire labels, updated in place for each segmentation result */
+  vtkSmartPointer<vtkPoints>              m_SegmentedPoints;
+
+  /*! Points of m_CandidatesPolyData, updated in place for each segmentation result */
+  vtkSmartPointer<vtkPoints>              m_CandidatePoints;
+
   /*! ROI mode handler callback command instance */
   vtkSmartPointer<vtkROIModeHandler>      m_ROIModeHandler;
 
@@ -347,6 +418,24 @@ protected:
   /*! Tracked frame to hold the desired image to process*/
   igsioTrackedFrame                        m_Frame;
 
+  /*! Thread segmenting the displayed images */
+  QThread*                                m_SegmentationPreviewThread;
+
+  /*! Segments the displayed images in m_SegmentationPreviewThread */
+  QPlusSegmentationPreviewWorker*         m_SegmentationPreviewWorker;
+
+  /*! Latest segmentation result (its storage is reused for the next results) */
+  QPlusSegmentationPreviewWorker::Result  m_SegmentationResult;
+
+  /*! Flag indicating that the segmentation parameters have changed since they were sent to the segmentation preview worker */
+  bool                                    m_SegmentationParametersModified;
+
+  /*! Timestamp of the frame that was last submitted for segmentation */
+  double                                  m_SegmentedFrameTimestamp;
+
+  /*! Searches for the fastest reliable segmentation parameters on the collected frames */
+  QPlusSegmentationParameterOptimizer*    m_ParameterOptimizer;
+
 protected:
   Ui::SegmentationParameterDialog ui;
 };
@@ -0,0 +1,526 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "QPlusSegmentationParameterOptimizer.h"
+
+// PlusLib includes
+#include <PlusFidPatternRecognition.h>
+#include <PlusFidPatternRecognitionCommon.h>
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+
+// Qt includes
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+// STL includes
+#include <algorithm>
+#include <random>
+
+namespace
+{
+  // Maximum distance of a segmented fiducial from the one found with the initial parameters
+  const double MAXIMUM_FIDUCIAL_POSITION_DIFFERENCE_PX = 2.0;
+
+  // Largest value accepted by the maximum candidates field of the segmentation parameter dialog
+  const int MAXIMUM_NUMBER_OF_FIDUCIAL_POINT_CANDIDATES = 250;
+
+  // Number of the fastest most reliable candidates that are timed again one at a time (in addition to the initial parameters)
+  const int NUMBER_OF_RETIMED_CANDIDATES = 5;
+}
+
+//-----------------------------------------------------------------------------
+/*! Segments all frames with the parameters of a candidate */
+class QPlusSegmentationParameterOptimizer::CandidateEvaluator : public QRunnable
+{
+public:
+  CandidateEvaluator(QPlusSegmentationParameterOptimizer* aOptimizer, int aCandidateIndex, vtkXMLDataElement* aConfig)
+    : Optimizer(aOptimizer)
+    , CandidateIndex(aCandidateIndex)
+    , Config(aConfig)
+  {
+    setAutoDelete(true);
+  }
+
+  virtual void run()
+  {
+    std::vector<FrameResult> frameResults;
+    if (Optimizer->SegmentFrames(Config, frameResults) != PLUS_SUCCESS)
+    {
+      if (Optimizer->IsCancelRequested())
+      {
+        return;
+      }
+      LOG_WARNING("Failed to configure segmentation with candidate parameter set " << CandidateIndex);
+      frameResults.clear();
+    }
+
+    Optimizer->AddCandidateResults(CandidateIndex, frameResults);
+  }
+
+  QPlusSegmentationParameterOptimizer* Optimizer;
+  int CandidateIndex;
+  vtkSmartPointer<vtkXMLDataElement> Config;
+};
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationParameterOptimizer::Parameters::Parameters()
+  : ThresholdImagePercent(0.0)
+  , MorphologicalOpeningCircleRadiusMm(0.0)
+  , NumberOfMaximumFiducialPointCandidates(PlusFidSegmentation::DEFAULT_NUMBER_OF_MAXIMUM_FIDUCIAL_POINT_CANDIDATES)
+  , CollinearPointsMaxDistanceFromLineMm(0.0)
+  , AngleToleranceDegrees(0.0)
+  , MaxLinePairDistanceErrorPercent(0.0)
+  , MaxAngleDifferenceDegrees(0.0)
+{
+}
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationParameterOptimizer::Evaluation::Evaluation()
+  : NumberOfReliablySegmentedFrames(0)
+  , MeanSegmentationTimeSec(0.0)
+{
+}
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationParameterOptimizer::QPlusSegmentationParameterOptimizer(QObject* aParent)
+  : QObject(aParent)
+  , m_NumberOfCandidates(64)
+  , m_NumberOfEvaluatedCandidates(0)
+  , m_MaximumNumberOfFrames(30)
+  , m_Running(false)
+  , m_CancelRequested(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationParameterOptimizer::~QPlusSegmentationParameterOptimizer()
+{
+  Cancel();
+  ClearFrames();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPlusSegmentationParameterOptimizer::AddFrame(igsioTrackedFrame& aTrackedFrame)
+{
+  if (IsRunning())
+  {
+    LOG_ERROR("Frames cannot be added while segmentation parameter optimization is running");
+    return PLUS_FAIL;
+  }
+  if (GetNumberOfFrames() >= m_MaximumNumberOfFrames)
+  {
+    LOG_WARNING("Segmentation parameter optimization already has the maximum number of frames (" << m_MaximumNumberOfFrames << ")");
+    return PLUS_FAIL;
+  }
+  m_Frames.push_back(new igsioTrackedFrame(aTrackedFrame));
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPlusSegmentationParameterOptimizer::ClearFrames()
+{
+  if (IsRunning())
+  {
+    LOG_ERROR("Frames cannot be removed while segmentation parameter optimization is running");
+    return PLUS_FAIL;
+  }
+  for (std::vector<igsioTrackedFrame*>::iterator frameIt = m_Frames.begin(); frameIt != m_Frames.end(); ++frameIt)
+  {
+    delete *frameIt;
+  }
+  m_Frames.clear();
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPlusSegmentationParameterOptimizer::Start(vtkXMLDataElement* aConfig, int aNumberOfThreads)
+{
+  LOG_TRACE("QPlusSegmentationParameterOptimizer::Start");
+
+  Cancel();
+
+  if (m_Frames.empty())
+  {
+    LOG_ERROR("No frames are added for segmentation parameter optimization");
+    return PLUS_FAIL;
+  }
+  vtkXMLDataElement* segmentationParameters = (aConfig != NULL ? aConfig->FindNestedElementWithName("Segmentation") : NULL);
+  if (segmentationParameters == NULL)
+  {
+    LOG_ERROR("No Segmentation element is found in the XML tree!");
+    return PLUS_FAIL;
+  }
+
+  Parameters initialParameters;
+  if (ReadParameters(segmentationParameters, initialParameters) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  GenerateCandidates(initialParameters);
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_CandidateResults.assign(m_Candidates.size(), std::vector<FrameResult>());
+    m_NumberOfEvaluatedCandidates = 0;
+    m_InitialEvaluation = Evaluation();
+    m_BestEvaluation = Evaluation();
+    m_CancelRequested = false;
+    m_Running = true;
+  }
+
+  if (aNumberOfThreads < 1)
+  {
+    // Leave one core for acquisition and rendering
+    aNumberOfThreads = std::max(QThread::idealThreadCount() - 1, 1);
+  }
+  m_ThreadPool.setMaxThreadCount(aNumberOfThreads);
+
+  m_CandidateConfigs.clear();
+  for (unsigned int candidateIndex = 0; candidateIndex < m_Candidates.size(); ++candidateIndex)
+  {
+    vtkSmartPointer<vtkXMLDataElement> candidateConfig = vtkSmartPointer<vtkXMLDataElement>::New();
+    candidateConfig->DeepCopy(aConfig);
+    WriteParameters(m_Candidates[candidateIndex], candidateConfig->FindNestedElementWithName("Segmentation"));
+    m_CandidateConfigs.push_back(candidateConfig);
+  }
+  for (unsigned int candidateIndex = 0; candidateIndex < m_Candidates.size(); ++candidateIndex)
+  {
+    m_ThreadPool.start(new CandidateEvaluator(this, candidateIndex, m_CandidateConfigs[candidateIndex]));
+  }
+
+  LOG_INFO("Segmentation parameter optimization started with " << m_Candidates.size() << " parameter sets on " << m_Frames.size() << " frames using " << aNumberOfThreads << " threads");
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterOptimizer::Cancel()
+{
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_CancelRequested = true;
+  }
+  m_ThreadPool.waitForDone();
+
+  QMutexLocker locker(&m_Mutex);
+  m_Running = false;
+}
+
+//-----------------------------------------------------------------------------
+bool QPlusSegmentationParameterOptimizer::IsRunning()
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_Running;
+}
+
+//-----------------------------------------------------------------------------
+bool QPlusSegmentationParameterOptimizer::IsCancelRequested()
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_CancelRequested;
+}
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationParameterOptimizer::Evaluation QPlusSegmentationParameterOptimizer::GetInitialEvaluation()
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_InitialEvaluation;
+}
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationParameterOptimizer::Evaluation QPlusSegmentationParameterOptimizer::GetBestEvaluation()
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_BestEvaluation;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPlusSegmentationParameterOptimizer::ReadParameters(vtkXMLDataElement* aSegmentationParameters, Parameters& aParameters)
+{
+  if (aSegmentationParameters == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (!aSegmentationParameters->GetScalarAttribute("ThresholdImagePercent", aParameters.ThresholdImagePercent)
+      || !aSegmentationParameters->GetScalarAttribute("MorphologicalOpeningCircleRadiusMm", aParameters.MorphologicalOpeningCircleRadiusMm)
+      || !aSegmentationParameters->GetScalarAttribute("CollinearPointsMaxDistanceFromLineMm", aParameters.CollinearPointsMaxDistanceFromLineMm)
+      || !aSegmentationParameters->GetScalarAttribute("AngleToleranceDegrees", aParameters.AngleToleranceDegrees)
+      || !aSegmentationParameters->GetScalarAttribute("MaxLinePairDistanceErrorPercent", aParameters.MaxLinePairDistanceErrorPercent)
+      || !aSegmentationParameters->GetScalarAttribute("MaxAngleDifferenceDegrees", aParameters.MaxAngleDifferenceDegrees))
+  {
+    LOG_ERROR("Segmentation parameters are missing from the configuration, they cannot be optimized");
+    return PLUS_FAIL;
+  }
+
+  aParameters.NumberOfMaximumFiducialPointCandidates = PlusFidSegmentation::DEFAULT_NUMBER_OF_MAXIMUM_FIDUCIAL_POINT_CANDIDATES;
+  aSegmentationParameters->GetScalarAttribute("NumberOfMaximumFiducialPointCandidates", aParameters.NumberOfMaximumFiducialPointCandidates);
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterOptimizer::WriteParameters(const Parameters& aParameters, vtkXMLDataElement* aSegmentationParameters)
+{
+  if (aSegmentationParameters == NULL)
+  {
+    return;
+  }
+
+  aSegmentationParameters->SetDoubleAttribute("ThresholdImagePercent", aParameters.ThresholdImagePercent);
+  aSegmentationParameters->SetDoubleAttribute("MorphologicalOpeningCircleRadiusMm", aParameters.MorphologicalOpeningCircleRadiusMm);
+  aSegmentationParameters->SetIntAttribute("NumberOfMaximumFiducialPointCandidates", aParameters.NumberOfMaximumFiducialPointCandidates);
+  aSegmentationParameters->SetDoubleAttribute("CollinearPointsMaxDistanceFromLineMm", aParameters.CollinearPointsMaxDistanceFromLineMm);
+  aSegmentationParameters->SetDoubleAttribute("AngleToleranceDegrees", aParameters.AngleToleranceDegrees);
+  aSegmentationParameters->SetDoubleAttribute("MaxLinePairDistanceErrorPercent", aParameters.MaxLinePairDistanceErrorPercent);
+  aSegmentationParameters->SetDoubleAttribute("MaxAngleDifferenceDegrees", aParameters.MaxAngleDifferenceDegrees);
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterOptimizer::GenerateCandidates(const Parameters& aInitialParameters)
+{
+  m_Candidates.clear();
+  m_Candidates.push_back(aInitialParameters);
+
+  // Fixed seed, so that the same frames and initial parameters give the same proposal
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<double> scale(0.5, 1.5);
+  std::uniform_real_distribution<double> thresholdShift(-15.0, 15.0);
+  std::uniform_real_distribution<double> openingScale(0.7, 1.3);
+  // Fewer candidates make line finding faster, more may be needed to find the pattern at all
+  std::uniform_int_distribution<int> maximumCandidates(std::max(aInitialParameters.NumberOfMaximumFiducialPointCandidates / 4, 1),
+      std::min(aInitialParameters.NumberOfMaximumFiducialPointCandidates * 3 / 2 + 1, MAXIMUM_NUMBER_OF_FIDUCIAL_POINT_CANDIDATES));
+
+  for (int i = 0; i < m_NumberOfCandidates; ++i)
+  {
+    Parameters candidate;
+    candidate.ThresholdImagePercent = std::min(std::max(aInitialParameters.ThresholdImagePercent + thresholdShift(generator), 1.0), 99.0);
+    candidate.MorphologicalOpeningCircleRadiusMm = aInitialParameters.MorphologicalOpeningCircleRadiusMm * openingScale(generator);
+    candidate.NumberOfMaximumFiducialPointCandidates = maximumCandidates(generator);
+    candidate.CollinearPointsMaxDistanceFromLineMm = aInitialParameters.CollinearPointsMaxDistanceFromLineMm * scale(generator);
+    candidate.AngleToleranceDegrees = aInitialParameters.AngleToleranceDegrees * scale(generator);
+    candidate.MaxLinePairDistanceErrorPercent = aInitialParameters.MaxLinePairDistanceErrorPercent * scale(generator);
+    candidate.MaxAngleDifferenceDegrees = aInitialParameters.MaxAngleDifferenceDegrees * scale(generator);
+    m_Candidates.push_back(candidate);
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPlusSegmentationParameterOptimizer::SegmentFrames(vtkXMLDataElement* aConfig, std::vector<FrameResult>& aFrameResults)
+{
+  aFrameResults.clear();
+  PlusFidPatternRecognition patternRecognition;
+  if (patternRecognition.ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  for (std::vector<igsioTrackedFrame*>::const_iterator frameIt = m_Frames.begin(); frameIt != m_Frames.end(); ++frameIt)
+  {
+    if (IsCancelRequested())
+    {
+      return PLUS_FAIL;
+    }
+
+    // Pattern recognition stores the segmented fiducials in the frame, so the shared frames are not used directly
+    igsioTrackedFrame trackedFrame(**frameIt);
+
+    FrameResult frameResult;
+    PlusPatternRecognitionResult segResults;
+    PlusFidPatternRecognition::PatternRecognitionError error = PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_NO_ERROR;
+    double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    PlusStatus status = patternRecognition.RecognizePattern(&trackedFrame, segResults, error, 0);
+    frameResult.SegmentationTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+
+    const std::vector<std::vector<double> >& segmentedDots = segResults.GetFoundDotsCoordinateValue();
+    frameResult.Segmented = (status == PLUS_SUCCESS && error == PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_NO_ERROR && !segmentedDots.empty());
+    for (std::vector<std::vector<double> >::const_iterator dotIt = segmentedDots.begin(); frameResult.Segmented && dotIt != segmentedDots.end(); ++dotIt)
+    {
+      std::array<double, 2> point = {{ (*dotIt)[0], (*dotIt)[1] }};
+      frameResult.SegmentedPoints.push_back(point);
+    }
+    aFrameResults.push_back(frameResult);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterOptimizer::AddCandidateResults(int aCandidateIndex, const std::vector<FrameResult>& aFrameResults)
+{
+  int percent = 0;
+  bool allCandidatesEvaluated = false;
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (m_CancelRequested)
+    {
+      return;
+    }
+    m_CandidateResults[aCandidateIndex] = aFrameResults;
+    ++m_NumberOfEvaluatedCandidates;
+    // The candidates that are timed again are part of the progress as well
+    percent = 100 * m_NumberOfEvaluatedCandidates / static_cast<int>(m_Candidates.size() + NUMBER_OF_RETIMED_CANDIDATES + 1);
+    allCandidatesEvaluated = (m_NumberOfEvaluatedCandidates == static_cast<int>(m_Candidates.size()));
+  }
+
+  emit ProgressChanged(percent);
+  if (allCandidatesEvaluated)
+  {
+    // This is the last running evaluation, so the other threads of the pool are idle while the candidates are timed again
+    SelectBestCandidate();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterOptimizer::ComputeEvaluations(std::vector<int>& aCandidateIndices, std::vector<Evaluation>& aEvaluations)
+{
+  aCandidateIndices.clear();
+  aEvaluations.clear();
+  const std::vector<FrameResult>& initialResults = m_CandidateResults[0];
+
+  for (unsigned int candidateIndex = 0; candidateIndex < m_Candidates.size(); ++candidateIndex)
+  {
+    const std::vector<FrameResult>& candidateResults = m_CandidateResults[candidateIndex];
+    if (candidateResults.size() != m_Frames.size())
+    {
+      // Could not be configured
+      continue;
+    }
+
+    Evaluation evaluation;
+    evaluation.SegmentationParameters = m_Candidates[candidateIndex];
+    for (unsigned int frameIndex = 0; frameIndex < candidateResults.size(); ++frameIndex)
+    {
+      const FrameResult& frameResult = candidateResults[frameIndex];
+      evaluation.MeanSegmentationTimeSec += frameResult.SegmentationTimeSec / candidateResults.size();
+      if (!frameResult.Segmented)
+      {
+        continue;
+      }
+
+      bool reliable = true;
+      if (initialResults.size() == m_Frames.size() && initialResults[frameIndex].Segmented)
+      {
+        // The same fiducials have to be found as with the initial parameters
+        const std::vector<std::array<double, 2> >& initialPoints = initialResults[frameIndex].SegmentedPoints;
+        reliable = (frameResult.SegmentedPoints.size() == initialPoints.size());
+        for (unsigned int pointIndex = 0; reliable && pointIndex < initialPoints.size(); ++pointIndex)
+        {
+          double dx = frameResult.SegmentedPoints[pointIndex][0] - initialPoints[pointIndex][0];
+          double dy = frameResult.SegmentedPoints[pointIndex][1] - initialPoints[pointIndex][1];
+          reliable = (dx * dx + dy * dy <= MAXIMUM_FIDUCIAL_POSITION_DIFFERENCE_PX * MAXIMUM_FIDUCIAL_POSITION_DIFFERENCE_PX);
+        }
+      }
+      if (reliable)
+      {
+        ++evaluation.NumberOfReliablySegmentedFrames;
+      }
+    }
+
+    aCandidateIndices.push_back(candidateIndex);
+    aEvaluations.push_back(evaluation);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationParameterOptimizer::SelectBestCandidate()
+{
+  std::vector<int> candidateIndices;
+  std::vector<Evaluation> evaluations;
+  {
+    QMutexLocker locker(&m_Mutex);
+    ComputeEvaluations(candidateIndices, evaluations);
+  }
+
+  // Fastest of the most reliable candidates according to the times measured in parallel, and the initial parameters
+  std::vector<unsigned int> mostReliable;
+  int initialEvaluationIndex = -1;
+  for (unsigned int evaluationIndex = 0; evaluationIndex < evaluations.size(); ++evaluationIndex)
+  {
+    if (candidateIndices[evaluationIndex] == 0)
+    {
+      initialEvaluationIndex = evaluationIndex;
+    }
+    if (!mostReliable.empty() && evaluations[evaluationIndex].NumberOfReliablySegmentedFrames > evaluations[mostReliable[0]].NumberOfReliablySegmentedFrames)
+    {
+      mostReliable.clear();
+    }
+    if (mostReliable.empty() || evaluations[evaluationIndex].NumberOfReliablySegmentedFrames == evaluations[mostReliable[0]].NumberOfReliablySegmentedFrames)
+    {
+      mostReliable.push_back(evaluationIndex);
+    }
+  }
+  std::stable_sort(mostReliable.begin(), mostReliable.end(), [&evaluations](unsigned int a, unsigned int b)
+  {
+    return evaluations[a].MeanSegmentationTimeSec < evaluations[b].MeanSegmentationTimeSec;
+  });
+  if (mostReliable.size() > static_cast<unsigned int>(NUMBER_OF_RETIMED_CANDIDATES))
+  {
+    mostReliable.resize(NUMBER_OF_RETIMED_CANDIDATES);
+  }
+  std::vector<unsigned int> retimed = mostReliable;
+  if (initialEvaluationIndex >= 0 && std::find(retimed.begin(), retimed.end(), static_cast<unsigned int>(initialEvaluationIndex)) == retimed.end())
+  {
+    retimed.push_back(initialEvaluationIndex);
+  }
+
+  for (unsigned int retimedIndex = 0; retimedIndex < retimed.size(); ++retimedIndex)
+  {
+    Evaluation& evaluation = evaluations[retimed[retimedIndex]];
+    std::vector<FrameResult> frameResults;
+    if (SegmentFrames(m_CandidateConfigs[candidateIndices[retimed[retimedIndex]]], frameResults) != PLUS_SUCCESS)
+    {
+      if (IsCancelRequested())
+      {
+        return;
+      }
+      // Keep the time measured in parallel
+      continue;
+    }
+    evaluation.MeanSegmentationTimeSec = 0.0;
+    for (std::vector<FrameResult>::const_iterator frameResultIt = frameResults.begin(); frameResultIt != frameResults.end(); ++frameResultIt)
+    {
+      evaluation.MeanSegmentationTimeSec += frameResultIt->SegmentationTimeSec / frameResults.size();
+    }
+    emit ProgressChanged(100 * static_cast<int>(m_Candidates.size() + retimedIndex + 1) / static_cast<int>(m_Candidates.size() + NUMBER_OF_RETIMED_CANDIDATES + 1));
+  }
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (m_CancelRequested)
+    {
+      return;
+    }
+    m_InitialEvaluation = (initialEvaluationIndex >= 0 ? evaluations[initialEvaluationIndex] : Evaluation());
+    // The initial parameters compete as well if they are among the most reliable ones, so the best candidate is never slower
+    bool bestFound = false;
+    m_BestEvaluation = Evaluation();
+    for (std::vector<unsigned int>::const_iterator evaluationIndexIt = retimed.begin(); evaluationIndexIt != retimed.end(); ++evaluationIndexIt)
+    {
+      const Evaluation& evaluation = evaluations[*evaluationIndexIt];
+      if (evaluation.NumberOfReliablySegmentedFrames == evaluations[mostReliable[0]].NumberOfReliablySegmentedFrames
+          && (!bestFound || evaluation.MeanSegmentationTimeSec < m_BestEvaluation.MeanSegmentationTimeSec))
+      {
+        bestFound = true;
+        m_BestEvaluation = evaluation;
+      }
+    }
+    m_Running = false;
+
+    LOG_INFO("Segmentation parameter optimization finished. Initial parameters: " << m_InitialEvaluation.NumberOfReliablySegmentedFrames << "/" << m_Frames.size()
+             << " frames segmented, " << m_InitialEvaluation.MeanSegmentationTimeSec * 1000.0 << " ms per frame. Best parameters: "
+             << m_BestEvaluation.NumberOfReliablySegmentedFrames << "/" << m_Frames.size() << " frames segmented, " << m_BestEvaluation.MeanSegmentationTimeSec * 1000.0 << " ms per frame.");
+  }
+
+  emit ProgressChanged(100);
+  emit Finished();
+}
@@ -0,0 +1,188 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef SEGMENTATIONPARAMETEROPTIMIZER_H
+#define SEGMENTATIONPARAMETEROPTIMIZER_H
+
+// PlusLib includes
+#include <PlusConfigure.h>
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// Qt includes
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+
+// STL includes
+#include <array>
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkXMLDataElement;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QPlusSegmentationParameterOptimizer
+ * \brief Searches for the segmentation parameters that segment a set of frames reliably in the shortest time
+ *
+ * Candidate parameter sets are sampled around the initial parameters. Each candidate segments all the frames on a
+ * pool of worker threads, each candidate with its own pattern recognition instance. A candidate segments a frame
+ * reliably if it finds the same fiducials as the initial parameters (within a tolerance), or if it finds the pattern
+ * in a frame where the initial parameters did not. Among the candidates that segment the most frames reliably the
+ * one with the shortest mean segmentation time is the best. The initial parameters are evaluated as well, so the
+ * best candidate is never worse than the initial parameters.
+ *
+ * The segmentation times measured while the candidates run in parallel are distorted by the other threads, so
+ * the fastest of the most reliable candidates and the initial parameters are timed again one at a time, and the
+ * best candidate is selected based on these times.
+ * \ingroup PlusAppCommonWidgets
+ */
+class QPlusSegmentationParameterOptimizer : public QObject
+{
+  Q_OBJECT
+
+public:
+  /*! Segmentation parameters that are optimized */
+  struct Parameters
+  {
+    Parameters();
+    double ThresholdImagePercent;
+    double MorphologicalOpeningCircleRadiusMm;
+    int NumberOfMaximumFiducialPointCandidates;
+    double CollinearPointsMaxDistanceFromLineMm;
+    double AngleToleranceDegrees;
+    double MaxLinePairDistanceErrorPercent;
+    double MaxAngleDifferenceDegrees;
+  };
+
+  /*! Evaluation of a parameter set on all frames */
+  struct Evaluation
+  {
+    Evaluation();
+    Parameters SegmentationParameters;
+    /*! Number of frames in which the pattern was found reliably */
+    int NumberOfReliablySegmentedFrames;
+    /*! Mean segmentation time of a frame (in seconds) */
+    double MeanSegmentationTimeSec;
+  };
+
+  QPlusSegmentationParameterOptimizer(QObject* aParent = NULL);
+  ~QPlusSegmentationParameterOptimizer();
+
+  /*! Add a copy of the frame to the frames that the parameters are optimized for. Not allowed while running. */
+  PlusStatus AddFrame(igsioTrackedFrame& aTrackedFrame);
+
+  /*! Remove all frames. Not allowed while running. */
+  PlusStatus ClearFrames();
+
+  int GetNumberOfFrames() const { return static_cast<int>(m_Frames.size()); };
+
+  /*! Number of sampled candidate parameter sets (in addition to the initial parameters) */
+  void SetNumberOfCandidates(int aNumberOfCandidates) { m_NumberOfCandidates = aNumberOfCandidates; };
+
+  /*! Maximum number of frames that can be added, as all candidates segment all frames */
+  void SetMaximumNumberOfFrames(int aMaximumNumberOfFrames) { m_MaximumNumberOfFrames = aMaximumNumberOfFrames; };
+  int GetMaximumNumberOfFrames() const { return m_MaximumNumberOfFrames; };
+
+  /*!
+  * Start the optimization in the background. Finished is emitted when all candidates are evaluated.
+  * \param aConfig Device set configuration with the initial segmentation parameters, it is not modified
+  * \param aNumberOfThreads Number of segmentation threads (if less than 1 then it is determined from the number of CPU cores)
+  */
+  PlusStatus Start(vtkXMLDataElement* aConfig, int aNumberOfThreads = 0);
+
+  /*! Stop the optimization and wait for the running evaluations to return. Finished is not emitted. */
+  void Cancel();
+
+  /*! Returns true if the optimization has started and not finished or cancelled yet */
+  bool IsRunning();
+
+  /*! Evaluation of the initial parameters (valid after Finished is emitted) */
+  Evaluation GetInitialEvaluation();
+
+  /*! Evaluation of the best parameters (valid after Finished is emitted) */
+  Evaluation GetBestEvaluation();
+
+  /*! Read the optimized parameters from a segmentation element */
+  static PlusStatus ReadParameters(vtkXMLDataElement* aSegmentationParameters, Parameters& aParameters);
+
+  /*! Write the optimized parameters to a segmentation element */
+  static void WriteParameters(const Parameters& aParameters, vtkXMLDataElement* aSegmentationParameters);
+
+signals:
+  /*! Emitted when a candidate has been evaluated or timed again */
+  void ProgressChanged(int aPercent);
+
+  /*! Emitted when all candidates have been evaluated */
+  void Finished();
+
+protected:
+  /*! Segmentation result of a frame */
+  struct FrameResult
+  {
+    bool Segmented;
+    std::vector<std::array<double, 2> > SegmentedPoints;
+    double SegmentationTimeSec;
+  };
+
+  class CandidateEvaluator;
+  friend class CandidateEvaluator;
+
+  /*! Sample candidate parameter sets around the initial parameters (the first one is the initial parameters) */
+  void GenerateCandidates(const Parameters& aInitialParameters);
+
+  /*! Segment all frames with a configuration. Fails if the segmentation cannot be configured or the evaluations have to stop. */
+  PlusStatus SegmentFrames(vtkXMLDataElement* aConfig, std::vector<FrameResult>& aFrameResults);
+
+  /*! Store the segmentation results of a candidate, selects the best candidate after the last one (called from the worker threads) */
+  void AddCandidateResults(int aCandidateIndex, const std::vector<FrameResult>& aFrameResults);
+
+  /*!
+  * Evaluate the configured candidates against the results of the initial parameters (called with m_Mutex locked)
+  * \param aCandidateIndices Indices of the configured candidates
+  * \param aEvaluations Evaluations of the configured candidates, in the same order
+  */
+  void ComputeEvaluations(std::vector<int>& aCandidateIndices, std::vector<Evaluation>& aEvaluations);
+
+  /*! Time the fastest of the most reliable candidates again one at a time, select the best one and finish the optimization */
+  void SelectBestCandidate();
+
+  /*! Returns true if the evaluations have to stop (called from the worker threads) */
+  bool IsCancelRequested();
+
+protected:
+  /*! Frames that the parameters are optimized for, read-only while running */
+  std::vector<igsioTrackedFrame*> m_Frames;
+
+  /*! Candidate parameter sets, the first one is the initial parameters */
+  std::vector<Parameters> m_Candidates;
+
+  /*! Device set configurations with the candidate parameter sets */
+  std::vector<vtkSmartPointer<vtkXMLDataElement> > m_CandidateConfigs;
+
+  /*! Segmentation results of the candidates (empty if the candidate could not be configured) */
+  std::vector<std::vector<FrameResult> > m_CandidateResults;
+
+  int m_NumberOfCandidates;
+  int m_NumberOfEvaluatedCandidates;
+  int m_MaximumNumberOfFrames;
+
+  Evaluation m_InitialEvaluation;
+  Evaluation m_BestEvaluation;
+
+  bool m_Running;
+  bool m_CancelRequested;
+
+  /*! Threads running the candidate evaluations */
+  QThreadPool m_ThreadPool;
+
+  /*! Guards the results, the evaluations and the flags */
+  QMutex m_Mutex;
+};
+
+#endif
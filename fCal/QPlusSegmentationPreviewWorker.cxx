@@ -0,0 +1,234 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "QPlusSegmentationPreviewWorker.h"
+
+// PlusLib includes
+#include <PlusFidPatternRecognitionCommon.h>
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkXMLDataElement.h>
+
+// Qt includes
+#include <QMutexLocker>
+
+// STL includes
+#include <sstream>
+#include <utility>
+
+namespace
+{
+  // A frozen frame is typically segmented with a few parameter sets back and forth
+  const unsigned int RESULT_CACHE_SIZE = 16;
+}
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationPreviewWorker::Result::Result()
+  : Error(PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_NO_ERROR)
+  , SegmentationTimeSec(0.0)
+{
+}
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationPreviewWorker::QPlusSegmentationPreviewWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_PatternRecognition(NULL)
+  , m_FramePending(false)
+  , m_PendingConfig(NULL)
+  , m_RequestQueued(false)
+  , m_NewResultAvailable(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+QPlusSegmentationPreviewWorker::~QPlusSegmentationPreviewWorker()
+{
+  if (m_PatternRecognition != NULL)
+  {
+    delete m_PatternRecognition;
+    m_PatternRecognition = NULL;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationPreviewWorker::SetParameters(vtkXMLDataElement* aConfig)
+{
+  if (aConfig == NULL)
+  {
+    return;
+  }
+
+  QMutexLocker locker(&m_Mutex);
+  m_PendingConfig = aConfig;
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationPreviewWorker::RequestSegmentation(igsioTrackedFrame& aTrackedFrame)
+{
+  QMutexLocker locker(&m_Mutex);
+  // A frame that has not been segmented yet is stale now
+  m_PendingFrame = aTrackedFrame;
+  m_FramePending = true;
+  if (!m_RequestQueued)
+  {
+    m_RequestQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessSegmentationRequest", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool QPlusSegmentationPreviewWorker::TakeLatestResult(Result& aResult)
+{
+  QMutexLocker locker(&m_Mutex);
+  if (!m_NewResultAvailable)
+  {
+    return false;
+  }
+  std::swap(aResult, m_LatestResult);
+  m_NewResultAvailable = false;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationPreviewWorker::ProcessSegmentationRequest()
+{
+  vtkSmartPointer<vtkXMLDataElement> config;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_RequestQueued = false;
+    if (!m_FramePending)
+    {
+      return;
+    }
+    m_Frame = m_PendingFrame;
+    m_FramePending = false;
+    config = m_PendingConfig;
+    m_PendingConfig = NULL;
+  }
+
+  if (config.GetPointer() != NULL)
+  {
+    // Handlers may report a change even if the value is the same, do not reconfigure then
+    std::string parametersKey = GetParametersKey(config);
+    if (m_PatternRecognition == NULL || parametersKey != m_ParametersKey)
+    {
+      PlusFidPatternRecognition* patternRecognition = new PlusFidPatternRecognition();
+      if (patternRecognition->ReadConfiguration(config) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to read segmentation parameters for segmentation preview");
+        delete patternRecognition;
+      }
+      else
+      {
+        delete m_PatternRecognition;
+        m_PatternRecognition = patternRecognition;
+        m_ParametersKey = parametersKey;
+      }
+    }
+  }
+  if (m_PatternRecognition == NULL)
+  {
+    return;
+  }
+
+  const Result* cachedResult = FindCachedResult(m_Frame.GetTimestamp(), m_ParametersKey);
+  if (cachedResult != NULL)
+  {
+    LOG_TRACE("Segmentation result of frame " << std::fixed << m_Frame.GetTimestamp() << " is taken from the cache");
+    {
+      QMutexLocker locker(&m_Mutex);
+      m_LatestResult = *cachedResult;
+      m_NewResultAvailable = true;
+    }
+    emit ResultAvailable();
+    return;
+  }
+
+  Result& result = m_Result;
+  result.Error = PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_NO_ERROR;
+  result.CandidatePoints.clear();
+  result.SegmentedPoints.clear();
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  PlusPatternRecognitionResult segResults;
+  m_PatternRecognition->RecognizePattern(&m_Frame, segResults, result.Error, 0);   // 0: the frame is not saved into a buffer, so there is no specific frame index
+  result.SegmentationTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+
+  const std::vector<PlusFidDot>& candidateDots = segResults.GetCandidateFidValues();
+  result.CandidatePoints.reserve(candidateDots.size());
+  for (std::vector<PlusFidDot>::const_iterator dotIt = candidateDots.begin(); dotIt != candidateDots.end(); ++dotIt)
+  {
+    std::array<double, 2> point = {{ dotIt->GetX(), dotIt->GetY() }};
+    result.CandidatePoints.push_back(point);
+  }
+  const std::vector<std::vector<double> >& segmentedDots = segResults.GetFoundDotsCoordinateValue();
+  result.SegmentedPoints.reserve(segmentedDots.size());
+  for (std::vector<std::vector<double> >::const_iterator dotIt = segmentedDots.begin(); dotIt != segmentedDots.end(); ++dotIt)
+  {
+    std::array<double, 2> point = {{ (*dotIt)[0], (*dotIt)[1] }};
+    result.SegmentedPoints.push_back(point);
+  }
+
+  AddCachedResult(m_Frame.GetTimestamp(), m_ParametersKey, result);
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_LatestResult = result;
+    m_NewResultAvailable = true;
+  }
+
+  emit ResultAvailable();
+}
+
+//-----------------------------------------------------------------------------
+std::string QPlusSegmentationPreviewWorker::GetParametersKey(vtkXMLDataElement* aConfig)
+{
+  vtkXMLDataElement* segmentationParameters = aConfig->FindNestedElementWithName("Segmentation");
+  if (segmentationParameters == NULL)
+  {
+    return std::string();
+  }
+
+  std::ostringstream key;
+  for (int i = 0; i < segmentationParameters->GetNumberOfAttributes(); ++i)
+  {
+    key << segmentationParameters->GetAttributeName(i) << "=" << segmentationParameters->GetAttributeValue(i) << ";";
+  }
+  return key.str();
+}
+
+//-----------------------------------------------------------------------------
+const QPlusSegmentationPreviewWorker::Result* QPlusSegmentationPreviewWorker::FindCachedResult(double aFrameTimestamp, const std::string& aParametersKey)
+{
+  for (std::list<CachedResult>::iterator cachedResultIt = m_ResultCache.begin(); cachedResultIt != m_ResultCache.end(); ++cachedResultIt)
+  {
+    if (cachedResultIt->FrameTimestamp == aFrameTimestamp && cachedResultIt->ParametersKey == aParametersKey)
+    {
+      m_ResultCache.splice(m_ResultCache.begin(), m_ResultCache, cachedResultIt);
+      return &m_ResultCache.front().SegmentationResult;
+    }
+  }
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+void QPlusSegmentationPreviewWorker::AddCachedResult(double aFrameTimestamp, const std::string& aParametersKey, const Result& aResult)
+{
+  if (m_ResultCache.size() >= RESULT_CACHE_SIZE)
+  {
+    // Reuse the storage of the least recently used result
+    m_ResultCache.splice(m_ResultCache.begin(), m_ResultCache, --m_ResultCache.end());
+  }
+  else
+  {
+    m_ResultCache.push_front(CachedResult());
+  }
+  CachedResult& cachedResult = m_ResultCache.front();
+  cachedResult.FrameTimestamp = aFrameTimestamp;
+  cachedResult.ParametersKey = aParametersKey;
+  cachedResult.SegmentationResult = aResult;
+}
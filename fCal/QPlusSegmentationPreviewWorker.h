@@ -0,0 +1,139 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef SEGMENTATIONPREVIEWWORKER_H
+#define SEGMENTATIONPREVIEWWORKER_H
+
+// PlusLib includes
+#include <PlusConfigure.h>
+#include <PlusFidPatternRecognition.h>
+#include <igsioTrackedFrame.h>
+
+// Qt includes
+#include <QMutex>
+#include <QObject>
+
+// STL includes
+#include <array>
+#include <list>
+#include <string>
+#include <vector>
+
+class vtkXMLDataElement;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QPlusSegmentationPreviewWorker
+ * \brief Segments the frames displayed in the segmentation parameter dialog on a worker thread
+ *
+ * The dialog submits the displayed frame and, when they change, the segmentation parameters from the GUI thread.
+ * Only the latest submitted frame is kept: if frames are submitted faster than they can be segmented then the
+ * stale ones are dropped. The worker has its own pattern recognition instance, which is reconfigured from the
+ * latest submitted parameters before segmenting the next frame (only if the segmentation parameters differ from the
+ * current ones).
+ *
+ * The results of the most recent frame and parameter combinations are cached, so re-submitting a frozen frame with
+ * parameters that it has already been segmented with (e.g., when a parameter is changed back) does not segment it again.
+ * \ingroup PlusAppCommonWidgets
+ */
+class QPlusSegmentationPreviewWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  /*! Segmentation result of a frame */
+  struct Result
+  {
+    Result();
+    /*! Error reported by the pattern recognition */
+    PlusFidPatternRecognition::PatternRecognitionError Error;
+    /*! Fiducial candidate positions (in image pixels) */
+    std::vector<std::array<double, 2> > CandidatePoints;
+    /*! Segmented fiducial positions (in image pixels), empty if segmentation failed */
+    std::vector<std::array<double, 2> > SegmentedPoints;
+    /*! Time spent with segmenting the frame (in seconds) */
+    double SegmentationTimeSec;
+  };
+
+  QPlusSegmentationPreviewWorker(QObject* aParent = NULL);
+  ~QPlusSegmentationPreviewWorker();
+
+  /*!
+  * Set the segmentation parameters that are used for the frames submitted after this call. Call from the GUI thread.
+  * \param aConfig Device set configuration that contains the segmentation parameters. It is kept by the worker, so it must not be modified after the call.
+  */
+  void SetParameters(vtkXMLDataElement* aConfig);
+
+  /*! Request the segmentation of a copy of the frame. Replaces the pending frame, if any. */
+  void RequestSegmentation(igsioTrackedFrame& aTrackedFrame);
+
+  /*!
+  * Move the latest result to aResult (the previous content of aResult is reused as storage for the next result)
+  * \return False if there is no new result since the previous call
+  */
+  bool TakeLatestResult(Result& aResult);
+
+signals:
+  /*! Emitted when a new result is available (see TakeLatestResult) */
+  void ResultAvailable();
+
+protected slots:
+  /*! Segment the latest submitted frame (executed in the worker thread) */
+  void ProcessSegmentationRequest();
+
+protected:
+  /*! Segmentation result of a frame with a parameter set */
+  struct CachedResult
+  {
+    double FrameTimestamp;
+    std::string ParametersKey;
+    Result SegmentationResult;
+  };
+
+  /*! Returns a string that identifies the segmentation parameters of the configuration */
+  static std::string GetParametersKey(vtkXMLDataElement* aConfig);
+
+  /*! Find a cached result, moves it to the front of the cache if found. Returns NULL if not found. */
+  const Result* FindCachedResult(double aFrameTimestamp, const std::string& aParametersKey);
+
+  /*! Add a result to the front of the cache, removes the least recently used result if the cache is full */
+  void AddCachedResult(double aFrameTimestamp, const std::string& aParametersKey, const Result& aResult);
+
+protected:
+  /*! Pattern recognition, used only by the worker thread */
+  PlusFidPatternRecognition* m_PatternRecognition;
+
+  /*! Identifies the segmentation parameters of m_PatternRecognition, used only by the worker thread */
+  std::string m_ParametersKey;
+
+  /*! Most recently used results first, used only by the worker thread */
+  std::list<CachedResult> m_ResultCache;
+
+  /*! Frame being segmented, used only by the worker thread */
+  igsioTrackedFrame m_Frame;
+
+  /*! Result of the frame being segmented, used only by the worker thread (its storage is reused for the next frames) */
+  Result m_Result;
+
+  /*! Latest submitted frame that is not segmented yet */
+  igsioTrackedFrame m_PendingFrame;
+  bool m_FramePending;
+
+  /*! Latest submitted parameters that are not applied yet (NULL if the parameters have not changed) */
+  vtkSmartPointer<vtkXMLDataElement> m_PendingConfig;
+
+  /*! Flag indicating that a request is queued in the worker thread */
+  bool m_RequestQueued;
+
+  /*! Latest result */
+  Result m_LatestResult;
+  bool m_NewResultAvailable;
+
+  /*! Guards the pending frame and parameters, the latest result and the request */
+  QMutex m_Mutex;
+};
+
+#endif
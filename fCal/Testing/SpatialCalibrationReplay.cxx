@@ -0,0 +1,287 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+/*
+* This tool replays recorded validation and calibration sequences through the segmentation
+* pipeline and the probe calibration algorithm that fCal's spatial calibration toolbox uses,
+* and reports segmentation and calibration timing. It does not need a GUI or any hardware,
+* so it can be used for benchmarking the spatial calibration on any computer.
+*
+*/
+
+#include "PlusConfigure.h"
+#include "PlusTransformStatusFilter.h"
+#include "QPatternRecognitionPipeline.h"
+#include "PlusFidPatternRecognition.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkIGSIOTransformRepository.h"
+#include "vtkPlusProbeCalibrationAlgo.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkXMLUtilities.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <QThread>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+  /*! Statistics of the replay of a sequence */
+  struct ReplayStatistics
+  {
+    ReplayStatistics()
+      : NumberOfFrames(0)
+      , NumberOfValidFrames(0)
+      , NumberOfSegmentedFrames(0)
+      , TotalSegmentationTimeSec(0.0)
+      , MaxSegmentationTimeSec(0.0)
+      , ElapsedTimeSec(0.0)
+    {
+    }
+    int NumberOfFrames;
+    int NumberOfValidFrames;
+    int NumberOfSegmentedFrames;
+    double TotalSegmentationTimeSec;
+    double MaxSegmentationTimeSec;
+    double ElapsedTimeSec;
+  };
+}
+
+PlusStatus ReplaySequence(const std::string& sequenceFileName, QPatternRecognitionPipeline& pipeline, PlusTransformStatusFilter& transformStatusFilter,
+                          vtkIGSIOTrackedFrameList* segmentedFrames, ReplayStatistics& statistics);
+void PrintStatistics(const std::string& name, const ReplayStatistics& statistics);
+
+//-----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string inputConfigFileName;
+  std::string inputCalibrationSeqFileName;
+  std::string inputValidationSeqFileName;
+  int numberOfThreads = 0;
+  int queueLength = 32;
+  double minSegmentationSuccessRatePercent = 0.0;
+  double maxCalibrationErrorMm = 0.0;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Name of the device set configuration file that contains the segmentation and calibration parameters and the phantom registration.");
+  args.AddArgument("--calibration-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputCalibrationSeqFileName, "Sequence file with the recorded calibration frames.");
+  args.AddArgument("--validation-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputValidationSeqFileName, "Sequence file with the recorded validation frames.");
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of segmentation threads (Default: 0, one less than the number of CPU cores)");
+  args.AddArgument("--queue-length", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &queueLength, "Maximum number of frames in the segmentation pipeline (Default: 32)");
+  args.AddArgument("--min-segmentation-success-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &minSegmentationSuccessRatePercent, "Fail if less percent of the valid frames are segmented successfully (Default: 0)");
+  args.AddArgument("--max-calibration-error", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxCalibrationErrorMm, "Fail if the mean 3D reprojection error of the calibration is larger than this value in mm (Default: 0, not checked)");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputConfigFileName.empty() || inputCalibrationSeqFileName.empty() || inputValidationSeqFileName.empty())
+  {
+    std::cerr << "--config-file, --calibration-seq-file and --validation-seq-file are required" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Read configuration
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromFile(inputConfigFileName.c_str()));
+  if (configRootElement == NULL)
+  {
+    LOG_ERROR("Unable to read configuration from file " << inputConfigFileName.c_str());
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (transformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read transforms from configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkPlusProbeCalibrationAlgo> calibration = vtkSmartPointer<vtkPlusProbeCalibrationAlgo>::New();
+  if (calibration->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read probe calibration configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  PlusFidPatternRecognition patternRecognition;
+  if (patternRecognition.ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read segmentation configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  // Segment the frames the same way as the spatial calibration toolbox: validation data first, then calibration data
+  QPatternRecognitionPipeline pipeline;
+  if (pipeline.Start(configRootElement, numberOfThreads, queueLength) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start segmentation pipeline");
+    exit(EXIT_FAILURE);
+  }
+
+  // Frames without valid probe to phantom transform are dropped by their stored transform statuses, like in the toolbox
+  PlusTransformStatusFilter transformStatusFilter;
+  if (transformStatusFilter.Initialize(transformRepository, igsioTransformName(calibration->GetProbeCoordinateFrame(), calibration->GetPhantomCoordinateFrame())) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  ReplayStatistics validationStatistics;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> validationData = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (ReplaySequence(inputValidationSeqFileName, pipeline, transformStatusFilter, validationData, validationStatistics) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  ReplayStatistics calibrationStatistics;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> calibrationData = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (ReplaySequence(inputCalibrationSeqFileName, pipeline, transformStatusFilter, calibrationData, calibrationStatistics) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  pipeline.Stop();
+
+  // Calibrate
+  double calibrationStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (calibration->Calibrate(validationData, calibrationData, transformRepository, patternRecognition.GetFidLineFinder()->GetNWires()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Calibration failed");
+    exit(EXIT_FAILURE);
+  }
+  double calibrationTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - calibrationStartTimeSec;
+
+  // Report
+  std::cout << "Segmentation threads: " << (numberOfThreads > 0 ? numberOfThreads : std::max(QThread::idealThreadCount() - 1, 1)) << std::endl;
+  PrintStatistics("Validation", validationStatistics);
+  PrintStatistics("Calibration", calibrationStatistics);
+  std::cout << "Calibration time: " << std::fixed << std::setprecision(1) << calibrationTimeSec * 1000.0 << " ms" << std::endl;
+  std::cout << "Calibration error: " << std::setprecision(3) << calibration->GetCalibrationReprojectionError3DMean() << " mm (3D reprojection, mean)" << std::endl;
+
+  int numberOfValidFrames = validationStatistics.NumberOfValidFrames + calibrationStatistics.NumberOfValidFrames;
+  int numberOfSegmentedFrames = validationStatistics.NumberOfSegmentedFrames + calibrationStatistics.NumberOfSegmentedFrames;
+  double segmentationSuccessRatePercent = (numberOfValidFrames > 0 ? 100.0 * numberOfSegmentedFrames / numberOfValidFrames : 0.0);
+  if (segmentationSuccessRatePercent < minSegmentationSuccessRatePercent)
+  {
+    LOG_ERROR("Segmentation success rate is " << segmentationSuccessRatePercent << " percent, less than the required " << minSegmentationSuccessRatePercent << " percent");
+    exit(EXIT_FAILURE);
+  }
+
+  if (maxCalibrationErrorMm > 0 && calibration->GetCalibrationReprojectionError3DMean() > maxCalibrationErrorMm)
+  {
+    LOG_ERROR("Calibration error is " << calibration->GetCalibrationReprojectionError3DMean() << " mm, more than the allowed " << maxCalibrationErrorMm << " mm");
+    exit(EXIT_FAILURE);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus ReplaySequence(const std::string& sequenceFileName, QPatternRecognitionPipeline& pipeline, PlusTransformStatusFilter& transformStatusFilter,
+                          vtkIGSIOTrackedFrameList* segmentedFrames, ReplayStatistics& statistics)
+{
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> recordedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(sequenceFileName, recordedFrames) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read sequence file: " << sequenceFileName);
+    return PLUS_FAIL;
+  }
+  statistics.NumberOfFrames = recordedFrames->GetNumberOfTrackedFrames();
+
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  std::vector<unsigned int> validFrameIndices;
+  transformStatusFilter.GetValidFrames(recordedFrames, validFrameIndices);
+  statistics.NumberOfValidFrames = validFrameIndices.size();
+
+  // Every frame that is added to the pipeline is returned exactly once, segmented or not
+  PlusStatus status = PLUS_SUCCESS;
+  unsigned int numberOfAddedFrames = 0;
+  unsigned int numberOfReturnedFrames = 0;
+  std::vector<QPatternRecognitionPipeline::SegmentedFrame> pipelineOutput;
+  while (numberOfReturnedFrames < validFrameIndices.size())
+  {
+    // Add as many frames as the pipeline accepts, like the acquisition in the toolbox does
+    for (int freeSlots = pipeline.GetNumberOfFreeSlots(); freeSlots > 0 && numberOfAddedFrames < validFrameIndices.size(); --freeSlots, ++numberOfAddedFrames)
+    {
+      if (pipeline.AddFrame(recordedFrames->GetTrackedFrame(validFrameIndices[numberOfAddedFrames])) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << validFrameIndices[numberOfAddedFrames] << " to the segmentation pipeline");
+        return PLUS_FAIL;
+      }
+    }
+
+    pipelineOutput.clear();
+    pipeline.TakeSegmentedFrames(pipelineOutput);
+    if (pipelineOutput.empty())
+    {
+      QThread::msleep(1);
+      continue;
+    }
+    numberOfReturnedFrames += pipelineOutput.size();
+
+    for (std::vector<QPatternRecognitionPipeline::SegmentedFrame>::iterator frameIt = pipelineOutput.begin(); frameIt != pipelineOutput.end(); ++frameIt)
+    {
+      statistics.TotalSegmentationTimeSec += frameIt->SegmentationTimeSec;
+      statistics.MaxSegmentationTimeSec = std::max(statistics.MaxSegmentationTimeSec, frameIt->SegmentationTimeSec);
+      if (frameIt->Segmented)
+      {
+        statistics.NumberOfSegmentedFrames++;
+      }
+      LOG_DEBUG("Frame segmentation time: " << frameIt->SegmentationTimeSec * 1000.0 << " ms (" << (frameIt->Segmented ? "segmented" : "not segmented") << ")");
+      if (segmentedFrames->TakeTrackedFrame(frameIt->Frame, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add segmented frame to the calibration data");
+        status = PLUS_FAIL;
+      }
+    }
+  }
+
+  statistics.ElapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+  return status;
+}
+
+//-----------------------------------------------------------------------------
+void PrintStatistics(const std::string& name, const ReplayStatistics& statistics)
+{
+  std::cout << name << " frames: " << statistics.NumberOfFrames << " recorded, " << statistics.NumberOfValidFrames << " with valid probe to phantom transform, "
+            << statistics.NumberOfSegmentedFrames << " segmented";
+  if (statistics.NumberOfValidFrames > 0)
+  {
+    std::cout << " (" << std::fixed << std::setprecision(1) << 100.0 * statistics.NumberOfSegmentedFrames / statistics.NumberOfValidFrames << " percent)" << std::endl;
+    std::cout << name << " segmentation time per frame: " << statistics.TotalSegmentationTimeSec * 1000.0 / statistics.NumberOfValidFrames << " ms mean, "
+              << statistics.MaxSegmentationTimeSec * 1000.0 << " ms max" << std::endl;
+  }
+  else
+  {
+    std::cout << std::endl;
+  }
+  if (statistics.ElapsedTimeSec > 0)
+  {
+    std::cout << name << " throughput: " << std::fixed << std::setprecision(1) << statistics.NumberOfValidFrames / statistics.ElapsedTimeSec << " frames/s ("
+              << statistics.ElapsedTimeSec * 1000.0 << " ms total)" << std::endl;
+  }
+}
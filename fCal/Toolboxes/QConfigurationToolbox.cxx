@@ -8,6 +8,7 @@ See License.txt for details.
 #include "QConfigurationToolbox.h"
 #include "fCalMainWindow.h"
 #include "vtkPlusDisplayableObject.h"
+#include "vtkPlusModelCache.h"
 #include "vtkPlusVisualizationController.h"
 
 // PlusLib includes
@@ -458,6 +459,17 @@ PlusStatus QConfigurationToolbox::ReadConfiguration(vtkXMLDataElement* aConfig)
 
   m_ParentMainWindow->SetTransducerOriginPixelCoordinateFrame(transducerOriginPixelCoordinateFrame);
 
+  // Store parsed models in binary format so that they load faster the next time (disabled by default)
+  const char* preprocessedModelCache = fCalElement->GetAttribute("PreprocessedModelCache");
+  if (preprocessedModelCache != NULL && STRCASECMP(preprocessedModelCache, "TRUE") == 0)
+  {
+    vtkPlusModelCache::GetInstance()->SetPreprocessedCacheDirectory(vtkPlusConfig::GetInstance()->GetOutputDirectory() + "/ModelCache");
+  }
+  else
+  {
+    vtkPlusModelCache::GetInstance()->SetPreprocessedCacheDirectory("");
+  }
+
   // phantom model id
   const char* phantomModelId = fCalElement->GetAttribute("PhantomModelId");
   if (phantomModelId == NULL)
@@ -0,0 +1,319 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "QIncrementalCalibrationWorker.h"
+
+// PlusLib includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOAccurateTimer.h>
+#include <vtkIGSIOTrackedFrameList.h>
+#include <vtkIGSIOTransformRepository.h>
+#include <vtkPlusProbeCalibrationAlgo.h>
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPoints.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+// Qt includes
+#include <QMutexLocker>
+
+namespace
+{
+  //-----------------------------------------------------------------------------
+  /*! Copy the parts of a segmented frame that calibration uses (timestamp, transforms, segmented points), but not the image */
+  igsioTrackedFrame* CopyFrameForCalibration(igsioTrackedFrame* aTrackedFrame)
+  {
+    igsioTrackedFrame* frame = new igsioTrackedFrame();
+    frame->SetTimestamp(aTrackedFrame->GetTimestamp());
+
+    std::vector<igsioTransformName> transformNames;
+    aTrackedFrame->GetFrameTransformNameList(transformNames);
+    vtkSmartPointer<vtkMatrix4x4> transformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (std::vector<igsioTransformName>::iterator nameIt = transformNames.begin(); nameIt != transformNames.end(); ++nameIt)
+    {
+      ToolStatus status(TOOL_INVALID);
+      aTrackedFrame->GetFrameTransform(*nameIt, transformMatrix);
+      aTrackedFrame->GetFrameTransformStatus(*nameIt, status);
+      frame->SetFrameTransform(*nameIt, transformMatrix);
+      frame->SetFrameTransformStatus(*nameIt, status);
+    }
+
+    if (aTrackedFrame->GetFiducialPointsCoordinatePx() != NULL)
+    {
+      vtkSmartPointer<vtkPoints> fiducialPoints = vtkSmartPointer<vtkPoints>::New();
+      fiducialPoints->DeepCopy(aTrackedFrame->GetFiducialPointsCoordinatePx());
+      frame->SetFiducialPointsCoordinatePx(fiducialPoints);
+    }
+
+    return frame;
+  }
+}
+
+//-----------------------------------------------------------------------------
+QIncrementalCalibrationWorker::Estimate::Estimate()
+  : Valid(false)
+  , NumberOfCalibrationFrames(0)
+  , ValidationErrorMm(0.0)
+  , CalibrationErrorMm(0.0)
+  , ChangeMm(0.0)
+  , Converged(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+QIncrementalCalibrationWorker::QIncrementalCalibrationWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_Calibration(NULL)
+  , m_TransformRepository(vtkSmartPointer<vtkIGSIOTransformRepository>::New())
+  , m_ValidationData(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New())
+  , m_CalibrationData(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New())
+  , m_PreviousImageToProbeTransform(NULL)
+  , m_ImageWidthPx(0.0)
+  , m_ImageHeightPx(0.0)
+  , m_PendingImageWidthPx(0.0)
+  , m_PendingImageHeightPx(0.0)
+  , m_NumberOfStableUpdates(0)
+  , m_NumberOfFramesSinceLastRequest(0)
+  , m_UpdateQueued(false)
+  , m_Generation(0)
+  , m_UpdateIntervalFrames(10)
+  , m_MinimumNumberOfCalibrationFrames(50)
+  , m_ConvergenceThresholdMm(0.5)
+  , m_NumberOfStableUpdatesForConvergence(3)
+  , m_MaximumValidationErrorMm(1.0)
+{
+}
+
+//-----------------------------------------------------------------------------
+QIncrementalCalibrationWorker::~QIncrementalCalibrationWorker()
+{
+  Stop();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QIncrementalCalibrationWorker::Start(vtkXMLDataElement* aConfig, vtkIGSIOTransformRepository* aTransformRepository, const std::vector<PlusNWire>& aNWires)
+{
+  LOG_TRACE("QIncrementalCalibrationWorker::Start");
+
+  Stop();
+
+  // Wait for the update of the previous run to finish
+  QMutexLocker computationLocker(&m_ComputationMutex);
+
+  m_Calibration = vtkSmartPointer<vtkPlusProbeCalibrationAlgo>::New();
+  if (m_Calibration->ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read probe calibration configuration for incremental calibration");
+    m_Calibration = NULL;
+    return PLUS_FAIL;
+  }
+
+  m_TransformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (m_TransformRepository->DeepCopy(aTransformRepository, true) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to copy transform repository for incremental calibration");
+    m_Calibration = NULL;
+    return PLUS_FAIL;
+  }
+
+  m_NWires = aNWires;
+  m_ValidationData->Clear();
+  m_CalibrationData->Clear();
+  m_PreviousImageToProbeTransform = NULL;
+  m_ImageWidthPx = 0.0;
+  m_ImageHeightPx = 0.0;
+  m_NumberOfStableUpdates = 0;
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QIncrementalCalibrationWorker::Stop()
+{
+  QMutexLocker locker(&m_Mutex);
+
+  ++m_Generation;
+  for (std::vector<igsioTrackedFrame*>::iterator frameIt = m_PendingValidationFrames.begin(); frameIt != m_PendingValidationFrames.end(); ++frameIt)
+  {
+    delete *frameIt;
+  }
+  m_PendingValidationFrames.clear();
+  for (std::vector<igsioTrackedFrame*>::iterator frameIt = m_PendingCalibrationFrames.begin(); frameIt != m_PendingCalibrationFrames.end(); ++frameIt)
+  {
+    delete *frameIt;
+  }
+  m_PendingCalibrationFrames.clear();
+
+  m_NumberOfFramesSinceLastRequest = 0;
+  m_PendingImageWidthPx = 0.0;
+  m_PendingImageHeightPx = 0.0;
+  m_LatestEstimate = Estimate();
+
+  // The accumulated frames may be in use by an update, so they are deleted in the worker thread
+  QMetaObject::invokeMethod(this, "ReleaseFrames", Qt::QueuedConnection);
+}
+
+//-----------------------------------------------------------------------------
+void QIncrementalCalibrationWorker::ReleaseFrames()
+{
+  QMutexLocker computationLocker(&m_ComputationMutex);
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (!m_PendingCalibrationFrames.empty() || !m_PendingValidationFrames.empty())
+    {
+      // Restarted since the request
+      return;
+    }
+  }
+  m_ValidationData->Clear();
+  m_CalibrationData->Clear();
+}
+
+//-----------------------------------------------------------------------------
+void QIncrementalCalibrationWorker::AddValidationFrame(igsioTrackedFrame* aTrackedFrame)
+{
+  if (aTrackedFrame == NULL)
+  {
+    return;
+  }
+
+  QMutexLocker locker(&m_Mutex);
+  m_PendingValidationFrames.push_back(CopyFrameForCalibration(aTrackedFrame));
+}
+
+//-----------------------------------------------------------------------------
+void QIncrementalCalibrationWorker::AddCalibrationFrame(igsioTrackedFrame* aTrackedFrame)
+{
+  if (aTrackedFrame == NULL)
+  {
+    return;
+  }
+
+  QMutexLocker locker(&m_Mutex);
+  m_PendingCalibrationFrames.push_back(CopyFrameForCalibration(aTrackedFrame));
+  if (m_PendingImageWidthPx == 0.0)
+  {
+    FrameSizeType frameSize = aTrackedFrame->GetFrameSize();
+    m_PendingImageWidthPx = frameSize[0];
+    m_PendingImageHeightPx = frameSize[1];
+  }
+
+  if (++m_NumberOfFramesSinceLastRequest >= m_UpdateIntervalFrames && !m_UpdateQueued)
+  {
+    m_NumberOfFramesSinceLastRequest = 0;
+    m_UpdateQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessUpdateRequest", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+QIncrementalCalibrationWorker::Estimate QIncrementalCalibrationWorker::GetLatestEstimate()
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_LatestEstimate;
+}
+
+//-----------------------------------------------------------------------------
+void QIncrementalCalibrationWorker::ProcessUpdateRequest()
+{
+  QMutexLocker computationLocker(&m_ComputationMutex);
+
+  unsigned int generation = 0;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_UpdateQueued = false;
+    generation = m_Generation;
+
+    // Only the new frames are moved, the ones from the previous updates are kept
+    for (std::vector<igsioTrackedFrame*>::iterator frameIt = m_PendingValidationFrames.begin(); frameIt != m_PendingValidationFrames.end(); ++frameIt)
+    {
+      m_ValidationData->TakeTrackedFrame(*frameIt, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME);
+    }
+    m_PendingValidationFrames.clear();
+    for (std::vector<igsioTrackedFrame*>::iterator frameIt = m_PendingCalibrationFrames.begin(); frameIt != m_PendingCalibrationFrames.end(); ++frameIt)
+    {
+      m_CalibrationData->TakeTrackedFrame(*frameIt, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME);
+    }
+    m_PendingCalibrationFrames.clear();
+    m_ImageWidthPx = m_PendingImageWidthPx;
+    m_ImageHeightPx = m_PendingImageHeightPx;
+  }
+
+  if (m_Calibration.GetPointer() == NULL || m_ValidationData->GetNumberOfTrackedFrames() == 0 || m_CalibrationData->GetNumberOfTrackedFrames() == 0)
+  {
+    return;
+  }
+
+  LOG_TRACE("QIncrementalCalibrationWorker::ProcessUpdateRequest(" << m_CalibrationData->GetNumberOfTrackedFrames() << " calibration frames)");
+
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (m_Calibration->Calibrate(m_ValidationData, m_CalibrationData, m_TransformRepository, m_NWires) != PLUS_SUCCESS)
+  {
+    // Typically happens when there are too few frames yet, the next update will try again
+    LOG_DEBUG("Incremental calibration update failed with " << m_CalibrationData->GetNumberOfTrackedFrames() << " calibration frames");
+    return;
+  }
+  LOG_DEBUG("Incremental calibration update with " << m_CalibrationData->GetNumberOfTrackedFrames() << " calibration frames took " << (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) * 1000.0 << " ms");
+
+  vtkSmartPointer<vtkMatrix4x4> imageToProbeTransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  m_Calibration->GetImageToProbeTransformMatrix(imageToProbeTransformMatrix);
+
+  Estimate estimate;
+  estimate.Valid = true;
+  estimate.NumberOfCalibrationFrames = m_CalibrationData->GetNumberOfTrackedFrames();
+  estimate.ValidationErrorMm = m_Calibration->GetValidationReprojectionError3DMean();
+  estimate.CalibrationErrorMm = m_Calibration->GetCalibrationReprojectionError3DMean();
+  if (m_PreviousImageToProbeTransform.GetPointer() != NULL)
+  {
+    estimate.ChangeMm = GetImageCornerDisplacementMm(m_PreviousImageToProbeTransform, imageToProbeTransformMatrix);
+    m_NumberOfStableUpdates = (estimate.ChangeMm < m_ConvergenceThresholdMm ? m_NumberOfStableUpdates + 1 : 0);
+  }
+  m_PreviousImageToProbeTransform = imageToProbeTransformMatrix;
+
+  estimate.Converged = (m_NumberOfStableUpdates >= m_NumberOfStableUpdatesForConvergence
+                        && estimate.NumberOfCalibrationFrames >= m_MinimumNumberOfCalibrationFrames
+                        && estimate.ValidationErrorMm < m_MaximumValidationErrorMm);
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (generation != m_Generation)
+    {
+      // Stopped while computing
+      return;
+    }
+    m_LatestEstimate = estimate;
+  }
+
+  emit EstimateAvailable();
+}
+
+//-----------------------------------------------------------------------------
+double QIncrementalCalibrationWorker::GetImageCornerDisplacementMm(vtkMatrix4x4* aImageToProbe1, vtkMatrix4x4* aImageToProbe2)
+{
+  const double corners[4][4] =
+  {
+    {0.0, 0.0, 0.0, 1.0},
+    {m_ImageWidthPx, 0.0, 0.0, 1.0},
+    {0.0, m_ImageHeightPx, 0.0, 1.0},
+    {m_ImageWidthPx, m_ImageHeightPx, 0.0, 1.0}
+  };
+
+  double maxDisplacementMm = 0.0;
+  for (int i = 0; i < 4; ++i)
+  {
+    double cornerInProbe1[4] = {0.0, 0.0, 0.0, 1.0};
+    double cornerInProbe2[4] = {0.0, 0.0, 0.0, 1.0};
+    aImageToProbe1->MultiplyPoint(corners[i], cornerInProbe1);
+    aImageToProbe2->MultiplyPoint(corners[i], cornerInProbe2);
+    maxDisplacementMm = std::max(maxDisplacementMm, sqrt(vtkMath::Distance2BetweenPoints(cornerInProbe1, cornerInProbe2)));
+  }
+  return maxDisplacementMm;
+}
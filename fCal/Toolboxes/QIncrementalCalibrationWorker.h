@@ -0,0 +1,167 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef INCREMENTALCALIBRATIONWORKER_H
+#define INCREMENTALCALIBRATIONWORKER_H
+
+#include "PlusConfigure.h"
+
+#include "PlusFidPatternRecognitionCommon.h"
+
+#include <vtkSmartPointer.h>
+
+#include <QMutex>
+#include <QObject>
+
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+class vtkIGSIOTransformRepository;
+class vtkMatrix4x4;
+class vtkPlusProbeCalibrationAlgo;
+class vtkXMLDataElement;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QIncrementalCalibrationWorker
+ * \brief Updates a spatial calibration estimate while the calibration images are being acquired
+ *
+ * Segmented frames are added from the GUI thread. Calibration is computed in the thread the worker is moved to, on all
+ * frames that have been added so far, each time enough new calibration frames have arrived. Requests are coalesced:
+ * if frames arrive faster than the calibration can be computed then the next update includes all of them.
+ * The estimate is considered converged when the calibration has not changed more than the threshold for a few
+ * consecutive updates and the validation error is low enough.
+ * \ingroup PlusAppFCal
+ */
+class QIncrementalCalibrationWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  /*! Result of an update */
+  struct Estimate
+  {
+    Estimate();
+    /*! True if the calibration has been computed at least once */
+    bool Valid;
+    /*! Number of calibration frames used for the estimate */
+    int NumberOfCalibrationFrames;
+    /*! Mean 3D reprojection error of the validation frames (in mm) */
+    double ValidationErrorMm;
+    /*! Mean 3D reprojection error of the calibration frames (in mm) */
+    double CalibrationErrorMm;
+    /*! Largest displacement of the image corners since the previous estimate (in mm) */
+    double ChangeMm;
+    /*! True if the estimate has converged */
+    bool Converged;
+  };
+
+  QIncrementalCalibrationWorker(QObject* aParent = NULL);
+  ~QIncrementalCalibrationWorker();
+
+  /*!
+  * Discard frames and estimates of the previous run and prepare a new one. Call from the GUI thread.
+  * \param aConfig Device set configuration that contains the calibration parameters
+  * \param aTransformRepository Transform repository with the phantom registration, a copy is made
+  * \param aNWires Wire definitions of the phantom
+  */
+  PlusStatus Start(vtkXMLDataElement* aConfig, vtkIGSIOTransformRepository* aTransformRepository, const std::vector<PlusNWire>& aNWires);
+
+  /*! Discard frames and estimates, the update in progress (if any) is ignored */
+  void Stop();
+
+  /*! Add a copy of a segmented validation frame. Only the timestamp, the transforms and the segmented points are copied, not the image. */
+  void AddValidationFrame(igsioTrackedFrame* aTrackedFrame);
+
+  /*!
+  * Add a copy of a segmented calibration frame (without the image, but its size is stored for measuring the change of the calibration).
+  * Requests an update if enough new frames have been added.
+  */
+  void AddCalibrationFrame(igsioTrackedFrame* aTrackedFrame);
+
+  /*! Get the latest estimate */
+  Estimate GetLatestEstimate();
+
+  void SetUpdateIntervalFrames(int aValue) { m_UpdateIntervalFrames = aValue; };
+  void SetMinimumNumberOfCalibrationFrames(int aValue) { m_MinimumNumberOfCalibrationFrames = aValue; };
+  void SetConvergenceThresholdMm(double aValue) { m_ConvergenceThresholdMm = aValue; };
+  void SetNumberOfStableUpdatesForConvergence(int aValue) { m_NumberOfStableUpdatesForConvergence = aValue; };
+  void SetMaximumValidationErrorMm(double aValue) { m_MaximumValidationErrorMm = aValue; };
+
+signals:
+  /*! Emitted when a new estimate is available */
+  void EstimateAvailable();
+
+protected slots:
+  /*! Compute the calibration on all frames added so far (executed in the worker thread) */
+  void ProcessUpdateRequest();
+
+  /*! Delete the frames of a stopped run (executed in the worker thread) */
+  void ReleaseFrames();
+
+protected:
+  /*! Largest distance between the image corners transformed by two image to probe transforms */
+  double GetImageCornerDisplacementMm(vtkMatrix4x4* aImageToProbe1, vtkMatrix4x4* aImageToProbe2);
+
+protected:
+  /*! Calibration algorithm, used only by the worker thread while running */
+  vtkSmartPointer<vtkPlusProbeCalibrationAlgo> m_Calibration;
+
+  /*! Copy of the transform repository, used only by the worker thread while running */
+  vtkSmartPointer<vtkIGSIOTransformRepository> m_TransformRepository;
+
+  /*! Wire definitions of the phantom */
+  std::vector<PlusNWire> m_NWires;
+
+  /*! Frames used for calibration, accessed only by the worker thread while running */
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> m_ValidationData;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> m_CalibrationData;
+
+  /*! Frames added since the last update */
+  std::vector<igsioTrackedFrame*> m_PendingValidationFrames;
+  std::vector<igsioTrackedFrame*> m_PendingCalibrationFrames;
+
+  /*! Image to probe transform of the previous estimate */
+  vtkSmartPointer<vtkMatrix4x4> m_PreviousImageToProbeTransform;
+
+  /*! Image size, for measuring the change of the calibration, used only by the worker thread while running */
+  double m_ImageWidthPx;
+  double m_ImageHeightPx;
+
+  /*! Image size of the added calibration frames, taken from the source frames as the copies have no image */
+  double m_PendingImageWidthPx;
+  double m_PendingImageHeightPx;
+
+  /*! Latest result */
+  Estimate m_LatestEstimate;
+
+  /*! Number of consecutive updates that changed the calibration less than the threshold */
+  int m_NumberOfStableUpdates;
+
+  /*! Number of calibration frames added since the last update request */
+  int m_NumberOfFramesSinceLastRequest;
+
+  /*! Flag indicating that an update is queued in the worker thread */
+  bool m_UpdateQueued;
+
+  /*! Incremented on start and stop, so that results of an old run are discarded */
+  unsigned int m_Generation;
+
+  int m_UpdateIntervalFrames;
+  int m_MinimumNumberOfCalibrationFrames;
+  double m_ConvergenceThresholdMm;
+  int m_NumberOfStableUpdatesForConvergence;
+  double m_MaximumValidationErrorMm;
+
+  /*! Guards the pending frames, the latest estimate and the request */
+  QMutex m_Mutex;
+
+  /*! Held while an update is computed, so the algorithm is not reconfigured during computation */
+  QMutex m_ComputationMutex;
+};
+
+#endif
@@ -0,0 +1,244 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "QLatencyMonitorWorker.h"
+
+// PlusLib includes
+#include <vtkIGSIOTrackedFrameList.h>
+
+// STL includes
+#include <algorithm>
+
+// Qt includes
+#include <QMutexLocker>
+
+namespace
+{
+  /*! If the worker cannot keep up then the oldest frame lists are dropped, so that the queued images do not fill the memory */
+  const unsigned int MAX_NUMBER_OF_PENDING_FRAME_LISTS = 20;
+}
+
+//-----------------------------------------------------------------------------
+QLatencyMonitorWorker::Estimate::Estimate()
+  : Valid(false)
+  , MovingLagSec(0.0)
+  , Correlation(0.0)
+  , Timestamp(UNDEFINED_TIMESTAMP)
+{
+}
+
+//-----------------------------------------------------------------------------
+QLatencyMonitorWorker::QLatencyMonitorWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_LastEstimationTimestamp(UNDEFINED_TIMESTAMP)
+  , m_FixedType(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE)
+  , m_MovingType(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE)
+  , m_ResetRequested(false)
+  , m_ProcessingQueued(false)
+  , m_WindowSec(10.0)
+  , m_EstimationIntervalSec(5.0)
+  , m_MaximumLagSec(0.5)
+  , m_MinimumCorrelation(0.5)
+  , m_Generation(0)
+{
+  // The coarse sweep keeps the periodic estimation cheap
+  m_LagEstimator.SetSamplingResolutionSec(0.001);
+  m_LagEstimator.SetCoarseSamplingResolutionSec(0.01);
+}
+
+//-----------------------------------------------------------------------------
+QLatencyMonitorWorker::~QLatencyMonitorWorker()
+{
+}
+
+//-----------------------------------------------------------------------------
+void QLatencyMonitorWorker::Start(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aFixedType, const igsioTransformName& aFixedTransformName,
+                                  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aMovingType, const igsioTransformName& aMovingTransformName,
+                                  const std::vector<int>& aClipRectangle)
+{
+  QMutexLocker locker(&m_Mutex);
+  ++m_Generation;
+  m_PendingFrames.clear();
+  m_LatestEstimate = Estimate();
+
+  m_FixedType = aFixedType;
+  m_FixedTransformName = aFixedTransformName;
+  m_MovingType = aMovingType;
+  m_MovingTransformName = aMovingTransformName;
+  m_ClipRectangle = aClipRectangle;
+  m_ResetRequested = true;
+}
+
+//-----------------------------------------------------------------------------
+void QLatencyMonitorWorker::Stop()
+{
+  QMutexLocker locker(&m_Mutex);
+  ++m_Generation;
+  m_PendingFrames.clear();
+  m_LatestEstimate = Estimate();
+
+  // Release the collected signals at the next processing
+  m_FixedType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE;
+  m_MovingType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE;
+  m_ResetRequested = true;
+  if (!m_ProcessingQueued)
+  {
+    m_ProcessingQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessFrames", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QLatencyMonitorWorker::AddFrames(vtkIGSIOTrackedFrameList* aFixedFrames, vtkIGSIOTrackedFrameList* aMovingFrames)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_PendingFrames.push_back(std::make_pair(vtkSmartPointer<vtkIGSIOTrackedFrameList>(aFixedFrames), vtkSmartPointer<vtkIGSIOTrackedFrameList>(aMovingFrames)));
+  if (m_PendingFrames.size() > MAX_NUMBER_OF_PENDING_FRAME_LISTS)
+  {
+    // The fixed and moving frames of the same period are dropped together, so that the signals remain comparable
+    LOG_DEBUG("Latency monitor cannot keep up, oldest frames are dropped");
+    m_PendingFrames.erase(m_PendingFrames.begin());
+  }
+  if (!m_ProcessingQueued)
+  {
+    m_ProcessingQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessFrames", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool QLatencyMonitorWorker::IsQueueFull()
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_PendingFrames.size() >= MAX_NUMBER_OF_PENDING_FRAME_LISTS;
+}
+
+//-----------------------------------------------------------------------------
+QLatencyMonitorWorker::Estimate QLatencyMonitorWorker::GetLatestEstimate()
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_LatestEstimate;
+}
+
+//-----------------------------------------------------------------------------
+void QLatencyMonitorWorker::SetWindowSec(double aWindowSec)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_WindowSec = aWindowSec;
+}
+
+//-----------------------------------------------------------------------------
+void QLatencyMonitorWorker::SetEstimationIntervalSec(double aEstimationIntervalSec)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_EstimationIntervalSec = aEstimationIntervalSec;
+}
+
+//-----------------------------------------------------------------------------
+void QLatencyMonitorWorker::SetMaximumLagSec(double aMaximumLagSec)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_MaximumLagSec = aMaximumLagSec;
+}
+
+//-----------------------------------------------------------------------------
+void QLatencyMonitorWorker::SetMinimumCorrelation(double aMinimumCorrelation)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_MinimumCorrelation = aMinimumCorrelation;
+}
+
+//-----------------------------------------------------------------------------
+void QLatencyMonitorWorker::ProcessFrames()
+{
+  FrameListPairs frames;
+  unsigned int generation = 0;
+  double windowSec = 0.0;
+  double estimationIntervalSec = 0.0;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_ProcessingQueued = false;
+    frames.swap(m_PendingFrames);
+    generation = m_Generation;
+    windowSec = m_WindowSec;
+    estimationIntervalSec = m_EstimationIntervalSec;
+    m_LagEstimator.SetMaximumLagSec(m_MaximumLagSec);
+    m_LagEstimator.SetMinimumCorrelation(m_MinimumCorrelation);
+
+    if (m_ResetRequested)
+    {
+      m_FixedSignal.Reset(m_FixedType, m_FixedTransformName);
+      m_FixedSignal.SetClipRectangle(m_ClipRectangle);
+      m_MovingSignal.Reset(m_MovingType, m_MovingTransformName);
+      m_MovingSignal.SetClipRectangle(m_ClipRectangle);
+      m_LastEstimationTimestamp = UNDEFINED_TIMESTAMP;
+      m_ResetRequested = false;
+    }
+  }
+
+  if (m_FixedSignal.GetFrameType() == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE
+      || m_MovingSignal.GetFrameType() == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE)
+  {
+    // Stopped
+    return;
+  }
+
+  for (FrameListPairs::iterator framesIt = frames.begin(); framesIt != frames.end(); ++framesIt)
+  {
+    m_FixedSignal.AddFrames(framesIt->first);
+    m_MovingSignal.AddFrames(framesIt->second);
+  }
+
+  if (m_FixedSignal.GetNumberOfSamples() == 0 || m_MovingSignal.GetNumberOfSamples() == 0)
+  {
+    return;
+  }
+
+  // Keep only the latest window of both signals
+  const double latestTimestamp = std::min(m_FixedSignal.GetLatestTimestamp(), m_MovingSignal.GetLatestTimestamp());
+  m_FixedSignal.RemoveSamplesBefore(latestTimestamp - windowSec);
+  m_MovingSignal.RemoveSamplesBefore(latestTimestamp - windowSec);
+
+  if (m_LastEstimationTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    // Wait until the window is filled for the first time
+    m_LastEstimationTimestamp = latestTimestamp - estimationIntervalSec + windowSec;
+  }
+  if (latestTimestamp - m_LastEstimationTimestamp < estimationIntervalSec)
+  {
+    return;
+  }
+  m_LastEstimationTimestamp = latestTimestamp;
+
+  std::vector<double> fixedTimestamps;
+  std::vector<double> fixedPositions;
+  std::vector<double> movingTimestamps;
+  std::vector<double> movingPositions;
+  Estimate estimate;
+  estimate.Timestamp = latestTimestamp;
+  vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR error = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NONE;
+  if (m_FixedSignal.GetSignal(fixedTimestamps, fixedPositions) == PLUS_SUCCESS
+      && m_MovingSignal.GetSignal(movingTimestamps, movingPositions) == PLUS_SUCCESS
+      && m_LagEstimator.Update(fixedTimestamps, fixedPositions, movingTimestamps, movingPositions, error) == PLUS_SUCCESS)
+  {
+    estimate.Valid = true;
+    estimate.MovingLagSec = m_LagEstimator.GetMovingLagSec();
+  }
+  estimate.Correlation = m_LagEstimator.GetBestCorrelation();
+  LOG_DEBUG("Latency monitor estimate: " << (estimate.Valid ? "valid" : "invalid") << ", lag: " << estimate.MovingLagSec << "s, correlation: " << estimate.Correlation);
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (generation != m_Generation)
+    {
+      // Restarted or stopped while computing
+      return;
+    }
+    m_LatestEstimate = estimate;
+  }
+
+  emit EstimateAvailable();
+}
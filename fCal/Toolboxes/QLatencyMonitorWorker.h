@@ -0,0 +1,146 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef LATENCYMONITORWORKER_H
+#define LATENCYMONITORWORKER_H
+
+#include "PlusConfigure.h"
+#include "PlusTemporalCalibrationSignal.h"
+#include "PlusTemporalLagEstimator.h"
+
+#include <vtkSmartPointer.h>
+
+#include <QMutex>
+#include <QObject>
+
+#include <utility>
+#include <vector>
+
+class vtkIGSIOTrackedFrameList;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QLatencyMonitorWorker
+ * \brief Estimates the remaining lag between two streams continuously, on a low priority worker thread
+ *
+ * The toolbox fetches the new frames of the fixed and moving channels periodically and passes them to the worker.
+ * The worker reduces the frames to position signals, keeps only the latest time window of the signals and
+ * cross-correlates the window at a fixed interval. Since the timestamps are already corrected by the current
+ * time offsets, the estimated lag is the error of the current temporal calibration.
+ * \ingroup PlusAppFCal
+ */
+class QLatencyMonitorWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  /*! Result of a lag estimation on the signal window */
+  struct Estimate
+  {
+    Estimate();
+    /*! False if the lag could not be determined (e.g., there was not enough motion in the window) */
+    bool Valid;
+    /*! Lag of the moving stream in the window (positive if the moving stream is delayed) */
+    double MovingLagSec;
+    /*! Correlation of the signals at the estimated lag */
+    double Correlation;
+    /*! Latest sample timestamp in the window */
+    double Timestamp;
+  };
+
+  QLatencyMonitorWorker(QObject* aParent = NULL);
+  ~QLatencyMonitorWorker();
+
+  /*!
+  * Discard all collected data and set the signal sources
+  * \param aFixedType Fixed signal type
+  * \param aFixedTransformName Transform of the fixed tracker signal (ignored for video)
+  * \param aMovingType Moving signal type
+  * \param aMovingTransformName Transform of the moving tracker signal (ignored for video)
+  * \param aClipRectangle Region of the image where the line is searched in video signals
+  */
+  void Start(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aFixedType, const igsioTransformName& aFixedTransformName,
+             vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aMovingType, const igsioTransformName& aMovingTransformName,
+             const std::vector<int>& aClipRectangle);
+
+  /*! Discard the queued frames and ignore the results of the running estimation */
+  void Stop();
+
+  /*!
+  * Queue new frames of the fixed and moving channels (the same list can be passed for both if they share a channel).
+  * The number of queued lists is limited, the oldest fixed and moving lists are dropped together if the worker cannot keep up.
+  */
+  void AddFrames(vtkIGSIOTrackedFrameList* aFixedFrames, vtkIGSIOTrackedFrameList* aMovingFrames);
+
+  /*! Returns true if the worker cannot keep up and the next AddFrames would drop queued frames (fetching new frames can be postponed) */
+  bool IsQueueFull();
+
+  /*! Get the latest estimate */
+  Estimate GetLatestEstimate();
+
+  /*! Length of the signal window that is correlated */
+  void SetWindowSec(double aWindowSec);
+
+  /*! Time between two estimations, in signal time */
+  void SetEstimationIntervalSec(double aEstimationIntervalSec);
+
+  /*! Lag search range of the estimation */
+  void SetMaximumLagSec(double aMaximumLagSec);
+
+  /*! Estimates with lower correlation are invalid */
+  void SetMinimumCorrelation(double aMinimumCorrelation);
+
+signals:
+  /*! Emitted when a new estimate is available (see GetLatestEstimate) */
+  void EstimateAvailable();
+
+protected slots:
+  /*! Process the queued frames and estimate the lag if it is due (executed in the worker thread) */
+  void ProcessFrames();
+
+protected:
+  typedef std::vector<std::pair<vtkSmartPointer<vtkIGSIOTrackedFrameList>, vtkSmartPointer<vtkIGSIOTrackedFrameList> > > FrameListPairs;
+
+protected:
+  /*! Signals and the estimator are accessed only in the worker thread */
+  PlusTemporalCalibrationSignal m_FixedSignal;
+  PlusTemporalCalibrationSignal m_MovingSignal;
+  PlusTemporalLagEstimator m_LagEstimator;
+
+  /*! Signal time of the last estimation */
+  double m_LastEstimationTimestamp;
+
+  /*! Signal source settings to be applied in the worker thread before processing new frames */
+  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE m_FixedType;
+  igsioTransformName m_FixedTransformName;
+  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE m_MovingType;
+  igsioTransformName m_MovingTransformName;
+  std::vector<int> m_ClipRectangle;
+  bool m_ResetRequested;
+
+  /*! Fixed and moving frame lists waiting for processing */
+  FrameListPairs m_PendingFrames;
+
+  /*! Set while a processing request is queued */
+  bool m_ProcessingQueued;
+
+  double m_WindowSec;
+  double m_EstimationIntervalSec;
+
+  /*! Estimator settings to be applied in the worker thread before the estimation */
+  double m_MaximumLagSec;
+  double m_MinimumCorrelation;
+
+  Estimate m_LatestEstimate;
+
+  /*! Incremented by Start and Stop to discard the results of running estimations */
+  unsigned int m_Generation;
+
+  /*! Guards the pending frames, the settings and the latest estimate */
+  QMutex m_Mutex;
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "QLineSegmentationPreviewWorker.h"
+
+// PlusLib includes
+#include <igsioTrackedFrame.h>
+#include <vtkPlusLineSegmentationAlgo.h>
+
+// VTK includes
+#include <vtkBox.h>
+#include <vtkImageData.h>
+
+// Qt includes
+#include <QMutexLocker>
+
+//-----------------------------------------------------------------------------
+QLineSegmentationPreviewWorker::Line::Line()
+  : Detected(false)
+{
+  StartPoint_Image[0] = StartPoint_Image[1] = 0.0;
+  EndPoint_Image[0] = EndPoint_Image[1] = 0.0;
+}
+
+//-----------------------------------------------------------------------------
+QLineSegmentationPreviewWorker::QLineSegmentationPreviewWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_LineSegmenter(vtkSmartPointer<vtkPlusLineSegmentationAlgo>::New())
+  , m_ClipRectangleModified(false)
+  , m_PendingFrame(NULL)
+  , m_ProcessingQueued(false)
+  , m_LatestLineValid(false)
+  , m_Generation(0)
+{
+  m_LineSegmenter->SetSaveIntermediateImages(false);
+}
+
+//-----------------------------------------------------------------------------
+QLineSegmentationPreviewWorker::~QLineSegmentationPreviewWorker()
+{
+  delete m_PendingFrame;
+  m_PendingFrame = NULL;
+}
+
+//-----------------------------------------------------------------------------
+void QLineSegmentationPreviewWorker::SetClipRectangle(const std::vector<int>& aClipRectangle)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_ClipRectangle = aClipRectangle;
+  m_ClipRectangleModified = true;
+}
+
+//-----------------------------------------------------------------------------
+void QLineSegmentationPreviewWorker::SubmitFrame(igsioTrackedFrame* aTrackedFrame)
+{
+  if (aTrackedFrame == NULL)
+  {
+    return;
+  }
+
+  QMutexLocker locker(&m_Mutex);
+  delete m_PendingFrame;
+  m_PendingFrame = aTrackedFrame;
+  if (!m_ProcessingQueued)
+  {
+    m_ProcessingQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessPendingFrame", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QLineSegmentationPreviewWorker::Clear()
+{
+  QMutexLocker locker(&m_Mutex);
+  ++m_Generation;
+  delete m_PendingFrame;
+  m_PendingFrame = NULL;
+  m_LatestLineValid = false;
+}
+
+//-----------------------------------------------------------------------------
+bool QLineSegmentationPreviewWorker::GetLatestLine(Line& aLine)
+{
+  QMutexLocker locker(&m_Mutex);
+  aLine = m_LatestLine;
+  return m_LatestLineValid;
+}
+
+//-----------------------------------------------------------------------------
+void QLineSegmentationPreviewWorker::ProcessPendingFrame()
+{
+  igsioTrackedFrame* frame = NULL;
+  unsigned int generation = 0;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_ProcessingQueued = false;
+    frame = m_PendingFrame;
+    m_PendingFrame = NULL;
+    generation = m_Generation;
+    if (m_ClipRectangleModified && m_ClipRectangle.size() >= 4)
+    {
+      m_LineSegmenter->SetClipRectangle(m_ClipRectangle.data(), &(m_ClipRectangle.data()[2]));
+    }
+    m_ClipRectangleModified = false;
+  }
+
+  if (frame == NULL)
+  {
+    return;
+  }
+
+  Line line;
+  PlusStatus status = SegmentFrame(*frame, line);
+  delete frame;
+  if (status != PLUS_SUCCESS)
+  {
+    // Keep showing the previous result
+    return;
+  }
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (generation != m_Generation)
+    {
+      // Cleared while segmenting
+      return;
+    }
+    m_LatestLine = line;
+    m_LatestLineValid = true;
+  }
+
+  emit LineAvailable();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QLineSegmentationPreviewWorker::SegmentFrame(igsioTrackedFrame& aTrackedFrame, Line& aLine)
+{
+  m_LineSegmenter->SetTrackedFrame(aTrackedFrame);
+  if (m_LineSegmenter->Update() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  std::vector<vtkPlusLineSegmentationAlgo::LineParameters> parameters;
+  m_LineSegmenter->GetDetectedLineParameters(parameters);
+  if (parameters.empty() || !parameters[0].lineDetected)
+  {
+    aLine.Detected = false;
+    return PLUS_SUCCESS;
+  }
+
+  // Clip the line to the image
+  int* dimensions = aTrackedFrame.GetImageData()->GetImage()->GetDimensions();
+  double p1[3] = { parameters[0].lineOriginPoint_Image[0] - 100000 * parameters[0].lineDirectionVector_Image[0],
+                   parameters[0].lineOriginPoint_Image[1] - 100000 * parameters[0].lineDirectionVector_Image[1],
+                   0.0
+                 };
+  double p2[3] = { parameters[0].lineOriginPoint_Image[0] + 100000 * parameters[0].lineDirectionVector_Image[0],
+                   parameters[0].lineOriginPoint_Image[1] + 100000 * parameters[0].lineDirectionVector_Image[1],
+                   0.0
+                 };
+  double r1[3], r2[3];
+  double t1, t2;
+  int plane1, plane2;
+  double bounds[6] = { 0.0, static_cast<double>(dimensions[0]), 0.0, static_cast<double>(dimensions[1]), 0.0, 1.0 };
+  vtkBox::IntersectWithLine(bounds, p1, p2, t1, t2, r1, r2, plane1, plane2);
+
+  aLine.Detected = true;
+  aLine.StartPoint_Image[0] = r1[0];
+  aLine.StartPoint_Image[1] = r1[1];
+  aLine.EndPoint_Image[0] = r2[0];
+  aLine.EndPoint_Image[1] = r2[1];
+  return PLUS_SUCCESS;
+}
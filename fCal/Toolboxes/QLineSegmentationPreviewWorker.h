@@ -0,0 +1,103 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef LINESEGMENTATIONPREVIEWWORKER_H
+#define LINESEGMENTATIONPREVIEWWORKER_H
+
+#include "PlusConfigure.h"
+
+#include <vtkSmartPointer.h>
+
+#include <QMutex>
+#include <QObject>
+
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkPlusLineSegmentationAlgo;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QLineSegmentationPreviewWorker
+ * \brief Segments the line of the live image for the temporal calibration preview on a worker thread
+ *
+ * The worker object is moved to a low priority thread owned by the temporal calibration toolbox. Only the latest
+ * submitted frame is segmented, frames that arrive while a segmentation is running replace each other. The result
+ * contains only the line endpoints, so the GUI thread does not need to access the segmented image.
+ * \ingroup PlusAppFCal
+ */
+class QLineSegmentationPreviewWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  /*! Segmented line in image coordinates */
+  struct Line
+  {
+    Line();
+    /*! False if no line was found in the image */
+    bool Detected;
+    double StartPoint_Image[2];
+    double EndPoint_Image[2];
+  };
+
+  QLineSegmentationPreviewWorker(QObject* aParent = NULL);
+  ~QLineSegmentationPreviewWorker();
+
+  /*! Set the image region where the line is searched (origin x, origin y, size x, size y), empty vector means the whole image */
+  void SetClipRectangle(const std::vector<int>& aClipRectangle);
+
+  /*! Queue a frame for segmentation, the worker takes ownership of the frame. A pending frame that has not been segmented yet is discarded. */
+  void SubmitFrame(igsioTrackedFrame* aTrackedFrame);
+
+  /*! Discard the pending frame and ignore the results of segmentations that are already running */
+  void Clear();
+
+  /*! Get the line of the latest segmented frame. Returns false if no frame has been segmented since the last Clear. */
+  bool GetLatestLine(Line& aLine);
+
+signals:
+  /*! Emitted when a frame is segmented (see GetLatestLine) */
+  void LineAvailable();
+
+protected slots:
+  /*! Segment the pending frame (executed in the worker thread) */
+  void ProcessPendingFrame();
+
+protected:
+  /*! Segment a frame and compute the endpoints of the line at the image borders */
+  PlusStatus SegmentFrame(igsioTrackedFrame& aTrackedFrame, Line& aLine);
+
+protected:
+  /*! Line segmentation algorithm (used only in the worker thread) */
+  vtkSmartPointer<vtkPlusLineSegmentationAlgo> m_LineSegmenter;
+
+  /*! Clip rectangle to be applied before the next segmentation */
+  std::vector<int> m_ClipRectangle;
+
+  /*! Set when the clip rectangle has changed */
+  bool m_ClipRectangleModified;
+
+  /*! Latest submitted frame that is not segmented yet (owned) */
+  igsioTrackedFrame* m_PendingFrame;
+
+  /*! Set while a segmentation request is queued */
+  bool m_ProcessingQueued;
+
+  /*! Line of the latest segmented frame */
+  Line m_LatestLine;
+
+  /*! True if m_LatestLine is set */
+  bool m_LatestLineValid;
+
+  /*! Incremented by Clear to discard the results of running segmentations */
+  unsigned int m_Generation;
+
+  /*! Guards the pending frame, the clip rectangle and the latest line */
+  QMutex m_Mutex;
+};
+
+#endif
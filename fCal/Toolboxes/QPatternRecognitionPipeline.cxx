@@ -0,0 +1,244 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "QPatternRecognitionPipeline.h"
+
+// PlusLib includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOAccurateTimer.h>
+
+// STL includes
+#include <algorithm>
+
+// Qt includes
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+//-----------------------------------------------------------------------------
+/*! Segments queued frames until the pipeline is stopped */
+class QPatternRecognitionPipeline::Worker : public QRunnable
+{
+public:
+  Worker(QPatternRecognitionPipeline* aPipeline)
+    : Pipeline(aPipeline)
+  {
+    setAutoDelete(false);
+  }
+
+  virtual void run()
+  {
+    igsioTrackedFrame* trackedFrame = NULL;
+    unsigned int sequenceNumber = 0;
+    while (Pipeline->WaitForFrame(trackedFrame, sequenceNumber))
+    {
+      SegmentedFrame segmentedFrame;
+      segmentedFrame.Frame = trackedFrame;
+      segmentedFrame.Segmented = false;
+      segmentedFrame.Error = PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_NO_ERROR;
+
+      double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+      PlusPatternRecognitionResult result;
+      if (PatternRecognition.RecognizePattern(trackedFrame, result, segmentedFrame.Error, sequenceNumber) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to segment tracked frame");
+      }
+      else
+      {
+        segmentedFrame.Segmented = (result.GetFoundDotsCoordinateValue().size() > 0);
+      }
+      segmentedFrame.SegmentationTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+
+      Pipeline->AddSegmentedFrame(sequenceNumber, segmentedFrame);
+    }
+  }
+
+  QPatternRecognitionPipeline* Pipeline;
+  PlusFidPatternRecognition PatternRecognition;
+};
+
+//-----------------------------------------------------------------------------
+QPatternRecognitionPipeline::QPatternRecognitionPipeline()
+  : m_NextSequenceNumber(0)
+  , m_NextSequenceNumberToTake(0)
+  , m_Capacity(0)
+  , m_StopRequested(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+QPatternRecognitionPipeline::~QPatternRecognitionPipeline()
+{
+  Stop();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPatternRecognitionPipeline::Start(vtkXMLDataElement* aConfig, int aNumberOfWorkers, int aCapacity)
+{
+  LOG_TRACE("QPatternRecognitionPipeline::Start(" << aNumberOfWorkers << ", " << aCapacity << ")");
+
+  Stop();
+
+  if (aNumberOfWorkers < 1)
+  {
+    // Leave one core for acquisition and rendering
+    aNumberOfWorkers = std::max(QThread::idealThreadCount() - 1, 1);
+  }
+
+  for (int i = 0; i < aNumberOfWorkers; ++i)
+  {
+    Worker* worker = new Worker(this);
+    m_Workers.push_back(worker);
+    if (worker->PatternRecognition.ReadConfiguration(aConfig) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read segmentation configuration for pattern recognition worker");
+      Stop();
+      return PLUS_FAIL;
+    }
+  }
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_Capacity = std::max(aCapacity, aNumberOfWorkers);
+    m_StopRequested = false;
+    m_NextSequenceNumber = 0;
+    m_NextSequenceNumberToTake = 0;
+  }
+
+  m_ThreadPool.setMaxThreadCount(aNumberOfWorkers);
+  for (std::vector<Worker*>::iterator workerIt = m_Workers.begin(); workerIt != m_Workers.end(); ++workerIt)
+  {
+    m_ThreadPool.start(*workerIt);
+  }
+
+  LOG_DEBUG("Pattern recognition pipeline started with " << aNumberOfWorkers << " workers");
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QPatternRecognitionPipeline::Stop()
+{
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_StopRequested = true;
+    m_FrameQueued.wakeAll();
+  }
+  m_ThreadPool.waitForDone();
+
+  for (std::vector<Worker*>::iterator workerIt = m_Workers.begin(); workerIt != m_Workers.end(); ++workerIt)
+  {
+    delete *workerIt;
+  }
+  m_Workers.clear();
+
+  DeleteFrames();
+}
+
+//-----------------------------------------------------------------------------
+bool QPatternRecognitionPipeline::IsRunning()
+{
+  QMutexLocker locker(&m_Mutex);
+  return !m_StopRequested && !m_Workers.empty();
+}
+
+//-----------------------------------------------------------------------------
+int QPatternRecognitionPipeline::GetNumberOfFreeSlots()
+{
+  QMutexLocker locker(&m_Mutex);
+  if (m_StopRequested)
+  {
+    return 0;
+  }
+  int numberOfFramesInPipeline = m_NextSequenceNumber - m_NextSequenceNumberToTake;
+  return std::max(m_Capacity - numberOfFramesInPipeline, 0);
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPatternRecognitionPipeline::AddFrame(igsioTrackedFrame* aTrackedFrame)
+{
+  if (aTrackedFrame == NULL)
+  {
+    LOG_ERROR("Invalid tracked frame!");
+    return PLUS_FAIL;
+  }
+
+  QMutexLocker locker(&m_Mutex);
+  if (m_StopRequested || static_cast<int>(m_NextSequenceNumber - m_NextSequenceNumberToTake) >= m_Capacity)
+  {
+    return PLUS_FAIL;
+  }
+
+  m_QueuedFrames.enqueue(qMakePair(m_NextSequenceNumber++, new igsioTrackedFrame(*aTrackedFrame)));
+  m_FrameQueued.wakeOne();
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QPatternRecognitionPipeline::TakeSegmentedFrames(std::vector<SegmentedFrame>& aSegmentedFrames)
+{
+  QMutexLocker locker(&m_Mutex);
+
+  // Frames are returned in order, so a frame that is still being segmented holds back the ones after it
+  QMap<unsigned int, SegmentedFrame>::iterator frameIt = m_SegmentedFrames.find(m_NextSequenceNumberToTake);
+  while (frameIt != m_SegmentedFrames.end())
+  {
+    aSegmentedFrames.push_back(frameIt.value());
+    m_SegmentedFrames.erase(frameIt);
+    frameIt = m_SegmentedFrames.find(++m_NextSequenceNumberToTake);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool QPatternRecognitionPipeline::WaitForFrame(igsioTrackedFrame*& aTrackedFrame, unsigned int& aSequenceNumber)
+{
+  QMutexLocker locker(&m_Mutex);
+  while (m_QueuedFrames.isEmpty() && !m_StopRequested)
+  {
+    m_FrameQueued.wait(&m_Mutex);
+  }
+  if (m_StopRequested)
+  {
+    return false;
+  }
+
+  QPair<unsigned int, igsioTrackedFrame*> queuedFrame = m_QueuedFrames.dequeue();
+  aSequenceNumber = queuedFrame.first;
+  aTrackedFrame = queuedFrame.second;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void QPatternRecognitionPipeline::AddSegmentedFrame(unsigned int aSequenceNumber, const SegmentedFrame& aSegmentedFrame)
+{
+  QMutexLocker locker(&m_Mutex);
+  if (m_StopRequested)
+  {
+    delete aSegmentedFrame.Frame;
+    return;
+  }
+  m_SegmentedFrames.insert(aSequenceNumber, aSegmentedFrame);
+}
+
+//-----------------------------------------------------------------------------
+void QPatternRecognitionPipeline::DeleteFrames()
+{
+  QMutexLocker locker(&m_Mutex);
+
+  while (!m_QueuedFrames.isEmpty())
+  {
+    delete m_QueuedFrames.dequeue().second;
+  }
+
+  for (QMap<unsigned int, SegmentedFrame>::iterator frameIt = m_SegmentedFrames.begin(); frameIt != m_SegmentedFrames.end(); ++frameIt)
+  {
+    delete frameIt.value().Frame;
+  }
+  m_SegmentedFrames.clear();
+
+  m_NextSequenceNumber = 0;
+  m_NextSequenceNumberToTake = 0;
+}
@@ -0,0 +1,123 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef PATTERNRECOGNITIONPIPELINE_H
+#define PATTERNRECOGNITIONPIPELINE_H
+
+#include "PlusConfigure.h"
+
+#include <PlusFidPatternRecognition.h>
+
+#include <QMap>
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkXMLDataElement;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QPatternRecognitionPipeline
+ * \brief Segments tracked frames on a pool of worker threads
+ *
+ * The acquisition (producer) adds frames to a bounded queue, the workers (consumers) segment them, each with its own
+ * PlusFidPatternRecognition instance, and the segmented frames can be taken in the order they were added.
+ * The capacity limits the number of frames that are queued, being segmented or waiting to be taken, so the
+ * producer can leave frames in the device buffer when segmentation falls behind.
+ * \ingroup PlusAppFCal
+ */
+class QPatternRecognitionPipeline
+{
+public:
+  /*! Frame that has been processed by the pipeline */
+  struct SegmentedFrame
+  {
+    /*! Tracked frame with the segmented fiducial points, owned by the receiver */
+    igsioTrackedFrame* Frame;
+    /*! True if the pattern was found in the frame */
+    bool Segmented;
+    /*! Error reported by the pattern recognition */
+    PlusFidPatternRecognition::PatternRecognitionError Error;
+    /*! Time spent with segmenting the frame (in seconds) */
+    double SegmentationTimeSec;
+  };
+
+  QPatternRecognitionPipeline();
+  ~QPatternRecognitionPipeline();
+
+  /*!
+  * Create the workers and start processing. Discards frames of the previous run.
+  * \param aConfig Device set configuration that contains the segmentation parameters
+  * \param aNumberOfWorkers Number of segmentation threads (if less than 1 then it is determined from the number of CPU cores)
+  * \param aCapacity Maximum number of frames in the pipeline
+  */
+  PlusStatus Start(vtkXMLDataElement* aConfig, int aNumberOfWorkers, int aCapacity);
+
+  /*! Stop the workers and discard all frames that have not been taken yet */
+  void Stop();
+
+  /*! Returns true if the workers are running */
+  bool IsRunning();
+
+  /*! Number of frames that can be added without exceeding the capacity */
+  int GetNumberOfFreeSlots();
+
+  /*! Queue a copy of the frame for segmentation. Fails if the pipeline is not running or full. */
+  PlusStatus AddFrame(igsioTrackedFrame* aTrackedFrame);
+
+  /*! Take the segmented frames that are ready, in the order they were added. The caller owns the returned frames. */
+  void TakeSegmentedFrames(std::vector<SegmentedFrame>& aSegmentedFrames);
+
+protected:
+  class Worker;
+  friend class Worker;
+
+  /*! Wait for the next queued frame. Returns false if the pipeline is stopped. */
+  bool WaitForFrame(igsioTrackedFrame*& aTrackedFrame, unsigned int& aSequenceNumber);
+
+  /*! Store a processed frame */
+  void AddSegmentedFrame(unsigned int aSequenceNumber, const SegmentedFrame& aSegmentedFrame);
+
+  /*! Delete frames that have not been taken */
+  void DeleteFrames();
+
+protected:
+  /*! Workers, each one with its own pattern recognition instance */
+  std::vector<Worker*> m_Workers;
+
+  /*! Threads running the workers */
+  QThreadPool m_ThreadPool;
+
+  /*! Frames waiting for segmentation, with their sequence numbers */
+  QQueue< QPair<unsigned int, igsioTrackedFrame*> > m_QueuedFrames;
+
+  /*! Processed frames by sequence number */
+  QMap<unsigned int, SegmentedFrame> m_SegmentedFrames;
+
+  /*! Sequence number of the next frame to be added */
+  unsigned int m_NextSequenceNumber;
+
+  /*! Sequence number of the next frame to be taken */
+  unsigned int m_NextSequenceNumberToTake;
+
+  /*! Maximum number of frames in the pipeline */
+  int m_Capacity;
+
+  /*! Set when the workers have to stop */
+  bool m_StopRequested;
+
+  /*! Guards the queues */
+  QMutex m_Mutex;
+
+  /*! Signalled when a frame is queued or stop is requested */
+  QWaitCondition m_FrameQueued;
+};
+
+#endif
@@ -6,12 +6,14 @@ See License.txt for details.
 
 // Local includes
 #include "QPhantomRegistrationToolbox.h"
+#include "QPhantomRegistrationWorker.h"
 #include "fCalMainWindow.h"
 #include "vtkPlusDisplayableObject.h"
 #include "vtkPlusVisualizationController.h"
 
 // Qt includes
 #include <QFileDialog>
+#include <QThread>
 #include <QTimer>
 
 // IGSIO includes
@@ -52,6 +54,11 @@ QPhantomRegistrationToolbox::QPhantomRegistrationToolbox(fCalMainWindow* aParent
   , m_LandmarkPivotingState(LandmarkPivotingState_Incomplete)
   , m_PreviousStylusTipToReferenceTransformMatrix(vtkSmartPointer<vtkMatrix4x4>::New())
   , m_LandmarkDetected(-1)
+  , m_LandmarkRegistrationThread(NULL)
+  , m_LandmarkRegistrationWorker(NULL)
+  , m_LinearObjectPointSpacingMm(2.0)
+  , m_LinearObjectPathLengthSinceLastPointMm(0.0)
+  , m_LastSampledStylusTipToReferenceTransformMatrix(vtkSmartPointer<vtkMatrix4x4>::New())
 {
   ui.setupUi(this);
 
@@ -85,6 +92,13 @@ QPhantomRegistrationToolbox::QPhantomRegistrationToolbox(fCalMainWindow* aParent
   m_PhantomRenderer->AddActor(m_RequestedLandmarkActor);
   m_PhantomRenderer->AddActor(m_PhantomActor);
 
+  // Intermediate registrations are computed in the background so that landmark detection keeps up with the tracker
+  m_LandmarkRegistrationThread = new QThread(this);
+  m_LandmarkRegistrationWorker = new QPhantomRegistrationWorker();
+  m_LandmarkRegistrationWorker->moveToThread(m_LandmarkRegistrationThread);
+  connect(m_LandmarkRegistrationWorker, SIGNAL(ResultAvailable()), this, SLOT(LandmarkRegistrationResultAvailable()));
+  m_LandmarkRegistrationThread->start(QThread::LowPriority);
+
   // Connect events
   connect(ui.pushButton_OpenStylusCalibration, SIGNAL(clicked()), this, SLOT(OpenStylusCalibration()));
   connect(ui.pushButton_RecordPoint, SIGNAL(clicked()), this, SLOT(RecordPoint()));
@@ -105,6 +119,12 @@ QPhantomRegistrationToolbox::~QPhantomRegistrationToolbox()
 #else
   ui.canvasPhantom->renderWindow()->RemoveRenderer(m_PhantomRenderer);
 #endif
+
+  m_LandmarkRegistrationWorker->Stop();
+  m_LandmarkRegistrationThread->quit();
+  m_LandmarkRegistrationThread->wait();
+  delete m_LandmarkRegistrationWorker;
+  m_LandmarkRegistrationWorker = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -203,6 +223,16 @@ PlusStatus QPhantomRegistrationToolbox::ReadConfiguration(vtkXMLDataElement* aCo
     return PLUS_FAIL;
   }
 
+  vtkXMLDataElement* fCalElement = aConfig->FindNestedElementWithName("fCal");
+  if (fCalElement != NULL)
+  {
+    double linearObjectPointSpacingMm = 0.0;
+    if (fCalElement->GetScalarAttribute("LinearObjectRegistrationPointSpacingMm", linearObjectPointSpacingMm))
+    {
+      m_LinearObjectPointSpacingMm = linearObjectPointSpacingMm;
+    }
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -631,7 +661,22 @@ PlusStatus QPhantomRegistrationToolbox::Start()
   }
 
   vtkPlusDataCollector* dataCollector = m_ParentMainWindow->GetVisualizationController()->GetDataCollector();
-  m_LandmarkDetection->SetMinimumDistanceBetweenLandmarksMm(m_PhantomLandmarkRegistration->GetMinimunDistanceBetweenTwoLandmarksMm());
+  const double minimumDistanceBetweenLandmarksMm = m_PhantomLandmarkRegistration->GetMinimunDistanceBetweenTwoLandmarksMm();
+  m_LandmarkDetection->SetMinimumDistanceBetweenLandmarksMm(minimumDistanceBetweenLandmarksMm);
+  if (minimumDistanceBetweenLandmarksMm > 0.0)
+  {
+    m_DetectedLandmarkIndex.SetCellSizeMm(minimumDistanceBetweenLandmarksMm);
+  }
+
+  // Start is also called on activation without resetting the detection, so the index is rebuilt from the landmarks already detected
+  m_DetectedLandmarkIndex.Clear();
+  vtkPoints* detectedLandmarkPoints_Reference = m_LandmarkDetection->GetDetectedLandmarkPoints_Reference();
+  for (vtkIdType landmarkId = 0; landmarkId < detectedLandmarkPoints_Reference->GetNumberOfPoints(); ++landmarkId)
+  {
+    double landmark_Reference[3] = {0, 0, 0};
+    detectedLandmarkPoints_Reference->GetPoint(landmarkId, landmark_Reference);
+    m_DetectedLandmarkIndex.InsertPoint(landmarkId, landmark_Reference);
+  }
 
   if (dataCollector)
   {
@@ -777,6 +822,7 @@ void QPhantomRegistrationToolbox::RecordPoint()
   {
     return;
   }
+  m_DetectedLandmarkIndex.InsertPoint(m_LandmarkDetection->GetDetectedLandmarkPoints_Reference()->GetNumberOfPoints() - 1, stylusTipPosition_Reference);
 
   // Add recorded point to registration algorithm
   m_PhantomLandmarkRegistration->GetRecordedLandmarks_Reference()->InsertPoint(m_CurrentLandmarkIndex, stylusTipPosition_Reference[0], stylusTipPosition_Reference[1], stylusTipPosition_Reference[2]);
@@ -861,6 +907,9 @@ void QPhantomRegistrationToolbox::Undo()
       ui.tabWidget->setTabEnabled(1, true);
     }
 
+    // A background registration of the current landmarks must not overwrite the registration of the remaining ones
+    m_LandmarkRegistrationWorker->Stop();
+
     // Decrease current landmark index
     --m_CurrentLandmarkIndex;
 
@@ -870,6 +919,7 @@ void QPhantomRegistrationToolbox::Undo()
     // Delete previously acquired landmark
     m_ParentMainWindow->GetVisualizationController()->GetResultPolyDataPoints()->GetData()->RemoveTuple(m_CurrentLandmarkIndex);
     m_ParentMainWindow->GetVisualizationController()->GetResultPolyDataPoints()->Modified();
+    m_DetectedLandmarkIndex.RemovePoint(m_LandmarkDetection->GetDetectedLandmarkPoints_Reference()->GetNumberOfPoints() - 1);
     m_LandmarkDetection->DeleteLastLandmark();
 
     // Highlight previous landmark in left side render
@@ -936,7 +986,9 @@ void QPhantomRegistrationToolbox::Reset()
 
   //In case the reset stops the detection as well.
   //StopLandmarkPivotingRegistration();
+  m_LandmarkRegistrationWorker->Stop();
   m_LandmarkDetection->ResetDetection();
+  m_DetectedLandmarkIndex.Clear();
   if (m_LandmarkPivotingState == LandmarkPivotingState_Complete)
   {
     SetLandmarkPivotingState(LandmarkPivotingState_Incomplete);
@@ -1019,6 +1071,16 @@ void QPhantomRegistrationToolbox::StartLinearObjectRegistration()
     return;
   }
 
+  // Record the stylus tip poses from now on
+  igsioTransformName stylusTipToReferenceTransformName(m_PhantomLinearObjectRegistration->GetStylusTipCoordinateFrame(), m_PhantomLinearObjectRegistration->GetReferenceCoordinateFrame());
+  if (m_LinearObjectSampler.Reset(m_ParentMainWindow->GetVisualizationController()->GetSelectedChannel(),
+                                  m_ParentMainWindow->GetVisualizationController()->GetTransformRepository(), stylusTipToReferenceTransformName) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to start stylus tip position recording!");
+    return;
+  }
+  m_LinearObjectPathLengthSinceLastPointMm = 0.0;
+
   // Set state to in progress
   SetLinearObjectRegistrationState(LinearObjectRegistrationState_InProgress);
 
@@ -1102,6 +1164,13 @@ void QPhantomRegistrationToolbox::StartLandmarkDetectionRegistration()
       return;
     }
 
+    // The registration worker keeps its own copy of the algorithm and of the persistent transforms for the whole detection
+    if (m_LandmarkRegistrationWorker->Start(vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData(), m_ParentMainWindow->GetVisualizationController()->GetTransformRepository()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to start background phantom landmark registration!");
+      return;
+    }
+
     // Set state to in progress
     SetLandmarkPivotingState(LandmarkPivotingState_InProgress);
   }
@@ -1121,6 +1190,8 @@ void QPhantomRegistrationToolbox::StopLandmarkPivotingRegistration()
 
   // Disconnect acquisition function to timer
   disconnect(&m_ParentMainWindow->GetVisualizationController()->GetAcquisitionTimer(), SIGNAL(timeout()), this, SLOT(AddStylusTipTransformToLandmarkPivotingRegistration()));
+  // The final registration is computed below, intermediate results are not needed anymore
+  m_LandmarkRegistrationWorker->Stop();
   if (m_CurrentLandmarkIndex > 2)
   {
     if (m_PhantomLandmarkRegistration->LandmarkRegister(m_ParentMainWindow->GetVisualizationController()->GetTransformRepository()) != PLUS_SUCCESS)
@@ -1194,7 +1265,8 @@ void QPhantomRegistrationToolbox::AddStylusTipTransformToLandmarkPivotingRegistr
     ss << sylusTip_Reference[0] << " " << sylusTip_Reference[1] << " " << sylusTip_Reference[2];
     m_StylusPositionString = QString(ss.str().c_str());
 
-    m_LandmarkDetected = m_LandmarkDetection->GetNearExistingLandmarkId(sylusTip_Reference);
+    // Same criterion as vtkPlusLandmarkDetectionAlgo::GetNearExistingLandmarkId, but only the landmarks in the neighboring grid cells are checked
+    m_LandmarkDetected = m_DetectedLandmarkIndex.FindClosestPointWithinRadius(sylusTip_Reference, m_PhantomLandmarkRegistration->GetMinimunDistanceBetweenTwoLandmarksMm());
     if (m_LandmarkDetected >= 0)
     {
       LOG_DEBUG("There is a Landmark detected close to the stylus tip position.");
@@ -1210,6 +1282,7 @@ void QPhantomRegistrationToolbox::AddStylusTipTransformToLandmarkPivotingRegistr
       double landmarkDetected_Reference[4] = {0, 0, 0, 1};
       LOG_DEBUG("\n" << m_LandmarkDetection->GetDetectedLandmarksString() << "\n");
       m_LandmarkDetection->GetDetectedLandmarkPoints_Reference()->GetPoint(m_LandmarkDetection->GetDetectedLandmarkPoints_Reference()->GetNumberOfPoints() - 1, landmarkDetected_Reference);
+      m_DetectedLandmarkIndex.InsertPoint(m_LandmarkDetection->GetDetectedLandmarkPoints_Reference()->GetNumberOfPoints() - 1, landmarkDetected_Reference);
 
       // Add recorded point to visualization input if fulfills the criteria
       vtkPoints* detectedLandmarks_Reference = m_ParentMainWindow->GetVisualizationController()->GetResultPolyDataPoints();
@@ -1228,19 +1301,21 @@ void QPhantomRegistrationToolbox::AddStylusTipTransformToLandmarkPivotingRegistr
       // If there are at least 3 acquired landmarks then register
       if (m_CurrentLandmarkIndex >= 3)
       {
-        if (m_PhantomLandmarkRegistration->LandmarkRegister(m_ParentMainWindow->GetVisualizationController()->GetTransformRepository()) == PLUS_SUCCESS)
-        {
-          m_ParentMainWindow->GetVisualizationController()->ShowObjectById(m_ParentMainWindow->GetPhantomModelId(), true);
-          m_ParentMainWindow->GetVisualizationController()->ShowObjectById(m_ParentMainWindow->GetPhantomWiresModelId(), true);
-        }
-        else
-        {
-          LOG_ERROR("Phantom landmark registration failed!");
-        }
-
         //stop registration
         if (newLandmarkDetected == numberOfExpectedLandmarks)
         {
+          // The final registration is saved in the configuration, so it is computed right away
+          m_LandmarkRegistrationWorker->Stop();
+          if (m_PhantomLandmarkRegistration->LandmarkRegister(m_ParentMainWindow->GetVisualizationController()->GetTransformRepository()) == PLUS_SUCCESS)
+          {
+            m_ParentMainWindow->GetVisualizationController()->ShowObjectById(m_ParentMainWindow->GetPhantomModelId(), true);
+            m_ParentMainWindow->GetVisualizationController()->ShowObjectById(m_ParentMainWindow->GetPhantomWiresModelId(), true);
+          }
+          else
+          {
+            LOG_ERROR("Phantom landmark registration failed!");
+          }
+
           ui.tabWidget->setTabEnabled(1, false);
           if (m_ParentMainWindow->GetVisualizationController()->GetTransformRepository()->WriteConfiguration(vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData()) != PLUS_SUCCESS)
           {
@@ -1260,10 +1335,8 @@ void QPhantomRegistrationToolbox::AddStylusTipTransformToLandmarkPivotingRegistr
         }
         else
         {
-          // Set the camera to face the new pivot to be found
-          m_ParentMainWindow->GetVisualizationController()->ShowInput(true);
-          SetCameraViewAndHighlightNextLandmark(m_ParentMainWindow->GetVisualizationController()->GetCanvasRenderer()->GetActiveCamera(), m_PhantomLandmarkRegistration,
-                                                m_CurrentLandmarkIndex, m_ParentMainWindow->GetVisualizationController()->GetInputPolyDataPoints());
+          // Register in the background, the camera is set to face the new pivot to be found when the result is available
+          m_LandmarkRegistrationWorker->RequestRegistration(m_PhantomLandmarkRegistration->GetRecordedLandmarks_Reference());
         }
       }
       else
@@ -1282,82 +1355,139 @@ void QPhantomRegistrationToolbox::AddStylusTipTransformToLandmarkPivotingRegistr
   }
 }
 
+//-----------------------------------------------------------------------------
+void QPhantomRegistrationToolbox::LandmarkRegistrationResultAvailable()
+{
+  LOG_TRACE("PhantomRegistrationToolbox::LandmarkRegistrationResultAvailable");
+
+  QPhantomRegistrationWorker::Result result = m_LandmarkRegistrationWorker->GetLatestResult();
+  if (result.NumberOfLandmarks == 0 || m_LandmarkPivotingState != LandmarkPivotingState_InProgress || ToolboxState_InProgress != GetState())
+  {
+    // Detection has been stopped or restarted since the registration was requested
+    return;
+  }
+  if (result.NumberOfLandmarks != m_CurrentLandmarkIndex)
+  {
+    // Landmarks have been detected or undone since the registration was requested, the result is not current
+    LOG_DEBUG("Phantom landmark registration result of " << result.NumberOfLandmarks << " landmarks is ignored, there are " << m_CurrentLandmarkIndex << " landmarks now");
+    return;
+  }
+  if (!result.Valid)
+  {
+    LOG_ERROR("Phantom landmark registration failed!");
+    return;
+  }
+
+  // Only the phantom to reference transform is taken over from the worker's repository copy, the other transforms
+  // of the live repository may have changed since detection started
+  vtkIGSIOTransformRepository* transformRepository = m_ParentMainWindow->GetVisualizationController()->GetTransformRepository();
+  igsioTransformName phantomToReferenceTransformName(m_PhantomLandmarkRegistration->GetPhantomCoordinateFrame(), m_PhantomLandmarkRegistration->GetReferenceCoordinateFrame());
+  if (transformRepository->SetTransform(phantomToReferenceTransformName, result.PhantomToReferenceTransformMatrix) != PLUS_SUCCESS
+      || transformRepository->SetTransformPersistent(phantomToReferenceTransformName, true) != PLUS_SUCCESS
+      || transformRepository->SetTransformError(phantomToReferenceTransformName, result.RegistrationErrorMm) != PLUS_SUCCESS
+      || transformRepository->SetTransformDate(phantomToReferenceTransformName, result.RegistrationDate.c_str()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set phantom landmark registration result in the transform repository!");
+    return;
+  }
+  m_PhantomLandmarkRegistration->SetPhantomToReferenceTransformMatrix(result.PhantomToReferenceTransformMatrix);
+
+  m_ParentMainWindow->GetVisualizationController()->ShowObjectById(m_ParentMainWindow->GetPhantomModelId(), true);
+  m_ParentMainWindow->GetVisualizationController()->ShowObjectById(m_ParentMainWindow->GetPhantomWiresModelId(), true);
+
+  if (m_CurrentLandmarkIndex < m_PhantomLandmarkRegistration->GetDefinedLandmarks_Phantom()->GetNumberOfPoints())
+  {
+    // Set the camera to face the new pivot to be found
+    m_ParentMainWindow->GetVisualizationController()->ShowInput(true);
+    SetCameraViewAndHighlightNextLandmark(m_ParentMainWindow->GetVisualizationController()->GetCanvasRenderer()->GetActiveCamera(), m_PhantomLandmarkRegistration,
+                                          m_CurrentLandmarkIndex, m_ParentMainWindow->GetVisualizationController()->GetInputPolyDataPoints());
+  }
+}
+
 //-----------------------------------------------------------------------------
 void QPhantomRegistrationToolbox::AddStylusTipTransformToLinearObjectRegistration()
 {
   LOG_TRACE("PhantomRegistrationToolbox::AddStylusTipPositionToLinearObjectRegistration");
 
-  // Get stylus tip position
-  vtkSmartPointer<vtkMatrix4x4> stylusTipToReferenceTransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  ToolStatus status(TOOL_INVALID);
-  if (m_ParentMainWindow->GetVisualizationController()->GetTransformMatrix(m_PhantomLinearObjectRegistration->GetStylusTipCoordinateFrame(), m_PhantomLinearObjectRegistration->GetReferenceCoordinateFrame(), stylusTipToReferenceTransformMatrix, &status) != PLUS_SUCCESS)
+  // Get all stylus tip positions that the tracker recorded since the previous acquisition
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > stylusTipToReferenceTransformMatrices;
+  if (m_LinearObjectSampler.GetNewSamples(stylusTipToReferenceTransformMatrices) == 0)
   {
-    LOG_ERROR("No transform found between stylus tip and reference!");
     return;
   }
 
-  if (status == TOOL_OK)
-  {
-    // Assemble position string for toolbox
-    std::stringstream ss;
-    ss << stylusTipToReferenceTransformMatrix->GetElement(0, 3) << " " << stylusTipToReferenceTransformMatrix->GetElement(1, 3) << " " << stylusTipToReferenceTransformMatrix->GetElement(2, 3);
-    m_StylusPositionString = QString(ss.str().c_str());
+  // Assemble position string for toolbox
+  vtkMatrix4x4* latestStylusTipToReferenceTransformMatrix = stylusTipToReferenceTransformMatrices.back();
+  std::stringstream ss;
+  ss << latestStylusTipToReferenceTransformMatrix->GetElement(0, 3) << " " << latestStylusTipToReferenceTransformMatrix->GetElement(1, 3) << " " << latestStylusTipToReferenceTransformMatrix->GetElement(2, 3);
+  m_StylusPositionString = QString(ss.str().c_str());
 
-    // Add point to the input if fulfills the criteria
-    vtkPoints* points = m_ParentMainWindow->GetVisualizationController()->GetResultPolyDataPoints();
+  double positionDifferenceHighThresholdMm = 500.0;
+  double orientationDifferenceLowThresholdDegrees = 2.0;
+  double orientationDifferenceHighThresholdDegrees = 90.0;
 
-    double positionDifferenceLowThresholdMm = 2.0;
-    double positionDifferenceHighThresholdMm = 500.0;
-    double positionDifferenceMm = -1.0;
-    double orientationDifferenceLowThresholdDegrees = 2.0;
-    double orientationDifferenceHighThresholdDegrees = 90.0;
-    double orientationDifferenceDegrees = -1.0;
+  // Keep only the samples that are at least the point spacing apart along the stylus tip path (or rotated the stylus), so
+  // the points are uniformly distributed along the traced lines regardless of the stylus speed
+  std::vector<vtkMatrix4x4*> recordedTransformMatrices;
+  for (std::vector<vtkSmartPointer<vtkMatrix4x4> >::iterator matrixIt = stylusTipToReferenceTransformMatrices.begin(); matrixIt != stylusTipToReferenceTransformMatrices.end(); ++matrixIt)
+  {
+    vtkMatrix4x4* stylusTipToReferenceTransformMatrix = *matrixIt;
 
     //TODO: make sure that when you switch planes you are recording, all the new points are not treated as outliers
-    if (m_CurrentPointNumber < 1)
+    if (m_CurrentPointNumber < 1 && recordedTransformMatrices.empty())
     {
       // Always allow
-      positionDifferenceMm = (positionDifferenceLowThresholdMm + positionDifferenceHighThresholdMm) / 2.0;
-      orientationDifferenceDegrees = (orientationDifferenceLowThresholdDegrees + orientationDifferenceHighThresholdDegrees) / 2.0;
-    }
-    else
-    {
-      // Compute position and orientation difference of current and previous positions
-      positionDifferenceMm = igsioMath::GetPositionDifference(stylusTipToReferenceTransformMatrix, m_PreviousStylusTipToReferenceTransformMatrix);
-      orientationDifferenceDegrees = igsioMath::GetOrientationDifference(stylusTipToReferenceTransformMatrix, m_PreviousStylusTipToReferenceTransformMatrix);
+      recordedTransformMatrices.push_back(stylusTipToReferenceTransformMatrix);
+      m_LastSampledStylusTipToReferenceTransformMatrix->DeepCopy(stylusTipToReferenceTransformMatrix);
+      m_PreviousStylusTipToReferenceTransformMatrix->DeepCopy(stylusTipToReferenceTransformMatrix);
+      m_LinearObjectPathLengthSinceLastPointMm = 0.0;
+      continue;
     }
 
-    // If current point is close to the previous one, or too far (outlier), we do not insert it
-    if (positionDifferenceMm < orientationDifferenceLowThresholdDegrees && orientationDifferenceDegrees < orientationDifferenceLowThresholdDegrees)
-    {
-      LOG_DEBUG("Acquired position is too close to the previous - it is skipped");
-    }
-    else if (positionDifferenceMm > positionDifferenceHighThresholdMm || orientationDifferenceDegrees > orientationDifferenceHighThresholdDegrees)
+    double stepLengthMm = igsioMath::GetPositionDifference(stylusTipToReferenceTransformMatrix, m_LastSampledStylusTipToReferenceTransformMatrix);
+    double orientationDifferenceDegrees = igsioMath::GetOrientationDifference(stylusTipToReferenceTransformMatrix, m_PreviousStylusTipToReferenceTransformMatrix);
+    if (stepLengthMm > positionDifferenceHighThresholdMm || orientationDifferenceDegrees > orientationDifferenceHighThresholdDegrees)
     {
       LOG_DEBUG("Acquired position seems to be an outlier - it is skipped");
+      continue;
     }
-    else
+    m_LastSampledStylusTipToReferenceTransformMatrix->DeepCopy(stylusTipToReferenceTransformMatrix);
+    m_LinearObjectPathLengthSinceLastPointMm += stepLengthMm;
+
+    if (m_LinearObjectPathLengthSinceLastPointMm < m_LinearObjectPointSpacingMm && orientationDifferenceDegrees < orientationDifferenceLowThresholdDegrees)
     {
-      // Add the point into the registration dataset
-      m_PhantomLinearObjectRegistration->InsertNextCalibrationPoint(stylusTipToReferenceTransformMatrix);
+      // Too close to the previous point along the path
+      continue;
+    }
 
-      // Add to polydata for rendering
-      points->InsertPoint(m_CurrentPointNumber, stylusTipToReferenceTransformMatrix->GetElement(0, 3), stylusTipToReferenceTransformMatrix->GetElement(1, 3), stylusTipToReferenceTransformMatrix->GetElement(2, 3));
-      points->Modified();
+    recordedTransformMatrices.push_back(stylusTipToReferenceTransformMatrix);
+    m_PreviousStylusTipToReferenceTransformMatrix->DeepCopy(stylusTipToReferenceTransformMatrix);
+    m_LinearObjectPathLengthSinceLastPointMm = 0.0;
+  }
 
-      // Set new current point number
-      ++m_CurrentPointNumber;
+  if (recordedTransformMatrices.empty())
+  {
+    return;
+  }
 
-      // Reset the camera once in a while
-      if ((m_CurrentPointNumber > 0) && ((m_CurrentPointNumber % 10 == 0) || (m_CurrentPointNumber == 5)))
-      {
-        m_ParentMainWindow->GetVisualizationController()->GetCanvasRenderer()->ResetCamera();
-      }
+  // Add the points into the registration dataset and to the polydata for rendering
+  vtkPoints* points = m_ParentMainWindow->GetVisualizationController()->GetResultPolyDataPoints();
+  int previousPointNumber = m_CurrentPointNumber;
+  for (std::vector<vtkMatrix4x4*>::iterator matrixIt = recordedTransformMatrices.begin(); matrixIt != recordedTransformMatrices.end(); ++matrixIt)
+  {
+    m_PhantomLinearObjectRegistration->InsertNextCalibrationPoint(*matrixIt);
+    points->InsertPoint(m_CurrentPointNumber, (*matrixIt)->GetElement(0, 3), (*matrixIt)->GetElement(1, 3), (*matrixIt)->GetElement(2, 3));
+    ++m_CurrentPointNumber;
+  }
+  points->Modified();
 
-      //TODO: if there are more than 3 planes recorded, try to add a visualization of the phantom to the GUI
-      m_PreviousStylusTipToReferenceTransformMatrix->DeepCopy(stylusTipToReferenceTransformMatrix);
-    }
+  // Reset the camera once in a while
+  if ((previousPointNumber < 5 && m_CurrentPointNumber >= 5) || (previousPointNumber / 10 != m_CurrentPointNumber / 10))
+  {
+    m_ParentMainWindow->GetVisualizationController()->GetCanvasRenderer()->ResetCamera();
   }
+
+  //TODO: if there are more than 3 planes recorded, try to add a visualization of the phantom to the GUI
 }
 
 //-----------------------------------------------------------------------------
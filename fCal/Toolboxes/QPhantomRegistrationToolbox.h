@@ -11,6 +11,8 @@ See License.txt for details.
 
 #include "QAbstractToolbox.h"
 #include "PlusConfigure.h"
+#include "PlusPointGridIndex.h"
+#include "PlusTrackerPoseSampler.h"
 
 #include <QWidget>
 
@@ -20,6 +22,8 @@ class vtkPlusLandmarkDetectionAlgo;
 class vtkActor;
 class vtkPolyData;
 class vtkRenderer;
+class QPhantomRegistrationWorker;
+class QThread;
 
 enum TabIndex
 {
@@ -189,6 +193,11 @@ protected slots:
   */
   void AddStylusTipTransformToLandmarkPivotingRegistration();
 
+  /*!
+  Slot handling a new intermediate landmark registration computed by the registration worker
+  */
+  void LandmarkRegistrationResultAvailable();
+
 protected:
   /*! Phantom landmark registration algorithm */
   vtkSmartPointer<vtkPlusPhantomLandmarkRegistrationAlgo>     m_PhantomLandmarkRegistration;
@@ -202,6 +211,15 @@ protected:
   /*! Landmark already detected */
   int                                     m_LandmarkDetected;
 
+  /*! Spatial index of the detected landmarks (identifiers are the landmark indices), cell size is the minimum distance between landmarks */
+  PlusPointGridIndex                      m_DetectedLandmarkIndex;
+
+  /*! Thread computing the intermediate landmark registrations during landmark detection */
+  QThread*                                m_LandmarkRegistrationThread;
+
+  /*! Computes the intermediate landmark registrations in m_LandmarkRegistrationThread */
+  QPhantomRegistrationWorker*             m_LandmarkRegistrationWorker;
+
   /*! Renderer for the canvas */
   vtkSmartPointer<vtkRenderer>            m_PhantomRenderer;
 
@@ -236,6 +254,18 @@ protected:
   /*! Previous stylus tip to reference transform matrix to determine the difference at each point acquisition */
   vtkSmartPointer<vtkMatrix4x4>           m_PreviousStylusTipToReferenceTransformMatrix;
 
+  /*! Collects all stylus tip poses recorded by the tracker during linear object registration */
+  PlusTrackerPoseSampler                  m_LinearObjectSampler;
+
+  /*! Minimum length of the stylus tip path between two recorded linear object registration points */
+  double                                  m_LinearObjectPointSpacingMm;
+
+  /*! Length of the stylus tip path since the last recorded linear object registration point */
+  double                                  m_LinearObjectPathLengthSinceLastPointMm;
+
+  /*! Latest stylus tip to reference transform sample (recorded or not) for computing the path length */
+  vtkSmartPointer<vtkMatrix4x4>           m_LastSampledStylusTipToReferenceTransformMatrix;
+
 protected:
   Ui::PhantomRegistrationToolbox ui;
 
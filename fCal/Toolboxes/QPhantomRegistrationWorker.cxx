@@ -0,0 +1,164 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "QPhantomRegistrationWorker.h"
+
+// PlusLib includes
+#include <vtkIGSIOAccurateTimer.h>
+#include <vtkIGSIOTransformRepository.h>
+#include <vtkPlusPhantomLandmarkRegistrationAlgo.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkPoints.h>
+
+// Qt includes
+#include <QMutexLocker>
+
+//-----------------------------------------------------------------------------
+QPhantomRegistrationWorker::Result::Result()
+  : Valid(false)
+  , NumberOfLandmarks(0)
+  , PhantomToReferenceTransformMatrix(NULL)
+  , RegistrationErrorMm(0.0)
+{
+}
+
+//-----------------------------------------------------------------------------
+QPhantomRegistrationWorker::QPhantomRegistrationWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_Registration(NULL)
+  , m_TransformRepository(vtkSmartPointer<vtkIGSIOTransformRepository>::New())
+  , m_PendingLandmarks_Reference(NULL)
+  , m_RequestQueued(false)
+  , m_Generation(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+QPhantomRegistrationWorker::~QPhantomRegistrationWorker()
+{
+  Stop();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QPhantomRegistrationWorker::Start(vtkXMLDataElement* aConfig, vtkIGSIOTransformRepository* aTransformRepository)
+{
+  LOG_TRACE("QPhantomRegistrationWorker::Start");
+
+  Stop();
+
+  // Wait for the registration of the previous run to finish
+  QMutexLocker computationLocker(&m_ComputationMutex);
+
+  m_Registration = vtkSmartPointer<vtkPlusPhantomLandmarkRegistrationAlgo>::New();
+  if (m_Registration->ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read phantom registration configuration for background registration");
+    m_Registration = NULL;
+    return PLUS_FAIL;
+  }
+
+  m_TransformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (m_TransformRepository->DeepCopy(aTransformRepository, true) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to copy transform repository for background phantom registration");
+    m_Registration = NULL;
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QPhantomRegistrationWorker::Stop()
+{
+  QMutexLocker locker(&m_Mutex);
+  ++m_Generation;
+  m_PendingLandmarks_Reference = NULL;
+  m_LatestResult = Result();
+}
+
+//-----------------------------------------------------------------------------
+void QPhantomRegistrationWorker::RequestRegistration(vtkPoints* aRecordedLandmarks_Reference)
+{
+  if (aRecordedLandmarks_Reference == NULL)
+  {
+    return;
+  }
+
+  QMutexLocker locker(&m_Mutex);
+  m_PendingLandmarks_Reference = vtkSmartPointer<vtkPoints>::New();
+  m_PendingLandmarks_Reference->DeepCopy(aRecordedLandmarks_Reference);
+  if (!m_RequestQueued)
+  {
+    m_RequestQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessRegistrationRequest", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+QPhantomRegistrationWorker::Result QPhantomRegistrationWorker::GetLatestResult()
+{
+  QMutexLocker locker(&m_Mutex);
+  return m_LatestResult;
+}
+
+//-----------------------------------------------------------------------------
+void QPhantomRegistrationWorker::ProcessRegistrationRequest()
+{
+  QMutexLocker computationLocker(&m_ComputationMutex);
+
+  vtkSmartPointer<vtkPoints> landmarks_Reference;
+  unsigned int generation = 0;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_RequestQueued = false;
+    landmarks_Reference = m_PendingLandmarks_Reference;
+    m_PendingLandmarks_Reference = NULL;
+    generation = m_Generation;
+  }
+
+  if (m_Registration.GetPointer() == NULL || landmarks_Reference.GetPointer() == NULL)
+  {
+    return;
+  }
+
+  LOG_TRACE("QPhantomRegistrationWorker::ProcessRegistrationRequest(" << landmarks_Reference->GetNumberOfPoints() << " landmarks)");
+
+  Result result;
+  result.NumberOfLandmarks = landmarks_Reference->GetNumberOfPoints();
+
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  m_Registration->GetRecordedLandmarks_Reference()->DeepCopy(landmarks_Reference);
+  m_Registration->GetRecordedLandmarks_Reference()->Modified();
+  result.PhantomToReferenceTransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  igsioTransformName phantomToReferenceTransformName(m_Registration->GetPhantomCoordinateFrame(), m_Registration->GetReferenceCoordinateFrame());
+  if (m_Registration->LandmarkRegister(m_TransformRepository) == PLUS_SUCCESS
+      && m_TransformRepository->GetTransform(phantomToReferenceTransformName, result.PhantomToReferenceTransformMatrix) == PLUS_SUCCESS
+      && m_TransformRepository->GetTransformError(phantomToReferenceTransformName, result.RegistrationErrorMm) == PLUS_SUCCESS
+      && m_TransformRepository->GetTransformDate(phantomToReferenceTransformName, result.RegistrationDate) == PLUS_SUCCESS)
+  {
+    result.Valid = true;
+  }
+  else
+  {
+    LOG_DEBUG("Background phantom registration failed with " << result.NumberOfLandmarks << " landmarks");
+  }
+  LOG_DEBUG("Background phantom registration with " << result.NumberOfLandmarks << " landmarks took " << (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) * 1000.0 << " ms");
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (generation != m_Generation)
+    {
+      // Stopped while computing
+      return;
+    }
+    m_LatestResult = result;
+  }
+
+  emit ResultAvailable();
+}
@@ -0,0 +1,111 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef PHANTOMREGISTRATIONWORKER_H
+#define PHANTOMREGISTRATIONWORKER_H
+
+#include "PlusConfigure.h"
+
+#include <vtkSmartPointer.h>
+
+#include <QMutex>
+#include <QObject>
+
+#include <string>
+
+class vtkIGSIOTransformRepository;
+class vtkMatrix4x4;
+class vtkPlusPhantomLandmarkRegistrationAlgo;
+class vtkPoints;
+class vtkXMLDataElement;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QPhantomRegistrationWorker
+ * \brief Computes the intermediate phantom landmark registrations of landmark detection on a worker thread
+ *
+ * The landmarks recorded so far are submitted from the GUI thread each time a new landmark is detected. The
+ * registration is computed in the thread the worker is moved to. Requests are coalesced: if landmarks are submitted
+ * faster than the registration can be computed then only the latest landmark set is registered. The registration
+ * algorithm and the transform repository copy are configured once in Start and reused by all the registrations of
+ * the run.
+ * \ingroup PlusAppFCal
+ */
+class QPhantomRegistrationWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  /*! Result of a registration */
+  struct Result
+  {
+    Result();
+    /*! True if the registration succeeded */
+    bool Valid;
+    /*! Number of recorded landmarks that were registered */
+    int NumberOfLandmarks;
+    /*! Phantom to reference transform, as written to the repository copy by the registration algorithm */
+    vtkSmartPointer<vtkMatrix4x4> PhantomToReferenceTransformMatrix;
+    /*! Registration error (in mm), as written to the repository copy by the registration algorithm */
+    double RegistrationErrorMm;
+    /*! Registration date, as written to the repository copy by the registration algorithm */
+    std::string RegistrationDate;
+  };
+
+  QPhantomRegistrationWorker(QObject* aParent = NULL);
+  ~QPhantomRegistrationWorker();
+
+  /*!
+  * Discard results of the previous run and prepare a new one. Call from the GUI thread.
+  * \param aConfig Device set configuration that contains the phantom definition
+  * \param aTransformRepository Transform repository with the persistent transforms, a copy is made
+  */
+  PlusStatus Start(vtkXMLDataElement* aConfig, vtkIGSIOTransformRepository* aTransformRepository);
+
+  /*! Discard the pending request, the registration in progress (if any) is ignored */
+  void Stop();
+
+  /*! Request the registration of a copy of the recorded landmarks. Replaces the pending request, if any. */
+  void RequestRegistration(vtkPoints* aRecordedLandmarks_Reference);
+
+  /*! Get the latest result */
+  Result GetLatestResult();
+
+signals:
+  /*! Emitted when a new result is available (see GetLatestResult) */
+  void ResultAvailable();
+
+protected slots:
+  /*! Register the latest submitted landmarks (executed in the worker thread) */
+  void ProcessRegistrationRequest();
+
+protected:
+  /*! Registration algorithm, used only by the worker thread while running */
+  vtkSmartPointer<vtkPlusPhantomLandmarkRegistrationAlgo> m_Registration;
+
+  /*! Copy of the transform repository, used only by the worker thread while running */
+  vtkSmartPointer<vtkIGSIOTransformRepository> m_TransformRepository;
+
+  /*! Latest submitted landmarks that are not registered yet (NULL if there is no pending request) */
+  vtkSmartPointer<vtkPoints> m_PendingLandmarks_Reference;
+
+  /*! Flag indicating that a request is queued in the worker thread */
+  bool m_RequestQueued;
+
+  /*! Latest result */
+  Result m_LatestResult;
+
+  /*! Incremented on start and stop, so that results of an old run are discarded */
+  unsigned int m_Generation;
+
+  /*! Guards the pending landmarks, the latest result and the request */
+  QMutex m_Mutex;
+
+  /*! Held while a registration is computed, so the algorithm is not reconfigured during computation */
+  QMutex m_ComputationMutex;
+};
+
+#endif
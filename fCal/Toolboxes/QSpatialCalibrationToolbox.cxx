@@ -5,6 +5,10 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 // Local includes
+#include "PlusCalibrationFrameSelector.h"
+#include "PlusTransformStatusFilter.h"
+#include "QIncrementalCalibrationWorker.h"
+#include "QPatternRecognitionPipeline.h"
 #include "QSpatialCalibrationToolbox.h"
 #include "fCalMainWindow.h"
 #include "vtkPlusDisplayableObject.h"
@@ -18,6 +22,7 @@ See License.txt for details.
 #include <vtkPlusDevice.h>
 #include <vtkPlusProbeCalibrationAlgo.h>
 #include <vtkIGSIOTrackedFrameList.h>
+#include <vtkIGSIOTransformRepository.h>
 
 // VTK includes
 #include <vtkPoints.h>
@@ -26,6 +31,7 @@ See License.txt for details.
 
 // Qt includes
 #include <QFileDialog>
+#include <QThread>
 #include <QTimer>
 
 //-----------------------------------------------------------------------------
@@ -34,8 +40,16 @@ QSpatialCalibrationToolbox::QSpatialCalibrationToolbox(fCalMainWindow* aParentMa
   , QWidget(aParentMainWindow, aFlags)
   , m_Calibration(vtkSmartPointer<vtkPlusProbeCalibrationAlgo>::New())
   , m_PatternRecognition(new PlusFidPatternRecognition())
+  , m_SegmentationPipeline(new QPatternRecognitionPipeline())
+  , m_FrameSelector(new PlusCalibrationFrameSelector())
+  , m_FrameSelectionEnabled(false)
+  , m_NumberOfSkippedCalibrationImages(0)
+  , m_IncrementalCalibrationThread(NULL)
+  , m_IncrementalCalibrationWorker(NULL)
+  , m_IncrementalCalibrationEnabled(false)
   , m_SpatialCalibrationData(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New())
   , m_SpatialValidationData(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New())
+  , m_TransformStatusFilter(new PlusTransformStatusFilter())
   , m_CancelRequest(false)
   , m_LastRecordedFrameTimestamp(UNDEFINED_TIMESTAMP)
   , m_FreeHandStartupDelaySec(5)
@@ -46,8 +60,9 @@ QSpatialCalibrationToolbox::QSpatialCalibrationToolbox(fCalMainWindow* aParentMa
   , m_NumberOfSegmentedCalibrationImages(0)
   , m_NumberOfSegmentedValidationImages(0)
   , m_RecordingIntervalMs(200)
-  , m_MaxTimeSpentWithProcessingMs(150)
-  , m_LastProcessingTimePerFrameMs(-1)
+  , m_NumberOfSegmentationThreads(0)
+  , m_SegmentationQueueLength(32)
+  , m_ProbeToPhantomTransformValid(false)
 {
   ui.setupUi(this);
 
@@ -60,6 +75,13 @@ QSpatialCalibrationToolbox::QSpatialCalibrationToolbox(fCalMainWindow* aParentMa
   // Set up timer to wait before acquisition
   m_StartupDelayTimer = new QTimer(this);
 
+  // Calibration estimate is updated in a worker thread so that acquisition is not delayed
+  m_IncrementalCalibrationThread = new QThread(this);
+  m_IncrementalCalibrationWorker = new QIncrementalCalibrationWorker();
+  m_IncrementalCalibrationWorker->moveToThread(m_IncrementalCalibrationThread);
+  connect(m_IncrementalCalibrationWorker, SIGNAL(EstimateAvailable()), this, SLOT(IncrementalCalibrationEstimateAvailable()));
+  m_IncrementalCalibrationThread->start();
+
   // Connect events
   connect(ui.pushButton_OpenPhantomRegistration, SIGNAL(clicked()), this, SLOT(OpenPhantomRegistration()));
   connect(ui.pushButton_OpenSegmentationParameters, SIGNAL(clicked()), this, SLOT(OpenSegmentationParameters()));
@@ -71,6 +93,30 @@ QSpatialCalibrationToolbox::QSpatialCalibrationToolbox(fCalMainWindow* aParentMa
 //-----------------------------------------------------------------------------
 QSpatialCalibrationToolbox::~QSpatialCalibrationToolbox()
 {
+  m_IncrementalCalibrationWorker->Stop();
+  m_IncrementalCalibrationThread->quit();
+  m_IncrementalCalibrationThread->wait();
+  delete m_IncrementalCalibrationWorker;
+  m_IncrementalCalibrationWorker = NULL;
+
+  if (m_SegmentationPipeline != NULL)
+  {
+    delete m_SegmentationPipeline;
+    m_SegmentationPipeline = NULL;
+  }
+
+  if (m_FrameSelector != NULL)
+  {
+    delete m_FrameSelector;
+    m_FrameSelector = NULL;
+  }
+
+  if (m_TransformStatusFilter != NULL)
+  {
+    delete m_TransformStatusFilter;
+    m_TransformStatusFilter = NULL;
+  }
+
   if (m_PatternRecognition != NULL)
   {
     delete m_PatternRecognition;
@@ -185,17 +231,52 @@ PlusStatus QSpatialCalibrationToolbox::ReadConfiguration(vtkXMLDataElement* aCon
     LOG_WARNING("Unable to read RecordingIntervalMs attribute from fCal element of the device set configuration, default value '" << m_RecordingIntervalMs << "' will be used");
   }
 
-  int maxTimeSpentWithProcessingMs = 0;
-  if (fCalElement->GetScalarAttribute("MaxTimeSpentWithProcessingMs", maxTimeSpentWithProcessingMs))
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, FreeHandStartupDelaySec, fCalElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfSegmentationThreads, fCalElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, SegmentationQueueLength, fCalElement);
+
+  // Pose diversity based frame selection with early stop (disabled by default)
+  const char* frameSelection = fCalElement->GetAttribute("CalibrationFrameSelection");
+  m_FrameSelectionEnabled = (frameSelection != NULL && STRCASECMP(frameSelection, "TRUE") == 0);
+
+  double frameSelectionParameter = 0.0;
+  if (fCalElement->GetScalarAttribute("FrameSelectionMinimumPositionDifferenceMm", frameSelectionParameter))
   {
-    m_MaxTimeSpentWithProcessingMs = maxTimeSpentWithProcessingMs;
+    m_FrameSelector->SetMinimumPositionDifferenceMm(frameSelectionParameter);
   }
-  else
+  if (fCalElement->GetScalarAttribute("FrameSelectionMinimumAngleDifferenceDeg", frameSelectionParameter))
+  {
+    m_FrameSelector->SetMinimumAngleDifferenceDeg(frameSelectionParameter);
+  }
+  if (fCalElement->GetScalarAttribute("FrameSelectionMinimumOrientationSpreadDeg", frameSelectionParameter))
   {
-    LOG_WARNING("Unable to read MaxTimeSpentWithProcessingMs attribute from fCal element of the device set configuration, default value '" << m_MaxTimeSpentWithProcessingMs << "' will be used");
+    m_FrameSelector->SetMinimumOrientationSpreadDeg(frameSelectionParameter);
+  }
+  if (fCalElement->GetScalarAttribute("FrameSelectionMinimumImageCoverage", frameSelectionParameter))
+  {
+    m_FrameSelector->SetMinimumImageCoverage(frameSelectionParameter);
+  }
+  int minimumNumberOfCalibrationImagesToAcquire = 0;
+  if (fCalElement->GetScalarAttribute("MinimumNumberOfCalibrationImagesToAcquire", minimumNumberOfCalibrationImagesToAcquire))
+  {
+    m_FrameSelector->SetMinimumNumberOfFrames(minimumNumberOfCalibrationImagesToAcquire);
+    m_IncrementalCalibrationWorker->SetMinimumNumberOfCalibrationFrames(minimumNumberOfCalibrationImagesToAcquire);
   }
 
-  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, FreeHandStartupDelaySec, fCalElement);
+  // Calibration during acquisition with early stop on convergence (disabled by default)
+  const char* incrementalCalibration = fCalElement->GetAttribute("IncrementalCalibration");
+  m_IncrementalCalibrationEnabled = (incrementalCalibration != NULL && STRCASECMP(incrementalCalibration, "TRUE") == 0);
+
+  double incrementalCalibrationConvergenceThresholdMm = 0.0;
+  if (fCalElement->GetScalarAttribute("IncrementalCalibrationConvergenceThresholdMm", incrementalCalibrationConvergenceThresholdMm))
+  {
+    m_IncrementalCalibrationWorker->SetConvergenceThresholdMm(incrementalCalibrationConvergenceThresholdMm);
+  }
+  int incrementalCalibrationUpdateIntervalImages = 0;
+  if (fCalElement->GetScalarAttribute("IncrementalCalibrationUpdateIntervalImages", incrementalCalibrationUpdateIntervalImages))
+  {
+    m_IncrementalCalibrationWorker->SetUpdateIntervalFrames(incrementalCalibrationUpdateIntervalImages);
+  }
 
   return m_PatternRecognition->ReadConfiguration(vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData());
 }
@@ -637,6 +718,30 @@ void QSpatialCalibrationToolbox::StartCalibration()
   m_NumberOfSegmentedCalibrationImages = 0;
   m_NumberOfSegmentedValidationImages = 0;
   m_LastRecordedFrameTimestamp = UNDEFINED_TIMESTAMP;
+  m_ProbeToPhantomTransformValid = false;
+  m_NumberOfSkippedCalibrationImages = 0;
+  m_FrameSelector->Reset();
+
+  // Frame validity is determined on a copy of the transform repository (which contains the phantom registration)
+  if (m_TransformStatusFilter->Initialize(m_ParentMainWindow->GetVisualizationController()->GetTransformRepository(),
+                                         igsioTransformName(m_Calibration->GetProbeCoordinateFrame(), m_Calibration->GetPhantomCoordinateFrame())) != PLUS_SUCCESS)
+  {
+    return;
+  }
+
+  if (m_SegmentationPipeline->Start(vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData(), m_NumberOfSegmentationThreads, m_SegmentationQueueLength) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start segmentation threads");
+    return;
+  }
+
+  m_IncrementalCalibrationWorker->Stop();
+  if (m_IncrementalCalibrationEnabled
+      && m_IncrementalCalibrationWorker->Start(vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData(), m_ParentMainWindow->GetVisualizationController()->GetTransformRepository(), m_PatternRecognition->GetFidLineFinder()->GetNWires()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start incremental calibration");
+    return;
+  }
 
   m_CancelRequest = false;
 
@@ -654,13 +759,26 @@ void QSpatialCalibrationToolbox::DoCalibration()
   // Enable wire label visualization
   m_ParentMainWindow->GetVisualizationController()->EnableWireLabels(true);
 
-  // Get current time
-  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  // Get frames segmented since the last round
+  CollectSegmentedFrames();
 
-  // Calibrate if acquisition is ready
-  if (m_NumberOfSegmentedCalibrationImages >= m_NumberOfCalibrationImagesToAcquire
-      && m_NumberOfSegmentedValidationImages >= m_NumberOfValidationImagesToAcquire)
+  // Calibrate if acquisition is ready. With frame selection or incremental calibration, acquisition stops early
+  // when the selected frames are sufficient or the calibration estimate has converged.
+  bool calibrationDataReady = (m_NumberOfSegmentedCalibrationImages >= m_NumberOfCalibrationImagesToAcquire)
+                              || (m_FrameSelectionEnabled && m_FrameSelector->IsWellConditioned())
+                              || (m_IncrementalCalibrationEnabled && m_IncrementalCalibrationWorker->GetLatestEstimate().Converged);
+  if (calibrationDataReady && m_NumberOfSegmentedValidationImages >= m_NumberOfValidationImagesToAcquire)
   {
+    // Frames that are still in the pipeline are not needed anymore
+    m_SegmentationPipeline->Stop();
+    m_IncrementalCalibrationWorker->Stop();
+
+    if (m_FrameSelectionEnabled)
+    {
+      LOG_INFO("Calibration frame selection: " << m_NumberOfSegmentedCalibrationImages << " frames selected, " << m_NumberOfSkippedCalibrationImages << " skipped (orientation spread: "
+               << std::fixed << std::setprecision(1) << m_FrameSelector->GetOrientationSpreadDeg() << " deg, image coverage: " << m_FrameSelector->GetImageCoverage() * 100.0 << " percent)");
+    }
+
     LOG_INFO("Segmentation success rate: " << m_NumberOfSegmentedCalibrationImages + m_NumberOfSegmentedValidationImages << " out of " << m_SpatialCalibrationData->GetNumberOfTrackedFrames() + m_SpatialValidationData->GetNumberOfTrackedFrames() << " (" << (int)(((double)(m_NumberOfSegmentedCalibrationImages + m_NumberOfSegmentedValidationImages) / (double)(m_SpatialCalibrationData->GetNumberOfTrackedFrames() + m_SpatialValidationData->GetNumberOfTrackedFrames())) * 100.0 + 0.49) << " percent)");
 
     if (m_Calibration->Calibrate(m_SpatialValidationData, m_SpatialCalibrationData, m_ParentMainWindow->GetVisualizationController()->GetTransformRepository(), m_PatternRecognition->GetFidLineFinder()->GetNWires()) != PLUS_SUCCESS)
@@ -698,56 +816,70 @@ void QSpatialCalibrationToolbox::DoCalibration()
   if (m_CancelRequest)
   {
     LOG_INFO("Calibration process cancelled by the user");
+    m_SegmentationPipeline->Stop();
+    m_IncrementalCalibrationWorker->Stop();
     CancelCalibration();
     return;
   }
 
-  // Determine which data container to use
-  vtkIGSIOTrackedFrameList* trackedFrameListToUse = NULL;
-  if (m_NumberOfSegmentedValidationImages < m_NumberOfValidationImagesToAcquire)
-  {
-    trackedFrameListToUse = m_SpatialValidationData;
-  }
-  else
+  // Feed the segmentation threads with the frames acquired since the last round
+  QueueNewFramesForSegmentation();
+
+  // Update progress
+  int progressPercent = (int)(((m_NumberOfSegmentedCalibrationImages + m_NumberOfSegmentedValidationImages) / (double)(std::max(m_NumberOfValidationImagesToAcquire, m_NumberOfSegmentedValidationImages) + m_NumberOfCalibrationImagesToAcquire)) * 100.0);
+  m_ParentMainWindow->SetStatusBarProgress(progressPercent);
+
+  // Display segmented points (or hide them if unsuccessful)
+  DisplaySegmentedPoints(m_ProbeToPhantomTransformValid);
+
+  // Segmentation runs in the background, so acquisition can be repeated at a constant rate
+  QTimer::singleShot(m_RecordingIntervalMs, this, SLOT(DoCalibration()));
+}
+
+//-----------------------------------------------------------------------------
+void QSpatialCalibrationToolbox::QueueNewFramesForSegmentation()
+{
+  LOG_TRACE("SpatialCalibrationToolbox::QueueNewFramesForSegmentation");
+
+  if (m_ParentMainWindow->GetSelectedChannel() == NULL)
   {
-    trackedFrameListToUse = m_SpatialCalibrationData;
+    return;
   }
 
-  unsigned int numberOfFramesBeforeRecording = trackedFrameListToUse->GetNumberOfTrackedFrames();
-
-  // Acquire tracked frames since last acquisition (minimum 1 frame)
-  if (m_LastProcessingTimePerFrameMs < 1)
+  // Frames that do not fit in the pipeline are left in the buffer and acquired in a later round
+  int numberOfFramesToGet = m_SegmentationPipeline->GetNumberOfFreeSlots();
+  if (numberOfFramesToGet < 1)
   {
-    // if processing was less than 1ms/frame then assume it was 1ms (1000FPS processing speed) to avoid division by zero
-    m_LastProcessingTimePerFrameMs = 1;
+    LOG_DEBUG("Segmentation queue is full, acquisition of new frames is postponed");
+    return;
   }
-  int numberOfFramesToGet = std::max(m_MaxTimeSpentWithProcessingMs / m_LastProcessingTimePerFrameMs, 1);
 
-  if (m_ParentMainWindow->GetSelectedChannel() != NULL &&
-      m_ParentMainWindow->GetSelectedChannel()->GetTrackedFrameList(m_LastRecordedFrameTimestamp, trackedFrameListToUse, numberOfFramesToGet) != PLUS_SUCCESS)
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> acquiredFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  acquiredFrames->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP | REQUIRE_TRACKING_OK);
+  acquiredFrames->SetFrameTransformNameForValidation(igsioTransformName(m_ParentMainWindow->GetProbeCoordinateFrame(), m_Calibration->GetReferenceCoordinateFrame()));
+  if (m_ParentMainWindow->GetSelectedChannel()->GetTrackedFrameList(m_LastRecordedFrameTimestamp, acquiredFrames, numberOfFramesToGet) != PLUS_SUCCESS)
   {
     LOG_ERROR("Failed to get tracked frame list from data collector (last recorded timestamp: " << std::fixed << m_LastRecordedFrameTimestamp);
-    QTimer::singleShot(50, this, SLOT(DoCalibration()));
+    return;
+  }
+  if (acquiredFrames->GetNumberOfTrackedFrames() == 0)
+  {
     return;
   }
 
-  // Remove tracked frames without valid transforms
-  igsioTransformName probeToPhantomTransformName = igsioTransformName(m_Calibration->GetProbeCoordinateFrame(), m_Calibration->GetPhantomCoordinateFrame());
-  vtkIGSIOTransformRepository* transformRepository = m_ParentMainWindow->GetVisualizationController()->GetTransformRepository();
-  bool probeToPhantomTransformValid = false;
-  for (unsigned int frameIndex = numberOfFramesBeforeRecording; frameIndex < trackedFrameListToUse->GetNumberOfTrackedFrames(); frameIndex++)
+  // Drop tracked frames without valid transforms
+  std::vector<unsigned int> validFrameIndices;
+  m_TransformStatusFilter->GetValidFrames(acquiredFrames, validFrameIndices);
+  for (std::vector<unsigned int>::iterator frameIndexIt = validFrameIndices.begin(); frameIndexIt != validFrameIndices.end(); ++frameIndexIt)
   {
-    igsioTrackedFrame* trackedFrame = trackedFrameListToUse->GetTrackedFrame(frameIndex);
-    transformRepository->SetTransforms(*trackedFrame);
-    transformRepository->GetTransformValid(probeToPhantomTransformName, probeToPhantomTransformValid);
-    if (!probeToPhantomTransformValid)
-    {
-      trackedFrameListToUse->RemoveTrackedFrame(frameIndex);
-      frameIndex--; // we've deleted the current frame, so continue with the same frameIndex
-    }
+    m_SegmentationPipeline->AddFrame(acquiredFrames->GetTrackedFrame(*frameIndexIt));
   }
 
-  if (probeToPhantomTransformValid)
+  // The warning reflects the most recent frame
+  m_ProbeToPhantomTransformValid = (!validFrameIndices.empty() && validFrameIndices.back() == acquiredFrames->GetNumberOfTrackedFrames() - 1);
+
+  igsioTransformName probeToPhantomTransformName(m_Calibration->GetProbeCoordinateFrame(), m_Calibration->GetPhantomCoordinateFrame());
+  if (m_ProbeToPhantomTransformValid)
   {
     ui.label_Warning->setVisible(false);
   }
@@ -760,63 +892,92 @@ void QSpatialCalibrationToolbox::DoCalibration()
     ui.label_Warning->setVisible(true);
   }
 
-  // Segment last recorded images
+  LOG_DEBUG("Number of requested frames: " << numberOfFramesToGet << ", acquired: " << acquiredFrames->GetNumberOfTrackedFrames() << ", valid: " << validFrameIndices.size());
+}
+
+//-----------------------------------------------------------------------------
+bool QSpatialCalibrationToolbox::IsInformativeCalibrationFrame(igsioTrackedFrame* aTrackedFrame)
+{
+  if (!m_FrameSelectionEnabled)
+  {
+    return true;
+  }
+
+  igsioTransformName probeToPhantomTransformName(m_Calibration->GetProbeCoordinateFrame(), m_Calibration->GetPhantomCoordinateFrame());
+  vtkSmartPointer<vtkMatrix4x4> probeToPhantomTransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  ToolStatus status(TOOL_INVALID);
+  vtkIGSIOTransformRepository* transformRepository = m_TransformStatusFilter->GetTransformRepository();
+  if (transformRepository->SetTransforms(*aTrackedFrame) != PLUS_SUCCESS
+      || transformRepository->GetTransform(probeToPhantomTransformName, probeToPhantomTransformMatrix, &status) != PLUS_SUCCESS
+      || status != TOOL_OK)
+  {
+    // Frame validity has already been checked, so this should not happen. Keep the frame to be on the safe side.
+    LOG_WARNING("Unable to get probe to phantom transform of segmented frame, frame selection is skipped");
+    return true;
+  }
+
+  return m_FrameSelector->SelectFrame(probeToPhantomTransformMatrix, aTrackedFrame->GetFiducialPointsCoordinatePx(), aTrackedFrame->GetImageData()->GetFrameSize());
+}
+
+//-----------------------------------------------------------------------------
+void QSpatialCalibrationToolbox::CollectSegmentedFrames()
+{
+  std::vector<QPatternRecognitionPipeline::SegmentedFrame> segmentedFrames;
+  m_SegmentationPipeline->TakeSegmentedFrames(segmentedFrames);
+
   int numberOfNewlySegmentedImages = 0;
-  if (numberOfFramesBeforeRecording < trackedFrameListToUse->GetNumberOfTrackedFrames())
+  for (std::vector<QPatternRecognitionPipeline::SegmentedFrame>::iterator frameIt = segmentedFrames.begin(); frameIt != segmentedFrames.end(); ++frameIt)
   {
-    PlusFidPatternRecognition::PatternRecognitionError error;
-    if (m_PatternRecognition->RecognizePattern(trackedFrameListToUse, error, &numberOfNewlySegmentedImages) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to segment tracked frame list");
-      QTimer::singleShot(50, this, SLOT(DoCalibration()));
-      return;
-    }
-    if (error == PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_TOO_MANY_CANDIDATES)
+    if (frameIt->Error == PlusFidPatternRecognition::PATTERN_RECOGNITION_ERROR_TOO_MANY_CANDIDATES)
     {
       LOG_WARNING("Too many candidates in frame. Some candidates have been truncated to prevent freezing of the application.");
     }
 
-    if (m_NumberOfSegmentedValidationImages < m_NumberOfValidationImagesToAcquire)
+    // Validation data is filled first
+    bool validationFrame = (m_NumberOfSegmentedValidationImages < m_NumberOfValidationImagesToAcquire);
+    vtkIGSIOTrackedFrameList* trackedFrameListToUse = (validationFrame ? m_SpatialValidationData : m_SpatialCalibrationData);
+
+    // Calibration frames with poses similar to the already selected ones add computation but no information
+    if (!validationFrame && frameIt->Segmented && !IsInformativeCalibrationFrame(frameIt->Frame))
     {
-      m_NumberOfSegmentedValidationImages += numberOfNewlySegmentedImages;
+      m_NumberOfSkippedCalibrationImages++;
+      delete frameIt->Frame;
+      continue;
     }
-    else
+    if (trackedFrameListToUse->TakeTrackedFrame(frameIt->Frame, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME) != PLUS_SUCCESS)
     {
-      m_NumberOfSegmentedCalibrationImages += numberOfNewlySegmentedImages;
+      LOG_ERROR("Failed to add segmented frame to the calibration data");
+      continue;
     }
-  }
-
-  LOG_DEBUG("Number of segmented images in this round: " << numberOfNewlySegmentedImages << " out of " << trackedFrameListToUse->GetNumberOfTrackedFrames() - numberOfFramesBeforeRecording);
-
-  // Update progress if tracked frame has been successfully added
-  int progressPercent = (int)(((m_NumberOfSegmentedCalibrationImages + m_NumberOfSegmentedValidationImages) / (double)(std::max(m_NumberOfValidationImagesToAcquire, m_NumberOfSegmentedValidationImages) + m_NumberOfCalibrationImagesToAcquire)) * 100.0);
-  m_ParentMainWindow->SetStatusBarProgress(progressPercent);
-
-  // Display segmented points (or hide them if unsuccessful)
-  DisplaySegmentedPoints(probeToPhantomTransformValid);
 
-  // Compute time spent with processing one frame in this round
-  double computationTimeMs = (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) * 1000.0;
-  // Update last processing time if new tracked frames have been acquired
-  if (trackedFrameListToUse->GetNumberOfTrackedFrames() > numberOfFramesBeforeRecording)
-  {
-    m_LastProcessingTimePerFrameMs = computationTimeMs / (trackedFrameListToUse->GetNumberOfTrackedFrames() - numberOfFramesBeforeRecording);
-  }
+    if (frameIt->Segmented)
+    {
+      ++numberOfNewlySegmentedImages;
+      if (validationFrame)
+      {
+        m_NumberOfSegmentedValidationImages++;
+      }
+      else
+      {
+        m_NumberOfSegmentedCalibrationImages++;
+      }
 
-  // Launch timer to run acquisition again
-  int waitTimeMs = std::max((int)(m_RecordingIntervalMs - computationTimeMs), 0);
-  if (waitTimeMs == 0)
-  {
-    LOG_WARNING("Processing cannot keep up with aquisition! Try to decrease MaxTimeSpentWithProcessingMs parameter in device set configuration (it should be more than the processing time (the last one was " << m_LastProcessingTimePerFrameMs << "), so if it is already small, try to increase RecordingIntervalMs too)");
+      // The frame is owned by the tracked frame list now, the worker makes its own copy without the image
+      if (m_IncrementalCalibrationEnabled)
+      {
+        if (validationFrame)
+        {
+          m_IncrementalCalibrationWorker->AddValidationFrame(frameIt->Frame);
+        }
+        else
+        {
+          m_IncrementalCalibrationWorker->AddCalibrationFrame(frameIt->Frame);
+        }
+      }
+    }
   }
 
-  LOG_DEBUG("Number of requested frames: " << numberOfFramesToGet);
-  LOG_DEBUG("Number of tracked frames in the list: " << std::setw(3) << numberOfFramesBeforeRecording << " => " << trackedFrameListToUse->GetNumberOfTrackedFrames());
-  LOG_DEBUG("Last processing time: " << m_LastProcessingTimePerFrameMs);
-  LOG_DEBUG("Computation time: " << computationTimeMs);
-  LOG_DEBUG("Waiting time: " << waitTimeMs);
-
-  QTimer::singleShot(waitTimeMs, this, SLOT(DoCalibration()));
+  LOG_DEBUG("Number of segmented images in this round: " << numberOfNewlySegmentedImages << " out of " << segmentedFrames.size());
 }
 
 //-----------------------------------------------------------------------------
@@ -926,6 +1087,28 @@ bool QSpatialCalibrationToolbox::IsReadyToStartSpatialCalibration()
   return true;
 }
 
+//-----------------------------------------------------------------------------
+void QSpatialCalibrationToolbox::IncrementalCalibrationEstimateAvailable()
+{
+  if (m_State != ToolboxState_InProgress)
+  {
+    return;
+  }
+
+  QIncrementalCalibrationWorker::Estimate estimate = m_IncrementalCalibrationWorker->GetLatestEstimate();
+  if (!estimate.Valid)
+  {
+    return;
+  }
+
+  ui.label_Results->setText(QString("Current estimate (%1 calibration images):\n  Validation error: %2 mm\n  Calibration error: %3 mm\n  Change since last update: %4 mm%5")
+                            .arg(estimate.NumberOfCalibrationFrames)
+                            .arg(estimate.ValidationErrorMm, 0, 'f', 3)
+                            .arg(estimate.CalibrationErrorMm, 0, 'f', 3)
+                            .arg(estimate.ChangeMm, 0, 'f', 3)
+                            .arg(estimate.Converged ? "\n  Converged" : ""));
+}
+
 //-----------------------------------------------------------------------------
 void QSpatialCalibrationToolbox::DisplaySegmentedPoints(bool enable)
 {
@@ -966,6 +1149,9 @@ void QSpatialCalibrationToolbox::Reset()
 {
   QAbstractToolbox::Reset();
 
+  m_SegmentationPipeline->Stop();
+  m_IncrementalCalibrationWorker->Stop();
+
   if (m_PatternRecognition != NULL)
   {
     delete m_PatternRecognition;
@@ -983,6 +1169,8 @@ void QSpatialCalibrationToolbox::Reset()
   m_SpatialValidationData = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   m_SpatialValidationData->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP | REQUIRE_TRACKING_OK);
 
+  m_FrameSelector->Reset();
+
   // Restore calibration and pattern recognition algorithm details
   this->OnActivated();
 }
@@ -16,8 +16,13 @@ See License.txt for details.
 
 #include <QWidget>
 
+class PlusCalibrationFrameSelector;
+class PlusTransformStatusFilter;
+class QIncrementalCalibrationWorker;
+class QThread;
 class vtkPlusProbeCalibrationAlgo;
 class PlusFidPatternRecognition;
+class QPatternRecognitionPipeline;
 class vtkIGSIOTrackedFrameList;
 
 //-----------------------------------------------------------------------------
@@ -82,6 +87,19 @@ protected:
 
   void SetFreeHandStartupDelaySec(int freeHandStartupDelaySec) {m_FreeHandStartupDelaySec = freeHandStartupDelaySec;};
 
+  void SetNumberOfSegmentationThreads(int numberOfSegmentationThreads) {m_NumberOfSegmentationThreads = numberOfSegmentationThreads;};
+
+  void SetSegmentationQueueLength(int segmentationQueueLength) {m_SegmentationQueueLength = segmentationQueueLength;};
+
+  /*! Get new frames from the selected channel, drop the ones without valid probe to phantom transform and queue the rest for segmentation */
+  void QueueNewFramesForSegmentation();
+
+  /*! Move the segmented frames from the pipeline to the validation or calibration data */
+  void CollectSegmentedFrames();
+
+  /*! Returns true if the calibration frame selector accepts the segmented frame (always true if frame selection is disabled) */
+  bool IsInformativeCalibrationFrame(igsioTrackedFrame* aTrackedFrame);
+
 protected slots:
 
   /*! Start the delay startup timer*/
@@ -108,6 +126,9 @@ protected slots:
   /*! Slot handling cancel calibration event (button click or explicit call) */
   void CancelCalibration();
 
+  /*! Show the latest incremental calibration estimate */
+  void IncrementalCalibrationEstimateAvailable();
+
 protected:
   /*! Calibration algorithm */
   vtkSmartPointer<vtkPlusProbeCalibrationAlgo>  m_Calibration;
@@ -115,12 +136,36 @@ protected:
   /*! Pattern recognition algorithm */
   PlusFidPatternRecognition*                    m_PatternRecognition;
 
+  /*! Segments the acquired frames in worker threads */
+  QPatternRecognitionPipeline*                  m_SegmentationPipeline;
+
+  /*! Selects calibration frames with diverse poses and decides when the calibration data is sufficient */
+  PlusCalibrationFrameSelector*                 m_FrameSelector;
+
+  /*! Flag indicating whether calibration frames are selected by pose diversity (otherwise all segmented frames are used) */
+  bool                                          m_FrameSelectionEnabled;
+
+  /*! Number of segmented calibration frames that were skipped by the frame selector */
+  int                                           m_NumberOfSkippedCalibrationImages;
+
+  /*! Thread that updates the calibration estimate during acquisition */
+  QThread*                                      m_IncrementalCalibrationThread;
+
+  /*! Updates the calibration estimate as segmented frames arrive (lives in m_IncrementalCalibrationThread) */
+  QIncrementalCalibrationWorker*                m_IncrementalCalibrationWorker;
+
+  /*! Flag indicating whether the calibration is updated during acquisition and acquisition stops when the estimate has converged */
+  bool                                          m_IncrementalCalibrationEnabled;
+
   /*! Tracked frame data for spatial calibration */
   vtkSmartPointer<vtkIGSIOTrackedFrameList>      m_SpatialCalibrationData;
 
   /*! Tracked frame data for validation of spatial calibration */
   vtkSmartPointer<vtkIGSIOTrackedFrameList>      m_SpatialValidationData;
 
+  /*! Selects the frames with valid probe to phantom transform, uses a copy of the transform repository */
+  PlusTransformStatusFilter*                    m_TransformStatusFilter;
+
   /*! Delay time before start acquisition [s] */
   int                           m_FreeHandStartupDelaySec;
 
@@ -151,11 +196,14 @@ protected:
   /*! Time interval between recording (sampling) cycles (in milliseconds) */
   int                           m_RecordingIntervalMs;
 
-  /*! Maximum time spent with processing (getting tracked frames, segmentation) per second (in milliseconds) */
-  int                           m_MaxTimeSpentWithProcessingMs;
+  /*! Number of threads that segment the acquired frames (0 means one less than the number of CPU cores) */
+  int                           m_NumberOfSegmentationThreads;
+
+  /*! Maximum number of frames waiting for or under segmentation. New frames are left in the buffer while the queue is full. */
+  int                           m_SegmentationQueueLength;
 
-  /*! Time needed to process one frame in the latest recording round (in milliseconds) */
-  int                           m_LastProcessingTimePerFrameMs;
+  /*! Flag indicating whether the probe to phantom transform was valid in the latest acquired frame */
+  bool                          m_ProbeToPhantomTransformValid;
 
 protected:
   Ui::SpatialCalibrationToolbox ui;
@@ -29,6 +29,7 @@ QStylusCalibrationToolbox::QStylusCalibrationToolbox(fCalMainWindow* aParentMain
   , m_FreeHandStartupDelaySec(5)
   , m_CurrentPointNumber(0)
   , m_PreviousStylusToReferenceTransformMatrix(vtkSmartPointer<vtkMatrix4x4>::New())
+  , m_StopWhenConverged(true)
 {
   ui.setupUi(this);
 
@@ -134,6 +135,19 @@ PlusStatus QStylusCalibrationToolbox::ReadConfiguration(vtkXMLDataElement* aConf
 
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, FreeHandStartupDelaySec, fCalElement);
 
+  // Automatic stop when the pivot point estimate has converged
+  int minimumNumberOfStylusCalibrationPointsToAcquire = 0;
+  if (fCalElement->GetScalarAttribute("MinimumNumberOfStylusCalibrationPointsToAcquire", minimumNumberOfStylusCalibrationPointsToAcquire))
+  {
+    m_IncrementalPivotCalibration.SetMinimumNumberOfPoses(minimumNumberOfStylusCalibrationPointsToAcquire);
+  }
+  double stylusCalibrationConvergenceThresholdMm = 0.0;
+  if (fCalElement->GetScalarAttribute("StylusCalibrationConvergenceThresholdMm", stylusCalibrationConvergenceThresholdMm))
+  {
+    m_IncrementalPivotCalibration.SetConvergenceThresholdMm(stylusCalibrationConvergenceThresholdMm);
+  }
+  m_StopWhenConverged = (m_IncrementalPivotCalibration.GetConvergenceThresholdMm() > 0.0);
+
   return PLUS_SUCCESS;
 }
 
@@ -163,6 +177,24 @@ void QStylusCalibrationToolbox::RefreshContent()
     ui.label_NumberOfPoints->setText(QString("%1 / %2").arg(m_CurrentPointNumber).arg(m_NumberOfPoints));
     ui.label_CurrentPosition->setText(m_StylusPositionString);
     m_ParentMainWindow->SetStatusBarProgress((int)(100.0 * (m_CurrentPointNumber / (double)m_NumberOfPoints) + 0.5));
+
+    // Current estimate
+    if (m_IncrementalPivotCalibration.IsSolutionValid())
+    {
+      double pivotPointToMarkerTranslation[3] = {0, 0, 0};
+      m_IncrementalPivotCalibration.GetPivotPointToMarkerTranslation(pivotPointToMarkerTranslation);
+      ui.label_CalibrationError->setText(QString("%1 mm (RMS)").arg(m_IncrementalPivotCalibration.GetRmsErrorMm(), 0, 'f', 2));
+      ui.label_StylusTipTransform->setText(QString("%1 %2 %3")
+                                           .arg(pivotPointToMarkerTranslation[0], 7, 'f', 1, ' ')
+                                           .arg(pivotPointToMarkerTranslation[1], 7, 'f', 1, ' ')
+                                           .arg(pivotPointToMarkerTranslation[2], 7, 'f', 1, ' '));
+    }
+    else
+    {
+      // Not enough pivoting yet
+      ui.label_CalibrationError->setText(tr("N/A"));
+      ui.label_StylusTipTransform->setText(tr("N/A"));
+    }
   }
   else if (m_State == ToolboxState_Done)
   {
@@ -423,6 +455,7 @@ void QStylusCalibrationToolbox::StartCalibration()
 
   // Initialize calibration
   m_PivotCalibration->RemoveAllCalibrationPoints();
+  m_IncrementalPivotCalibration.Reset();
 
   // Initialize stylus tool
   vtkPlusDisplayableObject* object = m_ParentMainWindow->GetVisualizationController()->GetObjectById(m_ParentMainWindow->GetStylusModelId());
@@ -526,37 +559,67 @@ void QStylusCalibrationToolbox::OnDataAcquired()
     }
     else
     {
+      // Sample the stylus poses that are recorded from now on
+      igsioTransformName stylusToReferenceTransformName(m_PivotCalibration->GetObjectMarkerCoordinateFrame(), m_PivotCalibration->GetReferenceCoordinateFrame());
+      if (m_PivotSampler.Reset(m_ParentMainWindow->GetVisualizationController()->GetSelectedChannel(),
+                               m_ParentMainWindow->GetVisualizationController()->GetTransformRepository(), stylusToReferenceTransformName) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to start stylus position recording!");
+        SetState(ToolboxState_Error);
+        SetDisplayAccordingToState();
+        return;
+      }
       SetState(ToolboxState_InProgress);
       SetDisplayAccordingToState();
     }
     return;
   }
 
-  // Get stylus position
-  vtkSmartPointer<vtkMatrix4x4> stylusToReferenceTransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  ToolStatus status(TOOL_INVALID);
-  std::string objectMarkerCoordinateFrame = m_PivotCalibration->GetObjectMarkerCoordinateFrame();
-  std::string referenceCoordinateFrame = m_PivotCalibration->GetReferenceCoordinateFrame();
-  if (m_ParentMainWindow->GetVisualizationController()->GetTransformMatrix(objectMarkerCoordinateFrame.c_str(), referenceCoordinateFrame.c_str(), stylusToReferenceTransformMatrix, &status) != PLUS_SUCCESS)
+  // Get all stylus positions that the tracker recorded since the previous acquisition
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > stylusToReferenceTransformMatrices;
+  if (m_PivotSampler.GetNewSamples(stylusToReferenceTransformMatrices) == 0)
   {
-    LOG_ERROR("No transform found between stylus and reference!");
     return;
   }
 
-  if (status != TOOL_OK)
+  // Assemble position string for toolbox from the latest position
+  vtkMatrix4x4* latestStylusToReferenceTransformMatrix = stylusToReferenceTransformMatrices.back();
+  m_StylusPositionString = QString("%1 %2 %3")
+                           .arg(latestStylusToReferenceTransformMatrix->GetElement(0, 3), 7, 'f', 1, ' ')
+                           .arg(latestStylusToReferenceTransformMatrix->GetElement(1, 3), 7, 'f', 1, ' ')
+                           .arg(latestStylusToReferenceTransformMatrix->GetElement(2, 3), 7, 'f', 1, ' ');
+
+  for (std::vector<vtkSmartPointer<vtkMatrix4x4> >::iterator matrixIt = stylusToReferenceTransformMatrices.begin(); matrixIt != stylusToReferenceTransformMatrices.end(); ++matrixIt)
   {
-    return;
-  }
+    if (!AddStylusPose(*matrixIt))
+    {
+      continue;
+    }
 
-  // Assemble position string for toolbox
-  m_StylusPositionString = QString("%1 %2 %3")
-                           .arg(stylusToReferenceTransformMatrix->GetElement(0, 3), 7, 'f', 1, ' ')
-                           .arg(stylusToReferenceTransformMatrix->GetElement(1, 3), 7, 'f', 1, ' ')
-                           .arg(stylusToReferenceTransformMatrix->GetElement(2, 3), 7, 'f', 1, ' ');
+    // Reset the camera once in a while
+    if ((m_CurrentPointNumber > 0) && ((m_CurrentPointNumber % 10 == 0) || (m_CurrentPointNumber == 5) || (m_CurrentPointNumber >= m_NumberOfPoints)))
+    {
+      m_ParentMainWindow->GetVisualizationController()->GetCanvasRenderer()->ResetCamera();
+    }
 
-  // Add point to the input if fulfills the criteria
-  vtkSmartPointer<vtkPoints> points = m_ParentMainWindow->GetVisualizationController()->GetInputPolyDataPoints();
+    // If enough points have been acquired, stop
+    if (m_CurrentPointNumber >= m_NumberOfPoints)
+    {
+      StopCalibration();
+      return;
+    }
+    if (m_StopWhenConverged && m_IncrementalPivotCalibration.IsConverged())
+    {
+      LOG_INFO("Stylus calibration estimate has converged after " << m_CurrentPointNumber << " points");
+      StopCalibration();
+      return;
+    }
+  }
+}
 
+//-----------------------------------------------------------------------------
+bool QStylusCalibrationToolbox::AddStylusPose(vtkMatrix4x4* aStylusToReferenceTransformMatrix)
+{
   double positionDifferenceLowThresholdMm = 2.0;
   double positionDifferenceHighThresholdMm = 500.0;
   double positionDifferenceMm = -1.0;
@@ -572,41 +635,29 @@ void QStylusCalibrationToolbox::OnDataAcquired()
   else
   {
     // Compute position and orientation difference of current and previous positions
-    positionDifferenceMm = igsioMath::GetPositionDifference(stylusToReferenceTransformMatrix, m_PreviousStylusToReferenceTransformMatrix);
-    orientationDifferenceDegrees = igsioMath::GetOrientationDifference(stylusToReferenceTransformMatrix, m_PreviousStylusToReferenceTransformMatrix);
+    positionDifferenceMm = igsioMath::GetPositionDifference(aStylusToReferenceTransformMatrix, m_PreviousStylusToReferenceTransformMatrix);
+    orientationDifferenceDegrees = igsioMath::GetOrientationDifference(aStylusToReferenceTransformMatrix, m_PreviousStylusToReferenceTransformMatrix);
   }
 
   // If current point is close to the previous one, or too far (outlier), we do not insert it
   if (positionDifferenceMm < orientationDifferenceLowThresholdDegrees && orientationDifferenceDegrees < orientationDifferenceLowThresholdDegrees)
   {
     LOG_DEBUG("Acquired position is too close to the previous - it is skipped");
+    return false;
   }
-  else
-  {
-    // Add the point into the calibration dataset
-    m_PivotCalibration->InsertNextCalibrationPoint(stylusToReferenceTransformMatrix);
 
-    // Add to polydata for rendering
-    points->InsertPoint(m_CurrentPointNumber, stylusToReferenceTransformMatrix->GetElement(0, 3), stylusToReferenceTransformMatrix->GetElement(1, 3), stylusToReferenceTransformMatrix->GetElement(2, 3));
-    points->Modified();
+  // Add the point into the calibration dataset
+  m_PivotCalibration->InsertNextCalibrationPoint(aStylusToReferenceTransformMatrix);
+  m_IncrementalPivotCalibration.AddPose(aStylusToReferenceTransformMatrix);
 
-    // Set new current point number
-    ++m_CurrentPointNumber;
+  // Add to polydata for rendering
+  vtkPoints* points = m_ParentMainWindow->GetVisualizationController()->GetInputPolyDataPoints();
+  points->InsertPoint(m_CurrentPointNumber, aStylusToReferenceTransformMatrix->GetElement(0, 3), aStylusToReferenceTransformMatrix->GetElement(1, 3), aStylusToReferenceTransformMatrix->GetElement(2, 3));
+  points->Modified();
 
-    // Reset the camera once in a while
-    if ((m_CurrentPointNumber > 0) && ((m_CurrentPointNumber % 10 == 0) || (m_CurrentPointNumber == 5) || (m_CurrentPointNumber >= m_NumberOfPoints)))
-    {
-      m_ParentMainWindow->GetVisualizationController()->GetCanvasRenderer()->ResetCamera();
-    }
+  // Set new current point number
+  ++m_CurrentPointNumber;
 
-    // If enough points have been acquired, stop
-    if (m_CurrentPointNumber >= m_NumberOfPoints)
-    {
-      StopCalibration();
-    }
-    else
-    {
-      m_PreviousStylusToReferenceTransformMatrix->DeepCopy(stylusToReferenceTransformMatrix);
-    }
-  }
-}
\ No newline at end of file
+  m_PreviousStylusToReferenceTransformMatrix->DeepCopy(aStylusToReferenceTransformMatrix);
+  return true;
+}
@@ -11,6 +11,8 @@ See License.txt for details.
 
 #include "QAbstractToolbox.h"
 #include "PlusConfigure.h"
+#include "PlusIncrementalPivotCalibration.h"
+#include "PlusTrackerPoseSampler.h"
 
 #include <QWidget>
 #include <QTime>
@@ -81,7 +83,7 @@ protected slots:
   void NumberOfStylusCalibrationPointsChanged(int aNumberOfPoints);
 
   /*!
-  * Acquire stylus position and add it to the algorithm (called by the acquisition timer in object visualizer)
+  * Acquire the stylus positions recorded since the previous call and add them to the algorithm (called by the acquisition timer in object visualizer)
   */
   void OnDataAcquired();
 
@@ -90,6 +92,12 @@ protected:
   void StartCalibration();
   void SetFreeHandStartupDelaySec(int freeHandStartupDelaySec);
 
+  /*!
+  * Add a stylus pose to the calibration points if it differs enough from the previously added one
+  * \return True if the pose is added
+  */
+  bool AddStylusPose(vtkMatrix4x4* aStylusToReferenceTransformMatrix);
+
   vtkSmartPointer<vtkPlusPivotCalibrationAlgo>  m_PivotCalibration;
   int                                           m_NumberOfPoints;
   int                                           m_FreeHandStartupDelaySec;
@@ -97,6 +105,11 @@ protected:
   QString                                       m_StylusPositionString;
   vtkSmartPointer<vtkMatrix4x4>                 m_PreviousStylusToReferenceTransformMatrix;
   QTime                                         m_CalibrationStartupDelayStartTime;
+  PlusTrackerPoseSampler                        m_PivotSampler;
+  /*! Updated after each added point for displaying the current estimate and for stopping as soon as it has converged */
+  PlusIncrementalPivotCalibration               m_IncrementalPivotCalibration;
+  /*! Stop the calibration when the incremental estimate has converged, before m_NumberOfPoints are acquired */
+  bool                                          m_StopWhenConverged;
 
 protected:
   Ui::StylusCalibrationToolbox ui;
@@ -0,0 +1,187 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "QTemporalCalibrationSignalWorker.h"
+
+// PlusLib includes
+#include <vtkIGSIOTrackedFrameList.h>
+
+// Qt includes
+#include <QMutexLocker>
+
+// STL includes
+#include <iomanip>
+
+//-----------------------------------------------------------------------------
+QTemporalCalibrationSignalWorker::QTemporalCalibrationSignalWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_FixedType(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE)
+  , m_MovingType(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE)
+  , m_ResetRequested(false)
+  , m_ProcessingQueued(false)
+  , m_RecordingFinished(false)
+  , m_Generation(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+QTemporalCalibrationSignalWorker::~QTemporalCalibrationSignalWorker()
+{
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationSignalWorker::Start(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aFixedType, const igsioTransformName& aFixedTransformName,
+    vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aMovingType, const igsioTransformName& aMovingTransformName,
+    const std::vector<int>& aClipRectangle)
+{
+  QMutexLocker locker(&m_Mutex);
+  ++m_Generation;
+  m_PendingFrames.clear();
+  m_FixedTimestamps.clear();
+  m_FixedPositions.clear();
+  m_MovingTimestamps.clear();
+  m_MovingPositions.clear();
+  m_RecordingFinished = false;
+
+  m_FixedType = aFixedType;
+  m_FixedTransformName = aFixedTransformName;
+  m_MovingType = aMovingType;
+  m_MovingTransformName = aMovingTransformName;
+  m_ClipRectangle = aClipRectangle;
+  m_ResetRequested = true;
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationSignalWorker::Stop()
+{
+  QMutexLocker locker(&m_Mutex);
+  ++m_Generation;
+  m_PendingFrames.clear();
+  m_FixedTimestamps.clear();
+  m_FixedPositions.clear();
+  m_MovingTimestamps.clear();
+  m_MovingPositions.clear();
+  m_RecordingFinished = false;
+
+  // Release the collected signals at the next processing
+  m_FixedType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE;
+  m_MovingType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE;
+  m_ResetRequested = true;
+  if (!m_ProcessingQueued)
+  {
+    m_ProcessingQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessFrames", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationSignalWorker::AddFrames(vtkIGSIOTrackedFrameList* aFixedFrames, vtkIGSIOTrackedFrameList* aMovingFrames)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_PendingFrames.push_back(std::make_pair(vtkSmartPointer<vtkIGSIOTrackedFrameList>(aFixedFrames), vtkSmartPointer<vtkIGSIOTrackedFrameList>(aMovingFrames)));
+  if (!m_ProcessingQueued)
+  {
+    m_ProcessingQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessFrames", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationSignalWorker::Finish()
+{
+  // Queued after the processing of the frames that have been added so far
+  QMetaObject::invokeMethod(this, "FinishRecording", Qt::QueuedConnection);
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QTemporalCalibrationSignalWorker::GetSignals(std::vector<double>& aFixedTimestamps, std::vector<double>& aFixedPositions,
+    std::vector<double>& aMovingTimestamps, std::vector<double>& aMovingPositions)
+{
+  QMutexLocker locker(&m_Mutex);
+  if (!m_RecordingFinished)
+  {
+    return PLUS_FAIL;
+  }
+  aFixedTimestamps = m_FixedTimestamps;
+  aFixedPositions = m_FixedPositions;
+  aMovingTimestamps = m_MovingTimestamps;
+  aMovingPositions = m_MovingPositions;
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+unsigned int QTemporalCalibrationSignalWorker::ProcessPendingFrames()
+{
+  FrameListPairs frames;
+  unsigned int generation = 0;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_ProcessingQueued = false;
+    frames.swap(m_PendingFrames);
+    generation = m_Generation;
+
+    if (m_ResetRequested)
+    {
+      m_FixedSignal.Reset(m_FixedType, m_FixedTransformName);
+      m_FixedSignal.SetClipRectangle(m_ClipRectangle);
+      m_MovingSignal.Reset(m_MovingType, m_MovingTransformName);
+      m_MovingSignal.SetClipRectangle(m_ClipRectangle);
+      m_ResetRequested = false;
+    }
+  }
+
+  if (frames.empty())
+  {
+    return generation;
+  }
+
+  int numberOfFixedSamplesBeforeRecording = m_FixedSignal.GetNumberOfSamples();
+  int numberOfMovingSamplesBeforeRecording = m_MovingSignal.GetNumberOfSamples();
+  for (FrameListPairs::iterator framesIt = frames.begin(); framesIt != frames.end(); ++framesIt)
+  {
+    m_FixedSignal.AddFrames(framesIt->first);
+    m_MovingSignal.AddFrames(framesIt->second);
+  }
+  LOG_DEBUG("Number of samples in the calibration dataset: Fixed: " << std::setw(3) << numberOfFixedSamplesBeforeRecording << " => " << m_FixedSignal.GetNumberOfSamples() << "; Moving: " << numberOfMovingSamplesBeforeRecording << " => " << m_MovingSignal.GetNumberOfSamples());
+
+  return generation;
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationSignalWorker::ProcessFrames()
+{
+  ProcessPendingFrames();
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationSignalWorker::FinishRecording()
+{
+  unsigned int generation = ProcessPendingFrames();
+
+  // The estimator reports the error if a signal is too short
+  std::vector<double> fixedTimestamps;
+  std::vector<double> fixedPositions;
+  m_FixedSignal.GetSignal(fixedTimestamps, fixedPositions);
+  std::vector<double> movingTimestamps;
+  std::vector<double> movingPositions;
+  m_MovingSignal.GetSignal(movingTimestamps, movingPositions);
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (generation != m_Generation)
+    {
+      // Restarted or stopped while processing
+      return;
+    }
+    m_FixedTimestamps.swap(fixedTimestamps);
+    m_FixedPositions.swap(fixedPositions);
+    m_MovingTimestamps.swap(movingTimestamps);
+    m_MovingPositions.swap(movingPositions);
+    m_RecordingFinished = true;
+  }
+
+  emit RecordingFinished();
+}
@@ -0,0 +1,117 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef TEMPORALCALIBRATIONSIGNALWORKER_H
+#define TEMPORALCALIBRATIONSIGNALWORKER_H
+
+#include "PlusConfigure.h"
+#include "PlusTemporalCalibrationSignal.h"
+
+#include <vtkSmartPointer.h>
+
+#include <QMutex>
+#include <QObject>
+
+#include <utility>
+#include <vector>
+
+class vtkIGSIOTrackedFrameList;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QTemporalCalibrationSignalWorker
+ * \brief Reduces the frames recorded for temporal calibration to position signals on a worker thread
+ *
+ * The toolbox fetches the new frames of the fixed and moving channels periodically and passes them to the worker,
+ * so the line segmentation of the video frames does not block the user interface during recording. When the
+ * recording is finished the worker processes the remaining frames and emits RecordingFinished, then the signals
+ * can be retrieved by GetSignals.
+ * \ingroup PlusAppFCal
+ */
+class QTemporalCalibrationSignalWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  QTemporalCalibrationSignalWorker(QObject* aParent = NULL);
+  ~QTemporalCalibrationSignalWorker();
+
+  /*!
+  * Discard all collected data and start a new recording
+  * \param aFixedType Fixed signal type
+  * \param aFixedTransformName Transform of the fixed tracker signal (ignored for video)
+  * \param aMovingType Moving signal type
+  * \param aMovingTransformName Transform of the moving tracker signal (ignored for video)
+  * \param aClipRectangle Region of the image where the line is searched in video signals
+  */
+  void Start(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aFixedType, const igsioTransformName& aFixedTransformName,
+             vtkPlusTemporalCalibrationAlgo::FRAME_TYPE aMovingType, const igsioTransformName& aMovingTransformName,
+             const std::vector<int>& aClipRectangle);
+
+  /*! Queue new frames of the fixed and moving channels. All queued frames are processed, none of them are dropped. */
+  void AddFrames(vtkIGSIOTrackedFrameList* aFixedFrames, vtkIGSIOTrackedFrameList* aMovingFrames);
+
+  /*! Finish the recording: RecordingFinished is emitted when the queued frames are processed */
+  void Finish();
+
+  /*! Discard the queued frames and the collected signals, ignore the running processing */
+  void Stop();
+
+  /*! Get the signals of the finished recording. Fails if the recording that was started last is not finished yet. */
+  PlusStatus GetSignals(std::vector<double>& aFixedTimestamps, std::vector<double>& aFixedPositions,
+                        std::vector<double>& aMovingTimestamps, std::vector<double>& aMovingPositions);
+
+signals:
+  /*! Emitted when all frames of the recording are processed (see GetSignals) */
+  void RecordingFinished();
+
+protected slots:
+  /*! Add the queued frames to the signals (executed in the worker thread) */
+  void ProcessFrames();
+
+  /*! Add the remaining queued frames to the signals and store the signals of the recording (executed in the worker thread) */
+  void FinishRecording();
+
+protected:
+  typedef std::vector<std::pair<vtkSmartPointer<vtkIGSIOTrackedFrameList>, vtkSmartPointer<vtkIGSIOTrackedFrameList> > > FrameListPairs;
+
+  /*! Apply the requested reset and add the queued frames to the signals. Returns the generation of the processed frames. */
+  unsigned int ProcessPendingFrames();
+
+protected:
+  /*! Signals are accessed only in the worker thread */
+  PlusTemporalCalibrationSignal m_FixedSignal;
+  PlusTemporalCalibrationSignal m_MovingSignal;
+
+  /*! Signal source settings to be applied in the worker thread before processing new frames */
+  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE m_FixedType;
+  igsioTransformName m_FixedTransformName;
+  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE m_MovingType;
+  igsioTransformName m_MovingTransformName;
+  std::vector<int> m_ClipRectangle;
+  bool m_ResetRequested;
+
+  /*! Fixed and moving frame lists waiting for processing */
+  FrameListPairs m_PendingFrames;
+
+  /*! Set while a processing request is queued */
+  bool m_ProcessingQueued;
+
+  /*! Signals of the finished recording */
+  std::vector<double> m_FixedTimestamps;
+  std::vector<double> m_FixedPositions;
+  std::vector<double> m_MovingTimestamps;
+  std::vector<double> m_MovingPositions;
+  bool m_RecordingFinished;
+
+  /*! Incremented by Start and Stop to discard the results of running processing */
+  unsigned int m_Generation;
+
+  /*! Guards the pending frames, the settings and the signals of the finished recording */
+  QMutex m_Mutex;
+};
+
+#endif
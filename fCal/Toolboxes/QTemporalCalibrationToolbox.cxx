@@ -5,7 +5,11 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 // Local includes
+#include "QLatencyMonitorWorker.h"
+#include "QLineSegmentationPreviewWorker.h"
+#include "QTemporalCalibrationSignalWorker.h"
 #include "QTemporalCalibrationToolbox.h"
+#include "QTemporalCalibrationWorker.h"
 #include "fCalMainWindow.h"
 #include "vtkPlusVisualizationController.h"
 
@@ -14,18 +18,17 @@ See License.txt for details.
 #include <QMainWindow>
 #include <QMenuBar>
 #include <QStandardPaths>
+#include <QThread>
 
 // PlusLib includes
 #include <igsioTrackedFrame.h>
 #include <vtkPlusChannel.h>
 #include <vtkPlusDataSource.h>
-#include <vtkPlusLineSegmentationAlgo.h>
 #include <vtkPlusTemporalCalibrationAlgo.h>
 #include <vtkIGSIOTrackedFrameList.h>
 
 // VTK includes
 #include <vtkAbstractArray.h>
-#include <vtkBox.h>
 #include <vtkChartXY.h>
 #include <vtkContextScene.h>
 #include <vtkContextView.h>
@@ -50,8 +53,10 @@ namespace
 QTemporalCalibrationToolbox::QTemporalCalibrationToolbox(fCalMainWindow* aParentMainWindow, Qt::WindowFlags aFlags)
   : QAbstractToolbox(aParentMainWindow)
   , QWidget(aParentMainWindow, aFlags)
-  , TemporalCalibrationFixedData(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New())
-  , TemporalCalibrationMovingData(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New())
+  , TemporalCalibrationSignalThread(NULL)
+  , TemporalCalibrationSignalWorker(NULL)
+  , TemporalCalibrationThread(NULL)
+  , TemporalCalibrationWorker(NULL)
   , FreeHandStartupDelaySec(5)
   , StartupDelayRemainingTimeSec(0)
   , CancelRequest(false)
@@ -76,10 +81,56 @@ QTemporalCalibrationToolbox::QTemporalCalibrationToolbox(fCalMainWindow* aParent
   , RequestedFixedChannel("")
   , RequestedMovingChannel("")
   , SaveFileButton(nullptr)
-  , LineSegmenter(vtkSmartPointer<vtkPlusLineSegmentationAlgo>::New())
+  , LineSegmentationPreviewThread(NULL)
+  , LineSegmentationPreviewWorker(NULL)
+  , LastPreviewedVideoSource(NULL)
+  , LastPreviewedFrameUid(0)
+  , LatencyMonitorThread(NULL)
+  , LatencyMonitorWorker(NULL)
+  , LatencyMonitorFixedChannelId("")
+  , LatencyMonitorMovingChannelId("")
+  , LatencyMonitorFixedType(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE)
+  , LatencyMonitorMovingType(vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_NONE)
+  , LastMonitoredFixedItemTimestamp(UNDEFINED_TIMESTAMP)
+  , LastMonitoredMovingItemTimestamp(UNDEFINED_TIMESTAMP)
+  , LatencyMonitorRestartRequired(false)
+  , LatencyMonitorWindowSec(10.0)
+  , LatencyMonitorIntervalSec(5.0)
+  , LatencyMonitorAlertThresholdSec(0.02)
+  , LatencyAlertActive(false)
 {
   ui.setupUi(this);
 
+  // Recorded frames are reduced to positions in the background, so the line segmentation does not block the application
+  this->TemporalCalibrationSignalThread = new QThread(this);
+  this->TemporalCalibrationSignalWorker = new QTemporalCalibrationSignalWorker();
+  this->TemporalCalibrationSignalWorker->moveToThread(this->TemporalCalibrationSignalThread);
+  connect(this->TemporalCalibrationSignalWorker, SIGNAL(RecordingFinished()), this, SLOT(ComputeCalibrationResults()));
+  this->TemporalCalibrationSignalThread->start();
+
+  // The lag is computed in the background so that the application stays responsive
+  this->TemporalCalibrationThread = new QThread(this);
+  this->TemporalCalibrationWorker = new QTemporalCalibrationWorker();
+  this->TemporalCalibrationWorker->moveToThread(this->TemporalCalibrationThread);
+  connect(this->TemporalCalibrationWorker, SIGNAL(ProgressChanged(int, QString)), this, SLOT(CalibrationComputationProgressChanged(int, QString)));
+  connect(this->TemporalCalibrationWorker, SIGNAL(Finished(bool, bool)), this, SLOT(CalibrationComputationFinished(bool, bool)));
+  this->TemporalCalibrationThread->start();
+
+  // The line preview must not take processing time from acquisition
+  this->LineSegmentationPreviewThread = new QThread(this);
+  this->LineSegmentationPreviewWorker = new QLineSegmentationPreviewWorker();
+  this->LineSegmentationPreviewWorker->moveToThread(this->LineSegmentationPreviewThread);
+  connect(this->LineSegmentationPreviewWorker, SIGNAL(LineAvailable()), this, SLOT(LineSegmentationPreviewAvailable()));
+  this->LineSegmentationPreviewThread->start(QThread::LowPriority);
+
+  // Latency monitoring runs in the background during the whole session, it must not slow down acquisition either
+  this->LatencyMonitorThread = new QThread(this);
+  this->LatencyMonitorWorker = new QLatencyMonitorWorker();
+  this->LatencyMonitorWorker->moveToThread(this->LatencyMonitorThread);
+  connect(this->LatencyMonitorWorker, SIGNAL(EstimateAvailable()), this, SLOT(LatencyEstimateAvailable()));
+  this->LatencyMonitorThread->start(QThread::LowPriority);
+  connect(&LatencyMonitorTimer, &QTimer::timeout, this, &QTemporalCalibrationToolbox::MonitorLatency);
+
   // Connect events
   connect(ui.pushButton_StartCancelTemporal, &QPushButton::clicked, this, &QTemporalCalibrationToolbox::StartDelayTimer);
   connect(&StartupDelayTimer, &QTimer::timeout, this, &QTemporalCalibrationToolbox::DelayStartup);
@@ -88,6 +139,7 @@ QTemporalCalibrationToolbox::QTemporalCalibrationToolbox(fCalMainWindow* aParent
   connect(ui.comboBox_MovingChannelValue, SIGNAL(currentIndexChanged(int)), this, SLOT(MovingSignalChanged(int)));
   connect(ui.comboBox_FixedSourceValue, SIGNAL(currentIndexChanged(int)), this, SLOT(FixedSourceChanged(int)));
   connect(ui.comboBox_MovingSourceValue, SIGNAL(currentIndexChanged(int)), this, SLOT(MovingSourceChanged(int)));
+  connect(ui.checkBox_MonitorLatency, SIGNAL(toggled(bool)), this, SLOT(LatencyMonitoringToggled(bool)));
 }
 
 //-----------------------------------------------------------------------------
@@ -104,6 +156,30 @@ QTemporalCalibrationToolbox::~QTemporalCalibrationToolbox()
   {
     StartupDelayTimer.stop();
   }
+
+  this->TemporalCalibrationSignalWorker->Stop();
+  this->TemporalCalibrationSignalThread->quit();
+  this->TemporalCalibrationSignalThread->wait();
+  delete this->TemporalCalibrationSignalWorker;
+  this->TemporalCalibrationSignalWorker = NULL;
+
+  this->TemporalCalibrationWorker->RequestCancel();
+  this->TemporalCalibrationThread->quit();
+  this->TemporalCalibrationThread->wait();
+  delete this->TemporalCalibrationWorker;
+  this->TemporalCalibrationWorker = NULL;
+
+  this->LineSegmentationPreviewThread->quit();
+  this->LineSegmentationPreviewThread->wait();
+  delete this->LineSegmentationPreviewWorker;
+  this->LineSegmentationPreviewWorker = NULL;
+
+  LatencyMonitorTimer.stop();
+  this->LatencyMonitorWorker->Stop();
+  this->LatencyMonitorThread->quit();
+  this->LatencyMonitorThread->wait();
+  delete this->LatencyMonitorWorker;
+  this->LatencyMonitorWorker = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -257,7 +333,38 @@ PlusStatus QTemporalCalibrationToolbox::ReadConfiguration(vtkXMLDataElement* aCo
   }
 
   std::vector<int> clipping = this->TemporalCalibrationAlgo->GetVideoClipRectangle();
-  this->LineSegmenter->SetClipRectangle(clipping.data(), &(clipping.data()[2]));
+  this->LineSegmentationPreviewWorker->SetClipRectangle(clipping);
+
+  // Lag search range and acceptance threshold of the result
+  double temporalCalibrationMaximumLagSec = 0.0;
+  if (fCalElement->GetScalarAttribute("TemporalCalibrationMaximumLagSec", temporalCalibrationMaximumLagSec))
+  {
+    this->TemporalCalibrationWorker->GetLagEstimator()->SetMaximumLagSec(temporalCalibrationMaximumLagSec);
+    this->LatencyMonitorWorker->SetMaximumLagSec(temporalCalibrationMaximumLagSec);
+  }
+  double temporalCalibrationMinimumCorrelation = 0.0;
+  if (fCalElement->GetScalarAttribute("TemporalCalibrationMinimumCorrelation", temporalCalibrationMinimumCorrelation))
+  {
+    this->TemporalCalibrationWorker->GetLagEstimator()->SetMinimumCorrelation(temporalCalibrationMinimumCorrelation);
+    this->LatencyMonitorWorker->SetMinimumCorrelation(temporalCalibrationMinimumCorrelation);
+  }
+
+  // Latency monitoring
+  double temporalLatencyMonitorWindowSec = 0.0;
+  if (fCalElement->GetScalarAttribute("TemporalLatencyMonitorWindowSec", temporalLatencyMonitorWindowSec))
+  {
+    this->LatencyMonitorWindowSec = temporalLatencyMonitorWindowSec;
+  }
+  double temporalLatencyMonitorIntervalSec = 0.0;
+  if (fCalElement->GetScalarAttribute("TemporalLatencyMonitorIntervalSec", temporalLatencyMonitorIntervalSec))
+  {
+    this->LatencyMonitorIntervalSec = temporalLatencyMonitorIntervalSec;
+  }
+  double temporalLatencyMonitorAlertThresholdSec = 0.0;
+  if (fCalElement->GetScalarAttribute("TemporalLatencyMonitorAlertThresholdSec", temporalLatencyMonitorAlertThresholdSec))
+  {
+    this->LatencyMonitorAlertThresholdSec = temporalLatencyMonitorAlertThresholdSec;
+  }
 
   if (fCalElement->GetAttribute("FixedChannelId") != NULL)
   {
@@ -290,75 +397,79 @@ void QTemporalCalibrationToolbox::RefreshContent()
     return;
   }
 
-  vtkPlusDataSource* selectedChannelVideoSource;
-  m_ParentMainWindow->GetVisualizationController()->GetSelectedChannel()->GetVideoSource(selectedChannelVideoSource);
+  vtkPlusDataSource* selectedChannelVideoSource = NULL;
+  if (m_ParentMainWindow->GetVisualizationController()->GetSelectedChannel()->GetVideoSource(selectedChannelVideoSource) != PLUS_SUCCESS
+      || selectedChannelVideoSource == NULL)
+  {
+    return;
+  }
+
+  // Fixed and moving signals may come from the same video source, the preview frame is taken only once
+  vtkPlusChannel* previewChannel = NULL;
   if (this->FixedChannel != NULL && this->FixedType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO)
   {
-    igsioTrackedFrame frame;
-    if (this->FixedChannel->GetTrackedFrame(frame) == PLUS_SUCCESS)
+    vtkPlusDataSource* fixedVideoSource = NULL;
+    if (this->FixedChannel->GetVideoSource(fixedVideoSource) == PLUS_SUCCESS && fixedVideoSource == selectedChannelVideoSource)
     {
-      vtkPlusDataSource* fixedVideoSource;
-      this->FixedChannel->GetVideoSource(fixedVideoSource);
-      if (fixedVideoSource != nullptr &&
-          fixedVideoSource == selectedChannelVideoSource
-         )
-      {
-        SegmentAndDisplayLine(frame);
-      }
+      previewChannel = this->FixedChannel;
     }
   }
-
-  if (this->MovingChannel != NULL && this->MovingType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO)
+  if (previewChannel == NULL && this->MovingChannel != NULL && this->MovingType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO)
   {
-    igsioTrackedFrame frame;
-    if (this->MovingChannel->GetTrackedFrame(frame) == PLUS_SUCCESS)
+    vtkPlusDataSource* movingVideoSource = NULL;
+    if (this->MovingChannel->GetVideoSource(movingVideoSource) == PLUS_SUCCESS && movingVideoSource == selectedChannelVideoSource)
     {
-      vtkPlusDataSource* movingVideoSource;
-      this->MovingChannel->GetVideoSource(movingVideoSource);
-      if (movingVideoSource != nullptr &&
-          movingVideoSource == selectedChannelVideoSource
-         )
-      {
-        SegmentAndDisplayLine(frame);
-      }
+      previewChannel = this->MovingChannel;
     }
   }
+  if (previewChannel == NULL)
+  {
+    return;
+  }
+
+  // Copy and segment the frame only if a new one has arrived since the last refresh
+  BufferItemUidType latestFrameUid = selectedChannelVideoSource->GetLatestItemUidInBuffer();
+  if (selectedChannelVideoSource == this->LastPreviewedVideoSource && latestFrameUid == this->LastPreviewedFrameUid)
+  {
+    return;
+  }
+
+  igsioTrackedFrame* frame = new igsioTrackedFrame();
+  if (previewChannel->GetTrackedFrame(*frame) != PLUS_SUCCESS)
+  {
+    delete frame;
+    return;
+  }
+  this->LastPreviewedVideoSource = selectedChannelVideoSource;
+  this->LastPreviewedFrameUid = latestFrameUid;
+
+  // The segmentation result is displayed in LineSegmentationPreviewAvailable
+  this->LineSegmentationPreviewWorker->SubmitFrame(frame);
 }
 
 //----------------------------------------------------------------------------
-void QTemporalCalibrationToolbox::SegmentAndDisplayLine(igsioTrackedFrame& frame)
+void QTemporalCalibrationToolbox::LineSegmentationPreviewAvailable()
 {
-  // Try segmenting the line from the image
-  this->LineSegmenter->SetTrackedFrame(frame);
-  this->LineSegmenter->SetSaveIntermediateImages(false);
-  if (this->LineSegmenter->Update() == PLUS_SUCCESS)
-  {
-    std::vector<vtkPlusLineSegmentationAlgo::LineParameters> parameters;
-    this->LineSegmenter->GetDetectedLineParameters(parameters);
-    if (parameters[0].lineDetected)
-    {
-      auto dimensions = frame.GetImageData()->GetImage()->GetDimensions();
-      double p1[3] = { parameters[0].lineOriginPoint_Image[0] - 100000 * parameters[0].lineDirectionVector_Image[0],
-                       parameters[0].lineOriginPoint_Image[1] - 100000 * parameters[0].lineDirectionVector_Image[1],
-                       0.0
-                     };
-      double p2[3] = { parameters[0].lineOriginPoint_Image[0] + 100000 * parameters[0].lineDirectionVector_Image[0],
-                       parameters[0].lineOriginPoint_Image[1] + 100000 * parameters[0].lineDirectionVector_Image[1],
-                       0.0
-                     };
-      double r1[3], r2[3];
-      double t1, t2;
-      int plane1, plane2;
-      double bounds[6] = { 0.0, static_cast<double>(dimensions[0]), 0.0, static_cast<double>(dimensions[1]), 0.0, 1.0 };
-      vtkBox::IntersectWithLine(bounds, p1, p2, t1, t2, r1, r2, plane1, plane2);
-
-      m_ParentMainWindow->GetVisualizationController()->SetLineSegmentationPoints(r1, r2);
-      m_ParentMainWindow->GetVisualizationController()->SetLineSegmentationVisible(true);
-    }
-    else
-    {
-      m_ParentMainWindow->GetVisualizationController()->SetLineSegmentationVisible(false);
-    }
+  if (this->FixedChannel == NULL && this->MovingChannel == NULL)
+  {
+    // Toolbox has been deactivated since the frame was submitted
+    return;
+  }
+
+  QLineSegmentationPreviewWorker::Line line;
+  if (!this->LineSegmentationPreviewWorker->GetLatestLine(line))
+  {
+    return;
+  }
+
+  if (line.Detected)
+  {
+    m_ParentMainWindow->GetVisualizationController()->SetLineSegmentationPoints(line.StartPoint_Image, line.EndPoint_Image);
+    m_ParentMainWindow->GetVisualizationController()->SetLineSegmentationVisible(true);
+  }
+  else
+  {
+    m_ParentMainWindow->GetVisualizationController()->SetLineSegmentationVisible(false);
   }
 }
 
@@ -442,6 +553,7 @@ void QTemporalCalibrationToolbox::SetDisplayAccordingToState()
     ui.comboBox_MovingChannelValue->setEnabled(false);
     ui.comboBox_FixedSourceValue->setEnabled(false);
     ui.comboBox_MovingSourceValue->setEnabled(false);
+    ui.checkBox_MonitorLatency->setEnabled(false);
   }
   else if (m_State == ToolboxState_Idle)
   {
@@ -465,6 +577,7 @@ void QTemporalCalibrationToolbox::SetDisplayAccordingToState()
     ui.comboBox_MovingChannelValue->setEnabled(true);
     ui.comboBox_FixedSourceValue->setEnabled(ui.comboBox_FixedSourceValue->count() > 0);
     ui.comboBox_MovingSourceValue->setEnabled(ui.comboBox_MovingSourceValue->count() > 0);
+    ui.checkBox_MonitorLatency->setEnabled(true);
 
     QApplication::restoreOverrideCursor();
   }
@@ -482,6 +595,7 @@ void QTemporalCalibrationToolbox::SetDisplayAccordingToState()
     ui.comboBox_MovingChannelValue->setEnabled(true);
     ui.comboBox_FixedSourceValue->setEnabled(ui.comboBox_FixedSourceValue->count() > 0);
     ui.comboBox_MovingSourceValue->setEnabled(ui.comboBox_MovingSourceValue->count() > 0);
+    ui.checkBox_MonitorLatency->setEnabled(true);
   }
   else if (m_State == ToolboxState_InProgress)
   {
@@ -495,6 +609,7 @@ void QTemporalCalibrationToolbox::SetDisplayAccordingToState()
     ui.comboBox_MovingChannelValue->setEnabled(false);
     ui.comboBox_FixedSourceValue->setEnabled(false);
     ui.comboBox_MovingSourceValue->setEnabled(false);
+    ui.checkBox_MonitorLatency->setEnabled(true);
   }
   else if (m_State == ToolboxState_Done)
   {
@@ -518,6 +633,7 @@ void QTemporalCalibrationToolbox::SetDisplayAccordingToState()
     ui.comboBox_MovingChannelValue->setEnabled(true);
     ui.comboBox_FixedSourceValue->setEnabled(ui.comboBox_FixedSourceValue->count() > 0);
     ui.comboBox_MovingSourceValue->setEnabled(ui.comboBox_MovingSourceValue->count() > 0);
+    ui.checkBox_MonitorLatency->setEnabled(true);
 
     QApplication::restoreOverrideCursor();
   }
@@ -534,6 +650,7 @@ void QTemporalCalibrationToolbox::SetDisplayAccordingToState()
     ui.comboBox_MovingChannelValue->setEnabled(false);
     ui.comboBox_FixedSourceValue->setEnabled(false);
     ui.comboBox_MovingSourceValue->setEnabled(false);
+    ui.checkBox_MonitorLatency->setEnabled(false);
 
     QApplication::restoreOverrideCursor();
   }
@@ -606,13 +723,11 @@ void QTemporalCalibrationToolbox::StartCalibration()
   // Set the local time offset to 0 before synchronization
   QString curFixedType = ui.comboBox_FixedSourceValue->currentData().toString();
   this->FixedType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO;
-  this->TemporalCalibrationFixedData->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
+  this->FixedValidationTransformName.Clear();
   if (QString::compare(curFixedType, QString("Video")) != 0)
   {
     this->FixedType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER;
-    this->TemporalCalibrationFixedData->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP | REQUIRE_TRACKING_OK);
     this->FixedValidationTransformName.SetTransformName(std::string(ui.comboBox_FixedSourceValue->currentText().toLatin1()).c_str());
-    this->TemporalCalibrationFixedData->SetFrameTransformNameForValidation(this->FixedValidationTransformName);
     LOG_DEBUG("Temporal calibration fixed signal: " << this->FixedValidationTransformName.GetTransformName() << " transform in channel " << (this->FixedChannel->GetChannelId() ? this->FixedChannel->GetChannelId() : "(undefined)"));
   }
   else
@@ -623,13 +738,11 @@ void QTemporalCalibrationToolbox::StartCalibration()
 
   QString curMovingType = ui.comboBox_MovingSourceValue->itemData(ui.comboBox_MovingSourceValue->currentIndex()).toString();
   this->MovingType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO;
-  this->TemporalCalibrationMovingData->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
+  this->MovingValidationTransformName.Clear();
   if (QString::compare(curMovingType, QString("Video")) != 0)
   {
     this->MovingType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER;
-    this->TemporalCalibrationMovingData->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP | REQUIRE_TRACKING_OK);
     this->MovingValidationTransformName.SetTransformName(std::string(ui.comboBox_MovingSourceValue->currentText().toLatin1()).c_str());
-    this->TemporalCalibrationMovingData->SetFrameTransformNameForValidation(this->MovingValidationTransformName);
     LOG_DEBUG("Temporal calibration moving signal: " << this->MovingValidationTransformName.GetTransformName() << " transform in channel " << (this->MovingChannel->GetChannelId() ? this->MovingChannel->GetChannelId() : "(undefined)"));
   }
   else
@@ -638,8 +751,9 @@ void QTemporalCalibrationToolbox::StartCalibration()
   }
   this->PreviousMovingOffset = this->MovingChannel->GetOwnerDevice()->GetLocalTimeOffsetSec();
 
-  TemporalCalibrationFixedData->Clear();
-  TemporalCalibrationMovingData->Clear();
+  this->TemporalCalibrationSignalWorker->Start(this->FixedType, this->FixedValidationTransformName,
+                                               this->MovingType, this->MovingValidationTransformName,
+                                               this->TemporalCalibrationAlgo->GetVideoClipRectangle());
 
   double currentTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
   LastRecordedFixedItemTimestamp = UNDEFINED_TIMESTAMP; // means start from latest
@@ -657,52 +771,72 @@ void QTemporalCalibrationToolbox::StartCalibration()
 //-----------------------------------------------------------------------------
 void QTemporalCalibrationToolbox::ComputeCalibrationResults()
 {
-  // Create dialog
-  QDialog* temporalCalibrationDialog = new QDialog(this, Qt::Dialog);
-  temporalCalibrationDialog->setMinimumSize(QSize(360, 80));
-  temporalCalibrationDialog->setWindowTitle(tr("fCal"));
-  temporalCalibrationDialog->setStyleSheet("QDialog { background-color: rgb(224, 224, 224); }");
-
-  QLabel* temporalCalibrationLabel = new QLabel(QString("Computing temporal calibration, please wait..."), temporalCalibrationDialog);
-  temporalCalibrationLabel->setFont(QFont("SansSerif", 16));
-
-  QHBoxLayout* layout = new QHBoxLayout();
-  layout->addWidget(temporalCalibrationLabel);
-
-  temporalCalibrationDialog->setLayout(layout);
-  temporalCalibrationDialog->show();
+  LOG_TRACE("TemporalCalibrationToolbox::ComputeCalibrationResults");
+
+  std::vector<double> fixedTimestamps;
+  std::vector<double> fixedPositions;
+  std::vector<double> movingTimestamps;
+  std::vector<double> movingPositions;
+  if (m_State != ToolboxState_InProgress
+      || this->TemporalCalibrationSignalWorker->GetSignals(fixedTimestamps, fixedPositions, movingTimestamps, movingPositions) != PLUS_SUCCESS)
+  {
+    // Cancelled while the last recorded frames were processed
+    return;
+  }
 
   ui.label_InstructionsTemporal->setText(tr("Please wait until computing temporal calibration is finished"));
   m_ParentMainWindow->SetStatusBarText(QString(" Computing temporal calibration"));
+  m_ParentMainWindow->SetStatusBarProgress(0);
+
+  if (this->TemporalCalibrationWorker->IsRunning())
+  {
+    // Computation of a cancelled calibration may still be running
+    this->TemporalCalibrationWorker->RequestCancel();
+    this->TemporalCalibrationWorker->WaitForFinished();
+  }
+
+  // A coarse sweep of the whole lag range is refined at 1ms resolution
+  this->TemporalCalibrationWorker->GetLagEstimator()->SetSamplingResolutionSec(0.001);
+  this->TemporalCalibrationWorker->GetLagEstimator()->SetCoarseSamplingResolutionSec(0.01);
+  this->TemporalCalibrationWorker->SetSignals(fixedTimestamps, fixedPositions, movingTimestamps, movingPositions);
 
-  QApplication::processEvents();
+  // The Cancel button remains active, the result is processed in CalibrationComputationFinished
+  this->TemporalCalibrationWorker->Start();
+}
 
-  this->TemporalCalibrationAlgo->SetFixedFrames(TemporalCalibrationFixedData, this->FixedType);
-  if (this->FixedType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER)
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationToolbox::CalibrationComputationProgressChanged(int aPercent, QString aMessage)
+{
+  if (m_State != ToolboxState_InProgress)
   {
-    this->TemporalCalibrationAlgo->SetFixedProbeToReferenceTransformName(std::string(ui.comboBox_FixedSourceValue->currentText().toLatin1()));
+    return;
   }
-  this->TemporalCalibrationAlgo->SetMovingFrames(TemporalCalibrationMovingData, this->MovingType);
-  if (this->MovingType == vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER)
+
+  m_ParentMainWindow->SetStatusBarText(aMessage);
+  m_ParentMainWindow->SetStatusBarProgress(aPercent);
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationToolbox::CalibrationComputationFinished(bool aSuccess, bool aCancelled)
+{
+  LOG_TRACE("TemporalCalibrationToolbox::CalibrationComputationFinished(" << (aSuccess ? "true" : "false") << ", " << (aCancelled ? "true" : "false") << ")");
+
+  if (aCancelled || m_State != ToolboxState_InProgress)
   {
-    this->TemporalCalibrationAlgo->SetMovingProbeToReferenceTransformName(std::string(ui.comboBox_MovingSourceValue->currentText().toLatin1()));
+    // The toolbox state has already been reset by CancelCalibration
+    return;
   }
 
-  this->TemporalCalibrationAlgo->SetSamplingResolutionSec(0.001);
+  PlusTemporalLagEstimator* lagEstimator = this->TemporalCalibrationWorker->GetLagEstimator();
 
-  //  Calculate the time-offset
-  vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR error = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NONE;
   std::string errorStr;
   std::ostringstream strs;
-  if (this->TemporalCalibrationAlgo->Update(error) != PLUS_SUCCESS)
+  if (!aSuccess)
   {
-    switch (error)
+    switch (this->TemporalCalibrationWorker->GetError())
     {
       case vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_RESULT_ABOVE_THRESHOLD:
-        double correlation;
-        this->TemporalCalibrationAlgo->GetBestCorrelation(correlation);
-
-        strs << "Result above threshold. " << correlation;
+        strs << "Correlation of the signals is too low: " << lagEstimator->GetBestCorrelation();
         errorStr = strs.str();
         break;
       case vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_INVALID_TRANSFORM_NAME:
@@ -724,7 +858,7 @@ void QTemporalCalibrationToolbox::ComputeCalibrationResults()
         errorStr = "Data not in MF orientation.";
         break;
       case vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NOT_ENOUGH_FIXED_FRAMES:
-        errorStr = "Not enough frames in fixed signal.";
+        errorStr = (lagEstimator->IsMovingSignalTooShort() ? "Not enough frames in moving signal." : "Not enough frames in fixed signal.");
         break;
       case vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NO_FRAMES_IN_ULTRASOUND_DATA:
         errorStr = "No frames in ultrasound data.";
@@ -744,26 +878,11 @@ void QTemporalCalibrationToolbox::ComputeCalibrationResults()
     ui.label_State->setPalette(palette);
     ui.label_State->setText(QString(errorStr.c_str()));
 
-    temporalCalibrationDialog->done(0);
-    temporalCalibrationDialog->hide();
-    delete temporalCalibrationDialog;
-
     return;
   }
 
   // Get result
-  double movingLagSec = 0;
-  if (this->TemporalCalibrationAlgo->GetMovingLagSec(movingLagSec) != PLUS_SUCCESS)
-  {
-    LOG_ERROR("Cannot determine time lag, temporal calibration failed");
-    CancelCalibration();
-
-    temporalCalibrationDialog->done(0);
-    temporalCalibrationDialog->hide();
-    delete temporalCalibrationDialog;
-
-    return;
-  }
+  double movingLagSec = lagEstimator->GetMovingLagSec();
 
   LOG_INFO("Temporal calibration result: moving stream lags by " << movingLagSec << "s");
 
@@ -776,18 +895,17 @@ void QTemporalCalibrationToolbox::ComputeCalibrationResults()
   ui.label_State->setText(tr("Current moving time offset: %1 s").arg(movingLagSec));
 
   // Save metric tables
-  this->TemporalCalibrationAlgo->GetFixedPositionSignal(this->FixedPositionMetric);
+  lagEstimator->GetFixedPositionSignal(this->FixedPositionMetric);
   this->FixedPositionMetric->GetColumn(0)->SetName("Time [s]");
   this->FixedPositionMetric->GetColumn(1)->SetName("Fixed signal");
-  this->TemporalCalibrationAlgo->GetUncalibratedMovingPositionSignal(this->UncalibratedMovingPositionMetric);
+  lagEstimator->GetUncalibratedMovingPositionSignal(this->UncalibratedMovingPositionMetric);
   this->UncalibratedMovingPositionMetric->GetColumn(0)->SetName("Time [s]");
   this->UncalibratedMovingPositionMetric->GetColumn(1)->SetName("Moving signal before calibration");
-  this->TemporalCalibrationAlgo->GetCalibratedMovingPositionSignal(this->CalibratedMovingPositionMetric);
+  lagEstimator->GetCalibratedMovingPositionSignal(this->CalibratedMovingPositionMetric);
   this->CalibratedMovingPositionMetric->GetColumn(0)->SetName("Time [s]");
   this->CalibratedMovingPositionMetric->GetColumn(1)->SetName("Moving signal after calibration");
 
-  TemporalCalibrationFixedData->Clear();
-  TemporalCalibrationMovingData->Clear();
+  this->TemporalCalibrationSignalWorker->Stop();
 
   SetState(ToolboxState_Done);
 
@@ -796,11 +914,6 @@ void QTemporalCalibrationToolbox::ComputeCalibrationResults()
   ui.pushButton_StartCancelTemporal->setText(tr("Start"));
 
   m_ParentMainWindow->SetToolboxesEnabled(true);
-
-  // Close dialog
-  temporalCalibrationDialog->done(0);
-  temporalCalibrationDialog->hide();
-  delete temporalCalibrationDialog;
 }
 
 //-----------------------------------------------------------------------------
@@ -818,7 +931,9 @@ void QTemporalCalibrationToolbox::DoCalibration()
 
     // The prescribed data collection time is up
     m_ParentMainWindow->GetVisualizationController()->SetLineSegmentationVisible(false);
-    ComputeCalibrationResults();
+
+    // The calibration is computed when the worker has processed the remaining frames
+    this->TemporalCalibrationSignalWorker->Finish();
     return;
   }
 
@@ -830,19 +945,14 @@ void QTemporalCalibrationToolbox::DoCalibration()
     return;
   }
 
-  int numberOfFixedFramesBeforeRecording = TemporalCalibrationFixedData->GetNumberOfTrackedFrames();
-  int numberOfMovingFramesBeforeRecording = TemporalCalibrationMovingData->GetNumberOfTrackedFrames();
-
-  vtkPlusDataSource* selectedChannelVideoSource;
-  m_ParentMainWindow->GetVisualizationController()->GetSelectedChannel()->GetVideoSource(selectedChannelVideoSource);
+  // Frames are reduced to positions in the worker thread and then released, so memory use does not grow with the images
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> fixedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   if (this->FixedChannel != NULL)
   {
-    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-    if (this->FixedChannel->GetTrackedFrameList(this->LastRecordedFixedItemTimestamp, frameList, 50) != PLUS_SUCCESS)
+    if (this->FixedChannel->GetTrackedFrameList(this->LastRecordedFixedItemTimestamp, fixedFrameList, 50) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to add data to fixed frame list.");
     }
-    this->TemporalCalibrationFixedData->AddTrackedFrameList(frameList, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME);
   }
   else
   {
@@ -850,14 +960,13 @@ void QTemporalCalibrationToolbox::DoCalibration()
     CancelCalibration();
     return;
   }
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> movingFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   if (this->MovingChannel != NULL)
   {
-    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-    if (this->MovingChannel->GetTrackedFrameList(this->LastRecordedMovingItemTimestamp, frameList, 50) != PLUS_SUCCESS)
+    if (this->MovingChannel->GetTrackedFrameList(this->LastRecordedMovingItemTimestamp, movingFrameList, 50) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to add data to moving frame list.");
     }
-    this->TemporalCalibrationMovingData->AddTrackedFrameList(frameList, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME);
   }
   else
   {
@@ -866,10 +975,11 @@ void QTemporalCalibrationToolbox::DoCalibration()
     return;
   }
 
+  this->TemporalCalibrationSignalWorker->AddFrames(fixedFrameList, movingFrameList);
+
   // Update progress
   int progressPercent = (int)((currentTimeSec - StartTimeSec) / TemporalCalibrationDurationSec * 100.0);
   m_ParentMainWindow->SetStatusBarProgress(progressPercent);
-  LOG_DEBUG("Number of tracked frames in the calibration dataset: Fixed: " << std::setw(3) << numberOfFixedFramesBeforeRecording << " => " << TemporalCalibrationFixedData->GetNumberOfTrackedFrames() << "; Moving: " << numberOfMovingFramesBeforeRecording << " => " << TemporalCalibrationMovingData->GetNumberOfTrackedFrames());
 
   QTimer::singleShot(RecordingIntervalMs, this, SLOT(DoCalibration()));
 }
@@ -894,6 +1004,8 @@ void QTemporalCalibrationToolbox::CancelCalibration()
   else
   {
     CancelRequest = true;
+    this->TemporalCalibrationSignalWorker->Stop();
+    this->TemporalCalibrationWorker->RequestCancel();
 
     this->PreviousFixedOffset = INVALID_OFFSET;
     this->PreviousMovingOffset = INVALID_OFFSET;
@@ -1058,9 +1170,184 @@ void QTemporalCalibrationToolbox::OnDeactivated()
   this->FixedChannel = NULL;
   this->MovingChannel = NULL;
 
+  this->LineSegmentationPreviewWorker->Clear();
+  this->LastPreviewedVideoSource = NULL;
+
   m_ParentMainWindow->GetVisualizationController()->SetLineSegmentationVisible(false);
 }
 
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationToolbox::Reset()
+{
+  QAbstractToolbox::Reset();
+
+  // The monitored channels are usually removed by a disconnect
+  ui.checkBox_MonitorLatency->setChecked(false);
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationToolbox::LatencyMonitoringToggled(bool aOn)
+{
+  LOG_TRACE("TemporalCalibrationToolbox::LatencyMonitoringToggled(" << (aOn ? "true" : "false") << ")");
+
+  if (!aOn)
+  {
+    LatencyMonitorTimer.stop();
+    this->LatencyMonitorWorker->Stop();
+    this->LatencyAlertActive = false;
+    ui.label_LatencyMonitor->setPalette(QPalette());
+    ui.label_LatencyMonitor->setText(QString(""));
+    return;
+  }
+
+  // Monitor the signals that are currently selected for calibration
+  bool sameSignal = QString::compare(ui.comboBox_FixedChannelValue->currentText(), ui.comboBox_MovingChannelValue->currentText(), Qt::CaseInsensitive) == 0
+                    && QString::compare(ui.comboBox_FixedSourceValue->currentText(), ui.comboBox_MovingSourceValue->currentText(), Qt::CaseInsensitive) == 0;
+  if (ui.comboBox_FixedChannelValue->currentIndex() == -1 || ui.comboBox_MovingChannelValue->currentIndex() == -1 || sameSignal)
+  {
+    LOG_ERROR("Latency monitoring requires different fixed and moving signal sources");
+    ui.checkBox_MonitorLatency->setChecked(false);
+    return;
+  }
+
+  this->LatencyMonitorFixedChannelId = std::string(ui.comboBox_FixedChannelValue->currentText().toLatin1());
+  this->LatencyMonitorMovingChannelId = std::string(ui.comboBox_MovingChannelValue->currentText().toLatin1());
+
+  this->LatencyMonitorFixedType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO;
+  this->LatencyMonitorFixedTransformName.Clear();
+  if (QString::compare(ui.comboBox_FixedSourceValue->currentData().toString(), QString("Video")) != 0)
+  {
+    this->LatencyMonitorFixedType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER;
+    this->LatencyMonitorFixedTransformName.SetTransformName(std::string(ui.comboBox_FixedSourceValue->currentText().toLatin1()).c_str());
+  }
+  this->LatencyMonitorMovingType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_VIDEO;
+  this->LatencyMonitorMovingTransformName.Clear();
+  if (QString::compare(ui.comboBox_MovingSourceValue->currentData().toString(), QString("Video")) != 0)
+  {
+    this->LatencyMonitorMovingType = vtkPlusTemporalCalibrationAlgo::FRAME_TYPE_TRACKER;
+    this->LatencyMonitorMovingTransformName.SetTransformName(std::string(ui.comboBox_MovingSourceValue->currentText().toLatin1()).c_str());
+  }
+
+  RestartLatencyMonitoring();
+  LatencyMonitorTimer.start(RecordingIntervalMs);
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationToolbox::RestartLatencyMonitoring()
+{
+  this->LatencyMonitorWorker->SetWindowSec(this->LatencyMonitorWindowSec);
+  this->LatencyMonitorWorker->SetEstimationIntervalSec(this->LatencyMonitorIntervalSec);
+  this->LatencyMonitorWorker->Start(this->LatencyMonitorFixedType, this->LatencyMonitorFixedTransformName,
+                                    this->LatencyMonitorMovingType, this->LatencyMonitorMovingTransformName,
+                                    this->TemporalCalibrationAlgo->GetVideoClipRectangle());
+
+  this->LastMonitoredFixedItemTimestamp = UNDEFINED_TIMESTAMP; // means start from latest
+  this->LastMonitoredMovingItemTimestamp = UNDEFINED_TIMESTAMP;
+  this->LatencyMonitorRestartRequired = false;
+  this->LatencyAlertActive = false;
+
+  ui.label_LatencyMonitor->setPalette(QPalette());
+  ui.label_LatencyMonitor->setText(tr("Latency monitor: collecting data..."));
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationToolbox::MonitorLatency()
+{
+  if (m_State == ToolboxState_StartupDelay || m_State == ToolboxState_InProgress)
+  {
+    // Temporal calibration changes the time offsets, data collected before it is not comparable with data after it
+    this->LatencyMonitorRestartRequired = true;
+    return;
+  }
+  if (this->LatencyMonitorRestartRequired)
+  {
+    RestartLatencyMonitoring();
+  }
+
+  vtkPlusDataCollector* dataCollector = m_ParentMainWindow->GetVisualizationController()->GetDataCollector();
+  if (dataCollector == NULL || !dataCollector->GetConnected())
+  {
+    return;
+  }
+  vtkPlusChannel* fixedChannel = NULL;
+  vtkPlusChannel* movingChannel = NULL;
+  if (dataCollector->GetChannel(fixedChannel, this->LatencyMonitorFixedChannelId) != PLUS_SUCCESS
+      || dataCollector->GetChannel(movingChannel, this->LatencyMonitorMovingChannelId) != PLUS_SUCCESS)
+  {
+    return;
+  }
+
+  if (this->LatencyMonitorWorker->IsQueueFull())
+  {
+    // The frames are not copied now but fetched at a later call, when the worker has caught up
+    return;
+  }
+
+  // The fetch positions are updated only if both fetches succeed, so that the signals remain in sync
+  double lastFixedItemTimestamp = this->LastMonitoredFixedItemTimestamp;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> fixedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (fixedChannel->GetTrackedFrameList(lastFixedItemTimestamp, fixedFrames, 50) != PLUS_SUCCESS)
+  {
+    LOG_DEBUG("Failed to get fixed frames for latency monitoring");
+    return;
+  }
+
+  // The frames are fetched only once if both signals come from the same channel
+  double lastMovingItemTimestamp = this->LastMonitoredMovingItemTimestamp;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> movingFrames = fixedFrames;
+  if (movingChannel != fixedChannel)
+  {
+    movingFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (movingChannel->GetTrackedFrameList(lastMovingItemTimestamp, movingFrames, 50) != PLUS_SUCCESS)
+    {
+      LOG_DEBUG("Failed to get moving frames for latency monitoring");
+      return;
+    }
+  }
+
+  this->LastMonitoredFixedItemTimestamp = lastFixedItemTimestamp;
+  this->LastMonitoredMovingItemTimestamp = lastMovingItemTimestamp;
+  this->LatencyMonitorWorker->AddFrames(fixedFrames, movingFrames);
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationToolbox::LatencyEstimateAvailable()
+{
+  if (!ui.checkBox_MonitorLatency->isChecked())
+  {
+    return;
+  }
+
+  QLatencyMonitorWorker::Estimate estimate = this->LatencyMonitorWorker->GetLatestEstimate();
+  if (!estimate.Valid)
+  {
+    ui.label_LatencyMonitor->setPalette(QPalette());
+    ui.label_LatencyMonitor->setText(tr("Latency monitor: no reliable estimate, move the probe periodically (correlation: %1)").arg(estimate.Correlation, 0, 'f', 2));
+    return;
+  }
+
+  bool alert = fabs(estimate.MovingLagSec) > this->LatencyMonitorAlertThresholdSec;
+  QPalette palette;
+  if (alert)
+  {
+    palette.setColor(ui.label_LatencyMonitor->foregroundRole(), QColor::fromRgb(255, 0, 0));
+  }
+  ui.label_LatencyMonitor->setPalette(palette);
+  ui.label_LatencyMonitor->setText(tr("Latency monitor: moving stream lags by %1 ms (correlation: %2)")
+                                   .arg(estimate.MovingLagSec * 1000.0, 0, 'f', 0).arg(estimate.Correlation, 0, 'f', 2));
+
+  if (alert && !this->LatencyAlertActive)
+  {
+    LOG_WARNING("Temporal calibration drift detected: moving stream lags by " << GetTimeAsString(estimate.MovingLagSec)
+                << ", which exceeds the " << GetTimeAsString(this->LatencyMonitorAlertThresholdSec) << " threshold. Repeat temporal calibration.");
+  }
+  else if (!alert && this->LatencyAlertActive)
+  {
+    LOG_INFO("Temporal calibration drift is within the threshold again: moving stream lags by " << GetTimeAsString(estimate.MovingLagSec));
+  }
+  this->LatencyAlertActive = alert;
+}
+
 //-----------------------------------------------------------------------------
 void QTemporalCalibrationToolbox::FixedSignalChanged(int newIndex)
 {
@@ -13,7 +13,6 @@ See License.txt for details.
 
 // PlusLib includes
 #include <PlusConfigure.h>
-#include <vtkPlusLineSegmentationAlgo.h>
 #include <vtkPlusTemporalCalibrationAlgo.h>
 
 // Qt includes
@@ -22,9 +21,16 @@ See License.txt for details.
 
 // IGSIO includes
 #include <igsioCommon.h>
+#include <igsioTransformName.h>
 
+class QLatencyMonitorWorker;
+class QLineSegmentationPreviewWorker;
+class QTemporalCalibrationSignalWorker;
+class QTemporalCalibrationWorker;
+class QThread;
 class vtkContextView;
 class vtkPlusChannel;
+class vtkPlusDataSource;
 class vtkTable;
 class vtkIGSIOTrackedFrameList;
 
@@ -57,6 +63,9 @@ public:
   */
   virtual void OnDeactivated();
 
+  /*! \brief Reset toolbox to initial state (stops latency monitoring) */
+  virtual void Reset();
+
   /*!
   * Read freehand calibration configuration for fCal
   * \param aConfig Root element of the input device set configuration XML data
@@ -82,7 +91,9 @@ protected:
   static std::string GetTimeAsString(double timeSec);
 
   void SetFreeHandStartupDelaySec(int freeHandStartupDelaySec) {FreeHandStartupDelaySec = freeHandStartupDelaySec;};
-  void SegmentAndDisplayLine(igsioTrackedFrame& frame);
+
+  /*! Discard the collected latency monitoring data and start collecting again with the stored signal sources */
+  void RestartLatencyMonitoring();
 
 protected slots:
   /*! Start the delay startup timer*/
@@ -103,9 +114,15 @@ protected slots:
   /*! Slot handling cancel calibration event (button click or explicit call) */
   void CancelCalibration();
 
-  /*! Compute calibration results from the collected data and display the results */
+  /*! Start computing calibration results in the worker thread when the recorded frames are processed */
   void ComputeCalibrationResults();
 
+  /*! Show progress of the calibration computation */
+  void CalibrationComputationProgressChanged(int aPercent, QString aMessage);
+
+  /*! Apply and display the calibration results when the computation is finished */
+  void CalibrationComputationFinished(bool aSuccess, bool aCancelled);
+
   /*! A signal combo box was changed */
   void FixedSignalChanged(int newIndex);
   void MovingSignalChanged(int newIndex);
@@ -117,11 +134,27 @@ protected slots:
   /*! When the user requests to save the calibration plots */
   void OnSavePlotsRequested();
 
+  /*! Display the line segmented by the preview worker */
+  void LineSegmentationPreviewAvailable();
+
+  /*! Start or stop latency monitoring when the Monitor latency check box is toggled */
+  void LatencyMonitoringToggled(bool aOn);
+
+  /*! Pass the new frames of the monitored channels to the latency monitor (called periodically) */
+  void MonitorLatency();
+
+  /*! Display the latest latency estimate and warn if it exceeds the threshold */
+  void LatencyEstimateAvailable();
+
 protected:
-  /*! Tracked frame for tracking data for temporal calibration */
-  vtkSmartPointer<vtkIGSIOTrackedFrameList>        TemporalCalibrationFixedData;
-  /*! Tracked frame for video data for temporal calibration */
-  vtkSmartPointer<vtkIGSIOTrackedFrameList>        TemporalCalibrationMovingData;
+  /*! Thread in which the recorded frames are reduced to position signals */
+  QThread*                                        TemporalCalibrationSignalThread;
+  /*! Collects the position signals of the fixed and moving streams (lives in TemporalCalibrationSignalThread) */
+  QTemporalCalibrationSignalWorker*               TemporalCalibrationSignalWorker;
+  /*! Thread in which the lag is computed */
+  QThread*                                        TemporalCalibrationThread;
+  /*! Computes the lag between the fixed and moving signals (lives in TemporalCalibrationThread) */
+  QTemporalCalibrationWorker*                     TemporalCalibrationWorker;
   /*! Delay time before start acquisition [s] */
   int                                             FreeHandStartupDelaySec;
   /*! Current time delayed before the acquisition [s] */
@@ -175,7 +208,42 @@ protected:
   std::string                                     LastSaveDirectory;
   QPushButton*                                    SaveFileButton;
 
-  vtkSmartPointer<vtkPlusLineSegmentationAlgo>    LineSegmenter;
+  /*! Low priority thread in which the line of the live image is segmented */
+  QThread*                                        LineSegmentationPreviewThread;
+  /*! Segments the line of the live image (lives in LineSegmentationPreviewThread) */
+  QLineSegmentationPreviewWorker*                 LineSegmentationPreviewWorker;
+  /*! Video source of the last frame sent to the preview worker */
+  vtkPlusDataSource*                              LastPreviewedVideoSource;
+  /*! Buffer item UID of the last frame sent to the preview worker (the same frame is not segmented again) */
+  BufferItemUidType                               LastPreviewedFrameUid;
+
+  /*! Low priority thread in which the latency is monitored */
+  QThread*                                        LatencyMonitorThread;
+  /*! Estimates the lag on a sliding window of the live signals (lives in LatencyMonitorThread) */
+  QLatencyMonitorWorker*                          LatencyMonitorWorker;
+  /*! Timer for fetching new frames for latency monitoring */
+  QTimer                                          LatencyMonitorTimer;
+  /*! Monitored channels (looked up by id at each fetch, as the channels may be deleted on reconnect) */
+  std::string                                     LatencyMonitorFixedChannelId;
+  std::string                                     LatencyMonitorMovingChannelId;
+  /*! Monitored signal sources */
+  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE      LatencyMonitorFixedType;
+  vtkPlusTemporalCalibrationAlgo::FRAME_TYPE      LatencyMonitorMovingType;
+  igsioTransformName                               LatencyMonitorFixedTransformName;
+  igsioTransformName                               LatencyMonitorMovingTransformName;
+  /*! Timestamps of the last frames fetched for latency monitoring */
+  double                                          LastMonitoredFixedItemTimestamp;
+  double                                          LastMonitoredMovingItemTimestamp;
+  /*! Set when the time offsets may have changed, so the collected monitoring data is obsolete */
+  bool                                            LatencyMonitorRestartRequired;
+  /*! Length of the signal window used for latency monitoring [s] */
+  double                                          LatencyMonitorWindowSec;
+  /*! Time between latency estimations [s] */
+  double                                          LatencyMonitorIntervalSec;
+  /*! A warning is shown if the absolute value of the estimated lag exceeds this [s] */
+  double                                          LatencyMonitorAlertThresholdSec;
+  /*! True if the latest estimate exceeded the threshold (the warning is logged only when it is exceeded first) */
+  bool                                            LatencyAlertActive;
 
 protected:
   Ui::TemporalCalibrationToolbox ui;
@@ -0,0 +1,107 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "QTemporalCalibrationWorker.h"
+
+// Qt includes
+#include <QMutexLocker>
+
+//-----------------------------------------------------------------------------
+QTemporalCalibrationWorker::QTemporalCalibrationWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_Error(vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NONE)
+  , m_LastProgressPercent(-1)
+  , m_CancelRequested(0)
+  , m_Running(false)
+{
+  m_LagEstimator.SetProgressCallback(std::bind(&QTemporalCalibrationWorker::UpdateProgress, this, std::placeholders::_1));
+}
+
+//-----------------------------------------------------------------------------
+QTemporalCalibrationWorker::~QTemporalCalibrationWorker()
+{
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationWorker::SetSignals(const std::vector<double>& aFixedTimestamps, const std::vector<double>& aFixedPositions,
+    const std::vector<double>& aMovingTimestamps, const std::vector<double>& aMovingPositions)
+{
+  m_FixedTimestamps = aFixedTimestamps;
+  m_FixedPositions = aFixedPositions;
+  m_MovingTimestamps = aMovingTimestamps;
+  m_MovingPositions = aMovingPositions;
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationWorker::Start()
+{
+  {
+    QMutexLocker lock(&m_RunningMutex);
+    m_Running = true;
+  }
+  m_CancelRequested = 0;
+  m_LastProgressPercent = -1;
+  m_Error = vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NONE;
+
+  QMetaObject::invokeMethod(this, "Compute", Qt::QueuedConnection);
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationWorker::RequestCancel()
+{
+  m_CancelRequested = 1;
+}
+
+//-----------------------------------------------------------------------------
+bool QTemporalCalibrationWorker::IsRunning()
+{
+  QMutexLocker lock(&m_RunningMutex);
+  return m_Running;
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationWorker::WaitForFinished()
+{
+  QMutexLocker lock(&m_RunningMutex);
+  while (m_Running)
+  {
+    m_FinishedCondition.wait(&m_RunningMutex);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QTemporalCalibrationWorker::Compute()
+{
+  LOG_TRACE("QTemporalCalibrationWorker::Compute");
+
+  UpdateProgress(0.0);
+  PlusStatus status = PLUS_FAIL;
+  if (!m_CancelRequested)
+  {
+    status = m_LagEstimator.Update(m_FixedTimestamps, m_FixedPositions, m_MovingTimestamps, m_MovingPositions, m_Error);
+  }
+  bool cancelled = (m_CancelRequested != 0);
+
+  {
+    QMutexLocker lock(&m_RunningMutex);
+    m_Running = false;
+    m_FinishedCondition.wakeAll();
+  }
+
+  emit Finished(status == PLUS_SUCCESS && !cancelled, cancelled);
+}
+
+//-----------------------------------------------------------------------------
+bool QTemporalCalibrationWorker::UpdateProgress(double aProgress)
+{
+  int percent = static_cast<int>(aProgress * 100.0);
+  if (percent != m_LastProgressPercent)
+  {
+    m_LastProgressPercent = percent;
+    emit ProgressChanged(percent, QString(" Computing temporal calibration ..."));
+  }
+  return (m_CancelRequested == 0);
+}
@@ -0,0 +1,113 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef TEMPORALCALIBRATIONWORKER_H
+#define TEMPORALCALIBRATIONWORKER_H
+
+#include "PlusConfigure.h"
+#include "PlusTemporalLagEstimator.h"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QWaitCondition>
+
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+/*! \class QTemporalCalibrationWorker
+ * \brief Computes the temporal calibration lag on a worker thread
+ *
+ * The worker object is moved to a thread owned by the temporal calibration toolbox. The toolbox sets the collected
+ * position signals then calls Start(), which queues the lag computation in the worker thread. Progress and the end
+ * of the computation are reported by signals, the result can be read from the lag estimator after Finished.
+ * \ingroup PlusAppFCal
+ */
+class QTemporalCalibrationWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  QTemporalCalibrationWorker(QObject* aParent = NULL);
+  ~QTemporalCalibrationWorker();
+
+  /*! Set the position signals to compute the lag from (the vectors are copied) */
+  void SetSignals(const std::vector<double>& aFixedTimestamps, const std::vector<double>& aFixedPositions,
+                  const std::vector<double>& aMovingTimestamps, const std::vector<double>& aMovingPositions);
+
+  /*! Lag estimator that holds the parameters and the result. It must not be accessed while the computation is running. */
+  PlusTemporalLagEstimator* GetLagEstimator() { return &m_LagEstimator; };
+
+  /*! Reason of the failure of the last computation */
+  vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR GetError() const { return m_Error; };
+
+  /*! Queue the computation in the worker thread */
+  void Start();
+
+  /*! Request cancellation of the running computation. The Finished signal is still emitted. */
+  void RequestCancel();
+
+  /*! Returns true if the computation is queued or running */
+  bool IsRunning();
+
+  /*! Block until the computation is finished */
+  void WaitForFinished();
+
+signals:
+  /*!
+  * Emitted when the progress changes (at most once per percent)
+  * \param aPercent Progress in percent
+  * \param aMessage Short description of the current step
+  */
+  void ProgressChanged(int aPercent, QString aMessage);
+
+  /*!
+  * Emitted when the computation is finished
+  * \param aSuccess True if the lag was determined successfully
+  * \param aCancelled True if the computation was cancelled by the user
+  */
+  void Finished(bool aSuccess, bool aCancelled);
+
+protected slots:
+  /*! Compute the lag (executed in the worker thread) */
+  void Compute();
+
+protected:
+  /*! Progress callback of the lag estimator, returns false if cancellation is requested */
+  bool UpdateProgress(double aProgress);
+
+protected:
+  /*! Computes the lag, also stores the parameters and the result */
+  PlusTemporalLagEstimator m_LagEstimator;
+
+  /*! Input signals */
+  std::vector<double> m_FixedTimestamps;
+  std::vector<double> m_FixedPositions;
+  std::vector<double> m_MovingTimestamps;
+  std::vector<double> m_MovingPositions;
+
+  /*! Reason of the failure of the last computation */
+  vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR m_Error;
+
+  /*! Last reported progress value */
+  int m_LastProgressPercent;
+
+  /*! Set when cancellation is requested */
+  QAtomicInt m_CancelRequested;
+
+  /*! Set while a computation is queued or running */
+  bool m_Running;
+
+  /*! Guards m_Running */
+  QMutex m_RunningMutex;
+
+  /*! Signalled when the computation is finished */
+  QWaitCondition m_FinishedCondition;
+};
+
+#endif
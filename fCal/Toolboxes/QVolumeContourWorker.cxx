@@ -0,0 +1,202 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "QVolumeContourWorker.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkImageShrink3D.h>
+#include <vtkMarchingContourFilter.h>
+#include <vtkPolyData.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+// Qt includes
+#include <QMutexLocker>
+
+namespace
+{
+  /*! Maximum size of the downsampled volume along any axis, in voxels */
+  const int MAX_DOWNSAMPLED_DIMENSION = 96;
+
+  /*! Maximum number of contours cached per resolution */
+  const int MAX_CACHED_CONTOURS = 16;
+}
+
+//-----------------------------------------------------------------------------
+QVolumeContourWorker::QVolumeContourWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_Volume(NULL)
+  , m_DownsampledVolume(NULL)
+  , m_PendingThreshold(0)
+  , m_RefinementQueued(false)
+  , m_VolumeGeneration(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+QVolumeContourWorker::~QVolumeContourWorker()
+{
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeContourWorker::SetVolume(vtkImageData* aVolume)
+{
+  LOG_TRACE("QVolumeContourWorker::SetVolume");
+
+  vtkSmartPointer<vtkImageData> volume = NULL;
+  vtkSmartPointer<vtkImageData> downsampledVolume = NULL;
+  if (aVolume != NULL && aVolume->GetNumberOfPoints() > 0)
+  {
+    // The caller keeps modifying its volume (e.g., with new previews), so the worker thread needs its own copy
+    volume = vtkSmartPointer<vtkImageData>::New();
+    volume->DeepCopy(aVolume);
+
+    int dimensions[3] = {0, 0, 0};
+    volume->GetDimensions(dimensions);
+    int maxDimension = std::max(dimensions[0], std::max(dimensions[1], dimensions[2]));
+    int shrinkFactor = static_cast<int>(std::ceil(static_cast<double>(maxDimension) / MAX_DOWNSAMPLED_DIMENSION));
+    if (shrinkFactor > 1)
+    {
+      vtkSmartPointer<vtkImageShrink3D> shrinkFilter = vtkSmartPointer<vtkImageShrink3D>::New();
+      shrinkFilter->SetInputData(volume);
+      shrinkFilter->SetShrinkFactors(shrinkFactor, shrinkFactor, shrinkFactor);
+      shrinkFilter->AveragingOn();
+      shrinkFilter->Update();
+      downsampledVolume = shrinkFilter->GetOutput();
+    }
+  }
+
+  QMutexLocker locker(&m_Mutex);
+  m_Volume = volume;
+  m_DownsampledVolume = downsampledVolume;
+  m_RefinedContours.clear();
+  m_RefinedContourOrder.clear();
+  m_DownsampledContours.clear();
+  m_DownsampledContourOrder.clear();
+  ++m_VolumeGeneration;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeContourWorker::Clear()
+{
+  SetVolume(NULL);
+}
+
+//-----------------------------------------------------------------------------
+bool QVolumeContourWorker::GetContour(int aThreshold, vtkSmartPointer<vtkPolyData>& aContour)
+{
+  vtkSmartPointer<vtkImageData> downsampledVolume = NULL;
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (m_RefinedContours.contains(aThreshold))
+    {
+      aContour = m_RefinedContours.value(aThreshold);
+      return true;
+    }
+    if (m_DownsampledVolume.GetPointer() == NULL)
+    {
+      // Volume is small, contouring at full resolution is fast
+      if (m_Volume.GetPointer() == NULL)
+      {
+        aContour = vtkSmartPointer<vtkPolyData>::New();
+        return true;
+      }
+      aContour = ComputeContour(m_Volume, aThreshold);
+      AddToCache(m_RefinedContours, m_RefinedContourOrder, aThreshold, aContour);
+      return true;
+    }
+    downsampledVolume = m_DownsampledVolume;
+  }
+
+  if (m_DownsampledContours.contains(aThreshold))
+  {
+    aContour = m_DownsampledContours.value(aThreshold);
+    return false;
+  }
+
+  aContour = ComputeContour(downsampledVolume, aThreshold);
+  AddToCache(m_DownsampledContours, m_DownsampledContourOrder, aThreshold, aContour);
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeContourWorker::RequestRefinement(int aThreshold)
+{
+  QMutexLocker locker(&m_Mutex);
+  m_PendingThreshold = aThreshold;
+  if (!m_RefinementQueued)
+  {
+    m_RefinementQueued = true;
+    QMetaObject::invokeMethod(this, "ProcessRefinementRequest", Qt::QueuedConnection);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeContourWorker::ProcessRefinementRequest()
+{
+  int threshold = 0;
+  unsigned int volumeGeneration = 0;
+  vtkSmartPointer<vtkImageData> volume = NULL;
+  {
+    QMutexLocker locker(&m_Mutex);
+    m_RefinementQueued = false;
+    threshold = m_PendingThreshold;
+    volumeGeneration = m_VolumeGeneration;
+    volume = m_Volume;
+    if (volume.GetPointer() == NULL || m_RefinedContours.contains(threshold))
+    {
+      return;
+    }
+  }
+
+  LOG_TRACE("QVolumeContourWorker::ProcessRefinementRequest(" << threshold << ")");
+
+  vtkSmartPointer<vtkPolyData> contour = ComputeContour(volume, threshold);
+
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (volumeGeneration != m_VolumeGeneration)
+    {
+      // Volume has been changed while contouring
+      return;
+    }
+    AddToCache(m_RefinedContours, m_RefinedContourOrder, threshold, contour);
+  }
+
+  emit RefinedContourAvailable(threshold);
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> QVolumeContourWorker::ComputeContour(vtkImageData* aVolume, int aThreshold)
+{
+  vtkSmartPointer<vtkMarchingContourFilter> contourFilter = vtkSmartPointer<vtkMarchingContourFilter>::New();
+  contourFilter->SetInputData(aVolume);
+  contourFilter->SetValue(0, aThreshold);
+  contourFilter->Update();
+
+  // Detach the result from the filter
+  vtkSmartPointer<vtkPolyData> contour = vtkSmartPointer<vtkPolyData>::New();
+  contour->ShallowCopy(contourFilter->GetOutput());
+  return contour;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeContourWorker::AddToCache(QMap<int, vtkSmartPointer<vtkPolyData> >& aCache, QList<int>& aCacheOrder, int aThreshold, vtkPolyData* aContour)
+{
+  if (!aCache.contains(aThreshold))
+  {
+    aCacheOrder.append(aThreshold);
+  }
+  aCache.insert(aThreshold, aContour);
+
+  while (aCacheOrder.size() > MAX_CACHED_CONTOURS)
+  {
+    aCache.remove(aCacheOrder.takeFirst());
+  }
+}
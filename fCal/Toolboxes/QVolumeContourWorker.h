@@ -0,0 +1,108 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef VOLUMECONTOURWORKER_H
+#define VOLUMECONTOURWORKER_H
+
+#include "PlusConfigure.h"
+
+#include <vtkSmartPointer.h>
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+
+class vtkImageData;
+class vtkPolyData;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QVolumeContourWorker
+ * \brief Computes contours of a reconstructed volume at multiple resolutions
+ *
+ * A downsampled copy of the volume is contoured synchronously in the GUI thread, which is fast enough to follow the
+ * threshold slider. The full resolution contour is computed in the thread the worker is moved to, and
+ * RefinedContourAvailable is emitted when it is ready. Requests are coalesced: only the latest requested threshold
+ * is refined. Contours of both resolutions are cached per threshold until the volume changes.
+ * \ingroup PlusAppFCal
+ */
+class QVolumeContourWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  QVolumeContourWorker(QObject* aParent = NULL);
+  ~QVolumeContourWorker();
+
+  /*! Set the volume to contour. A copy is made and the cached contours are discarded. Call from the GUI thread. */
+  void SetVolume(vtkImageData* aVolume);
+
+  /*! Discard the volume and the cached contours */
+  void Clear();
+
+  /*!
+  * Get the best contour that is available without waiting. Call from the GUI thread.
+  * \param aThreshold Contouring threshold
+  * \param aContour Output contour, the full resolution one if already computed, otherwise the downsampled one
+  * \return True if the returned contour is the full resolution one
+  */
+  bool GetContour(int aThreshold, vtkSmartPointer<vtkPolyData>& aContour);
+
+  /*! Queue computation of the full resolution contour. Replaces the previous request if that has not started yet. */
+  void RequestRefinement(int aThreshold);
+
+signals:
+  /*!
+  * Emitted when the full resolution contour is computed
+  * \param aThreshold Threshold of the contour
+  */
+  void RefinedContourAvailable(int aThreshold);
+
+protected slots:
+  /*! Compute the full resolution contour of the latest request (executed in the worker thread) */
+  void ProcessRefinementRequest();
+
+protected:
+  /*! Compute a contour of a volume */
+  static vtkSmartPointer<vtkPolyData> ComputeContour(vtkImageData* aVolume, int aThreshold);
+
+  /*! Add a contour to a cache, removing the oldest entry if the cache is full */
+  static void AddToCache(QMap<int, vtkSmartPointer<vtkPolyData> >& aCache, QList<int>& aCacheOrder, int aThreshold, vtkPolyData* aContour);
+
+protected:
+  /*! Full resolution volume, replaced (never modified) when a new volume is set */
+  vtkSmartPointer<vtkImageData> m_Volume;
+
+  /*! Downsampled volume, NULL if the volume is small enough to be contoured at full resolution */
+  vtkSmartPointer<vtkImageData> m_DownsampledVolume;
+
+  /*! Full resolution contours by threshold */
+  QMap<int, vtkSmartPointer<vtkPolyData> > m_RefinedContours;
+
+  /*! Thresholds of the full resolution contours in the order they were computed */
+  QList<int> m_RefinedContourOrder;
+
+  /*! Downsampled contours by threshold (accessed only from the GUI thread) */
+  QMap<int, vtkSmartPointer<vtkPolyData> > m_DownsampledContours;
+
+  /*! Thresholds of the downsampled contours in the order they were computed */
+  QList<int> m_DownsampledContourOrder;
+
+  /*! Threshold of the latest refinement request */
+  int m_PendingThreshold;
+
+  /*! Flag indicating that a refinement request is queued in the worker thread */
+  bool m_RefinementQueued;
+
+  /*! Incremented when the volume changes, so that contours of an old volume are not cached */
+  unsigned int m_VolumeGeneration;
+
+  /*! Guards the full resolution volume, the refined contours and the request */
+  QMutex m_Mutex;
+};
+
+#endif
@@ -5,24 +5,26 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "QCapturingToolbox.h"
+#include "QVolumeContourWorker.h"
 #include "QVolumeReconstructionToolbox.h"
+#include "QVolumeReconstructionWorker.h"
 #include "fCalMainWindow.h"
 #include "vtkPlusVisualizationController.h"
 
 // PlusLib includes
-#include <vtkPlusSequenceIO.h>
 #include <vtkIGSIOTrackedFrameList.h>
 #include <vtkPlusVolumeReconstructor.h>
 
 // VTK includes
 #include <vtkImageData.h>
-#include <vtkMarchingContourFilter.h>
+#include <vtkPolyData.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkRenderer.h>
 #include <vtkXMLUtilities.h>
 
 // Qt includes
 #include <QFileDialog>
+#include <QThread>
 
 //-----------------------------------------------------------------------------
 QVolumeReconstructionToolbox::QVolumeReconstructionToolbox(fCalMainWindow* aParentMainWindow, Qt::WindowFlags aFlags)
@@ -30,6 +32,10 @@ QVolumeReconstructionToolbox::QVolumeReconstructionToolbox(fCalMainWindow* aPare
   , QWidget(aParentMainWindow, aFlags)
   , m_VolumeReconstructor(NULL)
   , m_ReconstructedVolume(NULL)
+  , m_ReconstructionThread(NULL)
+  , m_ReconstructionWorker(NULL)
+  , m_ContourThread(NULL)
+  , m_ContourWorker(NULL)
   , m_VolumeReconstructionConfigFileLoaded(false)
   , m_VolumeReconstructionComplete(false)
   , m_ContouringThreshold(64.0)
@@ -39,6 +45,22 @@ QVolumeReconstructionToolbox::QVolumeReconstructionToolbox(fCalMainWindow* aPare
   m_VolumeReconstructor = vtkPlusVolumeReconstructor::New();
   m_ReconstructedVolume = vtkImageData::New();
 
+  // Reconstruction runs in a worker thread so that the UI stays responsive
+  m_ReconstructionThread = new QThread(this);
+  m_ReconstructionWorker = new QVolumeReconstructionWorker();
+  m_ReconstructionWorker->moveToThread(m_ReconstructionThread);
+  connect(m_ReconstructionWorker, SIGNAL(ProgressChanged(int, QString)), this, SLOT(ReconstructionProgressChanged(int, QString)));
+  connect(m_ReconstructionWorker, SIGNAL(PreviewVolumeAvailable()), this, SLOT(ReconstructionPreviewAvailable()));
+  connect(m_ReconstructionWorker, SIGNAL(Finished(bool, bool)), this, SLOT(ReconstructionFinished(bool, bool)));
+  m_ReconstructionThread->start();
+
+  // Full resolution contours are computed in the background while a downsampled contour is shown
+  m_ContourThread = new QThread(this);
+  m_ContourWorker = new QVolumeContourWorker();
+  m_ContourWorker->moveToThread(m_ContourThread);
+  connect(m_ContourWorker, SIGNAL(RefinedContourAvailable(int)), this, SLOT(RefinedContourAvailable(int)));
+  m_ContourThread->start();
+
   // Connect events
   connect(ui.pushButton_OpenVolumeReconstructionConfig, SIGNAL(clicked()), this, SLOT(OpenVolumeReconstructionConfig()));
   connect(ui.pushButton_OpenInputImage, SIGNAL(clicked()), this, SLOT(OpenInputImage()));
@@ -53,6 +75,17 @@ QVolumeReconstructionToolbox::QVolumeReconstructionToolbox(fCalMainWindow* aPare
 //-----------------------------------------------------------------------------
 QVolumeReconstructionToolbox::~QVolumeReconstructionToolbox()
 {
+  StopReconstruction();
+  m_ReconstructionThread->quit();
+  m_ReconstructionThread->wait();
+  delete m_ReconstructionWorker;
+  m_ReconstructionWorker = NULL;
+
+  m_ContourThread->quit();
+  m_ContourThread->wait();
+  delete m_ContourWorker;
+  m_ContourWorker = NULL;
+
   if (m_VolumeReconstructor != NULL)
   {
     m_VolumeReconstructor->Delete();
@@ -104,12 +137,6 @@ void QVolumeReconstructionToolbox::RefreshContent()
   //LOG_TRACE("VolumeReconstructionToolbox::RefreshContent");
 
   ui.label_ContouringThreshold->setText(QString::number(m_ContouringThreshold));
-
-  if (m_State == ToolboxState_InProgress)
-  {
-    // Needed for forced refreshing the UI (without this, no progress is shown)
-    QApplication::processEvents();
-  }
 }
 
 //-----------------------------------------------------------------------------
@@ -198,6 +225,8 @@ void QVolumeReconstructionToolbox::SetDisplayAccordingToState()
   {
     ui.label_Instructions->setText(tr("N/A"));
     ui.horizontalSlider_ContouringThreshold->setEnabled(m_VolumeReconstructionComplete);
+    ui.checkBox_ParallelInsertion->setEnabled(true);
+    ui.checkBox_StreamFromFile->setEnabled(true);
     ui.pushButton_Save->setEnabled(m_VolumeReconstructionComplete);
 
     if (! m_VolumeReconstructionConfigFileLoaded)
@@ -221,10 +250,13 @@ void QVolumeReconstructionToolbox::SetDisplayAccordingToState()
   }
   else if (m_State == ToolboxState_InProgress)
   {
-    ui.label_Instructions->setText("");
+    ui.label_Instructions->setText(tr("Press Cancel button to stop reconstruction"));
     ui.horizontalSlider_ContouringThreshold->setEnabled(false);
+    ui.checkBox_ParallelInsertion->setEnabled(false);
+    ui.checkBox_StreamFromFile->setEnabled(false);
 
-    ui.pushButton_Reconstruct->setEnabled(false);
+    // Reconstruct button acts as cancel button during reconstruction
+    ui.pushButton_Reconstruct->setEnabled(true);
     ui.pushButton_Save->setEnabled(false);
 
   }
@@ -232,6 +264,8 @@ void QVolumeReconstructionToolbox::SetDisplayAccordingToState()
   {
     ui.label_Instructions->setText("Reconstruction done");
     ui.horizontalSlider_ContouringThreshold->setEnabled(true);
+    ui.checkBox_ParallelInsertion->setEnabled(true);
+    ui.checkBox_StreamFromFile->setEnabled(true);
 
     ui.pushButton_Reconstruct->setEnabled(false);
     ui.pushButton_Save->setEnabled(true);
@@ -321,17 +355,33 @@ void QVolumeReconstructionToolbox::Reconstruct()
 {
   LOG_TRACE("VolumeReconstructionToolbox::Reconstruct");
 
-  QApplication::setOverrideCursor(QCursor(Qt::BusyCursor));
-
   if (ReconstructVolumeFromInputImage() != PLUS_SUCCESS)
   {
     LOG_ERROR("Unable to reconstruct volume!");
     SetState(ToolboxState_Error);
   }
+}
 
-  QApplication::restoreOverrideCursor();
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionToolbox::CancelReconstruction()
+{
+  LOG_TRACE("VolumeReconstructionToolbox::CancelReconstruction");
 
-  LOG_INFO("Volume reconstruction performed successfully");
+  // The worker reports the end of the reconstruction by the Finished signal
+  m_ReconstructionWorker->RequestCancel();
+  ui.pushButton_Reconstruct->setEnabled(false);
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionToolbox::StopReconstruction()
+{
+  if (m_ReconstructionWorker == NULL || !m_ReconstructionWorker->IsRunning())
+  {
+    return;
+  }
+
+  m_ReconstructionWorker->RequestCancel();
+  m_ReconstructionWorker->WaitForFinished();
 }
 
 //-----------------------------------------------------------------------------
@@ -362,23 +412,25 @@ PlusStatus QVolumeReconstructionToolbox::ReconstructVolumeFromInputImage()
 {
   LOG_TRACE("VolumeReconstructionToolbox::ReconstructVolumeFromInputImage");
 
-  SetState(ToolboxState_InProgress);
-
-  // Read image
-  m_ParentMainWindow->SetStatusBarText(QString(" Reading image sequence ..."));
-  m_ParentMainWindow->SetStatusBarProgress(0);
-  RefreshContent();
+  if (m_ReconstructionWorker->IsRunning())
+  {
+    LOG_ERROR("Volume reconstruction is already in progress!");
+    return PLUS_FAIL;
+  }
 
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = NULL;
+  m_ReconstructionWorker->SetTrackedFrameList(NULL);
+  m_ReconstructionWorker->SetInputFileName("");
 
   if (ui.comboBox_InputImage->currentText().left(1) == "<" && ui.comboBox_InputImage->currentText().right(1) == ">")       // If unsaved image is selected
   {
+    vtkIGSIOTrackedFrameList* trackedFrameList = NULL;
     QCapturingToolbox* capturingToolbox = dynamic_cast<QCapturingToolbox*>(m_ParentMainWindow->GetToolbox(ToolboxType_Capturing));
     if ((capturingToolbox == NULL) || ((trackedFrameList = capturingToolbox->GetRecordedFrames()) == NULL))
     {
       LOG_ERROR("Unable to get recorded frame list from Capturing toolbox!");
       return PLUS_FAIL;
     }
+    m_ReconstructionWorker->SetTrackedFrameList(trackedFrameList);
   }
   else
   {
@@ -391,63 +443,93 @@ PlusStatus QVolumeReconstructionToolbox::ReconstructVolumeFromInputImage()
     {
       imageFileNameIndex = ui.comboBox_InputImage->currentIndex();
     }
-    trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-    if (vtkPlusSequenceIO::Read(m_ImageFileNames.at(imageFileNameIndex).toLatin1().constData(), trackedFrameList) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to load input image file!");
-      return PLUS_FAIL;
-    }
+    m_ReconstructionWorker->SetInputFileName(m_ImageFileNames.at(imageFileNameIndex).toLatin1().constData());
   }
 
-
-  m_ParentMainWindow->SetStatusBarText(QString(" Reconstructing volume ..."));
-  m_ParentMainWindow->SetStatusBarProgress(0);
-  RefreshContent();
-
   m_VolumeReconstructor->SetReferenceCoordinateFrame(m_ParentMainWindow->GetReferenceCoordinateFrame().c_str());
   m_VolumeReconstructor->SetImageCoordinateFrame(m_ParentMainWindow->GetImageCoordinateFrame().c_str());
 
-  std::string errorDetail;
-  if (m_VolumeReconstructor->SetOutputExtentFromFrameList(trackedFrameList,
-      m_ParentMainWindow->GetVisualizationController()->GetTransformRepository(), errorDetail) == PLUS_FAIL)
+  // The worker gets a copy of the transform repository, the one used for visualization is not modified
+  if (m_ReconstructionWorker->SetTransformRepository(m_ParentMainWindow->GetVisualizationController()->GetTransformRepository()) != PLUS_SUCCESS)
   {
+    LOG_ERROR("Failed to copy transform repository for volume reconstruction!");
     return PLUS_FAIL;
   }
+  m_ReconstructionWorker->SetVolumeReconstructor(m_VolumeReconstructor);
+  m_ReconstructionWorker->SetCoordinateFrames(m_ParentMainWindow->GetImageCoordinateFrame(), m_ParentMainWindow->GetReferenceCoordinateFrame());
+  m_ReconstructionWorker->SetNumberOfPartitions(ui.checkBox_ParallelInsertion->isChecked() ? QThread::idealThreadCount() : 1);
+  m_ReconstructionWorker->SetStreamFromFile(ui.checkBox_StreamFromFile->isChecked());
+
+  SetState(ToolboxState_InProgress);
+
+  // Recorded frames must not change and the reconstructor must not be replaced while the worker uses them
+  m_ParentMainWindow->SetToolboxesEnabled(false);
+
+  disconnect(ui.pushButton_Reconstruct, SIGNAL(clicked()), this, SLOT(Reconstruct()));
+  connect(ui.pushButton_Reconstruct, SIGNAL(clicked()), this, SLOT(CancelReconstruction()));
+  ui.pushButton_Reconstruct->setText(tr("Cancel"));
+
+  m_ParentMainWindow->SetStatusBarText(QString(" Reading image sequence ..."));
+  m_ParentMainWindow->SetStatusBarProgress(0);
+
+  m_ReconstructionWorker->Start();
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionToolbox::ReconstructionProgressChanged(int aPercent, QString aMessage)
+{
+  m_ParentMainWindow->SetStatusBarText(aMessage);
+  m_ParentMainWindow->SetStatusBarProgress(aPercent);
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionToolbox::ReconstructionPreviewAvailable()
+{
+  LOG_TRACE("VolumeReconstructionToolbox::ReconstructionPreviewAvailable");
 
-  const int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
-  for (int frameIndex = 0; frameIndex < numberOfFrames; frameIndex += m_VolumeReconstructor->GetSkipInterval())
+  if (m_State != ToolboxState_InProgress)
   {
-    // Set progress
-    m_ParentMainWindow->SetStatusBarProgress((int)((100.0 * frameIndex) / numberOfFrames + 0.49));
-    RefreshContent();
+    return;
+  }
+
+  m_ReconstructionWorker->GetPreviewVolume(m_ReconstructedVolume);
+  DisplayReconstructedVolume();
+  m_ParentMainWindow->GetVisualizationController()->EnableVolumeActor(true);
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionToolbox::ReconstructionFinished(bool aSuccess, bool aCancelled)
+{
+  LOG_TRACE("VolumeReconstructionToolbox::ReconstructionFinished(" << (aSuccess ? "true" : "false") << ", " << (aCancelled ? "true" : "false") << ")");
+
+  disconnect(ui.pushButton_Reconstruct, SIGNAL(clicked()), this, SLOT(CancelReconstruction()));
+  connect(ui.pushButton_Reconstruct, SIGNAL(clicked()), this, SLOT(Reconstruct()));
+  ui.pushButton_Reconstruct->setText(tr("Reconstruct"));
+
+  m_ParentMainWindow->SetToolboxesEnabled(true);
 
-    igsioTrackedFrame* frame = trackedFrameList->GetTrackedFrame(frameIndex);
+  if (!aSuccess)
+  {
+    // The reconstructor contains an incomplete volume now, it cannot be saved or displayed
+    m_VolumeReconstructionComplete = false;
+    m_ParentMainWindow->SetStatusBarText(QString(""));
+    m_ParentMainWindow->SetStatusBarProgress(-1);
 
-    if (m_ParentMainWindow->GetVisualizationController()->GetTransformRepository()->SetTransforms(*frame) != PLUS_SUCCESS)
+    if (aCancelled)
     {
-      LOG_ERROR("Failed to update transform repository with frame #" << frameIndex);
-      continue;
+      SetState(ToolboxState_Idle);
     }
-
-    // Add this tracked frame to the reconstructor
-    bool insertedIntoVolume = false;
-    if (m_VolumeReconstructor->AddTrackedFrame(frame, m_ParentMainWindow->GetVisualizationController()->GetTransformRepository(), frameIndex == 0, frameIndex == numberOfFrames-1, &insertedIntoVolume) != PLUS_SUCCESS)
+    else
     {
-      LOG_ERROR("Failed to add tracked frame to volume with frame #" << frameIndex);
-      continue;
+      LOG_ERROR("Unable to reconstruct volume!");
+      SetState(ToolboxState_Error);
     }
+    return;
   }
 
-  m_ParentMainWindow->SetStatusBarProgress(0);
-  RefreshContent();
-
-  trackedFrameList->Clear();
-
-  m_ParentMainWindow->SetStatusBarProgress(0);
-  m_ParentMainWindow->SetStatusBarText(QString(" Filling holes in output volume..."));
-  RefreshContent();
-
-  m_VolumeReconstructor->ExtractGrayLevels(m_ReconstructedVolume);
+  m_ReconstructionWorker->GetReconstructedVolume(m_ReconstructedVolume);
 
   // Display result
   DisplayReconstructedVolume();
@@ -458,7 +540,7 @@ PlusStatus QVolumeReconstructionToolbox::ReconstructVolumeFromInputImage()
 
   SetState(ToolboxState_Done);
 
-  return PLUS_SUCCESS;
+  LOG_INFO("Volume reconstruction performed successfully");
 }
 
 //-----------------------------------------------------------------------------
@@ -466,20 +548,48 @@ void QVolumeReconstructionToolbox::DisplayReconstructedVolume()
 {
   LOG_TRACE("VolumeReconstructionToolbox::DisplayReconstructedVolume");
 
-  m_ParentMainWindow->SetStatusBarText(QString(" Generating contour for displaying..."));
+  // Contours of the previous volume are discarded
+  m_ContourWorker->SetVolume(m_ReconstructedVolume);
+
+  DisplayContour();
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionToolbox::DisplayContour()
+{
+  LOG_TRACE("VolumeReconstructionToolbox::DisplayContour");
+
   RefreshContent();
 
-  vtkSmartPointer<vtkMarchingContourFilter> contourFilter = vtkSmartPointer<vtkMarchingContourFilter>::New();
-  contourFilter->SetInputData(m_ReconstructedVolume);
-  contourFilter->SetValue(0, m_ContouringThreshold);
+  int threshold = static_cast<int>(m_ContouringThreshold);
+  vtkSmartPointer<vtkPolyData> contour;
+  bool refined = m_ContourWorker->GetContour(threshold, contour);
+  if (!refined)
+  {
+    m_ContourWorker->RequestRefinement(threshold);
+  }
 
   vtkSmartPointer<vtkPolyDataMapper> contourMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-  contourMapper->SetInputConnection(contourFilter->GetOutputPort());
+  contourMapper->SetInputData(contour);
 
   m_ParentMainWindow->GetVisualizationController()->SetVolumeMapper(contourMapper);
   m_ParentMainWindow->GetVisualizationController()->SetVolumeColor(0.0, 0.0, 1.0);
 }
 
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionToolbox::RefinedContourAvailable(int aThreshold)
+{
+  LOG_TRACE("VolumeReconstructionToolbox::RefinedContourAvailable(" << aThreshold << ")");
+
+  // Threshold may have changed since the refinement was requested
+  if (aThreshold != static_cast<int>(m_ContouringThreshold))
+  {
+    return;
+  }
+
+  DisplayContour();
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus QVolumeReconstructionToolbox::SaveVolumeToFile(QString aOutput)
 {
@@ -487,7 +597,16 @@ PlusStatus QVolumeReconstructionToolbox::SaveVolumeToFile(QString aOutput)
 
   if (aOutput.right(3).toLower() == QString("mha"))
   {
-    if (m_VolumeReconstructor->SaveReconstructedVolumeToMetafile(aOutput.toStdString()) != PLUS_SUCCESS)
+    // Volumes that are merged from partitions are not stored in the reconstructor
+    if (m_ReconstructionWorker->IsResultMergedFromPartitions())
+    {
+      if (vtkPlusVolumeReconstructor::SaveReconstructedVolumeToMetafile(m_ReconstructedVolume, aOutput.toStdString()) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to save reconstructed volume in sequence metafile!");
+        return PLUS_FAIL;
+      }
+    }
+    else if (m_VolumeReconstructor->SaveReconstructedVolumeToMetafile(aOutput.toStdString()) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to save reconstructed volume in sequence metafile!");
       return PLUS_FAIL;
@@ -577,18 +696,23 @@ void QVolumeReconstructionToolbox::RecomputeContourFromReconstructedVolume(int a
 
   m_ContouringThreshold = ui.horizontalSlider_ContouringThreshold->value();
 
-  LOG_INFO("Recomputing controur from reconstructed volume using threshold " << m_ContouringThreshold);
+  LOG_DEBUG("Recomputing contour from reconstructed volume using threshold " << m_ContouringThreshold);
 
-  DisplayReconstructedVolume();
+  DisplayContour();
 }
 
 //-----------------------------------------------------------------------------
 void QVolumeReconstructionToolbox::Reset()
 {
+  // The reconstructor is replaced, so the worker must not use it anymore
+  StopReconstruction();
+
   QAbstractToolbox::Reset();
 
   m_VolumeReconstructionComplete = false;
 
+  m_ContourWorker->Clear();
+
   if (m_VolumeReconstructor != NULL)
   {
     m_VolumeReconstructor->Delete();
@@ -14,6 +14,9 @@
 
 #include <QWidget>
 
+class QThread;
+class QVolumeContourWorker;
+class QVolumeReconstructionWorker;
 class vtkPlusVolumeReconstructor;
 class vtkImageData;
 
@@ -67,11 +70,14 @@ public:
 
 protected:
   /*!
-  * Reconstructs volume from input file
+  * Starts reconstructing volume from the selected input in the worker thread
   * \return Success flag
   */
   PlusStatus ReconstructVolumeFromInputImage();
 
+  /*! Cancel the running reconstruction and block until the worker thread stops using the reconstructor */
+  void StopReconstruction();
+
   /*!
   * Saves volume to file
   * \param aOutput Output file
@@ -79,9 +85,12 @@ protected:
   */
   PlusStatus SaveVolumeToFile(QString aOutput);
 
-  /*! Display reconstructed volume in canvas */
+  /*! Display reconstructed volume in canvas (call when the volume has changed) */
   void DisplayReconstructedVolume();
 
+  /*! Display the contour of the reconstructed volume at the current threshold, refining it in the background if needed */
+  void DisplayContour();
+
   /*!
   * Populate image combobox from the image file name list and the unsaved data in Capturing toolbox if present
   */
@@ -100,12 +109,27 @@ protected slots:
   /*! Slot handling open reconstruct button click  */
   void Reconstruct();
 
+  /*! Slot handling cancel button click (the reconstruct button turns into cancel during reconstruction) */
+  void CancelReconstruction();
+
   /*! Slot handling open save button click */
   void Save();
 
+  /*! Show reconstruction progress reported by the worker */
+  void ReconstructionProgressChanged(int aPercent, QString aMessage);
+
+  /*! Display the partial volume reported by the worker */
+  void ReconstructionPreviewAvailable();
+
+  /*! Display the result when the worker is finished */
+  void ReconstructionFinished(bool aSuccess, bool aCancelled);
+
   /*! Recompute the surface that is shown from the reconstructed volume when slider is moved */
   void RecomputeContourFromReconstructedVolume(int aValue);
 
+  /*! Replace the displayed downsampled contour by the full resolution one */
+  void RefinedContourAvailable(int aThreshold);
+
 protected:
   /*! Volume reconstructor instance */
   vtkPlusVolumeReconstructor*  m_VolumeReconstructor;
@@ -113,6 +137,18 @@ protected:
   /*! Reconstructed volume */
   vtkImageData*            m_ReconstructedVolume;
 
+  /*! Thread in which the reconstruction runs */
+  QThread*                m_ReconstructionThread;
+
+  /*! Worker that performs the reconstruction (lives in m_ReconstructionThread) */
+  QVolumeReconstructionWorker* m_ReconstructionWorker;
+
+  /*! Thread in which the full resolution contours are computed */
+  QThread*                m_ContourThread;
+
+  /*! Worker that computes and caches contours (lives in m_ContourThread) */
+  QVolumeContourWorker*   m_ContourWorker;
+
   /*! Flag indicating whether a volume reconstruction config file has been loaded successfully */
   bool                    m_VolumeReconstructionConfigFileLoaded;
 
@@ -0,0 +1,606 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusSequenceFileStreamReader.h"
+#include "QVolumeReconstructionWorker.h"
+
+// PlusLib includes
+#include <vtkIGSIOTrackedFrameList.h>
+#include <vtkIGSIOTransformRepository.h>
+#include <vtkPlusPasteSliceIntoVolume.h>
+#include <vtkPlusSequenceIO.h>
+#include <vtkPlusVolumeReconstructor.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkXMLDataElement.h>
+
+// STL includes
+#include <algorithm>
+
+// Qt includes
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+namespace
+{
+  //-----------------------------------------------------------------------------
+  /*! Inserts a contiguous range of frames into a private reconstructor */
+  class FrameInsertionTask : public QRunnable
+  {
+  public:
+    FrameInsertionTask()
+      : Reconstructor(vtkSmartPointer<vtkPlusVolumeReconstructor>::New())
+      , TransformRepository(vtkSmartPointer<vtkIGSIOTransformRepository>::New())
+      , TrackedFrameList(NULL)
+      , FirstFrameIndex(0)
+      , EndFrameIndex(0)
+      , SkipInterval(1)
+      , CancelRequested(NULL)
+      , NumberOfProcessedFrames(NULL)
+    {
+      setAutoDelete(false);
+    }
+
+    virtual void run()
+    {
+      for (int frameIndex = FirstFrameIndex; frameIndex < EndFrameIndex; frameIndex += SkipInterval)
+      {
+        if (*CancelRequested)
+        {
+          return;
+        }
+
+        igsioTrackedFrame* frame = TrackedFrameList->GetTrackedFrame(frameIndex);
+        if (TransformRepository->SetTransforms(*frame) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to update transform repository with frame #" << frameIndex);
+        }
+        else if (Reconstructor->AddTrackedFrame(frame, TransformRepository, frameIndex == FirstFrameIndex, frameIndex + SkipInterval >= EndFrameIndex) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to add tracked frame to volume with frame #" << frameIndex);
+        }
+        NumberOfProcessedFrames->fetchAndAddRelaxed(1);
+      }
+    }
+
+    vtkSmartPointer<vtkPlusVolumeReconstructor> Reconstructor;
+    vtkSmartPointer<vtkIGSIOTransformRepository> TransformRepository;
+    vtkIGSIOTrackedFrameList* TrackedFrameList;
+    int FirstFrameIndex;
+    int EndFrameIndex;
+    int SkipInterval;
+    QAtomicInt* CancelRequested;
+    QAtomicInt* NumberOfProcessedFrames;
+  };
+
+  //-----------------------------------------------------------------------------
+  /*! Merge partial volumes by averaging the voxel values weighted by the accumulation buffers */
+  template <class T>
+  void MergePartialVolumes(const std::vector<vtkSmartPointer<vtkImageData> >& aGrayLevels, const std::vector<vtkSmartPointer<vtkImageData> >& aAccumulations, vtkImageData* aMergedVolume)
+  {
+    const vtkIdType numberOfVoxels = aMergedVolume->GetNumberOfPoints();
+    T* mergedVoxels = static_cast<T*>(aMergedVolume->GetScalarPointer());
+    std::vector<T*> grayVoxels;
+    std::vector<unsigned short*> weights;
+    for (unsigned int i = 0; i < aGrayLevels.size(); ++i)
+    {
+      grayVoxels.push_back(static_cast<T*>(aGrayLevels[i]->GetScalarPointer()));
+      weights.push_back(static_cast<unsigned short*>(aAccumulations[i]->GetScalarPointer()));
+    }
+
+    for (vtkIdType voxelIndex = 0; voxelIndex < numberOfVoxels; ++voxelIndex)
+    {
+      double weightedSum = 0.0;
+      double weightSum = 0.0;
+      for (unsigned int i = 0; i < grayVoxels.size(); ++i)
+      {
+        double weight = weights[i][voxelIndex];
+        weightedSum += weight * grayVoxels[i][voxelIndex];
+        weightSum += weight;
+      }
+      mergedVoxels[voxelIndex] = (weightSum > 0.0 ? static_cast<T>(weightedSum / weightSum + 0.5) : static_cast<T>(0));
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+QVolumeReconstructionWorker::QVolumeReconstructionWorker(QObject* aParent)
+  : QObject(aParent)
+  , m_VolumeReconstructor(NULL)
+  , m_TrackedFrameList(NULL)
+  , m_InputFileName("")
+  , m_TransformRepository(NULL)
+  , m_PreviewIntervalPercent(25)
+  , m_LastProgressPercent(-1)
+  , m_NumberOfPartitions(1)
+  , m_ImageCoordinateFrame("")
+  , m_ReferenceCoordinateFrame("")
+  , m_ResultMergedFromPartitions(false)
+  , m_StreamFromFile(false)
+  , m_PreviewVolume(vtkSmartPointer<vtkImageData>::New())
+  , m_ReconstructedVolume(vtkSmartPointer<vtkImageData>::New())
+  , m_CancelRequested(0)
+  , m_Running(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+QVolumeReconstructionWorker::~QVolumeReconstructionWorker()
+{
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::SetVolumeReconstructor(vtkPlusVolumeReconstructor* aVolumeReconstructor)
+{
+  m_VolumeReconstructor = aVolumeReconstructor;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::SetTrackedFrameList(vtkIGSIOTrackedFrameList* aTrackedFrameList)
+{
+  m_TrackedFrameList = aTrackedFrameList;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::SetInputFileName(const std::string& aInputFileName)
+{
+  m_InputFileName = aInputFileName;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QVolumeReconstructionWorker::SetTransformRepository(vtkIGSIOTransformRepository* aTransformRepository)
+{
+  if (aTransformRepository == NULL)
+  {
+    LOG_ERROR("Invalid transform repository!");
+    return PLUS_FAIL;
+  }
+
+  m_TransformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (m_TransformRepository->DeepCopy(aTransformRepository, true) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to copy transform repository!");
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::SetPreviewIntervalPercent(int aPreviewIntervalPercent)
+{
+  m_PreviewIntervalPercent = aPreviewIntervalPercent;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::SetNumberOfPartitions(int aNumberOfPartitions)
+{
+  m_NumberOfPartitions = (aNumberOfPartitions < 1 ? 1 : aNumberOfPartitions);
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::SetCoordinateFrames(const std::string& aImageCoordinateFrame, const std::string& aReferenceCoordinateFrame)
+{
+  m_ImageCoordinateFrame = aImageCoordinateFrame;
+  m_ReferenceCoordinateFrame = aReferenceCoordinateFrame;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::SetStreamFromFile(bool aStreamFromFile)
+{
+  m_StreamFromFile = aStreamFromFile;
+}
+
+//-----------------------------------------------------------------------------
+bool QVolumeReconstructionWorker::IsResultMergedFromPartitions()
+{
+  QMutexLocker lock(&m_VolumeMutex);
+  return m_ResultMergedFromPartitions;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::Start()
+{
+  {
+    QMutexLocker lock(&m_RunningMutex);
+    m_Running = true;
+  }
+  m_CancelRequested = 0;
+  m_LastProgressPercent = -1;
+
+  QMetaObject::invokeMethod(this, "Reconstruct", Qt::QueuedConnection);
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::RequestCancel()
+{
+  m_CancelRequested = 1;
+}
+
+//-----------------------------------------------------------------------------
+bool QVolumeReconstructionWorker::IsRunning()
+{
+  QMutexLocker lock(&m_RunningMutex);
+  return m_Running;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::WaitForFinished()
+{
+  QMutexLocker lock(&m_RunningMutex);
+  while (m_Running)
+  {
+    m_FinishedCondition.wait(&m_RunningMutex);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::GetPreviewVolume(vtkImageData* aVolume)
+{
+  QMutexLocker lock(&m_VolumeMutex);
+  aVolume->DeepCopy(m_PreviewVolume);
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::GetReconstructedVolume(vtkImageData* aVolume)
+{
+  QMutexLocker lock(&m_VolumeMutex);
+  aVolume->DeepCopy(m_ReconstructedVolume);
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::Reconstruct()
+{
+  LOG_TRACE("QVolumeReconstructionWorker::Reconstruct");
+
+  PlusStatus status = DoReconstruction();
+  bool cancelled = (m_CancelRequested != 0);
+
+  // Release the inputs so that the frames are not kept in memory until the next reconstruction
+  m_TrackedFrameList = NULL;
+  m_TransformRepository = NULL;
+
+  {
+    QMutexLocker lock(&m_RunningMutex);
+    m_Running = false;
+    m_FinishedCondition.wakeAll();
+  }
+
+  emit Finished(status == PLUS_SUCCESS && !cancelled, cancelled);
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QVolumeReconstructionWorker::DoReconstruction()
+{
+  if (m_VolumeReconstructor == NULL || m_TransformRepository == NULL)
+  {
+    LOG_ERROR("Volume reconstruction worker is not initialized!");
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = m_TrackedFrameList;
+
+  // Frames of a file are read one by one during insertion, if the file format allows it
+  PlusSequenceFileStreamReader streamReader;
+  bool streamFrames = false;
+  if (trackedFrameList == NULL && m_StreamFromFile)
+  {
+    if (m_NumberOfPartitions > 1)
+    {
+      LOG_INFO("Frames cannot be streamed from file with parallel frame insertion, the whole sequence is loaded into memory");
+    }
+    else
+    {
+      SetProgress(0, QString(" Reading image sequence header ..."));
+      streamFrames = (streamReader.Open(m_InputFileName) == PLUS_SUCCESS);
+      if (!streamFrames)
+      {
+        LOG_INFO("Frames cannot be streamed from " << m_InputFileName << ", the whole sequence is loaded into memory");
+      }
+    }
+  }
+
+  if (trackedFrameList == NULL && !streamFrames)
+  {
+    SetProgress(0, QString(" Reading image sequence ..."));
+    trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (vtkPlusSequenceIO::Read(m_InputFileName, trackedFrameList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to load input image file!");
+      return PLUS_FAIL;
+    }
+  }
+
+  if (m_CancelRequested)
+  {
+    return PLUS_FAIL;
+  }
+
+  m_LastProgressPercent = -1;
+  SetProgress(0, QString(" Reconstructing volume ..."));
+
+  // Hole filling needs the accumulation buffer of all frames, so it can only be done by a single reconstructor
+  bool insertInParallel = (!streamFrames && m_NumberOfPartitions > 1 && trackedFrameList->GetNumberOfTrackedFrames() >= 2 * m_NumberOfPartitions);
+  if (insertInParallel && m_VolumeReconstructor->GetFillHoles())
+  {
+    LOG_WARNING("Parallel frame insertion is not available when hole filling is enabled. Frames are inserted sequentially.");
+    insertInParallel = false;
+  }
+  // Partial volumes are merged by their accumulation weighted mean, which gives the same result as a single reconstructor only for mean compounding
+  if (insertInParallel && m_VolumeReconstructor->GetCompoundingMode() != vtkPlusPasteSliceIntoVolume::MEAN_COMPOUNDING_MODE)
+  {
+    LOG_WARNING("Parallel frame insertion is only available with mean compounding. Frames are inserted sequentially.");
+    insertInParallel = false;
+  }
+
+  vtkSmartPointer<vtkImageData> reconstructedVolume = vtkSmartPointer<vtkImageData>::New();
+  PlusStatus status = PLUS_FAIL;
+  if (insertInParallel)
+  {
+    status = InsertFramesInParallel(trackedFrameList, reconstructedVolume);
+  }
+  else
+  {
+    status = InsertFramesSequentially(trackedFrameList, streamFrames ? &streamReader : NULL, reconstructedVolume);
+  }
+
+  if (status != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (trackedFrameList != NULL)
+  {
+    trackedFrameList->Clear();
+  }
+
+  {
+    QMutexLocker lock(&m_VolumeMutex);
+    m_ReconstructedVolume = reconstructedVolume;
+    m_ResultMergedFromPartitions = insertInParallel;
+  }
+
+  SetProgress(100, QString(" Generating contour for displaying..."));
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QVolumeReconstructionWorker::InsertFramesSequentially(vtkIGSIOTrackedFrameList* aTrackedFrameList, PlusSequenceFileStreamReader* aStreamReader, vtkImageData* aReconstructedVolume)
+{
+  // When streaming, the extent is computed from frames that contain only the transforms (first pass)
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> extentFrameList = aTrackedFrameList;
+  if (aStreamReader != NULL)
+  {
+    extentFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (aStreamReader->ReadFrameHeaders(extentFrameList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read frame headers of the input sequence!");
+      return PLUS_FAIL;
+    }
+  }
+
+  std::string errorDetail;
+  if (m_VolumeReconstructor->SetOutputExtentFromFrameList(extentFrameList, m_TransformRepository, errorDetail) == PLUS_FAIL)
+  {
+    LOG_ERROR("Failed to set output extent of volume: " << errorDetail);
+    return PLUS_FAIL;
+  }
+
+  const int numberOfFrames = extentFrameList->GetNumberOfTrackedFrames();
+  if (aStreamReader != NULL)
+  {
+    extentFrameList = NULL;
+  }
+
+  // Second pass: frames are read from the file one by one, only a single frame image is kept in memory
+  igsioTrackedFrame streamedFrame;
+  int lastPreviewPercent = 0;
+  for (int frameIndex = 0; frameIndex < numberOfFrames; frameIndex += m_VolumeReconstructor->GetSkipInterval())
+  {
+    if (m_CancelRequested)
+    {
+      LOG_INFO("Volume reconstruction cancelled by the user");
+      return PLUS_FAIL;
+    }
+
+    int percent = (int)((100.0 * frameIndex) / numberOfFrames + 0.49);
+    SetProgress(percent, QString(" Reconstructing volume ..."));
+
+    igsioTrackedFrame* frame = NULL;
+    if (aStreamReader != NULL)
+    {
+      streamedFrame = igsioTrackedFrame();
+      if (aStreamReader->ReadFrame(frameIndex, streamedFrame) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to read frame #" << frameIndex << " from the input sequence");
+        continue;
+      }
+      frame = &streamedFrame;
+    }
+    else
+    {
+      frame = aTrackedFrameList->GetTrackedFrame(frameIndex);
+    }
+
+    if (m_TransformRepository->SetTransforms(*frame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to update transform repository with frame #" << frameIndex);
+      continue;
+    }
+
+    // Add this tracked frame to the reconstructor
+    bool insertedIntoVolume = false;
+    if (m_VolumeReconstructor->AddTrackedFrame(frame, m_TransformRepository, frameIndex == 0, frameIndex == numberOfFrames - 1, &insertedIntoVolume) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add tracked frame to volume with frame #" << frameIndex);
+      continue;
+    }
+
+    // Publish a partial volume from time to time so that the user can see how the reconstruction progresses.
+    // Holes are not filled in the preview, as that would take about as long as filling the final volume.
+    if (m_PreviewIntervalPercent > 0 && percent - lastPreviewPercent >= m_PreviewIntervalPercent && percent < 100)
+    {
+      lastPreviewPercent = percent;
+      vtkSmartPointer<vtkImageData> previewVolume = vtkSmartPointer<vtkImageData>::New();
+      int fillHoles = m_VolumeReconstructor->GetFillHoles();
+      m_VolumeReconstructor->SetFillHoles(0);
+      PlusStatus previewStatus = m_VolumeReconstructor->ExtractGrayLevels(previewVolume);
+      m_VolumeReconstructor->SetFillHoles(fillHoles);
+      if (previewStatus == PLUS_SUCCESS)
+      {
+        {
+          QMutexLocker lock(&m_VolumeMutex);
+          m_PreviewVolume = previewVolume;
+        }
+        emit PreviewVolumeAvailable();
+      }
+    }
+  }
+
+  m_LastProgressPercent = -1;
+  SetProgress(0, QString(" Filling holes in output volume..."));
+
+  if (m_VolumeReconstructor->ExtractGrayLevels(aReconstructedVolume) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to extract gray levels from reconstructed volume!");
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus QVolumeReconstructionWorker::InsertFramesInParallel(vtkIGSIOTrackedFrameList* aTrackedFrameList, vtkImageData* aReconstructedVolume)
+{
+  // All partition reconstructors use the same settings as the main reconstructor
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  configRootElement->SetName("PlusConfiguration");
+  if (m_VolumeReconstructor->WriteConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get volume reconstructor configuration for parallel frame insertion!");
+    return PLUS_FAIL;
+  }
+
+  const int numberOfFrames = aTrackedFrameList->GetNumberOfTrackedFrames();
+  const int skipInterval = m_VolumeReconstructor->GetSkipInterval();
+  const int numberOfInsertedFrames = (numberOfFrames + skipInterval - 1) / skipInterval;
+
+  // Partitions are contiguous ranges of frames, aligned to the skip interval
+  std::vector<FrameInsertionTask*> tasks;
+  QAtomicInt numberOfProcessedFrames(0);
+  PlusStatus status = PLUS_SUCCESS;
+  for (int partitionIndex = 0; partitionIndex < m_NumberOfPartitions; ++partitionIndex)
+  {
+    FrameInsertionTask* task = new FrameInsertionTask();
+    tasks.push_back(task);
+    task->TrackedFrameList = aTrackedFrameList;
+    task->FirstFrameIndex = (numberOfInsertedFrames * partitionIndex / m_NumberOfPartitions) * skipInterval;
+    task->EndFrameIndex = std::min(numberOfFrames, (numberOfInsertedFrames * (partitionIndex + 1) / m_NumberOfPartitions) * skipInterval);
+    task->SkipInterval = skipInterval;
+    task->CancelRequested = &m_CancelRequested;
+    task->NumberOfProcessedFrames = &numberOfProcessedFrames;
+
+    std::string errorDetail;
+    if (task->Reconstructor->ReadConfiguration(configRootElement) != PLUS_SUCCESS
+        || task->TransformRepository->DeepCopy(m_TransformRepository, true) != PLUS_SUCCESS
+        || task->Reconstructor->SetOutputExtentFromFrameList(aTrackedFrameList, task->TransformRepository, errorDetail) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to initialize reconstructor of partition " << partitionIndex << ": " << errorDetail);
+      status = PLUS_FAIL;
+      break;
+    }
+    task->Reconstructor->SetImageCoordinateFrame(m_ImageCoordinateFrame.c_str());
+    task->Reconstructor->SetReferenceCoordinateFrame(m_ReferenceCoordinateFrame.c_str());
+    // Parallelism comes from the partitions, so the reconstructors do not need their own threads
+    task->Reconstructor->SetNumberOfThreads(1);
+  }
+
+  if (status == PLUS_SUCCESS)
+  {
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(m_NumberOfPartitions);
+    for (std::vector<FrameInsertionTask*>::iterator taskIt = tasks.begin(); taskIt != tasks.end(); ++taskIt)
+    {
+      threadPool.start(*taskIt);
+    }
+    while (!threadPool.waitForDone(100))
+    {
+      SetProgress((int)((100.0 * numberOfProcessedFrames) / numberOfInsertedFrames + 0.49), QString(" Reconstructing volume ..."));
+    }
+
+    if (m_CancelRequested)
+    {
+      LOG_INFO("Volume reconstruction cancelled by the user");
+      status = PLUS_FAIL;
+    }
+  }
+
+  // Merge the partial volumes
+  if (status == PLUS_SUCCESS)
+  {
+    m_LastProgressPercent = -1;
+    SetProgress(0, QString(" Merging partial volumes..."));
+
+    std::vector<vtkSmartPointer<vtkImageData> > grayLevels;
+    std::vector<vtkSmartPointer<vtkImageData> > accumulations;
+    for (std::vector<FrameInsertionTask*>::iterator taskIt = tasks.begin(); taskIt != tasks.end(); ++taskIt)
+    {
+      vtkSmartPointer<vtkImageData> grayLevel = vtkSmartPointer<vtkImageData>::New();
+      vtkSmartPointer<vtkImageData> accumulation = vtkSmartPointer<vtkImageData>::New();
+      if ((*taskIt)->Reconstructor->ExtractGrayLevels(grayLevel) != PLUS_SUCCESS
+          || (*taskIt)->Reconstructor->ExtractAccumulation(accumulation) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to extract partial volume!");
+        status = PLUS_FAIL;
+        break;
+      }
+      if (accumulation->GetScalarType() != VTK_UNSIGNED_SHORT || accumulation->GetNumberOfPoints() != grayLevel->GetNumberOfPoints()
+          || grayLevel->GetNumberOfScalarComponents() != 1)
+      {
+        LOG_ERROR("Unexpected partial volume format, volumes cannot be merged!");
+        status = PLUS_FAIL;
+        break;
+      }
+      grayLevels.push_back(grayLevel);
+      accumulations.push_back(accumulation);
+    }
+
+    if (status == PLUS_SUCCESS)
+    {
+      aReconstructedVolume->DeepCopy(grayLevels[0]);
+      switch (aReconstructedVolume->GetScalarType())
+      {
+        vtkTemplateMacro(MergePartialVolumes<VTK_TT>(grayLevels, accumulations, aReconstructedVolume));
+        default:
+          LOG_ERROR("Unsupported volume scalar type, partial volumes cannot be merged!");
+          status = PLUS_FAIL;
+      }
+      aReconstructedVolume->Modified();
+    }
+  }
+
+  for (std::vector<FrameInsertionTask*>::iterator taskIt = tasks.begin(); taskIt != tasks.end(); ++taskIt)
+  {
+    delete *taskIt;
+  }
+
+  return status;
+}
+
+//-----------------------------------------------------------------------------
+void QVolumeReconstructionWorker::SetProgress(int aPercent, const QString& aMessage)
+{
+  if (aPercent == m_LastProgressPercent)
+  {
+    return;
+  }
+  m_LastProgressPercent = aPercent;
+  emit ProgressChanged(aPercent, aMessage);
+}
@@ -0,0 +1,192 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef VOLUMERECONSTRUCTIONWORKER_H
+#define VOLUMERECONSTRUCTIONWORKER_H
+
+#include "PlusConfigure.h"
+
+#include <vtkSmartPointer.h>
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QWaitCondition>
+
+class PlusSequenceFileStreamReader;
+class vtkIGSIOTrackedFrameList;
+class vtkIGSIOTransformRepository;
+class vtkImageData;
+class vtkPlusVolumeReconstructor;
+
+//-----------------------------------------------------------------------------
+
+/*! \class QVolumeReconstructionWorker
+ * \brief Runs volume reconstruction on a worker thread
+ *
+ * The worker object is moved to a thread owned by the volume reconstruction toolbox. The toolbox sets the inputs
+ * then calls Start(), which queues the reconstruction in the worker thread. Progress, partial previews and the final
+ * result are reported by signals. The worker uses its own copy of the transform repository, so the visualization
+ * is not affected by the reconstruction.
+ * \ingroup PlusAppFCal
+ */
+class QVolumeReconstructionWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  QVolumeReconstructionWorker(QObject* aParent = NULL);
+  ~QVolumeReconstructionWorker();
+
+  /*! Set the reconstructor to use. It must not be accessed by other threads while reconstruction is running. */
+  void SetVolumeReconstructor(vtkPlusVolumeReconstructor* aVolumeReconstructor);
+
+  /*! Set frames to reconstruct from. If not set then frames are read from the input file. */
+  void SetTrackedFrameList(vtkIGSIOTrackedFrameList* aTrackedFrameList);
+
+  /*! Set sequence file to reconstruct from (used only if no tracked frame list is set) */
+  void SetInputFileName(const std::string& aInputFileName);
+
+  /*! Set the transform repository that contains the calibration transforms. A copy is made, the original is not modified. */
+  PlusStatus SetTransformRepository(vtkIGSIOTransformRepository* aTransformRepository);
+
+  /*! Set how often a partial volume preview is published, in percent of the processed frames (0 disables previews) */
+  void SetPreviewIntervalPercent(int aPreviewIntervalPercent);
+
+  /*!
+  * Set number of frame partitions that are inserted in parallel. Each partition is reconstructed by a separate
+  * reconstructor with its own transform repository and accumulation buffer, the partial volumes are merged at the end.
+  * Each partition allocates a full size output volume and accumulation buffer, so the memory needed for the reconstruction
+  * is about twice the number of partitions times the size of the output volume.
+  * Partial volumes can only be merged with mean compounding, with other compounding modes or hole filling frames
+  * are inserted sequentially. 1 means sequential insertion into the reconstructor set by SetVolumeReconstructor.
+  */
+  void SetNumberOfPartitions(int aNumberOfPartitions);
+
+  /*! Set coordinate frame names used by the partition reconstructors */
+  void SetCoordinateFrames(const std::string& aImageCoordinateFrame, const std::string& aReferenceCoordinateFrame);
+
+  /*!
+  * Enable reading the input file frame by frame during insertion instead of loading the whole sequence into memory.
+  * The volume extent is computed in a first pass that reads only the frame fields. Used only for sequential insertion
+  * of files that PlusSequenceFileStreamReader supports, other files are loaded completely.
+  */
+  void SetStreamFromFile(bool aStreamFromFile);
+
+  /*! Returns true if the last result was merged from partitions, i.e., it is not stored in the volume reconstructor */
+  bool IsResultMergedFromPartitions();
+
+  /*! Queue the reconstruction in the worker thread */
+  void Start();
+
+  /*! Request cancellation of the running reconstruction. The Finished signal is still emitted. */
+  void RequestCancel();
+
+  /*! Returns true if reconstruction is queued or running */
+  bool IsRunning();
+
+  /*! Block until the reconstruction is finished */
+  void WaitForFinished();
+
+  /*! Copy the latest partial preview volume (holes are not filled in it) */
+  void GetPreviewVolume(vtkImageData* aVolume);
+
+  /*! Copy the result volume of the last successful reconstruction */
+  void GetReconstructedVolume(vtkImageData* aVolume);
+
+signals:
+  /*!
+  * Emitted when the progress changes (at most once per percent)
+  * \param aPercent Progress in percent
+  * \param aMessage Short description of the current step
+  */
+  void ProgressChanged(int aPercent, QString aMessage);
+
+  /*! Emitted when a new partial preview volume is available (see GetPreviewVolume) */
+  void PreviewVolumeAvailable();
+
+  /*!
+  * Emitted when reconstruction is finished
+  * \param aSuccess True if the reconstruction completed successfully
+  * \param aCancelled True if the reconstruction was cancelled by the user
+  */
+  void Finished(bool aSuccess, bool aCancelled);
+
+protected slots:
+  /*! Perform the reconstruction (executed in the worker thread) */
+  void Reconstruct();
+
+protected:
+  /*! Insert frames and extract the result volume */
+  PlusStatus DoReconstruction();
+
+  /*! Insert frames one by one into the volume reconstructor, from the frame list or from the stream reader if it is not NULL */
+  PlusStatus InsertFramesSequentially(vtkIGSIOTrackedFrameList* aTrackedFrameList, PlusSequenceFileStreamReader* aStreamReader, vtkImageData* aReconstructedVolume);
+
+  /*! Insert partitions of the frames in parallel then merge the partial volumes */
+  PlusStatus InsertFramesInParallel(vtkIGSIOTrackedFrameList* aTrackedFrameList, vtkImageData* aReconstructedVolume);
+
+  /*! Emit progress change if the percent value has changed */
+  void SetProgress(int aPercent, const QString& aMessage);
+
+protected:
+  /*! Volume reconstructor (not owned) */
+  vtkPlusVolumeReconstructor* m_VolumeReconstructor;
+
+  /*! Frames to reconstruct from */
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> m_TrackedFrameList;
+
+  /*! Input sequence file name */
+  std::string m_InputFileName;
+
+  /*! Private copy of the transform repository */
+  vtkSmartPointer<vtkIGSIOTransformRepository> m_TransformRepository;
+
+  /*! Preview interval in percent */
+  int m_PreviewIntervalPercent;
+
+  /*! Last reported progress value */
+  int m_LastProgressPercent;
+
+  /*! Number of frame partitions inserted in parallel */
+  int m_NumberOfPartitions;
+
+  /*! Image coordinate frame name */
+  std::string m_ImageCoordinateFrame;
+
+  /*! Reference coordinate frame name */
+  std::string m_ReferenceCoordinateFrame;
+
+  /*! Flag indicating that the last result was merged from partitions */
+  bool m_ResultMergedFromPartitions;
+
+  /*! Flag indicating that frames are read from the input file one by one */
+  bool m_StreamFromFile;
+
+  /*! Latest partial volume */
+  vtkSmartPointer<vtkImageData> m_PreviewVolume;
+
+  /*! Result volume */
+  vtkSmartPointer<vtkImageData> m_ReconstructedVolume;
+
+  /*! Guards the preview and result volumes */
+  QMutex m_VolumeMutex;
+
+  /*! Set when cancellation is requested */
+  QAtomicInt m_CancelRequested;
+
+  /*! Set while a reconstruction is queued or running */
+  bool m_Running;
+
+  /*! Guards m_Running */
+  QMutex m_RunningMutex;
+
+  /*! Signalled when the reconstruction is finished */
+  QWaitCondition m_FinishedCondition;
+};
+
+#endif
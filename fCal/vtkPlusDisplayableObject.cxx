@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Local includes
 #include "vtkPlusDisplayableObject.h"
+#include "vtkPlusModelCache.h"
 
 // VTK includes
 #include <vtkActor.h>
@@ -13,7 +14,6 @@ See License.txt for details.
 #include <vtkPlusToolAxesActor.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkProperty.h>
-#include <vtkSTLReader.h>
 #include <vtkCylinderSource.h>
 #include <vtkConeSource.h>
 #include <vtkAppendPolyData.h>
@@ -460,10 +460,14 @@ PlusStatus vtkDisplayableModel::ReadConfiguration(vtkXMLDataElement* aConfig)
 
   if (this->STLModelFileName != NULL)
   {
-    vtkSmartPointer<vtkSTLReader> stlReader = vtkSmartPointer<vtkSTLReader>::New();
-    stlReader->SetFileName(this->STLModelFileName);
-    stlReader->Update();
-    SetPolyData(stlReader->GetOutput());
+    // Models are shared between all displayable objects that use the same file, so it is parsed only once
+    vtkSmartPointer<vtkPolyData> modelPolyData;
+    if (vtkPlusModelCache::GetInstance()->GetModel(this->STLModelFileName, modelPolyData) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to load model file for displayable object '" << objectId << "': " << this->STLModelFileName);
+      return PLUS_FAIL;
+    }
+    SetPolyData(modelPolyData);
     mapper->SetInputData(this->PolyData);
   }
 
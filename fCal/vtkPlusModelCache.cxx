@@ -0,0 +1,153 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "vtkPlusModelCache.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataReader.h>
+#include <vtkPolyDataWriter.h>
+#include <vtkSTLReader.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <functional>
+#include <sstream>
+
+//-----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusModelCache);
+
+//-----------------------------------------------------------------------------
+vtkPlusModelCache* vtkPlusModelCache::GetInstance()
+{
+  static vtkSmartPointer<vtkPlusModelCache> instance = vtkSmartPointer<vtkPlusModelCache>::New();
+  return instance;
+}
+
+//-----------------------------------------------------------------------------
+vtkPlusModelCache::vtkPlusModelCache()
+  : PreprocessedCacheDirectory("")
+  , Mutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+{
+}
+
+//-----------------------------------------------------------------------------
+vtkPlusModelCache::~vtkPlusModelCache()
+{
+  this->Models.clear();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusModelCache::Clear()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> lock(this->Mutex);
+  this->Models.clear();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusModelCache::GetModel(const std::string& aModelFileFullPath, vtkSmartPointer<vtkPolyData>& aPolyData)
+{
+  LOG_TRACE("vtkPlusModelCache::GetModel(" << aModelFileFullPath << ")");
+
+  std::string resolvedPath = vtksys::SystemTools::CollapseFullPath(aModelFileFullPath);
+  if (!vtksys::SystemTools::FileExists(resolvedPath, true))
+  {
+    LOG_ERROR("Model file does not exist: " << resolvedPath);
+    return PLUS_FAIL;
+  }
+  long int modifiedTime = vtksys::SystemTools::ModifiedTime(resolvedPath);
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> lock(this->Mutex);
+
+  std::map<std::string, CacheEntry>::iterator entryIt = this->Models.find(resolvedPath);
+  if (entryIt != this->Models.end() && entryIt->second.ModifiedTime == modifiedTime)
+  {
+    LOG_DEBUG("Model " << resolvedPath << " found in cache");
+    aPolyData = entryIt->second.PolyData;
+    return PLUS_SUCCESS;
+  }
+
+  vtkSmartPointer<vtkPolyData> polyData;
+  if (this->ReadModel(resolvedPath, modifiedTime, polyData) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  CacheEntry entry;
+  entry.ModifiedTime = modifiedTime;
+  entry.PolyData = polyData;
+  this->Models[resolvedPath] = entry;
+
+  aPolyData = polyData;
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusModelCache::ReadModel(const std::string& aModelFileFullPath, long int aModifiedTime, vtkSmartPointer<vtkPolyData>& aPolyData)
+{
+  std::string preprocessedFilePath;
+  if (!this->PreprocessedCacheDirectory.empty())
+  {
+    preprocessedFilePath = this->GetPreprocessedFilePath(aModelFileFullPath, aModifiedTime);
+    if (vtksys::SystemTools::FileExists(preprocessedFilePath, true))
+    {
+      vtkSmartPointer<vtkPolyDataReader> preprocessedReader = vtkSmartPointer<vtkPolyDataReader>::New();
+      preprocessedReader->SetFileName(preprocessedFilePath.c_str());
+      preprocessedReader->Update();
+      if (preprocessedReader->GetErrorCode() == 0 && preprocessedReader->GetOutput()->GetNumberOfPoints() > 0)
+      {
+        LOG_DEBUG("Model " << aModelFileFullPath << " loaded from preprocessed file " << preprocessedFilePath);
+        aPolyData = preprocessedReader->GetOutput();
+        return PLUS_SUCCESS;
+      }
+      LOG_WARNING("Failed to read preprocessed model file " << preprocessedFilePath << ". Reading the original model file instead.");
+    }
+  }
+
+  vtkSmartPointer<vtkSTLReader> stlReader = vtkSmartPointer<vtkSTLReader>::New();
+  stlReader->SetFileName(aModelFileFullPath.c_str());
+  stlReader->Update();
+  if (stlReader->GetErrorCode() != 0)
+  {
+    LOG_ERROR("Failed to read model file " << aModelFileFullPath);
+    return PLUS_FAIL;
+  }
+  aPolyData = stlReader->GetOutput();
+
+  if (!preprocessedFilePath.empty())
+  {
+    if (!vtksys::SystemTools::MakeDirectory(this->PreprocessedCacheDirectory))
+    {
+      LOG_WARNING("Unable to create preprocessed model cache directory " << this->PreprocessedCacheDirectory);
+      return PLUS_SUCCESS;
+    }
+    vtkSmartPointer<vtkPolyDataWriter> preprocessedWriter = vtkSmartPointer<vtkPolyDataWriter>::New();
+    preprocessedWriter->SetFileName(preprocessedFilePath.c_str());
+    preprocessedWriter->SetFileTypeToBinary();
+    preprocessedWriter->SetInputData(aPolyData);
+    if (preprocessedWriter->Write() == 0)
+    {
+      LOG_WARNING("Unable to write preprocessed model file " << preprocessedFilePath);
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkPlusModelCache::GetPreprocessedFilePath(const std::string& aModelFileFullPath, long int aModifiedTime)
+{
+  // Models with the same name may exist in different directories, so the name is made unique by a hash of the full path.
+  // The modification time is part of the name, so a stale preprocessed file is never used.
+  std::ostringstream fileName;
+  fileName << vtksys::SystemTools::GetFilenameWithoutLastExtension(aModelFileFullPath)
+           << "_" << std::hex << std::hash<std::string>()(aModelFileFullPath)
+           << "_" << std::dec << aModifiedTime << ".vtk";
+  return this->PreprocessedCacheDirectory + "/" + fileName.str();
+}
@@ -0,0 +1,92 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusModelCache_h
+#define __vtkPlusModelCache_h
+
+// PlusLib includes
+#include <PlusConfigure.h>
+#include <vtkIGSIORecursiveCriticalSection.h>
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <map>
+
+class vtkPolyData;
+
+//-----------------------------------------------------------------------------
+
+/*! \class vtkPlusModelCache
+ * \brief Process-wide cache of surface models loaded from STL files
+ *
+ * Models are keyed by their resolved full path and the modification time of the file, so a model file
+ * that is referenced by multiple displayable objects or loaded again on reconnect is parsed only once.
+ * The returned poly data is shared between all users and must not be modified in place.
+ *
+ * If a preprocessed cache directory is set then each parsed model is also stored in binary VTK format
+ * in that directory, which is much faster to load than STL on the next start of the application.
+ * \ingroup PlusAppCommonWidgets
+ */
+class vtkPlusModelCache : public vtkObject
+{
+public:
+  vtkTypeMacro(vtkPlusModelCache, vtkObject);
+  static vtkPlusModelCache* New();
+
+  /*! Get the process-wide instance */
+  static vtkPlusModelCache* GetInstance();
+
+  /*!
+  * Get the poly data of a model file. The file is only read if it is not in the cache yet or it has been modified since.
+  * \param aModelFileFullPath Full path of the STL model file
+  * \param aPolyData Shared poly data of the model (output)
+  */
+  PlusStatus GetModel(const std::string& aModelFileFullPath, vtkSmartPointer<vtkPolyData>& aPolyData);
+
+  /*! Remove all models from the in-memory cache (the preprocessed files are kept) */
+  void Clear();
+
+  /*! Set directory where the preprocessed models are stored. Empty string disables the preprocessed cache. */
+  vtkSetMacro(PreprocessedCacheDirectory, std::string);
+  /*! Get directory where the preprocessed models are stored */
+  vtkGetMacro(PreprocessedCacheDirectory, std::string);
+
+protected:
+  /*! Read an STL file, or its preprocessed version if it is up-to-date */
+  PlusStatus ReadModel(const std::string& aModelFileFullPath, long int aModifiedTime, vtkSmartPointer<vtkPolyData>& aPolyData);
+
+  /*! Get the path of the preprocessed file that belongs to a model file */
+  std::string GetPreprocessedFilePath(const std::string& aModelFileFullPath, long int aModifiedTime);
+
+protected:
+  vtkPlusModelCache();
+  virtual ~vtkPlusModelCache();
+
+protected:
+  struct CacheEntry
+  {
+    long int ModifiedTime;
+    vtkSmartPointer<vtkPolyData> PolyData;
+  };
+
+  /*! Cached models, keyed by the resolved full path of the model file */
+  std::map<std::string, CacheEntry> Models;
+
+  /*! Directory of the preprocessed models. Empty if the preprocessed cache is disabled. */
+  std::string PreprocessedCacheDirectory;
+
+  /*! Mutex guarding the cache */
+  vtkSmartPointer<vtkIGSIORecursiveCriticalSection> Mutex;
+
+private:
+  vtkPlusModelCache(const vtkPlusModelCache&);
+  void operator=(const vtkPlusModelCache&);
+};
+
+#endif